@@ -0,0 +1,466 @@
+/* FCE Ultra Network Play Server load test
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* Connects a number of simulated clients to a server, grouped into games, and has
+   them send input like the emulator does.  Reports how many updates per second the
+   clients get and how regularly they arrive.
+*/
+
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#include <vector>
+
+#include "types.h"
+#include "md5.h"
+
+#if defined (__APPLE__) || defined(BSD)
+#define MSG_NOSIGNAL SO_NOSIGPIPE
+#define SOL_TCP IPPROTO_TCP
+#endif
+
+typedef struct
+{
+	int TCPSocket;
+	int game;
+	int localplayers;
+	int loggedin;          /* Got the frame divisor, login sent. */
+	int protocol;          /* Protocol version the server switched us to. */
+	int confirm;           /* Server switched protocols, tell it our input does too. */
+
+	uint8 inbuf[4096];     /* Unparsed data from the server. */
+	uint32 inlen;
+	uint32 skip;           /* Payload bytes of the current command left to skip. */
+
+	uint64 lastupdate;
+	uint64 updates;
+	uint64 maxinterval;
+	uint64 intervalsum;
+	uint64 commands;
+	uint64 received;       /* Bytes received after the login. */
+	uint64 sends;
+} TestClient;
+
+static int Divisor;        /* Frames per update, sent by the server. */
+static int WantProtocol = 2;
+
+static uint64 GetCurTime(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv,0);
+	return((uint64)tv.tv_sec*1000000 + tv.tv_usec);
+}
+
+static void en32(uint8 *buf, uint32 morp)
+{
+	buf[0]=morp;
+	buf[1]=morp>>8;
+	buf[2]=morp>>16;
+	buf[3]=morp>>24;
+}
+
+static uint32 de32(uint8 *morp)
+{
+	return(morp[0]|(morp[1]<<8)|(morp[2]<<16)|(morp[3]<<24));
+}
+
+static int SendAll(int s, uint8 *data, uint32 len)
+{
+	while(len)
+	{
+		int l = send(s, data, len, MSG_NOSIGNAL);
+
+		if(l == -1)
+		{
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				usleep(100);
+				continue;
+			}
+			return(0);
+		}
+		data += l;
+		len -= l;
+	}
+	return(1);
+}
+
+static int SendLogin(TestClient *client, uint8 *password, int n)
+{
+	char nick[32];
+	uint8 buf[4 + 16 + 16 + 64 + 1 + sizeof(nick)];
+	uint8 *bp = buf + 4;
+	struct md5_context md5;
+	char gameid[32];
+
+	sprintf(nick, "Tester%d", n);
+	sprintf(gameid, "loadtest game %d", client->game);
+
+	md5_starts(&md5);
+	md5_update(&md5, (uint8 *)gameid, strlen(gameid));
+	md5_finish(&md5, bp);
+	bp += 16;
+
+	if(password)
+		memcpy(bp, password, 16);
+	else
+		memset(bp, 0, 16);
+	bp += 16;
+
+	memset(bp, 0, 64);
+	bp[0] = WantProtocol;
+	bp += 64;
+
+	*bp = client->localplayers;
+	bp++;
+
+	memcpy(bp, nick, strlen(nick));
+	bp += strlen(nick);
+
+	en32(buf, bp - buf - 4);
+	return(SendAll(client->TCPSocket, buf, bp - buf));
+}
+
+/* Parses what the server sent.  Returns the number of updates received. */
+static int ParseInput(TestClient *client)
+{
+	uint8 *bp = client->inbuf;
+	uint32 len = client->inlen;
+	int updates = 0;
+
+	for(;;)
+	{
+		if(client->skip)
+		{
+			if(!len)
+				break;
+
+			uint32 l = client->skip < len ? client->skip : len;
+
+			client->skip -= l;
+			bp += l;
+			len -= l;
+			continue;
+		}
+		if(client->protocol >= 2)
+		{
+			/* An update is a length byte and the changes, 0xFF escapes a command. */
+			if(len < 1)
+				break;
+			if(bp[0] == 0xFF)
+			{
+				if(len < 6)
+					break;
+				client->commands++;
+				if(bp[5] & 0x80)
+					client->skip = de32(bp + 1);
+				bp += 6;
+				len -= 6;
+			}
+			else
+			{
+				if(len < 1u + bp[0])
+					break;
+				updates++;
+				len -= 1 + bp[0];
+				bp += 1 + bp[0];
+			}
+			continue;
+		}
+
+		if(len < 5)
+			break;
+
+		uint8 cmd = bp[4];
+
+		if(cmd == 0x83)
+		{
+			/* Switch to the protocol version that follows. */
+			if(len < 6)
+				break;
+			client->protocol = bp[5];
+			client->confirm = 1;
+			bp += 6;
+			len -= 6;
+			continue;
+		}
+		else if(cmd & 0x80)
+		{
+			/* Save state requests, text and the like. */
+			client->skip = de32(bp);
+			client->commands++;
+		}
+		else if(cmd)
+			client->commands++;
+		else
+			updates++;
+		bp += 5;
+		len -= 5;
+	}
+	memmove(client->inbuf, bp, len);
+	client->inlen = len;
+	return(updates);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *host = "127.0.0.1";
+	int port = 4046;
+	int numclients = 200;
+	int playersper = 2;
+	int seconds = 10;
+	uint8 *password = 0;
+	int i;
+
+	for(i=1; i<argc ;i++)
+	{
+		if(!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h"))
+		{
+			printf("Usage: %s [OPTION]...\n" ,argv[0]);
+			printf("Connects simulated clients to an FCE Ultra game server and reports\nhow it keeps up.\n\n");
+
+			printf("-h\t--help\t\tDisplays this help message.\n");
+			printf("-s\t--server\tServer to connect to. (default=%s)\n", host);
+			printf("-p\t--port\t\tPort to connect to. (default=%d)\n", port);
+			printf("-w\t--password\tServer password.\n");
+			printf("-n\t--clients\tNumber of clients to simulate. (default=%d)\n", numclients);
+			printf("-g\t--players\tNumber of clients per game, 1-4. (default=%d)\n", playersper);
+			printf("-d\t--duration\tSeconds to run for. (default=%d)\n", seconds);
+			printf("-v\t--protocol\tProtocol version to ask for, 1 or 2. (default=%d)\n", WantProtocol);
+			return -1;
+		}
+		if(i + 1 == argc)
+		{
+			printf("Invalid parameter: %s\n", argv[i]);
+			return -1;
+		}
+		if(!strcmp(argv[i], "--server") || !strcmp(argv[i], "-s"))
+			host = argv[++i];
+		else if(!strcmp(argv[i], "--port") || !strcmp(argv[i], "-p"))
+			port = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--clients") || !strcmp(argv[i], "-n"))
+			numclients = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--players") || !strcmp(argv[i], "-g"))
+			playersper = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--duration") || !strcmp(argv[i], "-d"))
+			seconds = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--protocol") || !strcmp(argv[i], "-v"))
+			WantProtocol = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--password") || !strcmp(argv[i], "-w"))
+		{
+			const char *pass = argv[++i];
+			struct md5_context md5;
+
+			password = (uint8 *)malloc(16);
+			md5_starts(&md5);
+			md5_update(&md5,(uint8*)pass,strlen(pass));
+			md5_finish(&md5,password);
+		}
+		else
+		{
+			printf("Invalid parameter: %s\n", argv[i]);
+			return -1;
+		}
+	}
+	if(numclients < 1 || playersper < 1 || playersper > 4 || seconds < 1)
+	{
+		puts("Invalid parameters.");
+		return -1;
+	}
+
+	struct hostent *phostentb;
+	struct sockaddr_in sockin;
+
+	memset(&sockin, 0, sizeof(sockin));
+	sockin.sin_family = AF_INET;
+	sockin.sin_port = htons(port);
+	if(!(phostentb = gethostbyname(host)))
+	{
+		printf("Error getting host network information.\n");
+		return -1;
+	}
+	memcpy(&sockin.sin_addr, phostentb->h_addr, phostentb->h_length);
+
+	std::vector<TestClient> clients(numclients);
+	std::vector<struct pollfd> pfds(numclients);
+
+	printf("Connecting %d clients to %s:%d... ", numclients, host, port);
+	fflush(stdout);
+	for(i=0; i<numclients; i++)
+	{
+		TestClient *client = &clients[i];
+		int tcpopt = 1;
+
+		memset(client, 0, sizeof(TestClient));
+		client->game = i / playersper;
+		client->localplayers = 1;
+		client->TCPSocket = socket(AF_INET, SOCK_STREAM, 0);
+		setsockopt(client->TCPSocket, SOL_TCP, TCP_NODELAY, &tcpopt, sizeof(int));
+
+		if(connect(client->TCPSocket, (struct sockaddr *)&sockin, sizeof(sockin)))
+		{
+			printf("Error: %s\n",strerror(errno));
+			return -1;
+		}
+		fcntl(client->TCPSocket, F_SETFL, fcntl(client->TCPSocket, F_GETFL) | O_NONBLOCK);
+
+		pfds[i].fd = client->TCPSocket;
+		pfds[i].events = POLLIN;
+	}
+	puts("Ok");
+
+	uint64 start = GetCurTime();
+	uint64 end = start + (uint64)seconds * 1000000;
+	uint64 now;
+	int connected = numclients;
+	int x;
+
+	while((now = GetCurTime()) < end && connected)
+	{
+		if(poll(&pfds[0], pfds.size(), 100) <= 0)
+			continue;
+
+		now = GetCurTime();
+		for(i=0; i<numclients; i++)
+		{
+			TestClient *client = &clients[i];
+
+			if(!(pfds[i].revents & (POLLIN | POLLERR | POLLHUP)))
+				continue;
+
+			int l = recv(client->TCPSocket, client->inbuf + client->inlen, sizeof(client->inbuf) - client->inlen, 0);
+
+			if(l <= 0)
+			{
+				if(l == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+					continue;
+				printf("Client %d disconnected.\n", i);
+				close(client->TCPSocket);
+				pfds[i].fd = -1;
+				connected--;
+				continue;
+			}
+			client->inlen += l;
+			client->received += l;
+
+			if(!client->loggedin)
+			{
+				/* The server first sends the frame divisor. */
+				client->loggedin = 1;
+				Divisor = client->inbuf[0];
+				client->inlen--;
+				memmove(client->inbuf, client->inbuf + 1, client->inlen);
+				if(!SendLogin(client, password, i))
+				{
+					printf("Client %d login failed.\n", i);
+					return -1;
+				}
+			}
+
+			int updates = ParseInput(client);
+
+			if(client->confirm)
+			{
+				/* 0xFF escape in place of the input, length, command and the version. */
+				uint8 buf[4 + 4 + 1 + 1];
+				uint8 *bp = buf + client->localplayers;
+
+				buf[0] = 0xFF;
+				en32(bp, 1);
+				bp[4] = 0x83;
+				bp[5] = client->protocol;
+				SendAll(client->TCPSocket, buf, client->localplayers + 6);
+				client->confirm = 0;
+				client->sends++;
+			}
+			if(!updates)
+				continue;
+
+			/* Answer each update with input, like the emulator does.  Protocol 2 sends the
+			   input of every frame of the update.  Buttons are held for 10 frames. */
+			uint8 joy[4 * 16];
+			int frames = (client->protocol >= 2) ? Divisor : 1;
+			int joylen = client->localplayers * frames;
+
+			for(x=0; x<joylen; x++)
+				joy[x] = ((client->updates * Divisor + x / client->localplayers) / 10 + i) & 0x7F;
+			for(x=0; x<updates; x++)
+			{
+				SendAll(client->TCPSocket, joy, joylen);
+				client->sends++;
+			}
+
+			if(client->lastupdate)
+			{
+				uint64 interval = now - client->lastupdate;
+
+				client->intervalsum += interval;
+				if(interval > client->maxinterval)
+					client->maxinterval = interval;
+			}
+			client->lastupdate = now;
+			client->updates += updates;
+		}
+	}
+
+	double elapsed = (GetCurTime() - start) / 1000000.0;
+	uint64 totalupdates = 0, maxinterval = 0, intervalsum = 0, intervals = 0, minupdates = ~(uint64)0;
+	uint64 commands = 0, received = 0, sends = 0;
+
+	for(i=0; i<numclients; i++)
+	{
+		TestClient *client = &clients[i];
+
+		totalupdates += client->updates;
+		commands += client->commands;
+		received += client->received;
+		sends += client->sends;
+		if(client->updates < minupdates)
+			minupdates = client->updates;
+		if(client->maxinterval > maxinterval)
+			maxinterval = client->maxinterval;
+		intervalsum += client->intervalsum;
+		if(client->updates)
+			intervals += client->updates - 1;
+		if(pfds[i].fd != -1)
+			close(client->TCPSocket);
+	}
+
+	printf("%d of %d clients connected after %.1f seconds.\n", connected, numclients, elapsed);
+	printf("Updates: %llu total, %.1f/sec per client, %.1f/sec slowest client.\n", (unsigned long long)totalupdates,
+		totalupdates / elapsed / numclients, minupdates / elapsed);
+	printf("Update interval: %.2f ms average, %.2f ms worst.\n",
+		intervals ? intervalsum / 1000.0 / intervals : 0.0, maxinterval / 1000.0);
+	printf("Per client: %.0f bytes/sec received, %.1f sends/sec.\n",
+		received / elapsed / numclients, sends / elapsed / numclients);
+	printf("Commands and messages: %llu\n", (unsigned long long)commands);
+	return 0;
+}
@@ -35,8 +35,18 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#define USE_EPOLL
+#else
+#include <poll.h>
+#endif
 
 #include <exception>
+#include <vector>
 
 #include "types.h"
 #include "md5.h"
@@ -47,6 +57,7 @@
 #define DEFAULT_MAX 100
 #define DEFAULT_TIMEOUT 5
 #define DEFAULT_FRAMEDIVISOR 1
+#define DEFAULT_THREADS 1
 #define DEFAULT_CONFIG "/etc/fceux-server.conf"
 
 // MSG_NOSIGNAL and SOL_TCP have been depreciated on osx
@@ -55,6 +66,13 @@
 #define SOL_TCP IPPROTO_TCP
 #endif
 
+#define MAX_OUTBUF 1048576 /* Clients with more unsent data than this are dropped. */
+#define MAX_EVENTS 256
+
+#define CMD_PROTOCOL 0x83      /* Switches a client to a protocol version. */
+#define PROTOCOL_VERSION 2     /* Newest protocol version spoken, see SendUpdate(). */
+#define MAX_BATCH 16           /* Most frames per update in protocol 2. */
+
 typedef struct {
 	uint32 id; /* mainly for faster referencing when pointed to from the Games
 	              entries.
@@ -70,12 +88,38 @@ typedef struct {
 	uint8 *nbtcp;
 	uint32 nbtcphas, nbtcplen;
 	uint32 nbtcptype;
+
+	/* Data queued for sending, outbuf[outpos] to outbuf[outlen]. */
+	uint8 *outbuf;
+	uint32 outpos, outlen, outcap;
+	int pollout;        /* Waiting for the socket to become writable. */
+	int dirty;          /* In its shard's list of clients to flush. */
+	int dead;           /* Killed, the entry is released at the end of the loop. */
+
+	int shard;          /* The shard whose thread owns this client. */
+	void *reserved;     /* Game reserved at login, until the client is in it. */
+	int loginindex;     /* Index in the list of clients logging in, -1 if not in it. */
+	uint8 loginid[16];  /* Login data kept until the client joins its game. */
+	uint8 loginextra[64];
+
+	int protocol;       /* Protocol version of what we send the client. */
+	int uplink;         /* Protocol version of what the client sends. */
+	uint8 sentjoy[4];   /* Last frame sent to the client, updates only carry changes. */
 } ClientEntry;
 
 typedef struct
 {
+	/* Under GamesLock. */
 	uint8 id[16];            /* Unique 128-bit identifier for this game session. */
+	int inuse;               /* The entry holds a game. */
+	int shard;               /* The shard the game runs on. */
+	int members;             /* Clients in the game. */
+	int pending;             /* Clients with a reservation that aren't in the game yet. */
+
+	/* The rest belongs to the game's shard. */
 	uint8 joybuf[5];         /* 4 player data + 1 command byte */
+	uint8 frames[MAX_BATCH][4]; /* Player data for each frame of the next update. */
+	uint8 sentjoy[4];        /* Last frame of the previous update. */
 	int MaxPlayers;          /* Maximum players for this game */
 	ClientEntry *Players[4]; /* Pointers to player data. */
 	int IsUnique[4];         /* Set to 1 if player is unique client, 0
@@ -103,6 +147,9 @@ typedef struct
 	                                2 = 30 updates/sec, etc. */
 	unsigned int Port;           /* The port to listen on. */
 	uint8 *Password;             /* The server password. */
+	unsigned int Threads;        /* The number of threads to run games on, games are
+	                                assigned to them by their id.
+	                             */
 } CONFIG;
 
 CONFIG ServerConfig;
@@ -111,6 +158,7 @@ int LoadConfigFile(const char *fn)
 {
 	FILE *fp;
 	ServerConfig.Port = ServerConfig.MaxClients = ServerConfig.ConnectTimeout = ServerConfig.FrameDivisor = ~0;
+	ServerConfig.Threads = DEFAULT_THREADS;
 	if(fp=fopen(fn,"rb"))
 	{
 		char buf[256];
@@ -124,6 +172,8 @@ int LoadConfigFile(const char *fn)
 				sscanf(buf,"%*s %d",&ServerConfig.FrameDivisor);
 			else if(!strncasecmp(buf,"port",strlen("port")))
 				sscanf(buf,"%*s %d",&ServerConfig.Port);
+			else if(!strncasecmp(buf,"threads",strlen("threads")))
+				sscanf(buf,"%*s %d",&ServerConfig.Threads);
 			else if(!strncasecmp(buf,"password",strlen("password")))
 			{
 				char *pass = 0;
@@ -156,8 +206,56 @@ int LoadConfigFile(const char *fn)
 	return(1);
 }
 
+
+/* Each shard runs an event loop on its own thread(shard 0 on the main thread) and
+   runs the games started on it.  Shard 0 also accepts new clients and handles their
+   login, then hands each client to the shard of its game.  A new game is started on
+   the shard running the fewest games.
+*/
+typedef struct
+{
+	int id;
+#ifdef USE_EPOLL
+	int epfd;
+#else
+	std::vector<struct pollfd> pfds;
+	std::vector<void *> pptrs;
+#endif
+	int wakefd[2];                      /* Written to when clients are handed to the shard. */
+	pthread_mutex_t lock;
+	std::vector<ClientEntry *> handoff; /* Clients waiting to join a game here, under lock. */
+
+	std::vector<GameEntry *> active;    /* Games with players. */
+
+	std::vector<ClientEntry *> dirty;   /* Clients with queued data. */
+	std::vector<ClientEntry *> dead;    /* Clients to release at the end of the loop. */
+	std::vector<ClientEntry *> logins;  /* Clients logging in(shard 0 only). */
+
+	uint64 nexttick;
+	pthread_t thread;
+} Shard;
+
+typedef struct
+{
+	void *ptr;
+	int readable, writable, error;
+} PollEvent;
+
 static ClientEntry *Clients;
 static GameEntry *Games;
+static Shard *Shards;
+
+/* Free entries of Clients, under ClientsLock. */
+static std::vector<ClientEntry *> FreeClients;
+static pthread_mutex_t ClientsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Free entries of Games and the number of games on each shard, under GamesLock. */
+static std::vector<GameEntry *> FreeGames;
+static std::vector<int> ShardGames;
+static pthread_mutex_t GamesLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Tags for the events that aren't about a client. */
+static char ListenTag, WakeTag;
 
 static void en32(uint8 *buf, uint32 morp)
 {
@@ -172,14 +270,176 @@ static uint32 de32(uint8 *morp)
 	return(morp[0]|(morp[1]<<8)|(morp[2]<<16)|(morp[3]<<24));
 }
 
+/* Finds the game with the id, or takes a free entry for it on the shard with the
+   fewest games, and reserves it for a client that is logging in.  Returns NULL if
+   no more games can be started.
+*/
+static GameEntry *ReserveGame(uint8 id[16])
+{
+	GameEntry *game = 0;
+	unsigned int x;
+
+	pthread_mutex_lock(&GamesLock);
+	for(x=0; x<ServerConfig.MaxClients; x++)
+	{
+		if(Games[x].inuse && !memcmp(Games[x].id,id,16))
+		{
+			game = &Games[x];
+			break;
+		}
+	}
+	if(!game && FreeGames.size())
+	{
+		int shard = 0;
+
+		for(x=1; x<ShardGames.size(); x++)
+			if(ShardGames[x] < ShardGames[shard])
+				shard = x;
+
+		game = FreeGames.back();
+		FreeGames.pop_back();
+		game->inuse = 1;
+		game->shard = shard;
+		memcpy(game->id, id, 16);
+		ShardGames[shard]++;
+	}
+	if(game)
+		game->pending++;
+	pthread_mutex_unlock(&GamesLock);
+	return(game);
+}
+
+/* Drops a reservation(member = 0) or a client that was in the game(member = 1).  The
+   entry is freed when no client is in the game or has it reserved; the game's shard
+   must have stopped the game by then.
+*/
+static void UnrefGame(GameEntry *game, int member)
+{
+	pthread_mutex_lock(&GamesLock);
+	if(member)
+		game->members--;
+	else
+		game->pending--;
+	if(!game->members && !game->pending)
+	{
+		ShardGames[game->shard]--;
+		memset(game, 0, sizeof(GameEntry));
+		FreeGames.push_back(game);
+	}
+	pthread_mutex_unlock(&GamesLock);
+}
+
+/* Clears the part of a game that belongs to its shard. */
+static void ResetGame(GameEntry *game)
+{
+	memset(game->joybuf, 0, sizeof(GameEntry) - offsetof(GameEntry, joybuf));
+}
+
 static char *CleanNick(char *nick);
 static int NickUnique(ClientEntry *client);
-static void AddClientToGame(ClientEntry *client, uint8 id[16], uint8 extra[64]) throw();
-static void SendToAll(GameEntry *game, int cmd, uint8 *data, uint32 len) throw();
-static void BroadcastText(GameEntry *game, const char *fmt, ...) throw();
-static void TextToClient(ClientEntry *client, const char *fmt, ...) throw();
+static void AddClientToGame(ClientEntry *client);
+static void JoinGame(ClientEntry *client);
+static void HandOffClient(ClientEntry *client, int shard);
+static void SendCommand(ClientEntry *client, int cmd, uint8 *data, uint32 len);
+static void SendToAll(GameEntry *game, int cmd, uint8 *data, uint32 len);
+static void BroadcastText(GameEntry *game, const char *fmt, ...);
+static void TextToClient(ClientEntry *client, const char *fmt, ...);
 static void KillClient(ClientEntry *client);
 
+static void PollerInit(Shard *shard)
+{
+#ifdef USE_EPOLL
+	shard->epfd = epoll_create(64);
+	if(shard->epfd == -1)
+	{
+		printf("epoll_create failed: %s\n",strerror(errno));
+		exit(-1);
+	}
+#endif
+}
+
+static void PollerSet(Shard *shard, int fd, void *ptr, int writable, int add)
+{
+#ifdef USE_EPOLL
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | (writable ? EPOLLOUT : 0);
+	ev.data.ptr = ptr;
+	epoll_ctl(shard->epfd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev);
+#else
+	size_t x;
+
+	for(x=0; x<shard->pfds.size(); x++)
+		if(shard->pfds[x].fd == fd)
+			break;
+	if(x == shard->pfds.size())
+	{
+		struct pollfd pfd;
+
+		pfd.fd = fd;
+		shard->pfds.push_back(pfd);
+		shard->pptrs.push_back(ptr);
+	}
+	shard->pfds[x].events = POLLIN | (writable ? POLLOUT : 0);
+	shard->pfds[x].revents = 0;
+#endif
+}
+
+static void PollerDel(Shard *shard, int fd)
+{
+#ifdef USE_EPOLL
+	struct epoll_event ev;
+
+	epoll_ctl(shard->epfd, EPOLL_CTL_DEL, fd, &ev);
+#else
+	for(size_t x=0; x<shard->pfds.size(); x++)
+	{
+		if(shard->pfds[x].fd == fd)
+		{
+			shard->pfds.erase(shard->pfds.begin() + x);
+			shard->pptrs.erase(shard->pptrs.begin() + x);
+			break;
+		}
+	}
+#endif
+}
+
+static int PollerWait(Shard *shard, PollEvent *events, int timeout)
+{
+	int n = 0;
+#ifdef USE_EPOLL
+	struct epoll_event ev[MAX_EVENTS];
+	int count = epoll_wait(shard->epfd, ev, MAX_EVENTS, timeout);
+
+	for(int x=0; x<count; x++)
+	{
+		events[n].ptr = ev[x].data.ptr;
+		events[n].readable = (ev[x].events & EPOLLIN) != 0;
+		events[n].writable = (ev[x].events & EPOLLOUT) != 0;
+		events[n].error = (ev[x].events & (EPOLLERR | EPOLLHUP)) != 0;
+		n++;
+	}
+#else
+	if(poll(&shard->pfds[0], shard->pfds.size(), timeout) > 0)
+	{
+		for(size_t x=0; x<shard->pfds.size() && n<MAX_EVENTS; x++)
+		{
+			short re = shard->pfds[x].revents;
+
+			if(!re)
+				continue;
+			events[n].ptr = shard->pptrs[x];
+			events[n].readable = (re & POLLIN) != 0;
+			events[n].writable = (re & POLLOUT) != 0;
+			events[n].error = (re & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+			n++;
+		}
+	}
+#endif
+	return(n);
+}
+
 #define NBTCP_LOGINLEN      0x100
 #define NBTCP_LOGIN         0x200
 #define NBTCP_COMMANDLEN    0x300
@@ -195,6 +455,14 @@ static void StartNBTCPReceive(ClientEntry *client, uint32 type, uint32 len)
 	client->nbtcptype = type;
 }
 
+/* Frames of input per update, protocol 2 clients send every frame. */
+static int Batch;
+
+static void StartUpdateReceive(ClientEntry *client)
+{
+	StartNBTCPReceive(client, NBTCP_UPDATEDATA, client->localplayers * (client->uplink >= 2 ? Batch : 1));
+}
+
 static void RedoNBTCPReceive(ClientEntry *client)
 {
 	client->nbtcphas = 0;
@@ -211,7 +479,7 @@ static void EndNBTCPReceive(ClientEntry *client)
 
 static uint8 *MakeMPS(ClientEntry *client)
 {
-	static uint8 buf[64];
+	static __thread uint8 buf[64];
 	uint8 *bp = buf;
 	int x;
 	GameEntry *game = (GameEntry *)client->game;
@@ -233,7 +501,7 @@ static uint8 *MakeMPS(ClientEntry *client)
 }
 
 /* Returns 1 if we are back to normal game mode, 0 if more data is yet to arrive. */
-static int CheckNBTCPReceive(ClientEntry *client) throw()
+static int CheckNBTCPReceive(ClientEntry *client)
 {
 	if(!client->nbtcplen)
 		throw(1); /* Should not happen. */
@@ -262,18 +530,22 @@ static int CheckNBTCPReceive(ClientEntry *client) throw()
 			case NBTCP_UPDATEDATA:
 				{
 					GameEntry *game = (GameEntry *)client->game;
-					int x, wx;
+					int x, wx, f;
+					int perframe = (client->uplink >= 2) ? client->localplayers : 0;
 					if(client->nbtcp[0] == 0xFF)
 					{
 						EndNBTCPReceive(client);
 						StartNBTCPReceive(client, NBTCP_COMMANDLEN, 5);
 						return(1);
 					}
+					/* Protocol 1 clients only send one frame, it's used for the whole update. */
 					for(x=0,wx=0; x < 4; x++)
 					{
 						if(game->Players[x] == client)
 						{
-							game->joybuf[x] = client->nbtcp[wx];
+							for(f=0; f < Batch; f++)
+								game->frames[f][x] = client->nbtcp[f * perframe + wx];
+							game->joybuf[x] = game->frames[Batch - 1][x];
 							wx++;
 						}
 					}
@@ -292,7 +564,7 @@ static int CheckNBTCPReceive(ClientEntry *client) throw()
 					{
 						SendToAll((GameEntry*)client->game, client->nbtcp[4], 0, 0);
 						EndNBTCPReceive(client);
-						StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
+						StartUpdateReceive(client);
 					}
 					else if(client->nbtcp[4]&0x80)
 					{
@@ -305,7 +577,7 @@ static int CheckNBTCPReceive(ClientEntry *client) throw()
 						{
 							/* Woops.  Client probably tried to send a text message of 0 length.
 							   Or maybe a 0-length cheat file?  Better be safe! */
-							StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
+							StartUpdateReceive(client);
 						}
 					}
 					else throw(1);
@@ -316,7 +588,13 @@ static int CheckNBTCPReceive(ClientEntry *client) throw()
 					len = client->nbtcplen;
 					uint32 tocmd = client->nbtcptype & 0xFF;
 
-					if(tocmd == 0x90) /* Text */
+					if(tocmd == CMD_PROTOCOL)
+					{
+						/* The client's input switches to the protocol we switched it to. */
+						if(len == 1 && client->protocol >= 2 && client->nbtcp[0] == client->protocol)
+							client->uplink = client->protocol;
+					}
+					else if(tocmd == 0x90) /* Text */
 					{
 						char *ma, *ma2;
 
@@ -335,7 +613,7 @@ static int CheckNBTCPReceive(ClientEntry *client) throw()
 						SendToAll((GameEntry*)client->game, tocmd, client->nbtcp, len);
 					}
 					EndNBTCPReceive(client);
-					StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
+					StartUpdateReceive(client);
 					return(1);
 				}
 			case NBTCP_LOGINLEN:
@@ -348,15 +626,13 @@ static int CheckNBTCPReceive(ClientEntry *client) throw()
 			case NBTCP_LOGIN:
 				{
 					uint32 len;
-					uint8 gameid[16];
 					uint8 *sexybuf;
-					uint8 extra[64];
 
 					len = client->nbtcplen;
 					sexybuf = client->nbtcp;
 
 					/* Game ID(MD5'd game MD5 and password on client side). */
-					memcpy(gameid, sexybuf, 16);
+					memcpy(client->loginid, sexybuf, 16);
 					sexybuf += 16;
 					len -= 16;
 
@@ -369,7 +645,7 @@ static int CheckNBTCPReceive(ClientEntry *client) throw()
 					sexybuf += 16;
 					len -= 16;
 
-					memcpy(extra, sexybuf, 64);
+					memcpy(client->loginextra, sexybuf, 64);
 					sexybuf += 64;
 					len -= 64;
 
@@ -379,60 +655,52 @@ static int CheckNBTCPReceive(ClientEntry *client) throw()
 						TextToClient(client,"Invalid number(%d) of local players!",client->localplayers);
 						throw(1);
 					}
+
+					/* Newer clients ask for a protocol version in the first byte of the
+					   expansion data, older ones send 0.  Everything after the reply is
+					   sent in the new protocol. */
+					if(client->loginextra[0] >= 2 && ServerConfig.FrameDivisor <= MAX_BATCH)
+					{
+						uint8 version = PROTOCOL_VERSION;
+
+						SendCommand(client, CMD_PROTOCOL, &version, 1);
+						client->protocol = version;
+					}
 					sexybuf++;
 					len -= 1;
 
-					AddClientToGame(client, gameid, extra);
-					/* Get the nickname */
+					/* Get the nickname, it's checked once the client is in its game. */
 					if(len)
 					{
 						client->nickname = (char *)malloc(len + 1);
 						memcpy(client->nickname, sexybuf, len);
 						client->nickname[len] = 0;
-						if((client->nickname = CleanNick(client->nickname)))
-						if(!NickUnique(client)) /* Nickname already exists */
-						{
-							free(client->nickname);
-							client->nickname = 0;
-						}
 					}
-					uint8 *mps = MakeMPS(client);
-
-					if(!client->nickname)
-						asprintf(&client->nickname,"*Player %s",mps);
 
-					printf("Client %d assigned to game %d as player %s <%s>\n",client->id,(GameEntry*)client->game - Games,mps, client->nickname);
-
-					int x;
-					GameEntry *tg=(GameEntry *)client->game;
+					EndNBTCPReceive(client);
+					StartUpdateReceive(client);
 
-					for(x=0; x<tg->MaxPlayers; x++)
+					GameEntry *game = ReserveGame(client->loginid);
+					if(!game)
 					{
-						if(tg->Players[x] && tg->IsUnique[x])
-						{
-							if(tg->Players[x] != client)
-							{
-								try
-								{
-									TextToClient(tg->Players[x], "* Player %s has just connected as: %s",MakeMPS(client),client->nickname);
-								}
-								catch(int i)
-								{
-									KillClient(tg->Players[x]);
-								}
-								TextToClient(client, "* Player %s is already connected as: %s",MakeMPS(tg->Players[x]),tg->Players[x]->nickname);
-							}
-							else
-								TextToClient(client, "* You(Player %s) have just connected as: %s",MakeMPS(client),client->nickname);
-						}
+						TextToClient(client, "Sorry, no more games can be started on this server.");
+						throw(1);
 					}
+					client->reserved = (void *)game;
+					if(game->shard != client->shard)
+					{
+						/* The client belongs to another thread from now on. */
+						HandOffClient(client, game->shard);
+						return(0);
+					}
+					JoinGame(client);
 				}
-				EndNBTCPReceive(client);
-				StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
 				return(1);
 			}
 		}
 	}
+	if(!l)
+		throw(1); /* Connection closed. */
 	return(0);
 }
 
@@ -469,20 +737,87 @@ static int NickUnique(ClientEntry *client)
 	return(1);
 }
 
-static int MakeSendTCP(ClientEntry *client, uint8 *data, uint32 len) throw()
+/* Queues data for the client, it's sent when the shard flushes its clients. */
+static int MakeSendTCP(ClientEntry *client, uint8 *data, uint32 len)
 {
-	if(send(client->TCPSocket, data, len, MSG_NOSIGNAL) != len)
+	if(client->dead || (client->outlen - client->outpos + len) > MAX_OUTBUF)
 		throw(1);
 
+	if(client->outlen + len > client->outcap)
+	{
+		/* Move the unsent data to the front before growing the buffer. */
+		client->outlen -= client->outpos;
+		memmove(client->outbuf, client->outbuf + client->outpos, client->outlen);
+		client->outpos = 0;
+
+		if(client->outlen + len > client->outcap)
+		{
+			uint32 cap = client->outcap ? client->outcap : 256;
+
+			while(cap < client->outlen + len)
+				cap *= 2;
+			client->outbuf = (uint8 *)realloc(client->outbuf, cap);
+			client->outcap = cap;
+		}
+	}
+	memcpy(client->outbuf + client->outlen, data, len);
+	client->outlen += len;
+
+	if(!client->dirty)
+	{
+		client->dirty = 1;
+		Shards[client->shard].dirty.push_back(client);
+	}
 	return(1);
 }
 
-static void SendToAll(GameEntry *game, int cmd, uint8 *data, uint32 len) throw()
+/* Sends as much of the queued data as the socket takes. */
+static void FlushClient(ClientEntry *client)
 {
-	uint8 poo[5];
-	int x;
+	while(client->outpos < client->outlen)
+	{
+		int l = send(client->TCPSocket, client->outbuf + client->outpos, client->outlen - client->outpos, MSG_NOSIGNAL);
+
+		if(l == -1)
+		{
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			throw(1);
+		}
+		client->outpos += l;
+	}
+	if(client->outpos == client->outlen)
+		client->outpos = client->outlen = 0;
 
-	poo[4] = cmd;
+	int pollout = (client->outlen != 0);
+	if(pollout != client->pollout)
+	{
+		client->pollout = pollout;
+		PollerSet(&Shards[client->shard], client->TCPSocket, client, pollout, 0);
+	}
+}
+
+/* Queues a command for the client, commands with bit 7 set carry data.  Protocol 2
+   clients get it after a 0xFF escape.
+*/
+static void SendCommand(ClientEntry *client, int cmd, uint8 *data, uint32 len)
+{
+	uint8 poo[6];
+	uint8 *pp = poo;
+
+	if(client->protocol >= 2)
+		*pp++ = 0xFF;
+	en32(pp, (cmd & 0x80) ? len : 0);
+	pp[4] = cmd;
+	MakeSendTCP(client, poo, pp + 5 - poo);
+
+	if((cmd & 0x80) && len)
+		MakeSendTCP(client, data, len);
+}
+
+static void SendToAll(GameEntry *game, int cmd, uint8 *data, uint32 len)
+{
+	int x;
 
 	for(x=0;x<game->MaxPlayers;x++)
 	{
@@ -490,14 +825,7 @@ static void SendToAll(GameEntry *game, int cmd, uint8 *data, uint32 len) throw()
 
 		try
 		{
-			if(cmd & 0x80)
-				en32(poo, len);
-			MakeSendTCP(game->Players[x],poo,5);
-
-			if(cmd & 0x80)
-			{
-				MakeSendTCP(game->Players[x], data, len);
-			}
+			SendCommand(game->Players[x], cmd, data, len);
 		}
 		catch(int i)
 		{
@@ -506,7 +834,7 @@ static void SendToAll(GameEntry *game, int cmd, uint8 *data, uint32 len) throw()
 	}
 }
 
-static void TextToClient(ClientEntry *client, const char *fmt, ...) throw()
+static void TextToClient(ClientEntry *client, const char *fmt, ...)
 {
 	char *moo;
 	va_list ap;
@@ -516,19 +844,19 @@ static void TextToClient(ClientEntry *client, const char *fmt, ...) throw()
 	va_end(ap);
 
 
-	uint8 poo[5];
-	uint32 len;
-
-	poo[4] = 0x90;
-	len = strlen(moo);
-	en32(poo, len);
-
-	MakeSendTCP(client, poo, 5);
-	MakeSendTCP(client, (uint8*)moo, len);
+	try
+	{
+		SendCommand(client, 0x90, (uint8*)moo, strlen(moo));
+	}
+	catch(int i)
+	{
+		free(moo);
+		throw;
+	}
 	free(moo);
 }
 
-static void BroadcastText(GameEntry *game, const char *fmt, ...) throw()
+static void BroadcastText(GameEntry *game, const char *fmt, ...)
 {
 	char *moo;
 	va_list ap;
@@ -541,12 +869,52 @@ static void BroadcastText(GameEntry *game, const char *fmt, ...) throw()
 	free(moo);
 }
 
+static void RemoveLogin(ClientEntry *client)
+{
+	if(client->loginindex < 0)
+		return;
+
+	std::vector<ClientEntry *> &logins = Shards[0].logins;
+
+	logins[client->loginindex] = logins.back();
+	logins[client->loginindex]->loginindex = client->loginindex;
+	logins.pop_back();
+	client->loginindex = -1;
+}
+
+/* Takes a game nobody is in anymore off its shard. */
+static void StopGame(Shard *shard, GameEntry *game)
+{
+	printf("Game %d destroyed.\n",(int)(game-Games));
+	ResetGame(game);
+
+	for(size_t x=0; x<shard->active.size(); x++)
+	{
+		if(shard->active[x] == game)
+		{
+			shard->active[x] = shard->active.back();
+			shard->active.pop_back();
+			break;
+		}
+	}
+}
+
 static void KillClient(ClientEntry *client)
 {
 	GameEntry *game;
+	Shard *shard;
 	uint8 *mps;
 	char *bmsg;
 
+	if(client->dead)
+		return;
+
+	shard = &Shards[client->shard];
+	if(client->reserved)
+	{
+		UnrefGame((GameEntry *)client->reserved, 0);
+		client->reserved = 0;
+	}
 	game = (GameEntry *)client->game;
 	if(game)
 	{
@@ -568,66 +936,76 @@ static void KillClient(ClientEntry *client)
 		                                  players for this client, destroy the game.
 		                               */
 		{
-			printf("Game %d destroyed.\n",game-Games);
-			memset(game, 0, sizeof(GameEntry));
+			StopGame(shard, game);
+			UnrefGame(game, 1);
 			game = 0;
+			free(bmsg);
 		}
+		else
+			UnrefGame(game, 1);
 	}
 	else
 	{
 		time_t curtime = time(0);
 		printf("Unassigned client %d disconnected on %s",client->id, ctime(&curtime));
+		RemoveLogin(client);
 	}
 
+	if(client->TCPSocket != -1)
+	{
+		PollerDel(shard, client->TCPSocket);
+		close(client->TCPSocket);
+	}
+
+	/* Other clients may still be handled in this loop iteration and refer to this one,
+	   so the entry is released at its end.
+	*/
+	client->dead = 1;
+	client->game = 0;
+	shard->dead.push_back(client);
+
+	if(game)
+	{
+		BroadcastText(game,"%s",bmsg);
+		free(bmsg);
+	}
+}
+
+static void ReleaseClient(ClientEntry *client)
+{
 	if(client->nbtcp)
 		free(client->nbtcp);
 
 	if(client->nickname)
 		free(client->nickname);
 
-	if(client->TCPSocket != -1)
-		close(client->TCPSocket);
+	if(client->outbuf)
+		free(client->outbuf);
 
 	memset(client, 0, sizeof(ClientEntry));
 	client->TCPSocket = -1;
+	client->loginindex = -1;
 
-	if(game)
-		BroadcastText(game,"%s",bmsg);
+	pthread_mutex_lock(&ClientsLock);
+	FreeClients.push_back(client);
+	pthread_mutex_unlock(&ClientsLock);
 }
 
-static void AddClientToGame(ClientEntry *client, uint8 id[16], uint8 extra[64]) throw()
+/* Puts the client in the game it reserved at login, which runs on this shard. */
+static void AddClientToGame(ClientEntry *client)
 {
-	int wg;
-	GameEntry *game,*fegame;
+	GameEntry *game = (GameEntry *)client->reserved;
+	Shard *shard = &Shards[client->shard];
 
 retry:
 
-	game = NULL;
-	fegame = NULL;
-
-	/* First, find an available game. */
-	for(wg=0; wg<ServerConfig.MaxClients; wg++)
-	{
-		if(!Games[wg].MaxPlayers && !fegame)
-		{
-			if(!fegame)
-				fegame=&Games[wg];
-		}
-		else if(!memcmp(Games[wg].id,id,16)) /* A match was found! */
-		{
-			game = &Games[wg];
-			break;
-		}
-	}
-
-	if(!game) /* Hmm, no game found.  Guess we'll have to create one. */
+	if(!game->MaxPlayers) /* Nobody's in the game, start it. */
 	{
-		game=fegame;
-		printf("Game %d added\n",game-Games);
-		memset(game, 0, sizeof(GameEntry));
+		printf("Game %d added\n",(int)(game-Games));
+		ResetGame(game);
 		game->MaxPlayers = 4;
-		memcpy(game->id, id, 16);
-		memcpy(game->ExtraInfo, extra, 64);
+		memcpy(game->ExtraInfo, client->loginextra, 64);
+		shard->active.push_back(game);
 	}
 
 	int n;
@@ -636,9 +1014,7 @@ retry:
 	{
 		try
 		{
-			uint8 b[5];
-			b[4] = 0x81;
-			MakeSendTCP(game->Players[n], b, 5);
+			SendCommand(game->Players[n], 0x81, 0, 0);
 			break;
 		}
 		catch(int i)
@@ -673,24 +1049,394 @@ retry:
 	/* Game is full. */
 	if(n == game->MaxPlayers)
 	{
+		int others = 0;
+
 		for(n=0; n<game->MaxPlayers; n++)
+		{
 			if(game->Players[n] == client)
 				game->Players[n] = 0;
+			else if(game->Players[n])
+				others++;
+		}
+		if(!others)
+			StopGame(shard, game);
 		TextToClient(client, "Sorry, game is full.  %d instance(s) tried, %d available.",client->localplayers,client->localplayers - instancecount);
 		throw(1);
 	}
 
 	client->game = (void *)game;
+	client->reserved = 0;
+
+	pthread_mutex_lock(&GamesLock);
+	game->members++;
+	game->pending--;
+	pthread_mutex_unlock(&GamesLock);
 }
 
+/* Puts a logged in client into its game, on the shard that owns the game. */
+static void JoinGame(ClientEntry *client)
+{
+	RemoveLogin(client);
+	AddClientToGame(client);
+
+	if(client->nickname)
+	{
+		if((client->nickname = CleanNick(client->nickname)))
+		if(!NickUnique(client)) /* Nickname already exists */
+		{
+			free(client->nickname);
+			client->nickname = 0;
+		}
+	}
+	uint8 *mps = MakeMPS(client);
+
+	if(!client->nickname)
+		asprintf(&client->nickname,"*Player %s",mps);
 
+	printf("Client %d assigned to game %d as player %s <%s>\n",client->id,(GameEntry*)client->game - Games,mps, client->nickname);
 
+	int x;
+	GameEntry *tg=(GameEntry *)client->game;
+
+	for(x=0; x<tg->MaxPlayers; x++)
+	{
+		if(tg->Players[x] && tg->IsUnique[x])
+		{
+			if(tg->Players[x] != client)
+			{
+				try
+				{
+					TextToClient(tg->Players[x], "* Player %s has just connected as: %s",MakeMPS(client),client->nickname);
+				}
+				catch(int i)
+				{
+					KillClient(tg->Players[x]);
+				}
+				TextToClient(client, "* Player %s is already connected as: %s",MakeMPS(tg->Players[x]),tg->Players[x]->nickname);
+			}
+			else
+				TextToClient(client, "* You(Player %s) have just connected as: %s",MakeMPS(client),client->nickname);
+		}
+	}
+}
+
+/* Moves a client that finished logging in on shard 0 to the shard of its game. */
+static void HandOffClient(ClientEntry *client, int shard)
+{
+	Shard *from = &Shards[client->shard];
+	Shard *to = &Shards[shard];
+
+	RemoveLogin(client);
+	PollerDel(from, client->TCPSocket);
+
+	if(client->dirty)
+	{
+		for(size_t x=0; x<from->dirty.size(); x++)
+		{
+			if(from->dirty[x] == client)
+			{
+				from->dirty.erase(from->dirty.begin() + x);
+				break;
+			}
+		}
+		client->dirty = 0;
+	}
+	client->shard = shard;
+
+	pthread_mutex_lock(&to->lock);
+	to->handoff.push_back(client);
+	pthread_mutex_unlock(&to->lock);
+
+	write(to->wakefd[1], "", 1);
+}
+
+/* Takes the clients handed to this shard and puts them in their games. */
+static void TakeHandOffs(Shard *shard)
+{
+	std::vector<ClientEntry *> clients;
+	char buf[64];
+
+	while(read(shard->wakefd[0], buf, sizeof(buf)) > 0) {};
+
+	pthread_mutex_lock(&shard->lock);
+	clients.swap(shard->handoff);
+	pthread_mutex_unlock(&shard->lock);
+
+	for(size_t x=0; x<clients.size(); x++)
+	{
+		ClientEntry *client = clients[x];
+
+		/* Queued data is sent when the shard flushes. */
+		if(client->outpos < client->outlen)
+		{
+			client->dirty = 1;
+			shard->dirty.push_back(client);
+		}
+		client->pollout = 0;
+		PollerSet(shard, client->TCPSocket, client, 0, 1);
+
+		try
+		{
+			JoinGame(client);
+			while(CheckNBTCPReceive(client)) {};
+		}
+		catch(int i)
+		{
+			KillClient(client);
+		}
+	}
+}
+
+static void AcceptClients(Shard *shard)
+{
+	struct sockaddr_in sockin;
+	socklen_t sockin_len;
+	int s;
+
+	for(;;)
+	{
+		sockin_len = sizeof(sockin);
+		if((s = accept(ListenSocket, (struct sockaddr *)&sockin, &sockin_len)) == -1)
+			break;
+
+		ClientEntry *client = 0;
+
+		pthread_mutex_lock(&ClientsLock);
+		if(FreeClients.size())
+		{
+			client = FreeClients.back();
+			FreeClients.pop_back();
+		}
+		pthread_mutex_unlock(&ClientsLock);
+
+		if(!client)
+		{
+			printf("Client from %s refused, server is full\n",inet_ntoa(sockin.sin_addr));
+			close(s);
+			continue;
+		}
+
+		/* We have a new client.  Yippie. */
+		int tcpopt = 1;
+		setsockopt(s, SOL_TCP, TCP_NODELAY, &tcpopt, sizeof(int));
+		fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+
+		client->TCPSocket = s;
+		client->timeconnect = time(0);
+		client->id = client - Clients;
+		client->shard = shard->id;
+		printf("Client %d connecting from %s on %s",client->id,inet_ntoa(sockin.sin_addr),ctime(&client->timeconnect));
+
+		client->loginindex = shard->logins.size();
+		shard->logins.push_back(client);
+		PollerSet(shard, s, client, 0, 1);
+
+		try
+		{
+			uint8 buf[1];
+
+			buf[0] = ServerConfig.FrameDivisor;
+			MakeSendTCP(client, buf, 1);
+		}
+		catch(int i)
+		{
+			KillClient(client);
+			continue;
+		}
+		StartNBTCPReceive(client, NBTCP_LOGINLEN, 4);
+	}
+}
+
+/* Drops the clients that haven't logged in within the timeout. */
+static void CheckLogins(Shard *shard)
+{
+	time_t curtime = time(0);
+
+	for(size_t n = 0; n < shard->logins.size();)
+	{
+		ClientEntry *client = shard->logins[n];
+
+		if((client->timeconnect + ServerConfig.ConnectTimeout) < curtime)
+			KillClient(client); /* Removes it from the list. */
+		else
+			n++;
+	}
+}
+
+/* Encodes the game's next update for a protocol 2 client that last got prev.  An update
+   is a length byte followed, for each frame, by a byte with bit n set if player n's data
+   changed from the frame before and the new data of those players.
+*/
+static uint32 EncodeUpdate(GameEntry *game, uint8 *prev, uint8 *buf)
+{
+	uint8 *bp = buf + 1;
+	int f, x;
+
+	for(f = 0; f < Batch; f++)
+	{
+		uint8 *mask = bp++;
+
+		*mask = 0;
+		for(x = 0; x < 4; x++)
+		{
+			if(game->frames[f][x] != prev[x])
+			{
+				*mask |= 1 << x;
+				*bp++ = game->frames[f][x];
+			}
+		}
+		prev = game->frames[f];
+	}
+	buf[0] = bp - buf - 1;
+	return(bp - buf);
+}
+
+static void SendUpdate(GameEntry *game)
+{
+	uint8 shared[1 + MAX_BATCH * 5];
+	uint32 sharedlen = 0;
+	int n;
+
+	for(n = 0; n < game->MaxPlayers; n++)
+	{
+		ClientEntry *client = game->Players[n];
+
+		if(!client || !game->IsUnique[n]) continue;
+		try
+		{
+			if(client->protocol >= 2)
+			{
+				/* Clients that got every update so far all get the same bytes. */
+				if(!memcmp(client->sentjoy, game->sentjoy, 4))
+				{
+					if(!sharedlen)
+						sharedlen = EncodeUpdate(game, game->sentjoy, shared);
+					MakeSendTCP(client, shared, sharedlen);
+				}
+				else
+				{
+					uint8 buf[1 + MAX_BATCH * 5];
+
+					MakeSendTCP(client, buf, EncodeUpdate(game, client->sentjoy, buf));
+				}
+				memcpy(client->sentjoy, game->frames[Batch - 1], 4);
+			}
+			else
+				MakeSendTCP(client, game->joybuf, 5);
+		}
+		catch(int i)
+		{
+			KillClient(client);
+		}
+	} // A game's clients
+
+	memcpy(game->sentjoy, game->frames[Batch - 1], 4);
+}
+
+static void *ShardLoop(void *arg)
+{
+	Shard *shard = (Shard *)arg;
+	PollEvent events[MAX_EVENTS];
+	uint64 period = ThrottleGetPeriod();
+
+	shard->nexttick = ThrottleGetTime() + period;
+
+	/* Now for the BIG LOOP. */
+	while(1)
+	{
+		uint64 curtime = ThrottleGetTime();
+		int timeout = 0;
+		int n;
+
+		if(curtime < shard->nexttick)
+			timeout = (shard->nexttick - curtime + 999) / 1000;
+
+		int count = PollerWait(shard, events, timeout);
+
+		for(n = 0; n < count; n++)
+		{
+			if(events[n].ptr == &ListenTag)
+			{
+				AcceptClients(shard);
+				continue;
+			}
+			if(events[n].ptr == &WakeTag)
+			{
+				TakeHandOffs(shard);
+				continue;
+			}
+
+			ClientEntry *client = (ClientEntry *)events[n].ptr;
+
+			/* Killed by an earlier event, or handed to another shard. */
+			if(client->dead || client->shard != shard->id)
+				continue;
+
+			try
+			{
+				if(events[n].readable || events[n].error)
+					while(CheckNBTCPReceive(client)) {};
+				if(events[n].writable && client->shard == shard->id)
+					FlushClient(client);
+			}
+			catch(int i)
+			{
+				KillClient(client);
+			}
+		}
+
+		curtime = ThrottleGetTime();
+		if(curtime >= shard->nexttick)
+		{
+			/* Now we send the data to all the clients. */
+			for(size_t g = 0; g < shard->active.size(); g++)
+				SendUpdate(shard->active[g]);
+
+			if(shard->id == 0)
+				CheckLogins(shard);
+
+			/* Don't try to catch up after a long stall. */
+			if(curtime - shard->nexttick >= period * 4)
+				shard->nexttick = curtime + period;
+			else
+				shard->nexttick += period;
+		}
+
+		/* Send everything queued in this iteration. */
+		for(size_t x = 0; x < shard->dirty.size(); x++)
+		{
+			ClientEntry *client = shard->dirty[x];
+
+			client->dirty = 0;
+			if(client->dead)
+				continue;
+			try
+			{
+				FlushClient(client);
+			}
+			catch(int i)
+			{
+				KillClient(client);
+			}
+		}
+		shard->dirty.clear();
+
+		/* Killing a client while flushing can queue more data, which then waits
+		   for the next iteration. */
+		for(size_t x = 0; x < shard->dead.size(); x++)
+			ReleaseClient(shard->dead[x]);
+		shard->dead.clear();
+	} // while(1)
+
+	return(0);
+}
 
 int main(int argc, char *argv[])
 {
 	struct sockaddr_in sockin;
 	socklen_t sockin_len;
 	int i;
+	unsigned int x;
 	char* pass = 0;
 	/* If we can't load the default config file, use some defined values */
 	if(!LoadConfigFile(DEFAULT_CONFIG))
@@ -699,6 +1445,7 @@ int main(int argc, char *argv[])
 		ServerConfig.MaxClients = DEFAULT_MAX;
 		ServerConfig.ConnectTimeout = DEFAULT_TIMEOUT;
 		ServerConfig.FrameDivisor = DEFAULT_FRAMEDIVISOR;
+		ServerConfig.Threads = DEFAULT_THREADS;
 	}
 	char* configfile = 0;
 
@@ -717,6 +1464,7 @@ int main(int argc, char *argv[])
 			printf("-m\t--maxclients\tSpecifies the maximum amount of clients allowed \n\t\t\tto access the server. (default=%d)\n", DEFAULT_MAX);
 			printf("-t\t--timeout\tSpecifies the amount of seconds before the server \n\t\t\ttimes out. (default=%d)\n", DEFAULT_TIMEOUT);
 			printf("-f\t--framedivisor\tSpecifies frame divisor.\n\t\t\t(eg: 60 / framedivisor = updates per second)(default=%d)\n", DEFAULT_FRAMEDIVISOR);
+			printf("-j\t--threads\tSpecifies the number of threads to run games on.\n\t\t\t(default=%d)\n", DEFAULT_THREADS);
 			printf("-c\t--configfile\tLoads the given configuration file.\n");
 			return -1;
 		}
@@ -781,6 +1529,17 @@ int main(int argc, char *argv[])
 			ServerConfig.FrameDivisor = atoi(argv[i]);
 			continue;
 		}
+		if(!strcmp(argv[i], "--threads") || !strcmp(argv[i], "-j"))
+		{
+			i++;
+			if(argc == i)
+			{
+				printf("Please specify the number of threads.\n");
+				return -1;
+			}
+			ServerConfig.Threads = atoi(argv[i]);
+			continue;
+		}
 		if(!strcmp(argv[i], "--configfile") || !strcmp(argv[i], "-c"))
 		{
 			i++;
@@ -807,17 +1566,29 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
+	if(ServerConfig.Threads < 1)
+		ServerConfig.Threads = 1;
+	if(ServerConfig.Threads > ServerConfig.MaxClients)
+		ServerConfig.Threads = ServerConfig.MaxClients;
+
+	Batch = ServerConfig.FrameDivisor <= MAX_BATCH ? ServerConfig.FrameDivisor : 1;
+	if(Batch < 1)
+		Batch = 1;
+
 	Games = (GameEntry *)malloc(sizeof(GameEntry) * ServerConfig.MaxClients);
 	Clients = (ClientEntry *)malloc(sizeof(ClientEntry) * ServerConfig.MaxClients);
 
 	memset(Games,0,sizeof(GameEntry) * ServerConfig.MaxClients);
 	memset(Clients,0,sizeof(ClientEntry) * ServerConfig.MaxClients);
 
+	for(x=ServerConfig.MaxClients; x>0; x--)
 	{
-		int x;
-		for(x=0; x<ServerConfig.MaxClients; x++)
-			Clients[x].TCPSocket = -1;
+		Clients[x-1].TCPSocket = -1;
+		Clients[x-1].loginindex = -1;
+		FreeClients.push_back(&Clients[x-1]);
+		FreeGames.push_back(&Games[x-1]);
 	}
+	ShardGames.resize(ServerConfig.Threads);
 	RefreshThrottleFPS(ServerConfig.FrameDivisor);
 
 	/* First, we need to create a socket to listen on. */
@@ -834,6 +1605,7 @@ int main(int argc, char *argv[])
 		printf("Nodelay fail: %s",strerror(errno));
 		exit(-1);
 	}
+	setsockopt(ListenSocket, SOL_SOCKET, SO_REUSEADDR, &tcpopt, sizeof(int));
 
 	memset(&sockin, 0, sizeof(sockin));
 	sockin.sin_family = AF_INET;
@@ -849,7 +1621,7 @@ int main(int argc, char *argv[])
 	}
 	puts("Ok");
 	printf("Listening on socket... ");
-	if(listen(ListenSocket, 8))
+	if(listen(ListenSocket, 64))
 	{
 		printf("Error: %s",strerror(errno));
 		exit(-1);
@@ -859,89 +1631,35 @@ int main(int argc, char *argv[])
 	/* We don't want to block on accept() */
 	fcntl(ListenSocket, F_SETFL, fcntl(ListenSocket, F_GETFL) | O_NONBLOCK);
 
-	/* Now for the BIG LOOP. */
-	while(1)
+	Shards = new Shard[ServerConfig.Threads];
+	for(x=0; x<ServerConfig.Threads; x++)
 	{
-		int n;
-
-		for(n=0; n<ServerConfig.MaxClients; n++)
-		{
-			if(Clients[n].TCPSocket != -1) continue;
-			if((Clients[n].TCPSocket = accept(ListenSocket, (struct sockaddr *)&sockin, &sockin_len)) != -1)
-			{
-				struct sockaddr_in usockin;
-				/* We have a new client.  Yippie. */
-
-				fcntl(Clients[n].TCPSocket, F_SETFL, fcntl(Clients[n].TCPSocket, F_GETFL) | O_NONBLOCK);
+		Shard *shard = &Shards[x];
 
-				Clients[n].timeconnect = time(0);
-				Clients[n].id = n;
-				printf("Client %d connecting from %s on %s",n,inet_ntoa(sockin.sin_addr),ctime(&Clients[n].timeconnect));
-				{
-					uint8 buf[1];
+		shard->id = x;
+		pthread_mutex_init(&shard->lock, 0);
+		PollerInit(shard);
 
-					buf[0] = ServerConfig.FrameDivisor;
-					send(Clients[n].TCPSocket,buf,1,MSG_NOSIGNAL);
-				}
-				StartNBTCPReceive(&Clients[n], NBTCP_LOGINLEN, 4);
-			}
-		}
-
-		/* Check for users still in the login process(not yet assigned a game). BOING */
-		time_t curtime = time(0);
-		for(n = 0; n < ServerConfig.MaxClients; n++)
-		try
-		{
-			if(Clients[n].TCPSocket != -1 && !Clients[n].game)
-			{
-				if((Clients[n].timeconnect + ServerConfig.ConnectTimeout) < curtime)
-				{
-					KillClient(&Clients[n]);
-				}
-				else
-					while(CheckNBTCPReceive(&Clients[n])) {};
-			}
-		}
-		catch(int i)
+		if(pipe(shard->wakefd))
 		{
-			KillClient(&Clients[n]);
+			printf("pipe failed: %s\n",strerror(errno));
+			exit(-1);
 		}
+		fcntl(shard->wakefd[0], F_SETFL, fcntl(shard->wakefd[0], F_GETFL) | O_NONBLOCK);
+		PollerSet(shard, shard->wakefd[0], &WakeTag, 0, 1);
+	}
+	PollerSet(&Shards[0], ListenSocket, &ListenTag, 0, 1);
 
-		int whichgame;
-		for(whichgame = 0; whichgame < ServerConfig.MaxClients; whichgame ++)
-		{
-			/* Now, the loop to get data from each client.  Meep. */
-			for(n = 0; n < Games[whichgame].MaxPlayers; n++)
-			{
-				try
-				{
-					ClientEntry *client = Games[whichgame].Players[n];
-					if(!client || !Games[whichgame].IsUnique[n]) continue;
-					int localplayers = client->localplayers;
-
-					while(CheckNBTCPReceive(client)) {};
-				} // catch
-				catch(int i)
-				{
-					KillClient(Games[whichgame].Players[n]);
-				}
-			} // A games clients
-
-			/* Now we send the data to all the clients. */
-			for(n = 0; n < Games[whichgame].MaxPlayers; n++)
-			{
-				if(!Games[whichgame].Players[n] || !Games[whichgame].IsUnique[n]) continue;
-				try
-				{
-					MakeSendTCP(Games[whichgame].Players[n], Games[whichgame].joybuf, 5);
-				}
-				catch(int i)
-				{
-					KillClient(Games[whichgame].Players[n]);
-				}
-			} // A game's clients
-		} // Games
+	if(ServerConfig.Threads > 1)
+		printf("Running games on %d threads.\n",ServerConfig.Threads);
 
-		SpeedThrottle();
-	} // while(1)
+	for(x=1; x<ServerConfig.Threads; x++)
+	{
+		if(pthread_create(&Shards[x].thread, 0, ShardLoop, &Shards[x]))
+		{
+			printf("pthread_create failed\n");
+			exit(-1);
+		}
+	}
+	ShardLoop(&Shards[0]);
 }
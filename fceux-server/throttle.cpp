@@ -82,6 +82,16 @@ static uint64 GetCurTime(void)
  return(ret);
 }
 
+uint64 ThrottleGetTime(void)
+{
+ return(GetCurTime());
+}
+
+uint64 ThrottleGetPeriod(void)
+{
+ return(tfreq/desiredfps);
+}
+
 void SpeedThrottle(void)
 {
  static uint64 ttime,ltime;
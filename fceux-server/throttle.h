@@ -21,3 +21,7 @@
 
 void RefreshThrottleFPS(int divooder);
 void SpeedThrottle(void);
+
+/* Current time and time between updates, in microseconds. */
+uint64 ThrottleGetTime(void);
+uint64 ThrottleGetPeriod(void);
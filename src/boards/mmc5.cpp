@@ -21,6 +21,7 @@
 /* None of this code should use any of the iNES bank switching wrappers. */
 
 #include "mapinc.h"
+#include "../vramtrack.h"
 
 #include <array>
 
@@ -41,45 +42,53 @@ static INLINE void MMC5SPRVROM_BANK1(uint32 A, uint32 V) {
 	if (CHRptr[0]) {
 		V &= CHRmask1[0];
 		MMC5SPRVPage[(A) >> 10] = &CHRptr[0][(V) << 10] - (A);
+		FCEU_VRAMTrackBank(A, 1);
 	}
 }
 
 static INLINE void MMC5BGVROM_BANK1(uint32 A, uint32 V) {
 	if (CHRptr[0]) {
 		V &= CHRmask1[0]; MMC5BGVPage[(A) >> 10] = &CHRptr[0][(V) << 10] - (A);
+		FCEU_VRAMTrackBank(A, 1);
 	}
 }
 
 static INLINE void MMC5SPRVROM_BANK2(uint32 A, uint32 V) {
 	if (CHRptr[0]) {
 		V &= CHRmask2[0]; MMC5SPRVPage[(A) >> 10] = MMC5SPRVPage[((A) >> 10) + 1] = &CHRptr[0][(V) << 11] - (A);
+		FCEU_VRAMTrackBank(A, 2);
 	}
 }
 static INLINE void MMC5BGVROM_BANK2(uint32 A, uint32 V) {
 	if (CHRptr[0]) {
 		V &= CHRmask2[0]; MMC5BGVPage[(A) >> 10] = MMC5BGVPage[((A) >> 10) + 1] = &CHRptr[0][(V) << 11] - (A);
+		FCEU_VRAMTrackBank(A, 2);
 	}
 }
 
 static INLINE void MMC5SPRVROM_BANK4(uint32 A, uint32 V) {
 	if (CHRptr[0]) {
 		V &= CHRmask4[0]; MMC5SPRVPage[(A) >> 10] = MMC5SPRVPage[((A) >> 10) + 1] = MMC5SPRVPage[((A) >> 10) + 2] = MMC5SPRVPage[((A) >> 10) + 3] = &CHRptr[0][(V) << 12] - (A);
+		FCEU_VRAMTrackBank(A, 4);
 	}
 }
 static INLINE void MMC5BGVROM_BANK4(uint32 A, uint32 V) {
 	if (CHRptr[0]) {
 		V &= CHRmask4[0]; MMC5BGVPage[(A) >> 10] = MMC5BGVPage[((A) >> 10) + 1] = MMC5BGVPage[((A) >> 10) + 2] = MMC5BGVPage[((A) >> 10) + 3] = &CHRptr[0][(V) << 12] - (A);
+		FCEU_VRAMTrackBank(A, 4);
 	}
 }
 
 static INLINE void MMC5SPRVROM_BANK8(uint32 V) {
 	if (CHRptr[0]) {
 		V &= CHRmask8[0]; MMC5SPRVPage[0] = MMC5SPRVPage[1] = MMC5SPRVPage[2] = MMC5SPRVPage[3] = MMC5SPRVPage[4] = MMC5SPRVPage[5] = MMC5SPRVPage[6] = MMC5SPRVPage[7] = &CHRptr[0][(V) << 13];
+		FCEU_VRAMTrackBank(0, 8);
 	}
 }
 static INLINE void MMC5BGVROM_BANK8(uint32 V) {
 	if (CHRptr[0]) {
 		V &= CHRmask8[0]; MMC5BGVPage[0] = MMC5BGVPage[1] = MMC5BGVPage[2] = MMC5BGVPage[3] = MMC5BGVPage[4] = MMC5BGVPage[5] = MMC5BGVPage[6] = MMC5BGVPage[7] = &CHRptr[0][(V) << 13];
+		FCEU_VRAMTrackBank(0, 8);
 	}
 }
 
@@ -163,8 +172,10 @@ static void mmc5_PPUWrite(uint32 A, uint8 V) {
 		} else
 			PALRAM[tmp & 0x1F] = V & 0x3F;
 	} else if (tmp < 0x2000) {
-		if (PPUCHRRAM & (1 << (tmp >> 10)))
+		if (PPUCHRRAM & (1 << (tmp >> 10))) {
 			VPage[tmp >> 10][tmp] = V;
+			FCEU_VRAMTrackWrite(tmp);
+		}
 	} else {
 		if (PPUNTARAM & (1 << ((tmp & 0xF00) >> 10)))
 			vnapage[((tmp & 0xF00) >> 10)][tmp & 0x3FF] = V;
@@ -0,0 +1,758 @@
+/// \file
+/// \brief Lossless capture of video and audio, encoded by a background thread
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "palette.h"
+#include "video.h"
+#include "capture.h"
+#include "utils/endian.h"
+#include "utils/framedelta.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+#define CAPTURE_VERSION            2
+#define CAPTURE_HEADER_SIZE        32
+#define CAPTURE_MAX_PENDING        240		// queued packets before the emulator waits for the encoder
+#define CAPTURE_KEYFRAME_INTERVAL  600		// frames between frames that don't depend on the previous one
+#define CAPTURE_AVI_SEGMENT        (2000 * 1024 * 1024)	// start a new AVI file before reaching 2 GB
+
+static const uint8 captureMagic[8] = {'F','C','E','U','C','A','P',0x1A};
+
+enum
+{
+	CAPTURE_PACKET_VIDEO = 'V',
+	CAPTURE_PACKET_AUDIO = 'A',
+};
+
+struct CapturePacket
+{
+	uint8 type;
+	std::vector<uint8> data;
+};
+
+static std::mutex queueLock;
+static std::condition_variable wakeWorker;
+static std::condition_variable packetDone;
+static std::deque<CapturePacket*> pending;
+static std::vector<CapturePacket*> spare;	// written packets, reused to save allocating each frame
+static std::thread worker;
+static bool stopping = false;
+static bool writeFailed = false;
+
+// emulation thread
+static bool recording = false;
+static int captureFirst, captureLines;
+
+// worker thread
+static FILE *captureFile = NULL;
+static FrameDeltaEncoder encoder;
+static std::vector<uint8> encoded;
+static std::vector<uint8> compressed;
+static int sinceKeyframe;
+
+static bool WritePacket(uint8 type, const uint8 *data, uint32 size, const uint8 *data2 = NULL, uint32 size2 = 0)
+{
+	uint8 head[5];
+
+	head[0] = type;
+	FCEU_en32lsb(head + 1, size + size2);
+
+	if (fwrite(head, 1, 5, captureFile) != 5)
+		return false;
+	if (size && fwrite(data, 1, size, captureFile) != size)
+		return false;
+	if (size2 && fwrite(data2, 1, size2, captureFile) != size2)
+		return false;
+	return true;
+}
+
+// Encodes the pixels, emphasis and colors in the packet as a change to the previous frame.
+static bool WriteFrame(const std::vector<uint8> &frame)
+{
+	size_t size = captureLines * 256;
+
+	encoded.clear();
+	encoder.encode(&frame[0], &frame[size], &frame[size * 2], sinceKeyframe == 0, encoded);
+	sinceKeyframe = (sinceKeyframe + 1) % CAPTURE_KEYFRAME_INTERVAL;
+
+	uLongf compsize = compressBound(encoded.size());
+
+	if (compressed.size() < compsize)
+		compressed.resize(compsize);
+	if (compress2(&compressed[0], &compsize, &encoded[0], encoded.size(), Z_BEST_SPEED) != Z_OK)
+		return false;
+	return WritePacket(CAPTURE_PACKET_VIDEO, &compressed[0], compsize);
+}
+
+static void WorkerMain(void)
+{
+	std::unique_lock<std::mutex> guard(queueLock);
+
+	for (;;)
+	{
+		while (pending.empty() && !stopping)
+			wakeWorker.wait(guard);
+		if (pending.empty())
+			break;
+
+		CapturePacket *packet = pending.front();
+		pending.pop_front();
+		bool failed = writeFailed;
+
+		guard.unlock();
+		if (!failed)
+		{
+			if (packet->type == CAPTURE_PACKET_VIDEO)
+				failed = !WriteFrame(packet->data);
+			else
+				failed = !WritePacket(packet->type, &packet->data[0], packet->data.size());
+		}
+		guard.lock();
+
+		if (failed)
+			writeFailed = true;
+		spare.push_back(packet);
+		packetDone.notify_all();
+	}
+}
+
+static CapturePacket* NewPacket(uint8 type, size_t size)
+{
+	CapturePacket *packet = NULL;
+
+	{
+		std::lock_guard<std::mutex> guard(queueLock);
+
+		if (!spare.empty())
+		{
+			packet = spare.back();
+			spare.pop_back();
+		}
+	}
+	if (!packet)
+		packet = new CapturePacket;
+
+	packet->type = type;
+	packet->data.resize(size);
+	return packet;
+}
+
+// Returns false if the worker couldn't write an earlier packet, the capture is ended then.
+static bool Enqueue(CapturePacket *packet)
+{
+	std::unique_lock<std::mutex> guard(queueLock);
+
+	while (pending.size() >= CAPTURE_MAX_PENDING)
+		packetDone.wait(guard);
+
+	pending.push_back(packet);
+	wakeWorker.notify_one();
+	return !writeFailed;
+}
+
+int FCEUI_CaptureBegin(const char *fname)
+{
+	FCEUI_CaptureEnd();
+
+	if (!GameInfo)
+		return 0;
+
+	captureFile = FCEUD_UTF8fopen(fname, "wb");
+	if (!captureFile)
+	{
+		FCEU_DispMessage("Error creating capture file.",0);
+		return 0;
+	}
+	setvbuf(captureFile, NULL, _IOFBF, 1024 * 1024);
+
+	captureFirst = FSettings.FirstSLine;
+	captureLines = FSettings.LastSLine - FSettings.FirstSLine + 1;
+
+	uint8 header[CAPTURE_HEADER_SIZE];
+
+	memset(header, 0, sizeof(header));
+	memcpy(header, captureMagic, 8);
+	FCEU_en32lsb(header + 8, CAPTURE_VERSION);
+	FCEU_en32lsb(header + 12, FCEUI_GetDesiredFPS());
+	FCEU_en32lsb(header + 16, FSettings.SndRate);
+	FCEU_en16lsb(header + 20, 256);
+	FCEU_en16lsb(header + 22, captureLines);
+	FCEU_en16lsb(header + 24, captureFirst);
+
+	if (fwrite(header, 1, sizeof(header), captureFile) != sizeof(header))
+	{
+		fclose(captureFile);
+		captureFile = NULL;
+		FCEU_DispMessage("Error creating capture file.",0);
+		return 0;
+	}
+
+	encoder.reset(256, captureLines);
+	sinceKeyframe = 0;
+	stopping = false;
+	writeFailed = false;
+	worker = std::thread(WorkerMain);
+	recording = true;
+
+	FCEU_DispMessage("Capture started.",0);
+	return 1;
+}
+
+void FCEUI_CaptureEnd(void)
+{
+	if (!recording)
+		return;
+	recording = false;
+
+	{
+		std::lock_guard<std::mutex> guard(queueLock);
+
+		stopping = true;
+		wakeWorker.notify_one();
+	}
+	worker.join();
+
+	bool failed = writeFailed;
+
+	if (fclose(captureFile))
+		failed = true;
+	captureFile = NULL;
+
+	for (size_t i = 0; i < spare.size(); i++)
+		delete spare[i];
+	spare.clear();
+	std::vector<uint8>().swap(encoded);
+	std::vector<uint8>().swap(compressed);
+
+	FCEU_DispMessage(failed ? "Error writing capture." : "Capture stopped.",0);
+}
+
+bool FCEUI_CaptureIsRecording(void)
+{
+	return recording;
+}
+
+void FCEU_CaptureVideo(void)
+{
+	if (!recording)
+		return;
+
+	size_t size = captureLines * 256;
+	CapturePacket *packet = NewPacket(CAPTURE_PACKET_VIDEO, size * 2 + FRAMEDELTA_COLORS * 3);
+	uint8 *colors = &packet->data[size * 2];
+
+	memcpy(&packet->data[0], XBuf + captureFirst * 256, size);
+	memcpy(&packet->data[size], XDBuf + captureFirst * 256, size);
+
+	for (int x = 0; x < 256; x++)
+		FCEUD_GetPalette(x, colors + x * 3, colors + x * 3 + 1, colors + x * 3 + 2);
+	for (int x = 0; x < 512; x++)
+	{
+		uint8 *c = colors + (256 + x) * 3;
+
+		c[0] = paletteLUT[x] >> 16;
+		c[1] = paletteLUT[x] >> 8;
+		c[2] = paletteLUT[x];
+	}
+
+	if (!Enqueue(packet))
+		FCEUI_CaptureEnd();
+}
+
+void FCEU_CaptureAudio(int32 *Buffer, int Count)
+{
+	if (!recording || Count <= 0)
+		return;
+
+	CapturePacket *packet = NewPacket(CAPTURE_PACKET_AUDIO, Count * 2);
+	uint8 *dest = &packet->data[0];
+
+	for (int x = 0; x < Count; x++)
+		FCEU_en16lsb(dest + x * 2, Buffer[x] & 0xFFFF);
+	if (!Enqueue(packet))
+		FCEUI_CaptureEnd();
+}
+
+// the worker has to be stopped and the file closed if the driver exits without FCEUI_Kill()
+static struct CaptureGuard
+{
+	~CaptureGuard()
+	{
+		FCEUI_CaptureEnd();
+	}
+} captureGuard;
+
+//------------------------------------------------------------------------------
+// Reading captures
+
+struct CaptureReader
+{
+	FILE *fp;
+	uint32 fps, rate;
+	int width, lines;
+	uint32 frames;					// frames decoded so far
+	size_t maxEncoded;				// the largest a frame can get
+	FrameDeltaDecoder decoder;
+	std::vector<uint8> packet;		// payload of the last packet
+	std::vector<uint8> encoded;		// frame delta encoding of the last frame
+
+	CaptureReader() : fp(NULL) {}
+	~CaptureReader() { if (fp) fclose(fp); }
+};
+
+static bool ReaderOpen(CaptureReader &reader, const char *fname)
+{
+	uint8 header[CAPTURE_HEADER_SIZE];
+
+	reader.fp = FCEUD_UTF8fopen(fname, "rb");
+	if (!reader.fp)
+	{
+		FCEU_PrintError("Unable to open capture file %s.", fname);
+		return false;
+	}
+	if (fread(header, 1, sizeof(header), reader.fp) != sizeof(header) || memcmp(header, captureMagic, 8)
+	 || FCEU_de32lsb(header + 8) != CAPTURE_VERSION)
+	{
+		FCEU_PrintError("%s is not a capture file.", fname);
+		return false;
+	}
+
+	reader.fps = FCEU_de32lsb(header + 12);
+	reader.rate = FCEU_de32lsb(header + 16);
+	reader.width = FCEU_de16lsb(header + 20);
+	reader.lines = FCEU_de16lsb(header + 22);
+	reader.frames = 0;
+
+	if (!reader.fps || !reader.width || (reader.width & 7) || !reader.lines)
+	{
+		FCEU_PrintError("%s is not a capture file.", fname);
+		return false;
+	}
+	reader.decoder.reset(reader.width, reader.lines);
+
+	int tiles = reader.width / 8 * ((reader.lines + 7) / 8);
+
+	reader.maxEncoded = 1 + FRAMEDELTA_COLORS / 8 + FRAMEDELTA_COLORS * 3 + (tiles + 7) / 8 + tiles * (1 + 64 * 2);
+	return true;
+}
+
+// Reads the next packet and decodes it if it's a frame. Returns the packet type, 0 at
+// the end of the capture and -1 if it's damaged.
+static int ReaderNext(CaptureReader &reader)
+{
+	uint8 head[5];
+
+	if (fread(head, 1, 5, reader.fp) != 5)
+		return 0;
+
+	uint32 len = FCEU_de32lsb(head + 1);
+
+	reader.packet.resize(len);
+	if (len && fread(&reader.packet[0], 1, len, reader.fp) != len)
+	{
+		FCEU_printf("Capture file is truncated, ignoring the last packet.\n");
+		return 0;
+	}
+
+	if (head[0] == CAPTURE_PACKET_VIDEO)
+	{
+		uLongf size = reader.maxEncoded;
+
+		reader.encoded.resize(size);
+		if (!len || uncompress(&reader.encoded[0], &size, &reader.packet[0], len) != Z_OK
+		 || !reader.decoder.decode(&reader.encoded[0], size))
+		{
+			FCEU_PrintError("Capture frame %u is damaged.", reader.frames);
+			return -1;
+		}
+		reader.encoded.resize(size);
+		reader.frames++;
+	}
+	return head[0];
+}
+
+//------------------------------------------------------------------------------
+// Conversion to AVI
+
+// An uncompressed AVI file being written: 24 bit RGB video and 16 bit mono PCM audio.
+struct AviWriter
+{
+	FILE *fp;
+	int width, lines;
+	uint32 fps, rate;
+	uint32 frames, samples;
+	long moviPos;					// position of the 'movi' list type
+	std::vector<uint8> index;		// idx1 entries
+
+	AviWriter() : fp(NULL) {}
+};
+
+static void PutFourCC(FILE *fp, const char *id)
+{
+	fwrite(id, 1, 4, fp);
+}
+
+static void Put32(FILE *fp, uint32 v)
+{
+	uint8 b[4];
+
+	FCEU_en32lsb(b, v);
+	fwrite(b, 1, 4, fp);
+}
+
+static void Put16(FILE *fp, uint16 v)
+{
+	uint8 b[2];
+
+	FCEU_en16lsb(b, v);
+	fwrite(b, 1, 2, fp);
+}
+
+// Writes the headers, the counts are filled in by AviClose().
+static void AviWriteHeaders(AviWriter &avi)
+{
+	FILE *fp = avi.fp;
+	int streams = avi.rate ? 2 : 1;
+	uint32 frameSize = avi.width * avi.lines * 3;
+
+	PutFourCC(fp, "RIFF"); Put32(fp, 0); PutFourCC(fp, "AVI ");
+	PutFourCC(fp, "LIST"); Put32(fp, 4 + 64 + 124 + (streams == 2 ? 102 : 0)); PutFourCC(fp, "hdrl");
+
+	PutFourCC(fp, "avih"); Put32(fp, 56);
+	Put32(fp, (uint32)(1000000.0 * (1 << 24) / avi.fps));	// microseconds per frame
+	Put32(fp, 0);							// max bytes per second
+	Put32(fp, 0);							// padding granularity
+	Put32(fp, 0x10 | 0x100);				// has index, interleaved
+	Put32(fp, 0);							// total frames, offset 48
+	Put32(fp, 0);							// initial frames
+	Put32(fp, streams);
+	Put32(fp, frameSize);
+	Put32(fp, avi.width);
+	Put32(fp, avi.lines);
+	for (int i = 0; i < 4; i++)
+		Put32(fp, 0);
+
+	PutFourCC(fp, "LIST"); Put32(fp, 4 + 64 + 48); PutFourCC(fp, "strl");
+	PutFourCC(fp, "strh"); Put32(fp, 56);
+	PutFourCC(fp, "vids"); PutFourCC(fp, "DIB ");
+	Put32(fp, 0);							// flags
+	Put16(fp, 0); Put16(fp, 0);				// priority, language
+	Put32(fp, 0);							// initial frames
+	Put32(fp, 1 << 24);						// scale
+	Put32(fp, avi.fps);						// rate
+	Put32(fp, 0);							// start
+	Put32(fp, 0);							// length, offset 140
+	Put32(fp, frameSize);
+	Put32(fp, 0xFFFFFFFF);					// quality
+	Put32(fp, 0);							// sample size
+	Put16(fp, 0); Put16(fp, 0); Put16(fp, avi.width); Put16(fp, avi.lines);
+	PutFourCC(fp, "strf"); Put32(fp, 40);
+	Put32(fp, 40);
+	Put32(fp, avi.width);
+	Put32(fp, avi.lines);					// bottom up
+	Put16(fp, 1);							// planes
+	Put16(fp, 24);							// bits per pixel
+	Put32(fp, 0);							// BI_RGB
+	Put32(fp, frameSize);
+	for (int i = 0; i < 4; i++)
+		Put32(fp, 0);
+
+	if (streams == 2)
+	{
+		PutFourCC(fp, "LIST"); Put32(fp, 4 + 64 + 26); PutFourCC(fp, "strl");
+		PutFourCC(fp, "strh"); Put32(fp, 56);
+		PutFourCC(fp, "auds"); Put32(fp, 0);
+		Put32(fp, 0);
+		Put16(fp, 0); Put16(fp, 0);
+		Put32(fp, 0);
+		Put32(fp, 1);							// scale
+		Put32(fp, avi.rate);					// rate
+		Put32(fp, 0);
+		Put32(fp, 0);							// length, offset 264
+		Put32(fp, avi.rate * 2);
+		Put32(fp, 0xFFFFFFFF);
+		Put32(fp, 2);							// sample size
+		Put16(fp, 0); Put16(fp, 0); Put16(fp, 0); Put16(fp, 0);
+		PutFourCC(fp, "strf"); Put32(fp, 18);
+		Put16(fp, 1);							// PCM
+		Put16(fp, 1);							// channels
+		Put32(fp, avi.rate);
+		Put32(fp, avi.rate * 2);				// bytes per second
+		Put16(fp, 2);							// block align
+		Put16(fp, 16);							// bits per sample
+		Put16(fp, 0);
+	}
+
+	PutFourCC(fp, "LIST"); Put32(fp, 0); PutFourCC(fp, "movi");
+	avi.moviPos = ftell(fp) - 4;
+}
+
+static bool AviOpen(AviWriter &avi, const char *fname)
+{
+	avi.fp = FCEUD_UTF8fopen(fname, "wb");
+	if (!avi.fp)
+		return false;
+	setvbuf(avi.fp, NULL, _IOFBF, 1024 * 1024);
+
+	avi.frames = avi.samples = 0;
+	avi.index.clear();
+	AviWriteHeaders(avi);
+	return true;
+}
+
+static void AviChunk(AviWriter &avi, const char *id, const uint8 *data, uint32 size)
+{
+	uint8 entry[16];
+
+	memcpy(entry, id, 4);
+	FCEU_en32lsb(entry + 4, 0x10);			// keyframe
+	FCEU_en32lsb(entry + 8, ftell(avi.fp) - avi.moviPos);
+	FCEU_en32lsb(entry + 12, size);
+	avi.index.insert(avi.index.end(), entry, entry + 16);
+
+	PutFourCC(avi.fp, id);
+	Put32(avi.fp, size);
+	fwrite(data, 1, size, avi.fp);
+	if (size & 1)
+		fputc(0, avi.fp);
+}
+
+static bool AviClose(AviWriter &avi)
+{
+	FILE *fp = avi.fp;
+	long moviEnd = ftell(fp);
+
+	PutFourCC(fp, "idx1");
+	Put32(fp, avi.index.size());
+	if (!avi.index.empty())
+		fwrite(&avi.index[0], 1, avi.index.size(), fp);
+
+	long end = ftell(fp);
+
+	fseek(fp, 4, SEEK_SET);
+	Put32(fp, end - 8);
+	fseek(fp, 48, SEEK_SET);
+	Put32(fp, avi.frames);
+	fseek(fp, 140, SEEK_SET);
+	Put32(fp, avi.frames);
+	if (avi.rate)
+	{
+		fseek(fp, 264, SEEK_SET);
+		Put32(fp, avi.samples);
+	}
+	fseek(fp, avi.moviPos - 4, SEEK_SET);
+	Put32(fp, moviEnd - avi.moviPos);
+
+	bool ok = !ferror(fp);
+
+	if (fclose(fp))
+		ok = false;
+	avi.fp = NULL;
+	return ok;
+}
+
+static std::string AviSegmentName(const std::string &aviname, int segment)
+{
+	if (segment == 0)
+		return aviname;
+
+	size_t dot = aviname.find_last_of('.');
+	size_t slash = aviname.find_last_of("/\\");
+	std::string base = aviname, ext;
+	char num[16];
+
+	if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+	{
+		base = aviname.substr(0, dot);
+		ext = aviname.substr(dot);
+	}
+	snprintf(num, sizeof(num), "_part%d", segment + 1);
+	return base + num + ext;
+}
+
+bool FCEUI_CaptureConvert(const char *fname, const char *aviname)
+{
+	CaptureReader reader;
+
+	if (!ReaderOpen(reader, fname))
+		return false;
+
+	AviWriter avi;
+
+	avi.fps = reader.fps;
+	avi.rate = reader.rate;
+	avi.width = reader.width;
+	avi.lines = reader.lines;
+
+	if (!AviOpen(avi, aviname))
+	{
+		FCEU_PrintError("Unable to create %s.", aviname);
+		return false;
+	}
+
+	std::vector<uint8> rgb(avi.width * avi.lines * 3);
+	int segment = 0;
+	bool ok = true;
+	int type;
+
+	while ((type = ReaderNext(reader)) > 0)
+	{
+		if (type == CAPTURE_PACKET_AUDIO && avi.rate && reader.packet.size() >= 2)
+		{
+			AviChunk(avi, "01wb", &reader.packet[0], reader.packet.size() & ~1);
+			avi.samples += reader.packet.size() / 2;
+		}
+		else if (type == CAPTURE_PACKET_VIDEO)
+		{
+			const uint8 *colors = reader.decoder.getColors();
+
+			for (int y = 0; y < avi.lines; y++)
+			{
+				const uint8 *pix = reader.decoder.getPixels() + y * avi.width;
+				const uint8 *emph = reader.decoder.getEmphasis() + y * avi.width;
+				uint8 *dest = &rgb[(avi.lines - 1 - y) * avi.width * 3];
+
+				for (int x = 0; x < avi.width; x++, dest += 3)
+				{
+					// the packet keeps the 8 bit palette ahead of the PPU colors
+					int i = FCEU_PaletteIndex(pix[x], emph[x]);
+					const uint8 *c = &colors[(i >= PALETTE_8BIT ? i - PALETTE_8BIT : 256 + i) * 3];
+					dest[0] = c[2];
+					dest[1] = c[1];
+					dest[2] = c[0];
+				}
+			}
+			AviChunk(avi, "00db", &rgb[0], rgb.size());
+			avi.frames++;
+
+			if (ftell(avi.fp) >= CAPTURE_AVI_SEGMENT)
+			{
+				if (!AviClose(avi))
+				{
+					ok = false;
+					break;
+				}
+				std::string next = AviSegmentName(aviname, ++segment);
+
+				if (!AviOpen(avi, next.c_str()))
+				{
+					FCEU_PrintError("Unable to create %s.", next.c_str());
+					ok = false;
+					break;
+				}
+			}
+		}
+	}
+	if (type < 0)
+		ok = false;
+
+	if (avi.fp && !AviClose(avi))
+		ok = false;
+	if (!ok)
+		FCEU_PrintError("Error converting %s.", fname);
+	else
+		FCEU_printf("Converted %u frames to %d AVI file(s).\n", reader.frames, segment + 1);
+	return ok;
+}
+
+//------------------------------------------------------------------------------
+// Benchmark
+
+bool FCEUI_CaptureBenchmark(const char *fname)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	CaptureReader reader;
+
+	if (!ReaderOpen(reader, fname))
+		return false;
+
+	size_t size = reader.width * reader.lines;
+	FrameDeltaEncoder benchEncoder;
+	FrameDeltaDecoder benchDecoder;
+	std::vector<uint8> frame(size * 2 + FRAMEDELTA_COLORS * 3), delta, comp;
+	Clock::duration encodeTime(0), decodeTime(0), zlibTime(0);
+	double raw = 0, deltaBytes = 0, zlibBytes = 0;
+	uint32 keyframes = 0;
+	bool ok = true;
+	int type;
+
+	benchEncoder.reset(reader.width, reader.lines);
+	benchDecoder.reset(reader.width, reader.lines);
+
+	while ((type = ReaderNext(reader)) > 0)
+	{
+		if (type != CAPTURE_PACKET_VIDEO)
+			continue;
+
+		memcpy(&frame[0], reader.decoder.getPixels(), size);
+		memcpy(&frame[size], reader.decoder.getEmphasis(), size);
+		memcpy(&frame[size * 2], reader.decoder.getColors(), FRAMEDELTA_COLORS * 3);
+
+		bool keyframe = (reader.frames - 1) % CAPTURE_KEYFRAME_INTERVAL == 0;
+		Clock::time_point t0 = Clock::now();
+
+		delta.clear();
+		benchEncoder.encode(&frame[0], &frame[size], &frame[size * 2], keyframe, delta);
+
+		Clock::time_point t1 = Clock::now();
+
+		if (!benchDecoder.decode(&delta[0], delta.size())
+		 || memcmp(benchDecoder.getPixels(), &frame[0], size)
+		 || memcmp(benchDecoder.getEmphasis(), &frame[size], size)
+		 || memcmp(benchDecoder.getColors(), &frame[size * 2], FRAMEDELTA_COLORS * 3))
+		{
+			FCEU_PrintError("Frame %u doesn't decode to what was encoded.", reader.frames - 1);
+			ok = false;
+			break;
+		}
+
+		Clock::time_point t2 = Clock::now();
+		uLongf compsize = compressBound(delta.size());
+
+		if (comp.size() < compsize)
+			comp.resize(compsize);
+		compress2(&comp[0], &compsize, &delta[0], delta.size(), Z_BEST_SPEED);
+
+		Clock::time_point t3 = Clock::now();
+
+		encodeTime += t1 - t0;
+		decodeTime += t2 - t1;
+		zlibTime += t3 - t2;
+		raw += size * 2;
+		deltaBytes += delta.size();
+		zlibBytes += compsize;
+		keyframes += keyframe;
+	}
+	if (type < 0)
+		ok = false;
+
+	if (!reader.frames)
+	{
+		FCEU_printf("No frames in %s.\n", fname);
+		return ok;
+	}
+
+	double mb = raw / (1024 * 1024);
+	double enc = std::chrono::duration<double>(encodeTime).count();
+	double dec = std::chrono::duration<double>(decodeTime).count();
+	double zl = std::chrono::duration<double>(zlibTime).count();
+
+	FCEU_printf("%u frames of %dx%d, a keyframe every %d frames (%u)\n", reader.frames, reader.width, reader.lines, CAPTURE_KEYFRAME_INTERVAL, keyframes);
+	FCEU_printf("indexed:       %10.2f MB (RGB24 %.2f MB)\n", mb, mb * 1.5);
+	FCEU_printf("frame delta:   %10.2f MB  ratio %7.2f  encode %8.1f MB/s  decode %8.1f MB/s\n",
+		deltaBytes / (1024 * 1024), raw / deltaBytes, enc > 0 ? mb / enc : 0, dec > 0 ? mb / dec : 0);
+	FCEU_printf("+ zlib:        %10.2f MB  ratio %7.2f  encode %8.1f MB/s\n",
+		zlibBytes / (1024 * 1024), raw / zlibBytes, enc + zl > 0 ? mb / (enc + zl) : 0);
+	return ok;
+}
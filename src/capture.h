@@ -0,0 +1,30 @@
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+// Lossless video and audio capture.
+//
+// Every frame the visible lines of XBuf, their deemphasis bits and the 768 colors
+// they are shown with are copied and queued for a worker thread, together with the
+// samples of the frame. The worker stores the 8x8 tiles and colors that changed
+// since the previous frame (see utils/framedelta.h), compresses them with zlib and
+// appends them to a capture file, so nothing is converted to RGB while emulating.
+// The emulator only waits for the worker when it falls a couple of seconds behind.
+//
+// FCEUI_CaptureConvert() turns a capture file into uncompressed AVI files, and
+// FCEUI_CaptureBenchmark() measures the frame delta coding on the frames of one.
+//
+// File layout, all numbers little endian:
+//   header:  "FCEUCAP\x1A", version, fps << 24, sound rate (32 bits each),
+//            width, lines, first line (16 bits each), 6 reserved bytes
+//   packets: type, 32 bit payload length, payload
+//     'V'    frame: a zlib stream of the frame delta encoding of the frame, every
+//            600th frame is a keyframe
+//     'A'    samples: 16 bit mono
+
+// Appends a frame to the capture, from FCEU_PutImage().
+void FCEU_CaptureVideo(void);
+
+// Appends the samples of a frame to the capture.
+void FCEU_CaptureAudio(int32 *Buffer, int Count);
+
+#endif
@@ -31,6 +31,7 @@
 
 #include "file.h"
 #include "utils/memory.h"
+#include "vramtrack.h"
 
 
 #include <cstring>
@@ -234,6 +235,7 @@ void setchr1r(int r, uint32 A, uint32 V) {
 	else
 		PPUCHRRAM &= ~(1 << (A >> 10));
 	VPageR[(A) >> 10] = &CHRptr[r][(V) << 10] - (A);
+	FCEU_VRAMTrackBank(A, 1);
 }
 
 void setchr2r(int r, uint32 A, uint32 V) {
@@ -241,6 +243,7 @@ void setchr2r(int r, uint32 A, uint32 V) {
 	FCEUPPU_LineUpdate();
 	V &= CHRmask2[r];
 	VPageR[(A) >> 10] = VPageR[((A) >> 10) + 1] = &CHRptr[r][(V) << 11] - (A);
+	FCEU_VRAMTrackBank(A, 2);
 	if (CHRram[r])
 		PPUCHRRAM |= (3 << (A >> 10));
 	else
@@ -253,6 +256,7 @@ void setchr4r(int r, unsigned int A, unsigned int V) {
 	V &= CHRmask4[r];
 	VPageR[(A) >> 10] = VPageR[((A) >> 10) + 1] =
 							VPageR[((A) >> 10) + 2] = VPageR[((A) >> 10) + 3] = &CHRptr[r][(V) << 12] - (A);
+	FCEU_VRAMTrackBank(A, 4);
 	if (CHRram[r])
 		PPUCHRRAM |= (15 << (A >> 10));
 	else
@@ -267,6 +271,7 @@ void setchr8r(int r, uint32 V) {
 	V &= CHRmask8[r];
 	for (x = 7; x >= 0; x--)
 		VPageR[x] = &CHRptr[r][V << 13];
+	FCEU_VRAMTrackBank(0, 8);
 	if (CHRram[r])
 		PPUCHRRAM |= (255);
 	else
@@ -497,6 +502,7 @@ void FixGenieMap(void) {
 
 	for (x = 0; x < 8; x++)
 		VPage[x] = VPageG[x];
+	FCEU_VRAMTrackInvalidate();
 
 	VPageR = VPage;
 	FlushGenieRW();
@@ -528,6 +534,7 @@ void FCEU_GeniePower(void) {
 
 	for (x = 0; x < 8; x++)
 		VPage[x] = GENIEROM + 4096 - 0x400 * x;
+	FCEU_VRAMTrackInvalidate();
 
 	if (AllocGenieRW())
 		VPageR = VPageG;
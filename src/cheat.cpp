@@ -26,6 +26,7 @@
 #include "file.h"
 #include "cart.h"
 #include "driver.h"
+#include "memsnap.h"
 #include "utils/memory.h"
 
 #include <string>
@@ -883,6 +884,7 @@ void FCEU_CheatSetByte(uint32 A, uint8 V)
     CheatRPtrs[A>>10][A]=V;
    else if(A < 0x10000)
     BWrite[A](A, V);
+   FCEUI_MemSnapshotRequestUpdate();
 }
 
 // disable all cheats
@@ -42,6 +42,10 @@ int FCEUI_NetplayStart(int nlocal, int divisor);
 // Call when network play needs to stop.
 void FCEUI_NetplayStop(void);
 
+//Fills the 64 byte expansion field of the login packet sent to the server, which
+//asks for the newest protocol version the core speaks.
+void FCEUI_NetplayLoginExtra(uint8 *extra);
+
 //Note:  YOU MUST NOT CALL ANY FCEUI_* FUNCTIONS WHILE IN FCEUD_SendData() or FCEUD_RecvData().
 
 //Return 0 on failure, 1 on success.
@@ -59,6 +63,23 @@ void FCEUI_NetplayText(uint8 *text);
 //side.
 void FCEUD_NetworkClose(void);
 
+//Rollback network play with a single peer, see rollback.h.
+//Call only when a game is loaded.  localPort is 0 for player 1, 1 for player 2.
+//Returns 0 if it can't be started (while a movie is active).
+int FCEUI_RollbackStart(int localPort);
+void FCEUI_RollbackStop(void);
+bool FCEUI_RollbackActive(void);
+
+//Number of rollbacks and of frames emulated again because of them.
+void FCEUI_RollbackGetStats(int *rollbacks, int *frames);
+
+//Sends a packet to the peer without blocking.  Return 0 on failure, 1 on success.
+int FCEUD_RollbackSend(const void *data, uint32 len);
+
+//Receives one packet from the peer, waiting at most timeout milliseconds.
+//Returns its size, 0 if none arrived, -1 on failure.
+int FCEUD_RollbackRecv(void *data, uint32 len, int timeout);
+
 bool FCEUI_BeginWaveRecord(const char *fn);
 int FCEUI_EndWaveRecord(void);
 
@@ -79,6 +100,17 @@ void FCEUI_SetInputFC(ESIFC type, void *ptr, int attrib);
 void FCEUI_SetInputFourscore(bool attachFourscore);
 //tells whether a fourscore is attached
 bool FCEUI_GetInputFourscore();
+
+//late latching: gamepads take the state last passed to FCEUI_LatchGamepads() when the game strobes
+//them, instead of the state at the start of the frame. Off during movies, netplay and rollback.
+void FCEUI_SetLateLatch(bool enable);
+bool FCEUI_GetLateLatch(void);
+//the latest state of the four gamepads, laid out like the SI_GAMEPAD input. Callable from any thread.
+void FCEUI_LatchGamepads(uint32 pads);
+
+//prints the frames from pressing a button until the picture changes, measured at samples points
+//of the running game with savestates, see inputlag.cpp
+bool FCEUI_MeasureInputLag(int samples);
 //tells whether the microphone is used
 bool FCEUI_GetInputMicrophone();
 
@@ -119,6 +151,12 @@ void FCEUI_Kill(void);
 //Enable/Disable game genie. a=true->enabled
 void FCEUI_SetGameGenie(bool a);
 
+//Enable/Disable mapping iNES PRG/CHR from the ROM file instead of copying them. a=true->enabled
+void FCEUI_SetMapRomImages(bool a);
+
+//Enable/Disable sharing ROMs from archives or ips patches through files in /dev/shm when they're mapped. a=true->enabled
+void FCEUI_SetShareRomImages(bool a);
+
 //Set video system a=0 NTSC, a=1 PAL
 void FCEUI_SetVidSystem(int a);
 
@@ -289,6 +327,18 @@ void FCEUI_SetAviDisableMovieMessages(bool disable);
 void FCEUD_AviRecordTo(void);
 void FCEUD_AviStop(void);
 
+//Lossless capture of video and audio, see capture.h
+int FCEUI_CaptureBegin(const char *fname);
+void FCEUI_CaptureEnd(void);
+bool FCEUI_CaptureIsRecording(void);
+//converts a capture file to uncompressed AVI, split into _partN files at 2 GB
+bool FCEUI_CaptureConvert(const char *fname, const char *aviname);
+//prints the size and speed of the frame delta coding of a capture's frames
+bool FCEUI_CaptureBenchmark(const char *fname);
+
+//Indexes the ROMs below dir into fname (romlibrary.txt in the base directory if NULL), see romlibrary.h
+bool FCEUI_RomLibraryIndex(const char *dir, const char *fname, int threads);
+
 ///A callback that the emu core uses to poll the state of a given emulator command key
 typedef int TestCommandState(int cmd);
 ///Signals the emu core to poll for emulator commands and take actions
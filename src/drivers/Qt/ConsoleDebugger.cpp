@@ -54,6 +54,7 @@
 #include "../../asm.h"
 #include "../../ppu.h"
 #include "../../x6502.h"
+#include "../../memsnap.h"
 #include "common/os_utils.h"
 #include "common/configSys.h"
 
@@ -333,10 +334,10 @@ ConsoleDebugger::ConsoleDebugger(QWidget *parent)
 	seekEntry = new QLineEdit();
 	seekEntry->setFont( font );
 	seekEntry->setText("0000");
-	seekEntry->setMaxLength( 4 );
-	seekEntry->setInputMask( ">HHHH;" );
+	seekEntry->setMaxLength( 64 );
 	seekEntry->setAlignment(Qt::AlignCenter);
-	seekEntry->setMaximumWidth( 6 * fontCharWidth );
+	seekEntry->setMaximumWidth( 12 * fontCharWidth );
+	seekEntry->setToolTip( tr("Hex address or debug symbol name") );
 	grid->addWidget( seekEntry, 3, 1, Qt::AlignLeft );
 
 	hbox = new QHBoxLayout();
@@ -1704,8 +1705,18 @@ void ConsoleDebugger::seekToCB (void)
 	if ( s.size() > 0 )
 	{
 		long int addr, line;
+		debugSymbol_t *sym;
 
-		addr = strtol( s.c_str(), NULL, 16 );
+		sym = debugSymbolTable.getSymbolByName( s.c_str() );
+
+		if ( sym != NULL )
+		{
+			addr = sym->ofs;
+		}
+		else
+		{
+			addr = strtol( s.c_str(), NULL, 16 ) & 0xFFFF;
+		}
 		
 		line = asmView->getAsmLineFromAddr(addr);
 
@@ -2578,6 +2589,9 @@ void FCEUD_DebugBreakpoint( int bpNum )
 
 	printf("Breakpoint Hit: %i \n", bpNum );
 
+	// Let the memory views show the state at the breakpoint
+	FCEUI_MemSnapshotPublish();
+
 	fceuWrapperUnLock();
 
 	for (it=dbgWinList.begin(); it!=dbgWinList.end(); it++)
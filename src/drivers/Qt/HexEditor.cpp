@@ -47,6 +47,8 @@
 #include "../../ppu.h"
 #include "../../cart.h"
 #include "../../ines.h"
+#include "../../memsnap.h"
+#include "../../vramtrack.h"
 #include "../common/configSys.h"
 
 #include "Qt/main.h"
@@ -62,7 +64,6 @@
 #include "Qt/ConsoleUtilities.h"
 #include "Qt/ConsoleWindow.h"
 
-static bool memNeedsCheck = false;
 static HexBookMarkManager_t hbm;
 static std::list <HexEditorDialog_t*> winList;
 static const char *memViewNames[] = { "RAM", "PPU", "OAM", "ROM", NULL };
@@ -262,6 +263,31 @@ static int getOAM( unsigned int i )
 	return SPRAM[i & 0xFF];
 }
 //----------------------------------------------------------------------------
+// Memory activity checks read from the emulator's memory snapshot channel
+// so that they never need to wait for the emulation thread mutex.
+static const FCEUMemSnapshot *memSnap = NULL;
+
+static int getSnapRAM( unsigned int i )
+{
+	return memSnap->cpu[i & 0xFFFF];
+}
+//----------------------------------------------------------------------------
+static int getSnapPPU( unsigned int i )
+{
+	i &= 0x3FFF;
+
+	if ( memSnap->isNSF && (i >= 0x2000) )
+	{
+		return 0;
+	}
+	return memSnap->ppu[i];
+}
+//----------------------------------------------------------------------------
+static int getSnapOAM( unsigned int i )
+{
+	return memSnap->oam[i & 0xFF];
+}
+//----------------------------------------------------------------------------
 static int getROM( unsigned int offset)
 {
 	if (GameInfo == NULL )
@@ -338,6 +364,7 @@ static int writeMem( int mode, unsigned int addr, int value )
 			if (addr < 0x2000)
 			{
 				VPage[addr >> 10][addr] = value; //todo: detect if this is vrom and turn it red if so
+				FCEU_VRAMTrackWrite( addr );
 			}
 			if ((addr >= 0x2000) && (addr < 0x3F00))
 			{
@@ -368,12 +395,15 @@ static int writeMem( int mode, unsigned int addr, int value )
 			else if ( (addr >= PRGsize[0]+16) && (addr < CHRsize[0]+PRGsize[0]+16) )
 			{
 				*(uint8 *)(GetNesCHRPointer(addr-16-PRGsize[0])) = value;
+				FCEU_VRAMTrackInvalidate();
 			}
+			FCEU_MemNoteRomWrite( addr );
 		}
 		break;
 	}
 
 	hexEditorRequestUpdateAll();
+	FCEUI_MemSnapshotRequestUpdate();
 
    return 0;
 }
@@ -416,8 +446,10 @@ static int convFromXchar( int i )
 memBlock_t::memBlock_t( void )
 {
 	buf = NULL;
+	pageActv = NULL;
 	_size = 0;
 	_maxLines = 0;
+	_numPages = 0;
 	memAccessFunc = NULL;
 }
 //----------------------------------------------------------------------------
@@ -428,8 +460,13 @@ memBlock_t::~memBlock_t(void)
 	{
 		::free( buf ); buf = NULL;
 	}
+	if ( pageActv != NULL )
+	{
+		::free( pageActv ); pageActv = NULL;
+	}
 	_size = 0;
    _maxLines = 0;
+	_numPages = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -448,12 +485,21 @@ int memBlock_t::reAlloc( int newSize )
 	{
 		::free( buf ); buf = NULL;
 	}
+	if ( pageActv != NULL )
+	{
+		::free( pageActv ); pageActv = NULL;
+	}
 	_size = 0;
 	_maxLines = 0;
+	_numPages = 0;
 
 	buf = (struct memByte_t *)malloc( newSize * sizeof(struct memByte_t) );
 
-	if ( buf != NULL )
+	_numPages = (newSize + MEMSNAP_PAGE_SIZE - 1) >> MEMSNAP_PAGE_SHIFT;
+
+	pageActv = (unsigned char *)malloc( _numPages );
+
+	if ( (buf != NULL) && (pageActv != NULL) )
 	{
 		_size = newSize;
 		init();
@@ -467,7 +513,11 @@ int memBlock_t::reAlloc( int newSize )
 	   	_maxLines = (_size / 16);
 	   }
 	}
-	return (buf == NULL);
+	else
+	{
+		_numPages = 0;
+	}
+	return (buf == NULL) || (pageActv == NULL);
 }
 //----------------------------------------------------------------------------
 void memBlock_t::setAccessFunc( int (*newMemAccessFunc)( unsigned int offset) )
@@ -484,6 +534,7 @@ void memBlock_t::init(void)
 		buf[i].actv  = 0;
 		//buf[i].draw  = 1;
 	}
+	memset( pageActv, 0, _numPages );
 }
 //----------------------------------------------------------------------------
 HexBookMark::HexBookMark(void)
@@ -1375,6 +1426,8 @@ HexEditorDialog_t::HexEditorDialog_t(QWidget *parent)
 	winList.push_back(this);
 	fceuWrapperUnLock();
 
+	FCEUI_MemSnapshotSubscribe();
+
 	populateBookmarkMenu();
 
 	FCEUI_CreateCheatMap();
@@ -1389,6 +1442,8 @@ HexEditorDialog_t::~HexEditorDialog_t(void)
 	printf("Hex Editor Deleted\n");
 	periodicTimer->stop();
 
+	FCEUI_MemSnapshotUnsubscribe();
+
 	// Lock the emulation thread mutex to ensure
 	// that the emulator is not attempting to update memory values
 	// for window while we are destroying it or editing the window list.
@@ -1738,26 +1793,27 @@ void HexEditorDialog_t::openDebugSymbolEditWindow( int addr )
 //----------------------------------------------------------------------------
 void HexEditorDialog_t::updatePeriodic(void)
 {
+	bool redraw;
+
 	//printf("Update Periodic\n");
 	
 	undoEditAct->setEnabled( romEditList.undoQueueSize() > 0 );
 
-	if ( fceuWrapperTryLock(0) )
-	{
-		memNeedsCheck = false;
-
-		editor->checkMemActivity();
+	redraw = editor->checkMemActivity() > 0;
 
-		fceuWrapperUnLock();
-	}
-	else
+	// The cursor blink also provides a periodic full redraw for
+	// state owned by other windows (cheats, bookmarks, debugger).
+	if ( editor->updateCursorBlink() )
 	{
-		memNeedsCheck = true;
+		redraw = true;
 	}
 
 	editor->memModeUpdate();
 
-	editor->update();
+	if ( redraw )
+	{
+		editor->update();
+	}
 
 	setWindowTitle();
 
@@ -1871,7 +1927,10 @@ QHexEdit::QHexEdit(QWidget *parent)
 	editMask  =  0;
 	reverseVideo = true;
 	actvHighlightEnable = true;
-	total_instructions_lp = 0;
+	snapVersionLp = 0;
+	romGenLp      = 0;
+	actvCheckMode = -1;
+	actvCheckSize = 0;
 	pxLineXScroll = 0;
 
 	frzRamAddr = -1;
@@ -3274,49 +3333,165 @@ void QHexEdit::requestUpdate(void)
 	updateRequested = true;
 }
 //----------------------------------------------------------------------------
-// Calling of checkMemActivity must always be synchronized with the emulation
-// thread as calling GetMem while the emulation is executing can mess up certain
-// registers (especially controller registers $4016 and $4017)
+// RAM, PPU and OAM activity is checked against the emulator's memory snapshot
+// channel, so this no longer needs to be synchronized with the emulation thread.
+//
+// Only pages written since the last check (according to the snapshot page
+// versions or the ROM write generations) and pages that still have highlighted
+// bytes fading out are compared. Returns the number of such pages that are
+// currently in view, zero if nothing visible needs to be redrawn.
 int QHexEdit::checkMemActivity(void)
 {
-	int c;
+	int c, visStart, visEnd, numVisible = 0;
+	int (*readFunc)( unsigned int offset) = memAccessFunc;
+	const uint32_t *pageVer = NULL;
+	uint32_t romGen = 0;
+	bool fullScan;
+
+	fullScan = updateRequested || (viewMode != actvCheckMode) || (mb.size() != actvCheckSize);
 
 	// Don't perform memory activity checks when:
-	// 1. In ROM View Mode
-	// 2. The simulation is not cycling (paused)
+	// 1. In ROM View Mode and the ROM has not been written
+	// 2. No new memory snapshot has been published (paused)
 
-	if ( !updateRequested )
+	if ( viewMode == MODE_NES_ROM )
 	{
-		if ( ( viewMode == MODE_NES_ROM ) ||
-		      ( total_instructions_lp == total_instructions ) )
+		romGen = FCEUI_MemRomWriteGen();
+
+		if ( !fullScan && (romGen == romGenLp) )
 		{
-			return -1;
+			return 0;
+		}
+	}
+	else
+	{
+		memSnap = FCEUI_MemSnapshotAcquire();
+
+		if ( !fullScan && (memSnap->version == snapVersionLp) )
+		{
+			return 0;
+		}
+
+		switch ( viewMode )
+		{
+			default:
+			case MODE_NES_RAM:
+				readFunc = getSnapRAM;
+				pageVer  = memSnap->cpuPageVer;
+			break;
+			case MODE_NES_PPU:
+				readFunc = getSnapPPU;
+				pageVer  = memSnap->ppuPageVer;
+			break;
+			case MODE_NES_OAM:
+				readFunc = getSnapOAM;
+				pageVer  = &memSnap->oamPageVer;
+			break;
 		}
 	}
 
-	for (int i=0; i<mb.size(); i++)
+	if ( (readFunc == NULL) || (mb.size() == 0) )
+	{
+		return 0;
+	}
+
+	visStart = lineOffset * 16;
+	visEnd   = visStart + (viewLines * 16);
+
+	// ROM reads go to the cart memory itself, which a game load or close frees
+	if ( viewMode == MODE_NES_ROM )
+	{
+		fceuWrapperLock();
+	}
+
+	for (int p=0; p<mb.numPages(); p++)
 	{
-		c = memAccessFunc(i);
+		int start = p * MEMSNAP_PAGE_SIZE;
+		int end   = start + MEMSNAP_PAGE_SIZE;
+		bool dirty;
 
-		if ( c != mb.buf[i].data )
+		if ( end > mb.size() )
 		{
-			mb.buf[i].actv  = 15;
-			mb.buf[i].data  = c;
-			//mb.buf[i].draw  = 1;
+			end = mb.size();
+		}
+
+		if ( fullScan )
+		{
+			dirty = true;
+		}
+		else if ( viewMode == MODE_NES_ROM )
+		{
+			dirty = FCEUI_MemRomPageGen( start ) > romGenLp;
 		}
 		else
 		{
+			dirty = pageVer[p] > snapVersionLp;
+		}
+
+		if ( !dirty && (mb.pageActv[p] == 0) )
+		{
+			continue;
+		}
+		mb.pageActv[p] = 0;
+
+		for (int i=start; i<end; i++)
+		{
+			c = readFunc(i);
+
+			if ( c != mb.buf[i].data )
+			{
+				mb.buf[i].actv  = 15;
+				mb.buf[i].data  = c;
+				//mb.buf[i].draw  = 1;
+			}
+			else
+			{
+				if ( mb.buf[i].actv > 0 )
+				{
+					//mb.buf[i].draw = 1;
+					mb.buf[i].actv--;
+				}
+			}
 			if ( mb.buf[i].actv > 0 )
 			{
-				//mb.buf[i].draw = 1;
-				mb.buf[i].actv--;
+				mb.pageActv[p] = 1;
 			}
 		}
+
+		if ( (start < visEnd) && (end > visStart) )
+		{
+			numVisible++;
+		}
+	}
+
+	if ( viewMode == MODE_NES_ROM )
+	{
+		fceuWrapperUnLock();
+		romGenLp = romGen;
+	}
+	else
+	{
+		snapVersionLp = memSnap->version;
 	}
-	total_instructions_lp = total_instructions;
+	actvCheckMode = viewMode;
+	actvCheckSize = mb.size();
 	updateRequested = false;
 
-   return 0;
+   return numVisible;
+}
+//----------------------------------------------------------------------------
+// Advances the cursor blink timer, returns true when the cursor needs redrawing.
+bool QHexEdit::updateCursorBlink(void)
+{
+	if ( cursorBlinkCount >= 5 )
+	{
+		cursorBlink = !cursorBlink;
+		cursorBlinkCount = 0;
+		return true;
+	}
+	cursorBlinkCount++;
+
+	return false;
 }
 //----------------------------------------------------------------------------
 int QHexEdit::getRomAddrColor( int addr, QColor &fg, QColor &bg )
@@ -3342,14 +3517,6 @@ int QHexEdit::getRomAddrColor( int addr, QColor &fg, QColor &bg )
 	{
 		return -1;
 	}
-	if ( memAccessFunc )
-	{
-		mb.buf[addr].data = memAccessFunc(addr);
-	}
-	else
-	{
-		mb.buf[addr].data = 0;
-	}
 
 	if ( (txtHlgtStartAddr != txtHlgtEndAddr) && (addr >= txtHlgtStartAddr) && (addr <= txtHlgtEndAddr) )
 	{
@@ -3545,16 +3712,6 @@ void QHexEdit::paintEvent(QPaintEvent *event)
 	
 	painter.fillRect( 0, 0, w, h, this->palette().color(QPalette::Background) );
 
-	if ( cursorBlinkCount >= 5 )
-	{
-		cursorBlink = !cursorBlink;
-		cursorBlinkCount = 0;
-	} 
-	else
-  	{
-		cursorBlinkCount++;
-	}
-
 	cy = pxYoffset + (pxLineSpacing*cursorPosY) - pxCursorHeight + pxLineLead;
 
 	if ( cursorPosX < 32 )
@@ -3839,20 +3996,3 @@ int hexEditorOpenFromDebugger( int mode, int addr )
 	return 0;
 }
 //----------------------------------------------------------------------------
-// This function must be called from within the emulation thread
-void hexEditorUpdateMemoryValues(void)
-{
-	std::list <HexEditorDialog_t*>::iterator it;
-
-	if ( !memNeedsCheck )
-	{
-		return;
-	}
-
-	for (it = winList.begin(); it != winList.end(); it++)
-	{
-		(*it)->editor->checkMemActivity();
-	}
-	memNeedsCheck = false;
-}
-//----------------------------------------------------------------------------
@@ -39,12 +39,15 @@ struct memBlock_t
 	void init(void);
 	int  size(void){ return _size; }
 	int  numLines(void){ return _maxLines; }
+	int  numPages(void){ return _numPages; }
 	int  reAlloc( int newSize );
 	void setAccessFunc( int (*newMemAccessFunc)( unsigned int offset) );
 
 	struct memByte_t *buf;
+	unsigned char *pageActv;  // page still has highlighted bytes
 	int  _size;
 	int  _maxLines;
+	int  _numPages;
 	int (*memAccessFunc)( unsigned int offset);
 };
 
@@ -133,6 +136,7 @@ class QHexEdit : public QWidget
 		void memModeUpdate(void);
 		void openGotoAddrDialog(void);
 		int  checkMemActivity(void);
+		bool updateCursorBlink(void);
 		int  getAddr(void){ return cursorAddr; };
 		int  FreezeRam( const char *name, uint32_t a, uint8_t v, int c, int s, int type );
 		void loadHighlightToClipboard(void);
@@ -186,7 +190,10 @@ class QHexEdit : public QWidget
 
 		HexEditorDialog_t *parent;
 
-		uint64_t total_instructions_lp;
+		uint32_t snapVersionLp;
+		uint32_t romGenLp;
+		int      actvCheckMode;
+		int      actvCheckSize;
 
 		int viewMode;
 		int lineOffset;
@@ -340,7 +347,6 @@ class HexEditorDialog_t : public QDialog
 
 int hexEditorNumWindows(void);
 void hexEditorRequestUpdateAll(void);
-void hexEditorUpdateMemoryValues(void);
 void hexEditorLoadBookmarks(void);
 void hexEditorSaveBookmarks(void);
 int hexEditorOpenFromDebugger( int mode, int addr );
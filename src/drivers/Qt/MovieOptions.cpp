@@ -59,6 +59,8 @@ MovieOptionsDialog_t::MovieOptionsDialog_t(QWidget *parent)
 	putSubTitlesAvi = new QCheckBox(tr("Put Movie Sub Titles in AVI"));
 	autoBackUp = new QCheckBox(tr("Automatically Backup Movies"));
 	loadFullStates = new QCheckBox(tr("Load Full Save-State Movies:"));
+	slimStates = new QCheckBox(tr("Slim Save-State Movies (store only changed input)"));
+	journalRecording = new QCheckBox(tr("Journal Movie Recording (append edits, rewrite movie file in background)"));
 
 	lbl = new QLabel(tr("Loading states in record mode will not immediately truncate movie, next frame input will. (VBA-rr and SNES9x style)"));
 	lbl->setWordWrap(true);
@@ -72,6 +74,8 @@ MovieOptionsDialog_t::MovieOptionsDialog_t(QWidget *parent)
 	mainLayout->addWidget(autoBackUp);
 	mainLayout->addWidget(loadFullStates);
 	mainLayout->addWidget(lbl);
+	mainLayout->addWidget(slimStates);
+	mainLayout->addWidget(journalRecording);
 
 	readOnlyReplay->setChecked(suggestReadOnlyReplay);
 	pauseAfterPlay->setChecked(pauseAfterPlayback);
@@ -81,6 +85,8 @@ MovieOptionsDialog_t::MovieOptionsDialog_t(QWidget *parent)
 	putSubTitlesAvi->setChecked(subtitlesOnAVI);
 	autoBackUp->setChecked(autoMovieBackup);
 	loadFullStates->setChecked(fullSaveStateLoads);
+	slimStates->setChecked(slimMovieStates);
+	journalRecording->setChecked(journalMovieRecording);
 
 	closeButton = new QPushButton( tr("Close") );
 	closeButton->setIcon(style()->standardIcon(QStyle::SP_DialogCloseButton));
@@ -101,6 +107,8 @@ MovieOptionsDialog_t::MovieOptionsDialog_t(QWidget *parent)
 	connect(putSubTitlesAvi, SIGNAL(stateChanged(int)), this, SLOT(putSubTitlesAviChanged(int)));
 	connect(autoBackUp, SIGNAL(stateChanged(int)), this, SLOT(autoBackUpChanged(int)));
 	connect(loadFullStates, SIGNAL(stateChanged(int)), this, SLOT(loadFullStatesChanged(int)));
+	connect(slimStates, SIGNAL(stateChanged(int)), this, SLOT(slimStatesChanged(int)));
+	connect(journalRecording, SIGNAL(stateChanged(int)), this, SLOT(journalRecordingChanged(int)));
 }
 //----------------------------------------------------------------------------
 MovieOptionsDialog_t::~MovieOptionsDialog_t(void)
@@ -165,3 +173,13 @@ void MovieOptionsDialog_t::loadFullStatesChanged(int state)
 	fullSaveStateLoads = (state != Qt::Unchecked);
 }
 //----------------------------------------------------------------------------
+void MovieOptionsDialog_t::slimStatesChanged(int state)
+{
+	slimMovieStates = (state != Qt::Unchecked);
+}
+//----------------------------------------------------------------------------
+void MovieOptionsDialog_t::journalRecordingChanged(int state)
+{
+	journalMovieRecording = (state != Qt::Unchecked);
+}
+//----------------------------------------------------------------------------
@@ -37,6 +37,8 @@ protected:
 	QCheckBox *putSubTitlesAvi;
 	QCheckBox *autoBackUp;
 	QCheckBox *loadFullStates;
+	QCheckBox *slimStates;
+	QCheckBox *journalRecording;
 
 private:
 public slots:
@@ -50,4 +52,6 @@ private slots:
 	void putSubTitlesAviChanged(int state);
 	void autoBackUpChanged(int state);
 	void loadFullStatesChanged(int state);
+	void slimStatesChanged(int state);
+	void journalRecordingChanged(int state);
 };
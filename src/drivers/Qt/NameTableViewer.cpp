@@ -37,6 +37,7 @@
 #include "../../ines.h"
 #include "../../debug.h"
 #include "../../palette.h"
+#include "../../vramtrack.h"
 
 #include "Qt/ConsoleWindow.h"
 #include "Qt/ConsoleUtilities.h"
@@ -64,6 +65,9 @@ static bool drawTileGridLines = true;
 static bool drawAttrGridLines = false;
 static bool redrawtables = true;
 static bool resetDrawCounter = true;
+static uint32 vramSyncLp = 0; // VRAM tracking generation of the last table update
+static int drawModeLp = -1;
+static pal palrgbLp[32];
 
 //extern int FCEUPPU_GetAttr(int ntnum, int xt, int yt);
 
@@ -75,12 +79,13 @@ static class NTCache
 {
 public:
 	NTCache(void) 
-		: curr_vnapage(0)
+		: curr_vnapage(0), curr_ptable(-1)
 	{
 		memset( cache, 0, sizeof(cache) );
 	}
 
 	uint8_t* curr_vnapage;
+	int curr_ptable;
 	uint8_t cache[0x400];
 } cache[4];
 
@@ -1595,7 +1600,7 @@ inline void DrawChr( ppuNameTableTile_t *tile, const uint8_t *chr, int pal)
 	//pbitmap -= (((PALETTEBITWIDTH>>2)<<3)-24);
 }
 //----------------------------------------------------
-static void DrawNameTable(int scanline, int ntnum, bool invalidateCache) 
+static void DrawNameTable(int scanline, int ntnum, bool invalidateCache, uint32 vramSince) 
 {
 	NTCache &c = cache[ntnum];
 	uint8_t *tablecache = c.cache;
@@ -1613,15 +1618,19 @@ static void DrawNameTable(int scanline, int ntnum, bool invalidateCache)
 	}
 
 	bool invalid = invalidateCache;
-	//if we werent asked to invalidate the cache, maybe we need to invalidate it anyway due to vnapage changing
+	//if we werent asked to invalidate the cache, maybe we need to invalidate it anyway due to vnapage or the pattern table changing
 	if (!invalid)
 	{
-		invalid = (c.curr_vnapage != vnapage[ntnum]);
+		invalid = (c.curr_vnapage != vnapage[ntnum]) || (c.curr_ptable != ptable);
 	}
 	c.curr_vnapage = vnapage[ntnum];
+	c.curr_ptable  = ptable;
 	
-	//HACK: never cache anything
-	invalid = true;
+	//in its extended attribute mode MMC5 picks each tile's CHR bank from extended RAM, which the VRAM tracking does not see
+	if (MMC5Hack && (MMC5HackCHRMode == 1))
+	{
+		invalid = true;
+	}
 
 	for (int y=0;y<30;y++)
 	{
@@ -1631,7 +1640,8 @@ static void DrawNameTable(int scanline, int ntnum, bool invalidateCache)
 			int attraddr = 0x3C0+((y>>2)<<3)+(x>>2);
 			if (invalid
 				|| (table[ntaddr] != tablecache[ntaddr]) 
-				|| (table[attraddr] != tablecache[attraddr])) 
+				|| (table[attraddr] != tablecache[attraddr])
+				|| FCEUI_VRAMTrackTileChanged( (ptable + (table[ntaddr] << 4)) / VRAMTRACK_TILE_SIZE, vramSince )) 
 			{
 				int temp = (((y&2)<<1)+(x&2));
 				a = (table[attraddr] & (3<<temp)) >> temp;
@@ -1710,6 +1720,27 @@ void FCEUD_UpdateNTView(int scanline, bool drawall)
 		drawall = 1; //palette has changed, so redraw all
 	}
 
+	//the system palette and the view options change every tile as well
+	if (palo != NULL)
+	{
+		pal palrgb[32];
+
+		for (int i=0;i<32;i++)
+		{
+			palrgb[i] = palo[palcache[i]];
+		}
+		if (memcmp(palrgb,palrgbLp,sizeof(palrgb)) != 0)
+		{
+			memcpy(palrgbLp,palrgb,sizeof(palrgb));
+			drawall = 1;
+		}
+	}
+	if ((attview | (hidepal << 1)) != drawModeLp)
+	{
+		drawModeLp = attview | (hidepal << 1);
+		drawall = 1;
+	}
+
 	if ( vnapage[0] == NULL )
 	{
 		return;
@@ -1733,9 +1764,14 @@ void FCEUD_UpdateNTView(int scanline, bool drawall)
 		oldntmirroring = ntmirroring;
 	}
 
+	//only tiles whose pattern data was written or bank switched since the last update are redrawn
+	uint32 vramSince = vramSyncLp;
+
+	vramSyncLp = FCEUI_VRAMTrackSync();
+
 	for (int i=0;i<4;i++)
 	{
-		DrawNameTable(scanline,i,drawall);
+		DrawNameTable(scanline,i,drawall,vramSince);
 	}
 
 	chrchanged = 0;
@@ -45,6 +45,7 @@
 #include "../../cheat.h"
 #include "../../debug.h"
 #include "../../movie.h"
+#include "../../memtrack.h"
 
 #include "Qt/main.h"
 #include "Qt/dface.h"
@@ -102,6 +103,7 @@ struct memoryLocation_t
 };
 static struct memoryLocation_t memLoc[0x10000];
 static uint8_t lclMemBuf[0x10000];
+static uint32_t lclChgBuf[0x10000];
 
 static std::list<struct memoryLocation_t *> actvSrchList;
 static std::list<struct memoryLocation_t *> deactvSrchList;
@@ -475,6 +477,12 @@ RamSearchDialog_t::RamSearchDialog_t(QWidget *parent)
 	cycleCounter = 0;
 	frameCounterLastPass = currFrameCounter;
 
+	// Change counting is done by the core at the end of every frame,
+	// only keep it running while this window is open.
+	fceuWrapperLock();
+	FCEUI_MemTrackEnable(true);
+	fceuWrapperUnLock();
+
 	resetSearch();
 
 	updateTimer = new QTimer(this);
@@ -490,6 +498,10 @@ RamSearchDialog_t::~RamSearchDialog_t(void)
 	printf("Destroy RAM Search Window\n");
 	ramSearchWin = NULL;
 
+	fceuWrapperLock();
+	FCEUI_MemTrackEnable(false);
+	fceuWrapperUnLock();
+
 	actvSrchList.clear();
 	deactvSrchList.clear();
 	deactvFrameStack.clear();
@@ -522,7 +534,7 @@ void RamSearchDialog_t::periodicUpdate(void)
 	if (currFrameCounter != frameCounterLastPass)
 	{
 		fceuWrapperLock();
-		copyRamToLocalBuffer();
+		updateLocalBuffer();
 		fceuWrapperUnLock();
 
 		//if ( currFrameCounter != (frameCounterLastPass+1) )
@@ -1105,12 +1117,56 @@ void RamSearchDialog_t::copyRamToLocalBuffer(void)
 	}
 }
 //----------------------------------------------------------------------------
+void RamSearchDialog_t::updateLocalBuffer(void)
+{
+	std::list<struct memoryLocation_t *>::iterator it;
+	int dataSize, maxAddr = ShowROM ? 0x10000 : 0x8000;
+
+	switch (dpySize)
+	{
+		case 'd':
+			dataSize = 4;
+			break;
+		case 'w':
+			dataSize = 2;
+			break;
+		default:
+			dataSize = 1;
+			break;
+	}
+
+	// RAM and WRAM values and change counts come from the core's end of frame
+	// snapshot, so no change is missed between two timer ticks.
+	FCEUI_MemTrackCopy(lclMemBuf, lclChgBuf, dataSize);
+
+	// Everything else (registers and ROM) is only read for addresses still
+	// part of the active search.
+	for (it = actvSrchList.begin(); it != actvSrchList.end(); it++)
+	{
+		int addr = (*it)->addr;
+
+		for (int i = 0; i < 4; i++)
+		{
+			if ((addr + i) >= maxAddr)
+			{
+				break;
+			}
+			if (!FCEUI_MemTrackIsTracked(addr + i))
+			{
+				lclMemBuf[addr + i] = GetMem(addr + i);
+			}
+		}
+	}
+}
+//----------------------------------------------------------------------------
 void RamSearchDialog_t::resetSearch(void)
 {
 	memset(lclMemBuf, 0, sizeof(lclMemBuf));
+	memset(lclChgBuf, 0, sizeof(lclChgBuf));
 
 	fceuWrapperLock();
 	copyRamToLocalBuffer();
+	FCEUI_MemTrackClearCounts();
 	fceuWrapperUnLock();
 
 	actvSrchList.clear();
@@ -1186,6 +1242,12 @@ void RamSearchDialog_t::undoSearch(void)
 //----------------------------------------------------------------------------
 void RamSearchDialog_t::clearChangeCounts(void)
 {
+	fceuWrapperLock();
+	FCEUI_MemTrackClearCounts();
+	fceuWrapperUnLock();
+
+	memset(lclChgBuf, 0, sizeof(lclChgBuf));
+
 	for (unsigned int addr = 0; addr < 0x10000; addr++)
 	{
 		memLoc[addr].chgCount = 0;
@@ -1534,7 +1596,13 @@ void RamSearchDialog_t::updateRamValues(void)
 		val.v16.u = ReadValueAtHardwareAddress(loc->addr, 2);
 		val.v32.u = ReadValueAtHardwareAddress(loc->addr, 4);
 
-		if (dpySize == 'd')
+		if (FCEUI_MemTrackIsTracked(loc->addr))
+		{
+			// Counted every frame by the core
+			memLoc[loc->addr].val = val;
+			memLoc[loc->addr].chgCount = lclChgBuf[loc->addr];
+		}
+		else if (dpySize == 'd')
 		{
 			if (memLoc[loc->addr].val.v32.u != val.v32.u)
 			{
@@ -132,6 +132,7 @@ class RamSearchDialog_t : public QDialog
 		void SearchSpecificAddress(void);
 		void SearchNumberChanges(void);
 		void copyRamToLocalBuffer(void);
+		void updateLocalBuffer(void);
 
 	public slots:
 		void closeWindow(void);
@@ -40,6 +40,7 @@
 #include "../../fceu.h"
 #include "../../cheat.h"
 #include "../../debug.h"
+#include "../../memsnap.h"
 
 #include "Qt/main.h"
 #include "Qt/dface.h"
@@ -298,6 +299,8 @@ RamWatchDialog_t::RamWatchDialog_t(QWidget *parent)
 
 	ramWatchMainWin = this;
 
+	FCEUI_MemSnapshotSubscribe();
+
 	updateTimer  = new QTimer( this );
 
 	connect( updateTimer, &QTimer::timeout, this, &RamWatchDialog_t::periodicUpdate );
@@ -309,6 +312,8 @@ RamWatchDialog_t::~RamWatchDialog_t(void)
 {
 	updateTimer->stop();
 
+	FCEUI_MemSnapshotUnsubscribe();
+
 	if ( ramWatchMainWin == this )
 	{
 	   ramWatchMainWin = NULL;
@@ -365,6 +370,8 @@ void RamWatchDialog_t::updateRamWatchDisplay(void)
 	std::list < ramWatch_t * >::iterator it;
 	char addrStr[32], valStr1[16], valStr2[16];
 	ramWatch_t *rw;
+	// one snapshot for all the entries, so they show the same frame
+	const uint8_t *mem = FCEUI_MemSnapshotAcquire()->cpu;
 
 	for (it = ramWatchList.ls.begin (); it != ramWatchList.ls.end (); it++)
 	{
@@ -399,7 +406,7 @@ void RamWatchDialog_t::updateRamWatchDisplay(void)
 			}
 		}
 
-		rw->updateMem ();
+		rw->updateMem (mem);
 
 		if ( rw->isSep || (rw->addr < 0) )
 		{
@@ -713,26 +720,29 @@ void RamWatchDialog_t::saveListAs(void)
 	saveWatchFile( filename.toStdString().c_str() );
 }
 //----------------------------------------------------------------------------
-void ramWatch_t::updateMem (void)
+// mem is the CPU space of a snapshot from the emulator's memory
+// snapshot channel, acquired once per refresh by the caller.
+void ramWatch_t::updateMem (const uint8_t *mem)
 {
 	if ( addr < 0 )
 	{
 		return;
 	}
+
 	if (size == 1)
 	{
-		val.u8 = GetMem (addr);
+		val.u8 = mem[addr & 0xFFFF];
 	}
 	else if (size == 2)
 	{
-		val.u16 = (GetMem (addr) << 8) | GetMem (addr + 1);
+		val.u16 = (mem[addr & 0xFFFF] << 8) | mem[(addr + 1) & 0xFFFF];
 	}
 	else if (size == 4)
 	{
-		val.u32  = GetMem (addr + 3);
-		val.u32 |= GetMem (addr + 2) << 8;
-		val.u32 |= GetMem (addr + 1) << 16;
-		val.u32 |= GetMem (addr    ) << 24;
+		val.u32  = mem[(addr + 3) & 0xFFFF];
+		val.u32 |= mem[(addr + 2) & 0xFFFF] << 8;
+		val.u32 |= mem[(addr + 1) & 0xFFFF] << 16;
+		val.u32 |= mem[(addr    ) & 0xFFFF] << 24;
 	}
 }
 //------------------------------------------------------------------------.----
@@ -46,7 +46,7 @@ struct ramWatch_t
 		val.u32 = 0;
 	};
 
-	void updateMem (void);
+	void updateMem (const uint8_t *mem);
 };
 
 struct ramWatchList_t
@@ -104,7 +104,7 @@ struct ramWatchList_t
 		ls.push_back (rw);
 	}
 
-	void updateMemoryValues (void)
+	void updateMemoryValues (const uint8_t *mem)
 	{
 		ramWatch_t *rw;
 		std::list < ramWatch_t * >::iterator it;
@@ -113,7 +113,7 @@ struct ramWatchList_t
 		{
 			rw = *it;
 
-			rw->updateMem ();
+			rw->updateMem (mem);
 		}
 	}
 
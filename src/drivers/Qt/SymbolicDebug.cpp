@@ -23,6 +23,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <chrono>
+#include <vector>
+
 #include "../../types.h"
 #include "../../fceu.h"
 #include "../../debug.h"
@@ -228,11 +231,177 @@ void debugSymbolPage_t::print(void)
 	}
 }
 //--------------------------------------------------------------
+// debugSymbolIndex_t
+//--------------------------------------------------------------
+debugSymbolIndex_t::debugSymbolIndex_t(void)
+{
+	table = NULL;
+	mask  = 0;
+	numEntries = 0;
+}
+//--------------------------------------------------------------
+debugSymbolIndex_t::~debugSymbolIndex_t(void)
+{
+	if ( table )
+	{
+		free( table ); table = NULL;
+	}
+}
+//--------------------------------------------------------------
+void debugSymbolIndex_t::clear(void)
+{
+	if ( table )
+	{
+		memset( table, 0, (mask+1) * sizeof(entry_t) );
+	}
+	numEntries = 0;
+}
+//--------------------------------------------------------------
+unsigned int debugSymbolIndex_t::slot( int bank, int ofs )
+{
+	uint64_t key;
+
+	key = ((uint64_t)(uint32_t)bank << 32) | (uint32_t)ofs;
+
+	key *= 0x9E3779B97F4A7C15ull;
+
+	return (unsigned int)(key >> 32) & mask;
+}
+//--------------------------------------------------------------
+void debugSymbolIndex_t::resize( unsigned int newSize )
+{
+	entry_t *oldTable = table;
+	unsigned int i, oldSize = oldTable ? (mask+1) : 0;
+
+	table = (entry_t*)calloc( newSize, sizeof(entry_t) );
+	mask  = newSize - 1;
+	numEntries = 0;
+
+	for (i=0; i<oldSize; i++)
+	{
+		if ( oldTable[i].sym != NULL )
+		{
+			insert( oldTable[i].bank, oldTable[i].ofs, oldTable[i].sym );
+		}
+	}
+	if ( oldTable )
+	{
+		free( oldTable );
+	}
+}
+//--------------------------------------------------------------
+void debugSymbolIndex_t::reserve( int n )
+{
+	unsigned int size = 64;
+
+	// Keep the load factor at or below one half so that probe chains stay short.
+	while ( size < (unsigned int)(n * 2) )
+	{
+		size <<= 1;
+	}
+	if ( (table == NULL) || (size > (mask+1)) )
+	{
+		resize( size );
+	}
+}
+//--------------------------------------------------------------
+void debugSymbolIndex_t::insert( int bank, int ofs, debugSymbol_t *sym )
+{
+	unsigned int i;
+
+	if ( (table == NULL) || ((unsigned int)(numEntries+1) * 2 > (mask+1)) )
+	{
+		reserve( numEntries+1 );
+	}
+	i = slot( bank, ofs );
+
+	while ( table[i].sym != NULL )
+	{
+		if ( (table[i].bank == bank) && (table[i].ofs == ofs) )
+		{
+			table[i].sym = sym;
+			return;
+		}
+		i = (i+1) & mask;
+	}
+	table[i].bank = bank;
+	table[i].ofs  = ofs;
+	table[i].sym  = sym;
+	numEntries++;
+}
+//--------------------------------------------------------------
+void debugSymbolIndex_t::remove( int bank, int ofs )
+{
+	unsigned int i, j, k;
+
+	if ( table == NULL )
+	{
+		return;
+	}
+	i = slot( bank, ofs );
+
+	while ( table[i].sym != NULL )
+	{
+		if ( (table[i].bank == bank) && (table[i].ofs == ofs) )
+		{
+			break;
+		}
+		i = (i+1) & mask;
+	}
+	if ( table[i].sym == NULL )
+	{
+		return;
+	}
+
+	// Shift the following entries of the probe chain back so no
+	// tombstones are needed.
+	j = i;
+	while (1)
+	{
+		j = (j+1) & mask;
+
+		if ( table[j].sym == NULL )
+		{
+			break;
+		}
+		k = slot( table[j].bank, table[j].ofs );
+
+		if ( (i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j)) )
+		{
+			continue;
+		}
+		table[i] = table[j]; i = j;
+	}
+	table[i].sym = NULL;
+	numEntries--;
+}
+//--------------------------------------------------------------
+debugSymbol_t *debugSymbolIndex_t::find( int bank, int ofs )
+{
+	unsigned int i;
+
+	if ( table == NULL )
+	{
+		return NULL;
+	}
+	i = slot( bank, ofs );
+
+	while ( table[i].sym != NULL )
+	{
+		if ( (table[i].bank == bank) && (table[i].ofs == ofs) )
+		{
+			return table[i].sym;
+		}
+		i = (i+1) & mask;
+	}
+	return NULL;
+}
+//--------------------------------------------------------------
 // debugSymbolTable_t
 //--------------------------------------------------------------
 debugSymbolTable_t::debugSymbolTable_t(void)
 {
-
+	nameIndexValid = false;
 }
 //--------------------------------------------------------------
 debugSymbolTable_t::~debugSymbolTable_t(void)
@@ -249,6 +418,58 @@ void debugSymbolTable_t::clear(void)
 		delete it->second;
 	}
 	pageMap.clear();
+
+	addrIndex.clear();
+	nameIndex.clear();
+	nameIndexValid = false;
+}
+//--------------------------------------------------------------
+void debugSymbolTable_t::rebuildIndex(void)
+{
+	int n = 0;
+	std::map <int, debugSymbolPage_t*>::iterator it;
+	std::map <int, debugSymbol_t*>::iterator symIt;
+
+	for (it=pageMap.begin(); it!=pageMap.end(); it++)
+	{
+		n += it->second->size();
+	}
+	addrIndex.clear();
+	addrIndex.reserve( n );
+
+	for (it=pageMap.begin(); it!=pageMap.end(); it++)
+	{
+		debugSymbolPage_t *page = it->second;
+
+		for (symIt=page->symMap.begin(); symIt!=page->symMap.end(); symIt++)
+		{
+			addrIndex.insert( page->pageNum, symIt->first, symIt->second );
+		}
+	}
+	nameIndexValid = false;
+}
+//--------------------------------------------------------------
+void debugSymbolTable_t::rebuildNameIndex(void)
+{
+	std::map <int, debugSymbolPage_t*>::iterator it;
+	std::map <int, debugSymbol_t*>::iterator symIt;
+
+	nameIndex.clear();
+	nameIndex.reserve( addrIndex.size() );
+
+	for (it=pageMap.begin(); it!=pageMap.end(); it++)
+	{
+		debugSymbolPage_t *page = it->second;
+
+		for (symIt=page->symMap.begin(); symIt!=page->symMap.end(); symIt++)
+		{
+			if ( symIt->second->name.size() > 0 )
+			{
+				nameIndex.insert( std::make_pair( symIt->second->name, std::make_pair( page->pageNum, symIt->second ) ) );
+			}
+		}
+	}
+	nameIndexValid = true;
 }
 //--------------------------------------------------------------
 int generateNLFilenameForAddress(int address, char *NLfilename)
@@ -636,6 +857,8 @@ int debugSymbolTable_t::loadGameSymbols(void)
 		loadFileNL( i );
 	}
 
+	rebuildIndex();
+
 	//print();
 
 	return 0;
@@ -658,7 +881,11 @@ int debugSymbolTable_t::addSymbolAtBankOffset( int bank, int ofs, debugSymbol_t
 	{
 		page = it->second;
 	}
-	page->addSymbol( sym );
+	if ( page->addSymbol( sym ) == 0 )
+	{
+		addrIndex.insert( bank, sym->ofs, sym );
+	}
+	nameIndexValid = false;
 
 	return 0;
 }
@@ -678,20 +905,48 @@ int debugSymbolTable_t::deleteSymbolAtBankOffset( int bank, int ofs )
 	{
 		page = it->second;
 	}
+	addrIndex.remove( bank, ofs );
+	nameIndexValid = false;
 
 	return page->deleteSymbolAtOffset( ofs );
 }
 //--------------------------------------------------------------
 debugSymbol_t *debugSymbolTable_t::getSymbolAtBankOffset( int bank, int ofs )
 {
-	debugSymbol_t*sym = NULL;
-	std::map <int, debugSymbolPage_t*>::iterator it;
+	return addrIndex.find( bank, ofs );
+}
+//--------------------------------------------------------------
+debugSymbol_t *debugSymbolTable_t::getSymbolByName( const char *name, int *bankOut )
+{
+	debugSymbol_t *sym = NULL;
+	int bank = -1;
+	std::pair <nameIndexMap_t::iterator, nameIndexMap_t::iterator> range;
+	nameIndexMap_t::iterator it;
 
-	it = pageMap.find( bank );
+	if ( !nameIndexValid )
+	{
+		rebuildNameIndex();
+	}
+	range = nameIndex.equal_range( name );
 
-	if ( it != pageMap.end() )
+	// A name can be used in several banks, prefer the one that is mapped in right now.
+	for (it=range.first; it!=range.second; it++)
 	{
-		sym = (it->second)->getSymbolAtOffset( ofs );
+		int b = it->second.first;
+		debugSymbol_t *s = it->second.second;
+
+		if ( (b < 0) || (s->ofs < 0x8000) || (getBank( s->ofs ) == b) )
+		{
+			sym = s; bank = b; break;
+		}
+		if ( sym == NULL )
+		{
+			sym = s; bank = b;
+		}
+	}
+	if ( bankOut )
+	{
+		*bankOut = bank;
 	}
 	return sym;
 }
@@ -1160,6 +1415,169 @@ int DisassembleWithDebug(int addr, uint8_t *opcode, int flags, char *str, debugS
 	return 0;
 }
 //--------------------------------------------------------------
+// Fills the table with numSymbols made up symbols over RAM and the PRG banks
+// of the loaded game and times what symbolic tracing does with them: address
+// lookups, against the page maps they used to go through, and disassembly of
+// $8000-$FFFF with symbols. Also times name lookups. The game's own symbols
+// are dropped, not saved, so this is for the command line only.
+bool debugSymbolBenchmark( int numSymbols )
+{
+	typedef std::chrono::steady_clock Clock;
+	const int lookups = 1000000;
+	const int passes  = 20;
+	int numBanks, ramSyms, added = 0, mismatch = 0, found = 0;
+	std::map <int, std::map <int, debugSymbol_t*> > pageMaps;
+	std::vector <int> lookupBank, lookupOfs;
+	std::vector <std::string> names;
+	char stmp[64], asmTxt[256];
+	Clock::time_point start;
+	double mapNs, indexNs, nameNs, asmNs;
+	int lines = 0;
+
+	if ( (GameInfo == NULL) || (GameInfo->type == GIT_NSF) || (PRGsize[0] == 0) )
+	{
+		FCEU_printf("The symbol benchmark needs a game.\n");
+		return false;
+	}
+	debugSymbolTable.clear();
+
+	numBanks = PRGsize[0] >> debuggerPageSize;
+	if ( numBanks < 1 )
+	{
+		numBanks = 1;
+	}
+	ramSyms = numSymbols / 8;
+	if ( ramSyms > 0x800 )
+	{
+		ramSyms = 0x800;
+	}
+
+	srand(1);
+	for (int i=0; i<numSymbols; i++)
+	{
+		int bank, ofs;
+
+		if ( i < ramSyms )
+		{
+			bank = -1;
+			ofs  = (i * 0x3F7) & 0x7FF;
+		}
+		else
+		{
+			bank = rand() % numBanks;
+			ofs  = 0x8000 | (rand() & 0x7FFF);
+		}
+		if ( pageMaps[bank].count( ofs ) )
+		{
+			continue;
+		}
+		sprintf( stmp, "sym_%02X_%04X", bank & 0xFF, ofs );
+
+		debugSymbol_t *sym = new debugSymbol_t( ofs, stmp );
+
+		debugSymbolTable.addSymbolAtBankOffset( bank, ofs, sym );
+		pageMaps[bank][ofs] = sym;
+		names.push_back( stmp );
+		added++;
+	}
+
+	// operands are mostly RAM and the code around them
+	lookupBank.resize( lookups );
+	lookupOfs.resize( lookups );
+	for (int i=0; i<lookups; i++)
+	{
+		if ( rand() & 1 )
+		{
+			lookupBank[i] = -1;
+			lookupOfs[i]  = rand() & 0x7FF;
+		}
+		else
+		{
+			lookupBank[i] = rand() % numBanks;
+			lookupOfs[i]  = 0x8000 | (rand() & 0x7FFF);
+		}
+	}
+
+	start = Clock::now();
+	for (int i=0; i<lookups; i++)
+	{
+		std::map <int, std::map <int, debugSymbol_t*> >::iterator page = pageMaps.find( lookupBank[i] );
+		debugSymbol_t *sym = NULL;
+
+		if ( page != pageMaps.end() )
+		{
+			std::map <int, debugSymbol_t*>::iterator it = page->second.find( lookupOfs[i] );
+
+			if ( it != page->second.end() )
+			{
+				sym = it->second;
+			}
+		}
+		found += (sym != NULL);
+	}
+	mapNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / lookups;
+
+	start = Clock::now();
+	for (int i=0; i<lookups; i++)
+	{
+		found -= (debugSymbolTable.getSymbolAtBankOffset( lookupBank[i], lookupOfs[i] ) != NULL);
+	}
+	indexNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / lookups;
+	mismatch += (found != 0);
+
+	start = Clock::now();
+	for (int i=0; i<lookups; i++)
+	{
+		const std::string &name = names[ i % names.size() ];
+		debugSymbol_t *sym = debugSymbolTable.getSymbolByName( name.c_str() );
+
+		mismatch += (sym == NULL) || (sym->name != name);
+	}
+	nameNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / lookups;
+
+	start = Clock::now();
+	for (int p=0; p<passes; p++)
+	{
+		int addr = 0x8000;
+
+		while ( addr < 0x10000 )
+		{
+			uint8_t opcode[3];
+			int size;
+
+			opcode[0] = GetMem( addr );
+			size = opsize[ opcode[0] ];
+			if ( size == 0 )
+			{
+				addr++; continue;
+			}
+			for (int j=1; j<size; j++)
+			{
+				opcode[j] = GetMem( (addr + j) & 0xFFFF );
+			}
+			addr += size;
+
+			DisassembleWithDebug( addr, opcode, ASM_DEBUG_SYMS | ASM_DEBUG_REGS, asmTxt );
+			lines++;
+		}
+	}
+	asmNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / lines;
+
+	FCEU_printf("%d symbols in %d banks, %d lookups\n", added, numBanks, lookups);
+	FCEU_printf("  address, page maps  %8.1f ns\n", mapNs);
+	FCEU_printf("  address, index      %8.1f ns (x%.2f)\n", indexNs, mapNs / indexNs);
+	FCEU_printf("  name                %8.1f ns\n", nameNs);
+	FCEU_printf("  disassembly         %8.1f ns per line, %d lines\n", asmNs, lines);
+	if ( mismatch )
+	{
+		FCEU_printf("  MISMATCH\n");
+	}
+
+	debugSymbolTable.clear();
+
+	return mismatch == 0;
+}
+//--------------------------------------------------------------
 // Symbol Add/Edit Window Object
 //--------------------------------------------------------------
 SymbolEditWindow::SymbolEditWindow(QWidget *parent)
@@ -1514,6 +1932,7 @@ int SymbolEditWindow::exec(void)
 			}
 			sym->trimTrailingSpaces();
 		}
+		debugSymbolTable.invalidateNameIndex();
 		fceuWrapperUnLock();
 	}
 	return ret;
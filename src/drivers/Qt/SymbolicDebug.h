@@ -6,6 +6,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <unordered_map>
 
 #include <QWidget>
 #include <QDialog>
@@ -94,6 +95,40 @@ struct debugSymbolPage_t
 	std::map <int, debugSymbol_t*> symMap;
 };
 
+// Open addressed (bank,offset) -> symbol index. The per page maps stay the
+// owners of the symbols, this only makes the lookups done for every operand
+// during symbolic tracing and disassembly a single probe in the common case.
+class debugSymbolIndex_t
+{
+	public:
+		debugSymbolIndex_t(void);
+		~debugSymbolIndex_t(void);
+
+		void clear(void);
+		void reserve( int n );
+		void insert( int bank, int ofs, debugSymbol_t *sym );
+		void remove( int bank, int ofs );
+
+		debugSymbol_t *find( int bank, int ofs );
+
+		int size(void){ return numEntries; }
+
+	private:
+		struct entry_t
+		{
+			int  bank;
+			int  ofs;
+			debugSymbol_t *sym; // NULL marks an empty slot
+		};
+
+		entry_t      *table;
+		unsigned int  mask;
+		int           numEntries;
+
+		unsigned int slot( int bank, int ofs );
+		void resize( unsigned int newSize );
+};
+
 class debugSymbolTable_t
 {
 
@@ -111,14 +146,28 @@ class debugSymbolTable_t
 
 		debugSymbol_t *getSymbolAtBankOffset( int bank, int ofs );
 
+		debugSymbol_t *getSymbolByName( const char *name, int *bankOut = NULL );
+
 		int addSymbolAtBankOffset( int bank, int ofs, debugSymbol_t *sym );
 
 		int deleteSymbolAtBankOffset( int bank, int ofs );
 
+		// Must be called after symbol names are edited in place.
+		void invalidateNameIndex(void){ nameIndexValid = false; }
+
 	private:
 		std::map <int, debugSymbolPage_t*> pageMap;
 
+		debugSymbolIndex_t  addrIndex;
+
+		typedef std::unordered_multimap <std::string, std::pair<int, debugSymbol_t*> > nameIndexMap_t;
+
+		nameIndexMap_t  nameIndex; // name -> bank, symbol
+		bool  nameIndexValid;
+
 		int loadRegisterMap(void);
+		void rebuildIndex(void);
+		void rebuildNameIndex(void);
 
 };
 
@@ -188,4 +237,6 @@ int generateNLFilenameForAddress(int address, char *NLfilename);
 
 int DisassembleWithDebug(int addr, uint8_t *opcode, int flags, char *str, debugSymbol_t *symOut = NULL, debugSymbol_t *symOut2 = NULL );
 
+bool debugSymbolBenchmark( int numSymbols );
+
 #endif
@@ -228,6 +228,8 @@ InitConfig()
 	config->addOption("lowpass", "SDL.Sound.LowPass", 0);
     
 	config->addOption('g', "gamegenie", "SDL.GameGenie", 0);
+	config->addOption("maproms", "SDL.MapRoms", 0);
+	config->addOption("shareroms", "SDL.ShareRoms", 0);
 	config->addOption("pal", "SDL.PAL", 0);
 	config->addOption("autoPal", "SDL.AutoDetectPAL", 1);
 	config->addOption("frameskip", "SDL.Frameskip", 0);
@@ -271,6 +273,8 @@ InitConfig()
 	config->addOption("ystretch", "SDL.YStretch", 0);
 	config->addOption("noframe", "SDL.NoFrame", 0);
 	config->addOption("special", "SDL.SpecialFilter", 0);
+	config->addOption("filterthreads", "SDL.FilterThreads", -1);
+	config->addOption("benchblit", "SDL.BenchBlit", 0);
 	config->addOption("showfps", "SDL.ShowFPS", 0);
 	config->addOption("togglemenu", "SDL.ToggleMenu", 0);
 	config->addOption("cursorType", "SDL.CursorType", 0);
@@ -291,6 +295,13 @@ InitConfig()
 	config->addOption('k', "netkey", "SDL.NetworkGameKey", "");
 	config->addOption("port", "SDL.NetworkPort", 4046);
 	config->addOption("players", "SDL.NetworkPlayers", 1);
+
+	// rollback network play with a single peer
+	config->addOption("rollback", "SDL.RollbackPeer", "");
+	config->addOption("rollbackport", "SDL.RollbackPort", 4047);
+	config->addOption("rollbackplayer", "SDL.RollbackPlayer", 1);
+	config->addOption("rollbackdelay", "SDL.RollbackDelay", 0);
+	config->addOption("rollbackjitter", "SDL.RollbackJitter", 0);
      
 	// input configuration options
 	config->addOption("input1", "SDL.Input.0", "GamePad.0");
@@ -305,9 +316,20 @@ InitConfig()
 
 	// enable / disable opposite directionals (left + right or up + down simultaneously)
 	config->addOption("opposite-directionals", "SDL.Input.EnableOppositeDirectionals", 1);
+	config->addOption("latelatch", "SDL.Input.LateLatch", 0);
+	config->addOption("measurelag", "SDL.MeasureLag", 0);
+	config->addOption("benchsymbols", "SDL.BenchSymbols", 0);
     
 	// pause movie playback at frame x
 	config->addOption("pauseframe", "SDL.PauseFrame", 0);
+	// seek movie playback to frame x
+	config->addOption("seekframe", "SDL.SeekFrame", 0);
+	// frames between movie keyframes, 0 to not save keyframes
+	config->addOption("keyframes", "SDL.MovieKeyframeInterval", 0);
+	// verify a movie against its keyframes, optionally with several processes
+	config->addOption("verifymov", "SDL.VerifyMovie", "");
+	config->addOption("verifyjobs", "SDL.VerifyJobs", 1);
+	config->addOption("verifyshard", "SDL.VerifyShard", "");
 	config->addOption("recordhud", "SDL.RecordHUD", 1);
 	config->addOption("moviemsg", "SDL.MovieMsg", 1);
 
@@ -398,6 +420,16 @@ InitConfig()
     
 	// fm2 -> srt conversion
 	config->addOption("ripsubs", "SDL.RipSubs", "");
+
+	// lossless capture, and its conversion to avi
+	config->addOption("capture", "SDL.Capture", "");
+	config->addOption("convertcapture", "SDL.ConvertCapture", "");
+	config->addOption("benchcapture", "SDL.BenchCapture", "");
+
+	// rom library index
+	config->addOption("scanroms", "SDL.ScanRoms", "");
+	config->addOption("romindex", "SDL.RomIndex", "");
+	config->addOption("scanthreads", "SDL.ScanThreads", -1);
 	
 	// enable new PPU core
 	config->addOption("newppu", "SDL.NewPPU", 0);
@@ -574,6 +606,15 @@ UpdateEMUCore(Config *config)
 	config->getOption("SDL.GameGenie", &flag);
 	FCEUI_SetGameGenie(flag ? 1 : 0);
 
+	config->getOption("SDL.MapRoms", &flag);
+	FCEUI_SetMapRomImages(flag ? true : false);
+
+	config->getOption("SDL.ShareRoms", &flag);
+	FCEUI_SetShareRomImages(flag ? true : false);
+
+	config->getOption("SDL.Input.LateLatch", &flag);
+	FCEUI_SetLateLatch(flag ? true : false);
+
 	config->getOption("SDL.Sound.LowPass", &flag);
 	FCEUI_SetLowPass(flag ? 1 : 0);
 
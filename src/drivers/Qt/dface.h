@@ -37,4 +37,6 @@ void Giggles(int);
 void DoFun(void);
 
 int FCEUD_NetworkConnect(void);
+int FCEUD_RollbackConnect(void);
+void FCEUD_RollbackClose(void);
 
@@ -26,6 +26,8 @@
 #include <unzip.h>
 
 #include <QStyleFactory>
+#include <QProcess>
+#include <QCoreApplication>
 #include "Qt/main.h"
 #include "Qt/throttle.h"
 #include "Qt/config.h"
@@ -45,6 +47,7 @@
 #include "Qt/fceux_git_info.h"
 
 #include "common/cheat.h"
+#include "common/vidblit.h"
 #include "../../fceu.h"
 #include "../../movie.h"
 #include "../../version.h"
@@ -368,6 +371,7 @@ int LoadGame(const char *path, bool silent)
 	isloaded = 1;
 
 	//FCEUD_NetworkConnect();
+	FCEUD_RollbackConnect();
 	return 1;
 }
 
@@ -405,6 +409,7 @@ CloseGame(void)
 		saveInputSettingsToFile();
 	}
 
+	FCEUD_RollbackClose();
 	FCEUI_CloseGame();
 
 	DriverKill();
@@ -491,6 +496,12 @@ static const char *DriverUsage =
 "                          familykeyboard oekakids arkanoid shadow bworld\n"
 "                          4player\n"
 "--gamegenie    {0|1}   Enable emulated Game Genie.\n"
+"--maproms      {0|1}   Share the PRG/CHR of loaded ROMs with their files (default 0).\n"
+"                          Many instances of one ROM then use one copy, but rebuilding\n"
+"                          the ROM in place while it runs changes the running game or\n"
+"                          crashes it (SIGBUS).\n"
+"--shareroms    {0|1}   With --maproms, also share zipped or patched ROMs through a\n"
+"                          copy in /dev/shm, which stays until reboot (default 0).\n"
 "--frameskip    x       Set # of frames to skip per emulated frame.\n"
 "--xres         x       Set horizontal resolution for full screen mode.\n"
 "--yres         x       Set vertical resolution for full screen mode.\n"
@@ -504,6 +515,8 @@ static const char *DriverUsage =
 "--special      {1-4}   Use special video scaling filters\n"
 "                         (1 = hq2x; 2 = Scale2x; 3 = NTSC 2x; 4 = hq3x;\n"
 "                         5 = Scale3x; 6 = Prescale2x; 7 = Prescale3x; 8=Precale4x; 9=PAL)\n"
+"--filterthreads n      Split filters 1-5 among n more threads (-1 = by CPU count).\n"
+"--benchblit    {0|1}   Benchmark the blitter at every depth and scale and exit.\n"
 "--palette      f       Load custom global palette from file f.\n"
 "--sound        {0|1}   Enable sound.\n"
 "--soundrate    x       Set sound playback rate to x Hz.\n"
@@ -513,8 +526,22 @@ static const char *DriverUsage =
 "--soundrecord  f       Record sound to file f.\n"
 "--playmov      f       Play back a recorded FCM/FM2/FM3 movie from filename f.\n"
 "--pauseframe   x       Pause movie playback at frame x.\n"
+"--seekframe    x       Seek movie playback to frame x.\n"
+"--keyframes    x       Save movie keyframes for seeking every x frames of playback.\n"
+"--verifymov    f       Verify movie f against its keyframes and exit.\n"
+"--latelatch    {0|1}   Read the gamepads when the game strobes them, not at frame start.\n"
+"--measurelag   n       Measure the game's input lag at n points and exit.\n"
+"--benchsymbols n       Benchmark debug symbol lookups with n symbols and exit.\n"
+"--verifyjobs   x       Verify the movie with x processes in parallel.\n"
+"--verifyshard  i/n     Only verify shard i of n of the movie's keyframe segments.\n"
 "--fcmconvert   f       Convert fcm movie file f to fm2.\n"
 "--ripsubs      f       Convert movie's subtitles to srt\n"
+"--capture      f       Capture video and audio losslessly to file f.\n"
+"--convertcapture f     Convert capture file f to AVI and exit.\n"
+"--benchcapture f       Benchmark frame delta coding on capture file f and exit.\n"
+"--scanroms     d       Index the ROMs and zip archives below directory d and exit.\n"
+"--romindex     f       Write the index to file f (default romlibrary.txt in the base dir).\n"
+"--scanthreads  n       Scan with n threads (-1 = by CPU count).\n"
 "--subtitles    {0|1}   Enable subtitle display\n"
 "--fourscore    {0|1}   Enable fourscore emulation\n"
 "--no-config    {0|1}   Use default config file and do not save\n"
@@ -526,6 +553,11 @@ static const char *DriverUsage =
 "                       game loaded.\n"
 "--players      x       Set the number of local players in a network play\n"
 "                       session.\n"
+"--rollback     s       Play with the peer at 'host:port' using rollback netplay.\n"
+"--rollbackport x       Use UDP port x for rollback netplay.\n"
+"--rollbackplayer {1|2} Set the player to be in a rollback netplay session.\n"
+"--rollbackdelay x      Delay sent rollback packets by x ms (for testing).\n"
+"--rollbackjitter x     Delay sent rollback packets by up to x ms more at random.\n"
 "--rp2mic       {0|1}   Replace Port 2 Start with microphone (Famicom).\n"
 "--4buttonexit {0|1}    exit the emulator when A+B+Select+Start is pressed\n"
 "--loadstate {0-9|>9}   load from the given state when the game is loaded\n"
@@ -577,6 +609,133 @@ static void ShowUsage(const char *prog)
 	
 }
 
+/**
+ * Runs the shard of movie verification given by --verifyshard in this
+ * process. The first diverging frame is printed as "VERIFY <frame>",
+ * -1 if the movie syncs. Returns the exit code.
+ */
+static int verifyMovieShard(const std::string &fname, int shard, int shards)
+{
+	int frame;
+	std::string report;
+
+	if (!FCEUI_LoadMovie(fname.c_str(), true, false))
+	{
+		printf("Unable to load movie %s\n", fname.c_str());
+		return 2;
+	}
+	bool ok = FCEUI_MovieVerify(shard, shards, frame, report);
+
+	printf("%s", report.c_str());
+	printf("VERIFY %d\n", ok ? frame : -2);
+	fflush(stdout);
+
+	return ok ? ((frame < 0) ? 0 : 1) : 2;
+}
+
+/**
+ * Verifies the movie against its keyframes. With more than one job, the
+ * keyframe segments are split over that many child processes (the core
+ * can only run one game per process) and the earliest desync wins.
+ */
+static int verifyMovie(const std::string &fname, int argc, char *argv[])
+{
+	int jobs, shard = 0, shards = 0;
+	std::string s;
+
+	g_config->getOption("SDL.VerifyJobs", &jobs);
+	g_config->setOption("SDL.VerifyJobs", 1);
+	g_config->getOption("SDL.VerifyShard", &s);
+	g_config->setOption("SDL.VerifyShard", "");
+
+	if (!s.empty())
+	{
+		if ( (sscanf(s.c_str(), "%d/%d", &shard, &shards) != 2) || (shard < 1) || (shard > shards) )
+		{
+			printf("Invalid verify shard %s\n", s.c_str());
+			return 2;
+		}
+		return verifyMovieShard(fname, shard - 1, shards);
+	}
+	if (jobs <= 1)
+	{
+		return verifyMovieShard(fname, 0, 1);
+	}
+
+	QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+	std::vector<QProcess*> procs;
+
+	env.insert("QT_QPA_PLATFORM", "offscreen");
+
+	for (int i=0; i<jobs; i++)
+	{
+		QStringList args;
+
+		args << "--verifyshard" << QString("%1/%2").arg(i+1).arg(jobs);
+		args << "--no-config" << "1" << "--sound" << "0";
+
+		for (int j=1; j<argc; j++)
+		{
+			args << argv[j];
+		}
+		QProcess *proc = new QProcess();
+
+		proc->setProcessEnvironment(env);
+		proc->setProcessChannelMode(QProcess::MergedChannels);
+		proc->start(QCoreApplication::applicationFilePath(), args);
+		procs.push_back(proc);
+	}
+
+	int result = 0, frame = -1;
+	std::string report;
+
+	for (int i=0; i<jobs; i++)
+	{
+		int shardFrame = -2;
+		std::string shardReport;
+
+		if (procs[i]->waitForFinished(-1))
+		{
+			QStringList lines = QString(procs[i]->readAllStandardOutput()).split('\n');
+
+			for (int j=0; j<lines.size(); j++)
+			{
+				if (lines[j].startsWith("VERIFY "))
+				{
+					shardFrame = lines[j].mid(7).toInt();
+				}
+				else if (shardFrame == -2)
+				{
+					shardReport += lines[j].toStdString() + "\n";
+				}
+			}
+		}
+		delete procs[i];
+
+		if (shardFrame == -2)
+		{
+			printf("Verify shard %d/%d failed:\n%s", i+1, jobs, shardReport.c_str());
+			result = 2;
+		}
+		else if ( (shardFrame >= 0) && ((frame < 0) || (shardFrame < frame)) )
+		{
+			frame = shardFrame;
+			report = shardReport;
+		}
+	}
+
+	if (frame >= 0)
+	{
+		printf("%s", report.c_str());
+		return 1;
+	}
+	if (result == 0)
+	{
+		printf("Movie syncs (%d jobs).\n", jobs);
+	}
+	return result;
+}
+
 int  fceuWrapperInit( int argc, char *argv[] )
 {
 	int error;
@@ -708,6 +867,67 @@ int  fceuWrapperInit( int argc, char *argv[] )
 	else
 		FCEUI_SetAviDisableMovieMessages(false);
   
+	// check for a capture file to convert to avi
+	g_config->getOption("SDL.ConvertCapture", &s);
+	g_config->setOption("SDL.ConvertCapture", "");
+	if (!s.empty())
+	{
+		std::string outname;
+		size_t dot = s.find_last_of (".");
+		if (dot == std::string::npos)
+			outname = s + ".avi";
+		else
+			outname = s.substr(0,dot) + ".avi";
+
+		bool ok = FCEUI_CaptureConvert(s.c_str(), outname.c_str());
+
+		DriverKill();
+		SDL_Quit();
+		exit(ok ? 0 : 1);
+	}
+
+	// benchmark the frame delta coding on the frames of a capture
+	g_config->getOption("SDL.BenchCapture", &s);
+	g_config->setOption("SDL.BenchCapture", "");
+	if (!s.empty())
+	{
+		bool ok = FCEUI_CaptureBenchmark(s.c_str());
+
+		DriverKill();
+		SDL_Quit();
+		exit(ok ? 0 : 1);
+	}
+
+	int benchBlit;
+	g_config->getOption("SDL.BenchBlit", &benchBlit);
+	g_config->setOption("SDL.BenchBlit", 0);
+	if (benchBlit)
+	{
+		bool ok = BlitBenchmark();
+
+		DriverKill();
+		SDL_Quit();
+		exit(ok ? 0 : 1);
+	}
+
+	// index a directory of roms for the library
+	g_config->getOption("SDL.ScanRoms", &s);
+	g_config->setOption("SDL.ScanRoms", "");
+	if (!s.empty())
+	{
+		std::string index;
+		int scanThreads;
+
+		g_config->getOption("SDL.RomIndex", &index);
+		g_config->getOption("SDL.ScanThreads", &scanThreads);
+
+		bool ok = FCEUI_RomLibraryIndex(s.c_str(), index.empty() ? NULL : index.c_str(), scanThreads);
+
+		DriverKill();
+		SDL_Quit();
+		exit(ok ? 0 : 1);
+	}
+
 	// check for a .fm2 file to rip the subtitles
 	g_config->getOption("SDL.RipSubs", &s);
 	g_config->setOption("SDL.RipSubs", "");
@@ -833,10 +1053,65 @@ int  fceuWrapperInit( int argc, char *argv[] )
 			return -1;
 		}
 		g_config->setOption("SDL.LastOpenFile", argv[romIndex]);
-		g_config->save();
+
+		if (!noconfig)
+		{
+			g_config->save();
+		}
+	}
+
+	// movie verification, exits when done
+	g_config->getOption("SDL.VerifyMovie", &s);
+	g_config->setOption("SDL.VerifyMovie", "");
+	if (s != "")
+	{
+		int result = (romIndex >= 0) ? verifyMovie(s, argc, argv) : 2;
+
+		if (romIndex < 0)
+		{
+			printf("Movie verification needs a ROM.\n");
+		}
+		DriverKill();
+		SDL_Quit();
+		exit(result);
+	}
+
+	// symbolic trace/disassembly benchmark, exits when done
+	int benchSymbols;
+	g_config->getOption("SDL.BenchSymbols", &benchSymbols);
+	g_config->setOption("SDL.BenchSymbols", 0);
+	if (benchSymbols > 0)
+	{
+		bool ok = (romIndex >= 0) && debugSymbolBenchmark(benchSymbols);
+
+		if (romIndex < 0)
+		{
+			printf("The symbol benchmark needs a ROM.\n");
+		}
+		DriverKill();
+		SDL_Quit();
+		exit(ok ? 0 : 1);
+	}
+
+	// input lag measurement, exits when done
+	int measureLag;
+	g_config->getOption("SDL.MeasureLag", &measureLag);
+	g_config->setOption("SDL.MeasureLag", 0);
+	if (measureLag > 0)
+	{
+		bool ok = (romIndex >= 0) && FCEUI_MeasureInputLag(measureLag);
+
+		if (romIndex < 0)
+		{
+			printf("Measuring the input lag needs a ROM.\n");
+		}
+		DriverKill();
+		SDL_Quit();
+		exit(ok ? 0 : 1);
 	}
 
 	// movie playback
+	g_config->getOption("SDL.MovieKeyframeInterval", &movieKeyframeInterval);
 	g_config->getOption("SDL.Movie", &s);
 	g_config->setOption("SDL.Movie", "");
 	if (s != "")
@@ -858,6 +1133,15 @@ int  fceuWrapperInit( int argc, char *argv[] )
 			}
 			FCEUI_printf("Playing back movie located at %s\n", s.c_str());
 			FCEUI_LoadMovie(s.c_str(), replayReadOnlySetting, pauseframe ? pauseframe : false);
+
+			int seekframe;
+			g_config->getOption("SDL.SeekFrame", &seekframe);
+			g_config->setOption("SDL.SeekFrame", 0);
+
+			if (seekframe > 0 && !FCEUI_MovieSeek(seekframe))
+			{
+				FCEUI_printf("Unable to seek movie to frame %d\n", seekframe);
+			}
 		}
 		else
 		{
@@ -866,6 +1150,17 @@ int  fceuWrapperInit( int argc, char *argv[] )
 		g_config->getOption("SDL.MovieLength",&KillFCEUXonFrame);
 		printf("KillFCEUXonFrame %d\n",KillFCEUXonFrame);
 	}
+
+	// lossless capture, started after the movie so it begins with the movie's first frame
+	g_config->getOption("SDL.Capture", &s);
+	g_config->setOption("SDL.Capture", "");
+	if (s != "")
+	{
+		if (romIndex < 0 || !FCEUI_CaptureBegin(s.c_str()))
+		{
+			FCEUI_printf("Unable to capture to %s\n", s.c_str());
+		}
+	}
 	
     int save_state;
     g_config->getOption("SDL.PeriodicSaves", &periodic_saves);
@@ -950,19 +1245,22 @@ FCEUD_Update(uint8 *XBuf,
 	{
 		if(LoggingEnabled == 2)
 		{
-			int16* MonoBuf = new int16[Count];
+			static std::vector<int16> MonoBuf;
 			int n;
+			if ((int)MonoBuf.size() < Count)
+			{
+				MonoBuf.resize(Count);
+			}
 			for(n=0; n<Count; ++n)
 			{
 				MonoBuf[n] = Buffer[n] & 0xFFFF;
 			}
 			NESVideoLoggingAudio
 			(
-			  MonoBuf, 
+			  &MonoBuf[0], 
 			  FSettings.SndRate, 16, 1,
 			  Count
 			);
-			delete [] MonoBuf;
 		}
 		Count /= 2;
 		if (inited & 1)
@@ -1178,8 +1476,6 @@ int  fceuWrapperUpdate( void )
 	if ( GameInfo )
 	{
 		DoFun(frameskip, periodic_saves);
-	
-		hexEditorUpdateMemoryValues();
 
 		fceuWrapperUnLock();
 
@@ -63,6 +63,10 @@ static int CurInputType[NUM_INPUT_DEVICES] = { SI_GAMEPAD, SI_GAMEPAD, SI_NONE }
 static int cspec = 0;
 static int buttonConfigInProgress = 0;
 
+// options read every frame, see InitInputInterface()
+static const ConfigInt *oppositeDirsOpt = NULL;
+static const ConfigInt *fourButtonExitOpt = NULL;
+
 extern int gametype;
 static int DTestButton (ButtConfig * bc);
 
@@ -1320,8 +1324,7 @@ UpdateGamepad(void)
 
 	totalFrames = onFrames + offFrames;
 
-	int opposite_dirs;
-	g_config->getOption("SDL.Input.EnableOppositeDirectionals", &opposite_dirs);
+	int opposite_dirs = oppositeDirsOpt->get();
 
 	// go through each of the four game pads
 	for (wg = 0; wg < 4; wg++)
@@ -1354,10 +1357,8 @@ UpdateGamepad(void)
 			}
 		}
 
-		int four_button_exit;
-		g_config->getOption("SDL.ABStartSelectExit", &four_button_exit);
 		// if a+b+start+select is pressed, exit
-		if (four_button_exit && JS == 15) {
+		if (fourButtonExitOpt->get() && JS == 15) {
 		    FCEUI_printf("all buttons pressed, exiting\n");
 		    CloseGame();
 		    FCEUI_Kill();
@@ -1398,6 +1399,7 @@ UpdateGamepad(void)
 //  }
 
 	JSreturn = JS;
+	FCEUI_LatchGamepads(JS);
 }
 
 static ButtConfig powerpadsc[2][12] = {
@@ -1597,6 +1599,9 @@ void InitInputInterface ()
 
    memset( g_keyState, 0, sizeof(g_keyState) );
 
+	oppositeDirsOpt   = g_config->getIntHandle("SDL.Input.EnableOppositeDirectionals");
+	fourButtonExitOpt = g_config->getIntHandle("SDL.ABStartSelectExit");
+
 	for (t = 0, x = 0; x < 2; x++)
 	{
 		attrib = 0;
@@ -40,6 +40,7 @@
 #include "../../ppu.h"
 #include "../../debug.h"
 #include "../../palette.h"
+#include "../../vramtrack.h"
 
 #include "Qt/ppuViewer.h"
 #include "Qt/main.h"
@@ -70,6 +71,12 @@ static uint8_t pallast[32+3] = { 0 }; // palette cache for change comparison
 static uint8_t palcache[36] = { 0 }; //palette cache for drawing
 static uint8_t chrcache0[0x1000] = {0}, chrcache1[0x1000] = {0}, logcache0[0x1000] = {0}, logcache1[0x1000] = {0}; //cache CHR, fixes a refresh problem when right-clicking
 static bool	redrawWindow = true;
+static bool	chrRefreshAll = true; // re-read every tile on the next CHR refresh
+static bool	tileDirty[2][256];    // tiles that changed since they were last decoded
+static uint32	vramSyncLp = 0;       // VRAM tracking generation of the last CHR refresh
+static int	pindexLp[2] = { -1, -1 };
+static int	maskModeLp = -1;
+static pal	palrgbLp[36];
 
 static void initPPUViewer(void);
 static ppuPatternTable_t pattern0;
@@ -1226,6 +1233,7 @@ static int writeMemPPU( unsigned int addr, int value )
 	if (addr < 0x2000)
 	{
 		VPage[addr >> 10][addr] = value; //todo: detect if this is vrom and turn it red if so
+		FCEU_VRAMTrackWrite( addr );
 	}
 	if ((addr >= 0x2000) && (addr < 0x3F00))
 	{
@@ -1247,6 +1255,11 @@ static void initPPUViewer(void)
 	memset( chrcache1, 0, sizeof(chrcache1) );
 	memset( logcache0, 0, sizeof(logcache0) );
 	memset( logcache1, 0, sizeof(logcache1) );
+	memset( palrgbLp , 0, sizeof(palrgbLp)  );
+
+	chrRefreshAll = true;
+	pindexLp[0] = pindexLp[1] = -1;
+	maskModeLp = -1;
 
 	// forced palette (e.g. for debugging CHR when palettes are all-black)
 	palcache[(8*4)+0] = 0x0F;
@@ -1259,15 +1272,66 @@ static void initPPUViewer(void)
 
 }
 //----------------------------------------------------
-static void DrawPatternTable( ppuPatternTable_t *pattern, uint8_t *table, uint8_t *log, uint8_t pal)
+// Copies one 16 byte tile (0-511) of the pattern tables, and its CD logger
+// flags, into the viewer cache. Returns true if anything differs from the cache.
+static bool refreshTileCache( int tile )
+{
+	int  a = tile * VRAMTRACK_TILE_SIZE;
+	int  ofs = a & 0x0FFF;
+	uint8_t *chr = (a & 0x1000) ? chrcache1 : chrcache0;
+	uint8_t *log = (a & 0x1000) ? logcache1 : logcache0;
+	uint8_t *vp  = VPage[a >> 10];
+	bool changed = false;
+
+	if ( vp == NULL )
+	{
+		return false;
+	}
+
+	for (int i = 0; i < VRAMTRACK_TILE_SIZE; i++, a++, ofs++)
+	{
+		if ( chr[ofs] != vp[a] )
+		{
+			chr[ofs] = vp[a];
+			changed = true;
+		}
+
+		if (debug_loggingCD) 
+		{
+			uint8_t l = log[ofs];
+
+			if (cdloggerVideoDataSize)
+			{
+				int addr = &vp[a] - CHRptr[0];
+
+				if ((addr >= 0) && (addr < (int)cdloggerVideoDataSize))
+					l = cdloggervdata[addr];
+			}
+			else
+			{
+				l = cdloggervdata[a];
+			}
+
+			if ( log[ofs] != l )
+			{
+				log[ofs] = l;
+				changed = true;
+			}
+		}
+	}
+	return changed;
+}
+//----------------------------------------------------
+static bool DrawPatternTable( ppuPatternTable_t *pattern, uint8_t *table, uint8_t *log, uint8_t pal, bool *dirty, bool drawAll)
 {
 	int i,j,x,y,index=0;
 	int p=0,tmp;
 	uint8_t chr0,chr1,logs,shift;
+	bool drawn = false;
 
 	if (palo == NULL)
 	{
-		return;
+		return false;
 	}
 
 	pal <<= 2;
@@ -1275,6 +1339,16 @@ static void DrawPatternTable( ppuPatternTable_t *pattern, uint8_t *table, uint8_
 	{
 		for (j = 0; j < 16; j++)	//Rows
 		{
+			int t = (i << 4) | j;
+
+			if ( !drawAll && !dirty[t] )
+			{
+				index += 16;
+				continue;
+			}
+			dirty[t] = false;
+			drawn = true;
+
 			//printf("Tile: %X%X  index:%04X   %04X\n", j,i,index, (i<<4)|(j<<8));
 			//-----------------------------------------------
 			for (y = 0; y < 8; y++)
@@ -1308,6 +1382,7 @@ static void DrawPatternTable( ppuPatternTable_t *pattern, uint8_t *table, uint8_
 			//------------------------------------------------
 		}
 	}
+	return drawn;
 }
 //----------------------------------------------------
 void FCEUD_UpdatePPUView(int scanline, int refreshchr)
@@ -1321,42 +1396,34 @@ void FCEUD_UpdatePPUView(int scanline, int refreshchr)
 		return;
 	}
 	int x,y,i;
+	bool drawAll[2], drawn;
 
 
 	if (refreshchr)
 	{
-		int i10, x10;
-		for (i = 0, x=0x1000; i < 0x1000; i++, x++)
-		{
-			i10 = i>>10;
-			x10 = x>>10;
+		uint32 since = vramSyncLp;
+		bool readAll = chrRefreshAll || (scanline == -1);
 
-			if ( VPage[i10] == NULL )
-			{
-				continue;
-			}
-			chrcache0[i] = VPage[i10][i];
-			chrcache1[i] = VPage[x10][x];
+		vramSyncLp = FCEUI_VRAMTrackSync();
 
-			if (debug_loggingCD) 
+		// Only tiles written or bank switched since the last refresh need to be
+		// read back, unless the CD logger is running since its flags change
+		// without the CHR data changing.
+		if ( readAll || debug_loggingCD || FCEUI_VRAMTrackAnyChanged(since) )
+		{
+			for (i = 0; i < VRAMTRACK_NUM_TILES; i++)
 			{
-				if (cdloggerVideoDataSize)
+				if ( !readAll && !debug_loggingCD && !FCEUI_VRAMTrackTileChanged(i, since) )
 				{
-					int addr;
-					addr = &VPage[i10][i] - CHRptr[0];
-					if ((addr >= 0) && (addr < (int)cdloggerVideoDataSize))
-						logcache0[i] = cdloggervdata[addr];
-					addr = &VPage[x10][x] - CHRptr[0];
-					if ((addr >= 0) && (addr < (int)cdloggerVideoDataSize))
-						logcache1[i] = cdloggervdata[addr];
+					continue;
 				}
-			  	else
-			  	{
-					logcache0[i] = cdloggervdata[i];
-					logcache1[i] = cdloggervdata[x];
+				if ( refreshTileCache(i) )
+				{
+					tileDirty[i >> 8][i & 0xFF] = true;
 				}
 			}
 		}
+		chrRefreshAll = false;
 	}
 
 	if (PPUViewSkip < PPUViewRefresh) 
@@ -1394,10 +1461,49 @@ void FCEUD_UpdatePPUView(int scanline, int refreshchr)
 		}
 	}
 
-	DrawPatternTable( &pattern0,chrcache0,logcache0,pindex[0]);
-	DrawPatternTable( &pattern1,chrcache1,logcache1,pindex[1]);
+	// Tiles only need to be re-decoded when their data changed, unless
+	// something that affects every tile did.
+	drawAll[0] = drawAll[1] = false;
+
+	if ( palo != NULL )
+	{
+		pal palrgb[36];
+
+		for (i = 0; i < 36; i++)
+		{
+			palrgb[i] = palo[palcache[i]];
+		}
+		if ( memcmp( palrgb, palrgbLp, sizeof(palrgb) ) != 0 )
+		{
+			memcpy( palrgbLp, palrgb, sizeof(palrgb) );
+			drawAll[0] = drawAll[1] = true;
+		}
+	}
+
+	i = (PPUView_maskUnusedGraphics ? 1 : 0) | (PPUView_invertTheMask ? 2 : 0) | (debug_loggingCD ? 4 : 0);
+
+	if ( i != maskModeLp )
+	{
+		maskModeLp = i;
+		drawAll[0] = drawAll[1] = true;
+	}
+
+	for (i = 0; i < 2; i++)
+	{
+		if ( pindex[i] != pindexLp[i] )
+		{
+			pindexLp[i] = pindex[i];
+			drawAll[i] = true;
+		}
+	}
+
+	drawn  = DrawPatternTable( &pattern0,chrcache0,logcache0,pindex[0],tileDirty[0],drawAll[0]);
+	drawn |= DrawPatternTable( &pattern1,chrcache1,logcache1,pindex[1],tileDirty[1],drawAll[1]);
 
-	redrawWindow = true;
+	if ( drawn )
+	{
+		redrawWindow = true;
+	}
 }
 //----------------------------------------------------
 ppuPalatteView_t::ppuPalatteView_t(QWidget *parent)
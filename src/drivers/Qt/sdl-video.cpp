@@ -309,6 +309,11 @@ int InitVideo(FCEUGI *gi)
 
 	if ( !initBlitToHighDone )
 	{
+		int filterThreads;
+
+		g_config->getOption("SDL.FilterThreads", &filterThreads);
+		SetFilterThreads(filterThreads);
+
 		InitBlitToHigh(s_curbpp >> 3,
 							rmask,
 							gmask,
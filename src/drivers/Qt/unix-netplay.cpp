@@ -32,6 +32,8 @@
 #include "utils/memory.h"
 
 #include <string>
+#include <list>
+#include <vector>
 #include "common/configSys.h"
 
 #include <cstdio>
@@ -68,6 +70,19 @@ int FCEUDnetplay=0;
 
 static int s_Socket = -1;
 
+// rollback play, packets are held back by an artificial delay for testing
+struct RollbackPacket
+{
+	uint64 sendTime;
+	std::vector<uint8> data;
+};
+static int s_RollbackSocket = -1;
+static int s_RollbackDelay = 0;
+static int s_RollbackJitter = 0;
+static std::list<RollbackPacket> s_RollbackQueue;
+
+uint64 FCEUD_GetTime(void);
+
 static void
 en32(uint8 *buf,
      uint32 morp)
@@ -209,7 +224,7 @@ FCEUD_NetworkConnect(void)
 		memcpy(sendbuf + 4 + 16, md5out, 16);
 	}
 
-	memset(sendbuf + 4 + 16 + 16, 0, 64);
+	FCEUI_NetplayLoginExtra(sendbuf + 4 + 16 + 16);
 
 	sendbuf[4 + 16 + 16 + 64] = (uint8)localPlayers;
 
@@ -345,6 +360,187 @@ FCEUD_NetworkClose(void)
 }
 
 
+void
+FCEUD_RollbackClose(void)
+{
+	FCEUI_RollbackStop();
+
+	if(s_RollbackSocket >= 0) {
+		close(s_RollbackSocket);
+	}
+	s_RollbackSocket = -1;
+	s_RollbackQueue.clear();
+}
+
+/**
+ * Starts rollback play with the peer given by --rollback host:port, using
+ * UDP from the local port --rollbackport. --rollbackdelay and
+ * --rollbackjitter delay every packet sent by that many milliseconds, plus
+ * a random amount up to the jitter, to test over loopback.
+ */
+int
+FCEUD_RollbackConnect(void)
+{
+	struct sockaddr_in sockin;
+	struct hostent *phostentb;
+	unsigned long hadr;
+	int TSocket, port, peerPort, player;
+	std::string peer;
+
+	g_config->getOption("SDL.RollbackPeer", &peer);
+	g_config->getOption("SDL.RollbackPort", &port);
+	g_config->getOption("SDL.RollbackPlayer", &player);
+	g_config->getOption("SDL.RollbackDelay", &s_RollbackDelay);
+	g_config->getOption("SDL.RollbackJitter", &s_RollbackJitter);
+
+	g_config->setOption("SDL.RollbackPeer", "");
+
+	if(!peer.size()) {
+		return 0;
+	}
+	peerPort = port;
+
+	size_t colon = peer.rfind(':');
+	if(colon != std::string::npos) {
+		peerPort = atoi(peer.c_str() + colon + 1);
+		peer.erase(colon);
+	}
+
+	TSocket = socket(AF_INET, SOCK_DGRAM, 0);
+	if(TSocket < 0) {
+		const char* s = "Error creating datagram socket.";
+		puts(s);
+		FCEU_DispMessage(s,0);
+		return 0;
+	}
+
+	memset(&sockin, 0, sizeof(sockin));
+	sockin.sin_family = AF_INET;
+	sockin.sin_addr.s_addr = INADDR_ANY;
+	sockin.sin_port = htons(port);
+	if(bind(TSocket, (struct sockaddr *)&sockin, sizeof(sockin)) < 0) {
+		puts("Error binding rollback port.");
+		FCEU_DispMessage("Error binding rollback port",0);
+		close(TSocket);
+		return 0;
+	}
+
+	hadr = inet_addr(peer.c_str());
+	if(hadr != INADDR_NONE) {
+		sockin.sin_addr.s_addr = hadr;
+	} else {
+		phostentb = gethostbyname(peer.c_str());
+		if(!phostentb) {
+			puts("Error getting peer network information.");
+			FCEU_DispMessage("Error getting peer info",0);
+			close(TSocket);
+			return 0;
+		}
+		memcpy(&sockin.sin_addr, phostentb->h_addr, phostentb->h_length);
+	}
+	sockin.sin_port = htons(peerPort);
+
+	// only take datagrams from the peer
+	if(connect(TSocket, (struct sockaddr *)&sockin, sizeof(sockin)) < 0) {
+		puts("Error connecting to peer.");
+		FCEU_DispMessage("Error connecting to peer",0);
+		close(TSocket);
+		return 0;
+	}
+	s_RollbackSocket = TSocket;
+
+	if(!FCEUI_RollbackStart(player - 1)) {
+		FCEU_DispMessage("Rollback play can't start while a movie is active",0);
+		FCEUD_RollbackClose();
+		return 0;
+	}
+	return 1;
+}
+
+// Sends the queued packets whose delay is over.
+static int
+RollbackFlush(void)
+{
+	uint64 now = FCEUD_GetTime();
+	std::list<RollbackPacket>::iterator it = s_RollbackQueue.begin();
+
+	while(it != s_RollbackQueue.end()) {
+		if(it->sendTime > now) {
+			++it;
+			continue;
+		}
+#ifdef WIN32
+		send(s_RollbackSocket, (char*)&it->data[0], it->data.size(), 0);
+#else
+		send(s_RollbackSocket, &it->data[0], it->data.size(), 0);
+#endif
+		it = s_RollbackQueue.erase(it);
+	}
+	return 1;
+}
+
+int
+FCEUD_RollbackSend(const void *data,
+                   uint32 len)
+{
+	if(s_RollbackSocket < 0) {
+		return 0;
+	}
+	if(!s_RollbackDelay && !s_RollbackJitter) {
+#ifdef WIN32
+		send(s_RollbackSocket, (const char*)data, len, 0);
+#else
+		send(s_RollbackSocket, data, len, 0);
+#endif
+		return 1;
+	}
+
+	RollbackPacket packet;
+	packet.sendTime = FCEUD_GetTime() + s_RollbackDelay;
+	if(s_RollbackJitter > 0) {
+		packet.sendTime += rand() % (s_RollbackJitter + 1);
+	}
+	packet.data.assign((const uint8 *)data, (const uint8 *)data + len);
+	s_RollbackQueue.push_back(packet);
+
+	return RollbackFlush();
+}
+
+int
+FCEUD_RollbackRecv(void *data,
+                   uint32 len,
+                   int timeout)
+{
+	fd_set funfun;
+	struct timeval popeye;
+	int size;
+
+	if(s_RollbackSocket < 0) {
+		return -1;
+	}
+	RollbackFlush();
+
+	popeye.tv_sec = timeout / 1000;
+	popeye.tv_usec = (timeout % 1000) * 1000;
+
+	FD_ZERO(&funfun);
+	FD_SET(s_RollbackSocket, &funfun);
+
+	switch(select(s_RollbackSocket + 1, &funfun, 0, 0, &popeye)) {
+	case 0: return 0;
+	// a signal only cut the wait short
+	case -1: return (errno == EINTR) ? 0 : -1;
+	}
+
+#ifdef WIN32
+	size = recv(s_RollbackSocket, (char*)data, len, 0);
+#else
+	size = recv(s_RollbackSocket, data, len, 0);
+#endif
+	// a refused datagram only means the peer isn't listening yet
+	return (size < 0) ? 0 : size;
+}
+
 void
 FCEUD_NetplayText(uint8 *text)
 {
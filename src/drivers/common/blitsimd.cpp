@@ -0,0 +1,407 @@
+/// \file
+/// \brief Row kernels of the blitter, see blitsimd.h
+
+#include <string.h>
+
+#include "../../types.h"
+#include "../../palette.h"
+#include "blitsimd.h"
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <cpuid.h>
+#include <tmmintrin.h>
+#define BLITSIMD_X86
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#include <tmmintrin.h>
+#define BLITSIMD_X86
+#define SIMD_TARGET(isa)
+#endif
+
+static inline uint32 PixelColor(const uint32 *colors, uint8 pixel, uint8 emph)
+{
+	return colors[FCEU_PaletteIndex(pixel, emph)];
+}
+
+static void RowTo32_C(uint32 *dest, const uint8 *src, const uint8 *emph, const uint32 *colors, int width, int xscale)
+{
+	for (int x = 0; x < width; x++)
+	{
+		uint32 c = PixelColor(colors, src[x], emph[x]);
+
+		for (int i = 0; i < xscale; i++)
+			*dest++ = c;
+	}
+}
+
+static void RowTo24_C(uint8 *dest, const uint8 *src, const uint8 *emph, const uint32 *colors, int width, int xscale)
+{
+	for (int x = 0; x < width; x++)
+	{
+		uint32 c = PixelColor(colors, src[x], emph[x]);
+
+		for (int i = 0; i < xscale; i++, dest += 3)
+		{
+			dest[0] = c;
+			dest[1] = c >> 8;
+			dest[2] = c >> 16;
+		}
+	}
+}
+
+static void RowTo16_C(uint16 *dest, const uint8 *src, const uint8 *emph, const uint32 *colors, int width, int xscale)
+{
+	for (int x = 0; x < width; x++)
+	{
+		uint16 c = PixelColor(colors, src[x], emph[x]);
+
+		for (int i = 0; i < xscale; i++)
+			*dest++ = c;
+	}
+}
+
+static void Row32To24_C(uint8 *dest, const uint32 *src, int width)
+{
+	for (int x = 0; x < width; x++, dest += 3)
+	{
+		uint32 c = src[x];
+
+		dest[0] = c;
+		dest[1] = c >> 8;
+		dest[2] = c >> 16;
+	}
+}
+
+static void Row32To16_C(uint16 *dest, const uint32 *src, int width, const int shiftr[3], const int shiftl[3])
+{
+	for (int x = 0; x < width; x++)
+	{
+		uint32 c = src[x];
+		uint16 d;
+
+		d  = ((c & 0x0000FF) >> shiftr[2]) << shiftl[2];
+		d |= ((c & 0x00FF00) >> shiftr[1]) << shiftl[1];
+		d |= ((c & 0xFF0000) >> shiftr[0]) << shiftl[0];
+		dest[x] = d;
+	}
+}
+
+#ifdef BLITSIMD_X86
+
+// Color table indices of 16 pixels, FCEU_PaletteIndex() of each.
+SIMD_TARGET("sse2") static inline void PixelIndices(uint16 *idx, const uint8 *src, const uint8 *emph)
+{
+	const __m128i top = _mm_set1_epi8((char)0xC0);
+	__m128i p = _mm_loadu_si128((const __m128i *)src);
+	__m128i e = _mm_and_si128(_mm_loadu_si128((const __m128i *)emph), _mm_set1_epi8(7));
+
+	// the tag the PPU gives this emphasis: 0x80 for none, 0xC0 for all, else 0x40
+	__m128i none = _mm_and_si128(_mm_cmpeq_epi8(e, _mm_setzero_si128()), top);
+	__m128i all = _mm_and_si128(_mm_cmpeq_epi8(e, _mm_set1_epi8(7)), _mm_set1_epi8((char)0x80));
+	__m128i tag = _mm_xor_si128(_mm_set1_epi8(0x40), _mm_or_si128(none, all));
+	__m128i ppu = _mm_cmpeq_epi8(_mm_and_si128(p, top), tag);
+
+	// both halves of the index a byte at a time: color | emphasis << 6 for the
+	// PPU's pixels, PALETTE_8BIT + pixel for the rest. There's no byte shift, the
+	// bits a word shift carries across bytes are masked off.
+	__m128i lo = _mm_or_si128(_mm_and_si128(p, _mm_set1_epi8(0x3F)), _mm_and_si128(_mm_slli_epi16(e, 6), top));
+	__m128i hi = _mm_and_si128(_mm_srli_epi16(e, 2), _mm_set1_epi8(1));
+
+	lo = _mm_or_si128(_mm_and_si128(ppu, lo), _mm_andnot_si128(ppu, p));
+	hi = _mm_or_si128(_mm_and_si128(ppu, hi), _mm_andnot_si128(ppu, _mm_set1_epi8(PALETTE_8BIT >> 8)));
+	_mm_storeu_si128((__m128i *)idx, _mm_unpacklo_epi8(lo, hi));
+	_mm_storeu_si128((__m128i *)(idx + 8), _mm_unpackhi_epi8(lo, hi));
+}
+
+SIMD_TARGET("sse2") static inline __m128i LoadColors(const uint32 *colors, const uint16 *idx)
+{
+	return _mm_setr_epi32(colors[idx[0]], colors[idx[1]], colors[idx[2]], colors[idx[3]]);
+}
+
+// 4 pixels of 16 bits held in the low half of each lane.
+SIMD_TARGET("sse2") static inline void Store4To16(uint16 *dest, __m128i c)
+{
+	// sign extend first, the pack saturates
+	c = _mm_srai_epi32(_mm_slli_epi32(c, 16), 16);
+	_mm_storel_epi64((__m128i *)dest, _mm_packs_epi32(c, c));
+}
+
+SIMD_TARGET("ssse3") static inline void Store4To24(uint8 *dest, __m128i c)
+{
+	const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+	c = _mm_shuffle_epi8(c, pack);
+	_mm_storel_epi64((__m128i *)dest, c);
+	*(uint32 *)(dest + 8) = _mm_cvtsi128_si32(_mm_srli_si128(c, 8));
+}
+
+// The Scaled functions write 4 pixels each repeated xscale (1 to 4) times and
+// return the position after them. The stores are spelled out for each scale,
+// looping over the repeated vectors makes compilers fall back to memcpy.
+
+#define REPEAT_3A(c) _mm_shuffle_epi32(c, _MM_SHUFFLE(1, 0, 0, 0))
+#define REPEAT_3B(c) _mm_shuffle_epi32(c, _MM_SHUFFLE(2, 2, 1, 1))
+#define REPEAT_3C(c) _mm_shuffle_epi32(c, _MM_SHUFFLE(3, 3, 3, 2))
+#define REPEAT_4(c, i) _mm_shuffle_epi32(c, _MM_SHUFFLE(i, i, i, i))
+
+SIMD_TARGET("sse2") static inline uint32 *Scaled4To32(uint32 *dest, __m128i c, int xscale)
+{
+	switch (xscale)
+	{
+	case 1:
+		_mm_storeu_si128((__m128i *)dest, c);
+		break;
+	case 2:
+		_mm_storeu_si128((__m128i *)dest, _mm_unpacklo_epi32(c, c));
+		_mm_storeu_si128((__m128i *)(dest + 4), _mm_unpackhi_epi32(c, c));
+		break;
+	case 3:
+		_mm_storeu_si128((__m128i *)dest, REPEAT_3A(c));
+		_mm_storeu_si128((__m128i *)(dest + 4), REPEAT_3B(c));
+		_mm_storeu_si128((__m128i *)(dest + 8), REPEAT_3C(c));
+		break;
+	default:
+		_mm_storeu_si128((__m128i *)dest, REPEAT_4(c, 0));
+		_mm_storeu_si128((__m128i *)(dest + 4), REPEAT_4(c, 1));
+		_mm_storeu_si128((__m128i *)(dest + 8), REPEAT_4(c, 2));
+		_mm_storeu_si128((__m128i *)(dest + 12), REPEAT_4(c, 3));
+		break;
+	}
+	return dest + 4 * xscale;
+}
+
+SIMD_TARGET("ssse3") static inline uint8 *Scaled4To24(uint8 *dest, __m128i c, int xscale)
+{
+	switch (xscale)
+	{
+	case 1:
+		Store4To24(dest, c);
+		break;
+	case 2:
+		Store4To24(dest, _mm_unpacklo_epi32(c, c));
+		Store4To24(dest + 12, _mm_unpackhi_epi32(c, c));
+		break;
+	case 3:
+		Store4To24(dest, REPEAT_3A(c));
+		Store4To24(dest + 12, REPEAT_3B(c));
+		Store4To24(dest + 24, REPEAT_3C(c));
+		break;
+	default:
+		Store4To24(dest, REPEAT_4(c, 0));
+		Store4To24(dest + 12, REPEAT_4(c, 1));
+		Store4To24(dest + 24, REPEAT_4(c, 2));
+		Store4To24(dest + 36, REPEAT_4(c, 3));
+		break;
+	}
+	return dest + 12 * xscale;
+}
+
+SIMD_TARGET("sse2") static inline uint16 *Scaled4To16(uint16 *dest, __m128i c, int xscale)
+{
+	switch (xscale)
+	{
+	case 1:
+		Store4To16(dest, c);
+		break;
+	case 2:
+		Store4To16(dest, _mm_unpacklo_epi32(c, c));
+		Store4To16(dest + 4, _mm_unpackhi_epi32(c, c));
+		break;
+	case 3:
+		Store4To16(dest, REPEAT_3A(c));
+		Store4To16(dest + 4, REPEAT_3B(c));
+		Store4To16(dest + 8, REPEAT_3C(c));
+		break;
+	default:
+		Store4To16(dest, REPEAT_4(c, 0));
+		Store4To16(dest + 4, REPEAT_4(c, 1));
+		Store4To16(dest + 8, REPEAT_4(c, 2));
+		Store4To16(dest + 12, REPEAT_4(c, 3));
+		break;
+	}
+	return dest + 4 * xscale;
+}
+
+SIMD_TARGET("sse2") static void RowTo32_SSE2(uint32 *dest, const uint8 *src, const uint8 *emph, const uint32 *colors, int width, int xscale)
+{
+	uint16 idx[16];
+	int x = 0;
+
+	if (xscale <= 4)
+		for (; x + 16 <= width; x += 16)
+		{
+			PixelIndices(idx, src + x, emph + x);
+			for (int i = 0; i < 16; i += 4)
+				dest = Scaled4To32(dest, LoadColors(colors, idx + i), xscale);
+		}
+	RowTo32_C(dest, src + x, emph + x, colors, width - x, xscale);
+}
+
+SIMD_TARGET("sse2") static void RowTo24_SSE2(uint8 *dest, const uint8 *src, const uint8 *emph, const uint32 *colors, int width, int xscale)
+{
+	uint16 idx[16];
+	int x = 0;
+
+	// no byte shuffle, so just the indices
+	for (; x + 16 <= width; x += 16)
+	{
+		PixelIndices(idx, src + x, emph + x);
+		for (int i = 0; i < 16; i++)
+		{
+			uint32 c = colors[idx[i]];
+
+			for (int j = 0; j < xscale; j++, dest += 3)
+			{
+				dest[0] = c;
+				dest[1] = c >> 8;
+				dest[2] = c >> 16;
+			}
+		}
+	}
+	RowTo24_C(dest, src + x, emph + x, colors, width - x, xscale);
+}
+
+SIMD_TARGET("ssse3") static void RowTo24_SSSE3(uint8 *dest, const uint8 *src, const uint8 *emph, const uint32 *colors, int width, int xscale)
+{
+	uint16 idx[16];
+	int x = 0;
+
+	if (xscale <= 4)
+		for (; x + 16 <= width; x += 16)
+		{
+			PixelIndices(idx, src + x, emph + x);
+			for (int i = 0; i < 16; i += 4)
+				dest = Scaled4To24(dest, LoadColors(colors, idx + i), xscale);
+		}
+	RowTo24_C(dest, src + x, emph + x, colors, width - x, xscale);
+}
+
+SIMD_TARGET("sse2") static void RowTo16_SSE2(uint16 *dest, const uint8 *src, const uint8 *emph, const uint32 *colors, int width, int xscale)
+{
+	uint16 idx[16];
+	int x = 0;
+
+	if (xscale <= 4)
+		for (; x + 16 <= width; x += 16)
+		{
+			PixelIndices(idx, src + x, emph + x);
+			for (int i = 0; i < 16; i += 4)
+				dest = Scaled4To16(dest, LoadColors(colors, idx + i), xscale);
+		}
+	RowTo16_C(dest, src + x, emph + x, colors, width - x, xscale);
+}
+
+SIMD_TARGET("ssse3") static void Row32To24_SSSE3(uint8 *dest, const uint32 *src, int width)
+{
+	int x = 0;
+
+	for (; x + 4 <= width; x += 4, dest += 12)
+		Store4To24(dest, _mm_loadu_si128((const __m128i *)(src + x)));
+	Row32To24_C(dest, src + x, width - x);
+}
+
+SIMD_TARGET("sse2") static void Row32To16_SSE2(uint16 *dest, const uint32 *src, int width, const int shiftr[3], const int shiftl[3])
+{
+	const __m128i mask[3] = { _mm_set1_epi32(0xFF0000), _mm_set1_epi32(0x00FF00), _mm_set1_epi32(0x0000FF) };
+	__m128i sr[3], sl[3];
+	int x = 0;
+
+	for (int i = 0; i < 3; i++)
+	{
+		sr[i] = _mm_cvtsi32_si128(shiftr[i]);
+		sl[i] = _mm_cvtsi32_si128(shiftl[i]);
+	}
+
+	for (; x + 4 <= width; x += 4)
+	{
+		__m128i c = _mm_loadu_si128((const __m128i *)(src + x));
+		__m128i d = _mm_setzero_si128();
+
+		for (int i = 0; i < 3; i++)
+			d = _mm_or_si128(d, _mm_sll_epi32(_mm_srl_epi32(_mm_and_si128(c, mask[i]), sr[i]), sl[i]));
+		Store4To16(dest + x, d);
+	}
+	Row32To16_C(dest + x, src + x, width - x, shiftr, shiftl);
+}
+
+static int CpuLevel(void)
+{
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info, 1);
+	if (info[2] & (1 << 9))
+		return BLITSIMD_SSSE3;
+	if (info[3] & (1 << 26))
+		return BLITSIMD_SSE2;
+#else
+	unsigned int a, b, c, d;
+
+	if (!__get_cpuid(1, &a, &b, &c, &d))
+		return BLITSIMD_C;
+	if (c & bit_SSSE3)
+		return BLITSIMD_SSSE3;
+	if (d & bit_SSE2)
+		return BLITSIMD_SSE2;
+#endif
+	return BLITSIMD_C;
+}
+
+#else
+
+static int CpuLevel(void)
+{
+	return BLITSIMD_C;
+}
+
+#endif
+
+void (*BlitRowTo32)(uint32 *dest, const uint8 *src, const uint8 *emph, const uint32 *colors, int width, int xscale) = RowTo32_C;
+void (*BlitRowTo24)(uint8 *dest, const uint8 *src, const uint8 *emph, const uint32 *colors, int width, int xscale) = RowTo24_C;
+void (*BlitRowTo16)(uint16 *dest, const uint8 *src, const uint8 *emph, const uint32 *colors, int width, int xscale) = RowTo16_C;
+void (*Blit32RowTo24)(uint8 *dest, const uint32 *src, int width) = Row32To24_C;
+void (*Blit32RowTo16)(uint16 *dest, const uint32 *src, int width, const int shiftr[3], const int shiftl[3]) = Row32To16_C;
+
+int BlitSimdInit(int level)
+{
+	int best = CpuLevel();
+
+	if (level < 0 || level > best)
+		level = best;
+
+	BlitRowTo32 = RowTo32_C;
+	BlitRowTo24 = RowTo24_C;
+	BlitRowTo16 = RowTo16_C;
+	Blit32RowTo24 = Row32To24_C;
+	Blit32RowTo16 = Row32To16_C;
+
+#ifdef BLITSIMD_X86
+	if (level >= BLITSIMD_SSE2)
+	{
+		BlitRowTo32 = RowTo32_SSE2;
+		BlitRowTo24 = RowTo24_SSE2;
+		BlitRowTo16 = RowTo16_SSE2;
+		Blit32RowTo16 = Row32To16_SSE2;
+	}
+	if (level >= BLITSIMD_SSSE3)
+	{
+		BlitRowTo24 = RowTo24_SSSE3;
+		Blit32RowTo24 = Row32To24_SSSE3;
+	}
+#endif
+	return level;
+}
+
+const char *BlitSimdName(int level)
+{
+	switch (level)
+	{
+	case BLITSIMD_SSE2:
+		return "SSE2";
+	case BLITSIMD_SSSE3:
+		return "SSSE3";
+	default:
+		return "C";
+	}
+}
@@ -0,0 +1,31 @@
+#ifndef __BLITSIMD_H
+#define __BLITSIMD_H
+
+#include "../../types.h"
+
+// Row kernels of the blitter, in plain C and with SSE2/SSSE3 where the CPU has them.
+//
+// The expanding kernels turn a row of XBuf pixels and the matching XDBuf emphasis
+// bits into colors of the 512 + 256 entry table SetPaletteBlitToHigh() builds (see
+// FCEU_PaletteIndex()) and write each pixel xscale times. The table lookups themselves stay scalar as a
+// byte shuffle only reaches 16 entries; the vector code picks the table index of
+// 16 pixels at once, repeats the pixels and packs them down to 24 or 16 bits.
+
+#define BLITSIMD_C      0
+#define BLITSIMD_SSE2   1
+#define BLITSIMD_SSSE3  2
+
+// Picks the kernels of the given level, or of the best one the CPU has if that's
+// lower or level is -1. Returns the level picked.
+int BlitSimdInit(int level);
+const char *BlitSimdName(int level);
+
+extern void (*BlitRowTo32)(uint32 *dest, const uint8 *src, const uint8 *emph, const uint32 *colors, int width, int xscale);
+extern void (*BlitRowTo24)(uint8 *dest, const uint8 *src, const uint8 *emph, const uint32 *colors, int width, int xscale);
+extern void (*BlitRowTo16)(uint16 *dest, const uint8 *src, const uint8 *emph, const uint32 *colors, int width, int xscale);
+
+// Repacks 32 bit pixels, see Blit32to24() and Blit32to16().
+extern void (*Blit32RowTo24)(uint8 *dest, const uint32 *src, int width);
+extern void (*Blit32RowTo16)(uint16 *dest, const uint32 *src, int width, const int shiftr[3], const int shiftl[3]);
+
+#endif
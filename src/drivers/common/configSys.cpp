@@ -11,7 +11,56 @@
 #include "../../types.h"
 #include "configSys.h"
 
+#include <vector>
+
 std::string cfgFile = "fceux.cfg";
+
+Config::~Config()
+{
+    std::map<std::string, ConfigInt *>::iterator int_i;
+    std::map<std::string, ConfigDouble *>::iterator dbl_i;
+
+    for(int_i = _intHandles.begin(); int_i != _intHandles.end(); int_i++) {
+        delete int_i->second;
+    }
+    for(dbl_i = _dblHandles.begin(); dbl_i != _dblHandles.end(); dbl_i++) {
+        delete dbl_i->second;
+    }
+}
+
+/**
+ * Updates the handle of an option that was set and notifies its
+ * listeners.  They're called without the lock held, so they may set
+ * options themselves.
+ */
+void
+Config::_changed(const std::string &name)
+{
+    std::vector<std::pair<ConfigListener, void *> > listeners;
+    std::multimap<std::string, std::pair<ConfigListener, void *> >::iterator lst_i;
+
+    {
+        std::lock_guard<std::mutex> guard(_handleLock);
+        std::map<std::string, ConfigInt *>::iterator int_i = _intHandles.find(name);
+        std::map<std::string, ConfigDouble *>::iterator dbl_i = _dblHandles.find(name);
+
+        if(int_i != _intHandles.end()) {
+            int_i->second->_value.store(_intOptMap[name], std::memory_order_relaxed);
+        }
+        if(dbl_i != _dblHandles.end()) {
+            dbl_i->second->_value.store(_dblOptMap[name], std::memory_order_relaxed);
+        }
+        for(lst_i = _listeners.lower_bound(name);
+            lst_i != _listeners.end() && lst_i->first == name; lst_i++) {
+            listeners.push_back(lst_i->second);
+        }
+    }
+
+    for(size_t i = 0; i < listeners.size(); i++) {
+        listeners[i].first(name, listeners[i].second);
+    }
+}
+
 /**
  * Add a given option.  The option is specified as a short command
  * line (-f), long command line (--foo), option name (Foo), its type
@@ -331,7 +380,11 @@ Config::setOption(const std::string &name,
     }
 
     // set the option
-    opt_i->second = value;
+    {
+        std::lock_guard<std::mutex> guard(_handleLock);
+        opt_i->second = value;
+    }
+    _changed(name);
     return 0;
 }
 
@@ -351,7 +404,11 @@ Config::setOption(const std::string &name,
     }
 
     // set the option
-    opt_i->second = value;
+    {
+        std::lock_guard<std::mutex> guard(_handleLock);
+        opt_i->second = value;
+    }
+    _changed(name);
     return 0;
 }
 
@@ -371,7 +428,11 @@ Config::setOption(const std::string &name,
     }
 
     // set the option
-    opt_i->second = value;
+    {
+        std::lock_guard<std::mutex> guard(_handleLock);
+        opt_i->second = value;
+    }
+    _changed(name);
     return 0;
 }
 
@@ -391,7 +452,10 @@ Config::setOption(const std::string &name,
     }
 
     // set the option
-    opt_i->second = value;
+    {
+        std::lock_guard<std::mutex> guard(_handleLock);
+        opt_i->second = value;
+    }
     return 0;
 }
 
@@ -409,6 +473,7 @@ Config::getOption(const std::string &name,
     }
 
     // get the option
+    std::lock_guard<std::mutex> guard(_handleLock);
     (*value) = opt_i->second;
     return 0;
 }
@@ -426,6 +491,7 @@ Config::getOption(const std::string &name,
     }
 
     // get the option
+    std::lock_guard<std::mutex> guard(_handleLock);
     (*value) = opt_i->second.c_str();
     return 0;
 }
@@ -443,6 +509,7 @@ Config::getOption(const std::string &name,
     }
 
     // get the option
+    std::lock_guard<std::mutex> guard(_handleLock);
     (*value) = opt_i->second;
     return 0;
 }
@@ -460,6 +527,7 @@ Config::getOption(const std::string &name,
     }
 
     // get the option
+    std::lock_guard<std::mutex> guard(_handleLock);
     (*value) = opt_i->second ? true : false;
     return 0;
 }
@@ -477,10 +545,83 @@ Config::getOption(const std::string &name,
     }
 
     // get the option
+    std::lock_guard<std::mutex> guard(_handleLock);
     (*value) = opt_i->second;
     return 0;
 }
 
+const ConfigInt *
+Config::getIntHandle(const std::string &name)
+{
+    std::map<std::string, int>::const_iterator opt_i;
+    std::lock_guard<std::mutex> guard(_handleLock);
+
+    // confirm that the option exists
+    opt_i = _intOptMap.find(name);
+    if(opt_i == _intOptMap.end()) {
+        return NULL;
+    }
+
+    ConfigInt *&handle = _intHandles[name];
+    if(!handle) {
+        handle = new ConfigInt(opt_i->second);
+    }
+    return handle;
+}
+
+const ConfigDouble *
+Config::getDoubleHandle(const std::string &name)
+{
+    std::map<std::string, double>::const_iterator opt_i;
+    std::lock_guard<std::mutex> guard(_handleLock);
+
+    // confirm that the option exists
+    opt_i = _dblOptMap.find(name);
+    if(opt_i == _dblOptMap.end()) {
+        return NULL;
+    }
+
+    ConfigDouble *&handle = _dblHandles[name];
+    if(!handle) {
+        handle = new ConfigDouble(opt_i->second);
+    }
+    return handle;
+}
+
+int
+Config::subscribe(const std::string &name,
+                  ConfigListener fn,
+                  void *userData)
+{
+    // confirm that the option exists
+    if(_strOptMap.find(name) == _strOptMap.end() &&
+       _intOptMap.find(name) == _intOptMap.end() &&
+       _dblOptMap.find(name) == _dblOptMap.end()) {
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> guard(_handleLock);
+    _listeners.insert(std::make_pair(name, std::make_pair(fn, userData)));
+    return 0;
+}
+
+void
+Config::unsubscribe(const std::string &name,
+                    ConfigListener fn,
+                    void *userData)
+{
+    std::multimap<std::string, std::pair<ConfigListener, void *> >::iterator lst_i;
+    std::lock_guard<std::mutex> guard(_handleLock);
+
+    for(lst_i = _listeners.lower_bound(name);
+        lst_i != _listeners.end() && lst_i->first == name; lst_i++) {
+        if(lst_i->second.first == fn && lst_i->second.second == userData) {
+            _listeners.erase(lst_i);
+            return;
+        }
+    }
+}
+
 /**
  * Parses the command line arguments.  Short args are of the form -f
  * <opt>, long args are of the form --foo <opt>.  Returns < 0 on error,
@@ -544,6 +685,7 @@ Config::_parseArgs(int argc,
         int_i = _intOptMap.find(opt);
         dbl_i = _dblOptMap.find(opt);
         fn_i  = _fnOptMap.find(opt);
+        std::unique_lock<std::mutex> guard(_handleLock);
         if(str_i != _strOptMap.end()) {
             str_i->second = argv[i];
         } else if(int_i != _intOptMap.end()) {
@@ -551,11 +693,15 @@ Config::_parseArgs(int argc,
         } else if(dbl_i != _dblOptMap.end()) {
             dbl_i->second = atof(argv[i]);
         } else if(fn_i != _fnOptMap.end()) {
+            guard.unlock();
             (*(fn_i->second))(argv[i]);
+            continue;
         } else {
             // XXX invalid option?  shouldn't happen
             return -1;
         }
+        guard.unlock();
+        _changed(opt);
     }
 
     // if we didn't get a rom-name, return error
@@ -693,13 +839,19 @@ Config::_loadFile(const char* fname)
 			str_i = _strOptMap.find(name);
 			dbl_i = _dblOptMap.find(name);
 			int_i = _intOptMap.find(name);
-			if(str_i != _strOptMap.end()) {
-				str_i->second = value;
-			} else if(int_i != _intOptMap.end()) {
-				int_i->second = atol(value.c_str());
-			} else if(dbl_i != _dblOptMap.end()) {
-				dbl_i->second = atof(value.c_str());
+			{
+				std::lock_guard<std::mutex> guard(_handleLock);
+				if(str_i != _strOptMap.end()) {
+					str_i->second = value;
+				} else if(int_i != _intOptMap.end()) {
+					int_i->second = atol(value.c_str());
+				} else if(dbl_i != _dblOptMap.end()) {
+					dbl_i->second = atof(value.c_str());
+				} else {
+					continue;
+				}
 			}
+			_changed(name);
 		}
 
 		// close the file
@@ -739,6 +891,7 @@ Config::save()
 		config.write(buf, strlen(buf));
 
 		// write each configuration setting
+		std::lock_guard<std::mutex> guard(_handleLock);
 		for(int_i = _intOptMap.begin(); int_i != _intOptMap.end(); int_i++) 
 		{
 			snprintf(buf, 1024, "%s = %d\n",
@@ -1,8 +1,41 @@
 #ifndef __CONFIGSYS_H
 #define __CONFIGSYS_H
 
+#include <atomic>
 #include <map>
+#include <mutex>
 #include <string>
+#include <utility>
+
+/**
+ * The cached value of an integer or double option.  Config hands out
+ * one per option and stores every new value of the option into it, so
+ * code running each frame, or on another thread, can read the option
+ * without looking it up by name.
+ */
+template <typename T>
+class ConfigValue {
+public:
+    T get() const { return _value.load(std::memory_order_relaxed); }
+    operator T() const { return get(); }
+
+private:
+    friend class Config;
+
+    explicit ConfigValue(T value) : _value(value) { }
+    ConfigValue(const ConfigValue &);
+    void operator=(const ConfigValue &);
+
+    std::atomic<T> _value;
+};
+
+typedef ConfigValue<int>    ConfigInt;
+typedef ConfigValue<double> ConfigDouble;
+
+/**
+ * Called after an option was set, on the thread that set it.
+ */
+typedef void (*ConfigListener)(const std::string &name, void *userData);
 
 class Config {
 private:
@@ -16,7 +49,16 @@ private:
     std::map<char, std::string>        _shortArgMap;
     std::map<std::string, std::string> _longArgMap;
 
+    // guards the option values, handles and listeners, which are used
+    // from several threads. The option maps themselves only change while
+    // options are added, before parse().
+    mutable std::mutex _handleLock;
+    std::map<std::string, ConfigInt *>    _intHandles;
+    std::map<std::string, ConfigDouble *> _dblHandles;
+    std::multimap<std::string, std::pair<ConfigListener, void *> > _listeners;
+
 private:
+    void _changed(const std::string &);
     int _addOption(char, const std::string &, const std::string &, int);
     int _addOption(const std::string &, const std::string &, int);
     int _load(void);
@@ -31,7 +73,7 @@ public:
 
 public:
     Config(std::string d) : _dir(d) { }
-    ~Config() { }
+    ~Config();
 
     /**
      * Adds a configuration option.  All options must be added before
@@ -59,19 +101,40 @@ public:
     //int addOption(const std::string &, void (*)(const std::string &));
 
     /**
-     * Sets a configuration option.  Can be called at any time.
+     * Sets a configuration option.  Can be called at any time, from any
+     * thread.
      */
     int setOption(const std::string &, const std::string &);
     int setOption(const std::string &, int);
     int setOption(const std::string &, double);
     int setOption(const std::string &, void (*)(const std::string &));
 
+    /**
+     * Gets a configuration option, from any thread.  The string returned
+     * through a const char ** is only valid until the option is set again,
+     * so other threads should copy it into a std::string instead.
+     */
     int getOption(const std::string &, std::string *) const;
     int getOption(const std::string &, const char **) const;
     int getOption(const std::string &, int *) const;
     int getOption(const std::string &, bool *) const;
     int getOption(const std::string &, double *) const;
 
+    /**
+     * Returns the handle of an integer or double option, or NULL if
+     * there is no such option.  Look it up once; it stays valid as long
+     * as the Config does.
+     */
+    const ConfigInt *getIntHandle(const std::string &);
+    const ConfigDouble *getDoubleHandle(const std::string &);
+
+    /**
+     * Calls the listener with userData each time the option is set,
+     * by setOption(), the configuration file or the command line.
+     */
+    int subscribe(const std::string &, ConfigListener, void *userData);
+    void unsubscribe(const std::string &, ConfigListener, void *userData);
+
     /**
      * Parse the arguments.  Also read in the configuration file and
      * set the variables accordingly.
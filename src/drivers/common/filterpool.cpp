@@ -0,0 +1,122 @@
+/// \file
+/// \brief Threads that run the special video filters in bands of rows, see filterpool.h
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "filterpool.h"
+
+#define FILTERPOOL_MAX_THREADS  3
+#define FILTERPOOL_MIN_ROWS     16	// smaller bands aren't worth waking a thread for
+
+static std::mutex poolLock;
+static std::condition_variable wakeWorkers;
+static std::condition_variable bandsDone;
+static std::vector<std::thread> workers;
+static bool stopping = false;
+
+// the frame being filtered
+static const std::function<void(int, int)> *job = NULL;
+static unsigned int generation = 0;	// counts jobs, so a worker runs each one once
+static int jobRows, jobBands;
+static int pendingBands;
+
+static void BandRows(int band, int *first, int *last)
+{
+	*first = jobRows * band / jobBands;
+	*last = jobRows * (band + 1) / jobBands;
+}
+
+static void WorkerMain(int band, unsigned int seen)
+{
+	std::unique_lock<std::mutex> guard(poolLock);
+
+	for (;;)
+	{
+		while (generation == seen && !stopping)
+			wakeWorkers.wait(guard);
+		if (stopping)
+			break;
+		seen = generation;
+
+		// this job has fewer bands than there are threads
+		if (band >= jobBands)
+			continue;
+
+		const std::function<void(int, int)> &fn = *job;
+		int first, last;
+
+		BandRows(band, &first, &last);
+		guard.unlock();
+		fn(first, last);
+		guard.lock();
+
+		if (--pendingBands == 0)
+			bandsDone.notify_one();
+	}
+}
+
+void FilterPoolInit(int threads)
+{
+	FilterPoolKill();
+
+	if (threads < 0)
+	{
+		threads = (int)std::thread::hardware_concurrency() - 1;
+		if (threads > FILTERPOOL_MAX_THREADS)
+			threads = FILTERPOOL_MAX_THREADS;
+	}
+
+	// a thread may first get to run after the first job was posted, so each one
+	// is told which job it starts after
+	stopping = false;
+	for (int i = 0; i < threads; i++)
+		workers.push_back(std::thread(WorkerMain, i + 1, generation));
+}
+
+void FilterPoolKill(void)
+{
+	{
+		std::lock_guard<std::mutex> guard(poolLock);
+
+		stopping = true;
+		wakeWorkers.notify_all();
+	}
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	workers.clear();
+}
+
+void FilterPoolRun(int rows, const std::function<void(int first, int last)> &band)
+{
+	int bands = (int)workers.size() + 1;
+
+	if (bands > rows / FILTERPOOL_MIN_ROWS)
+		bands = rows / FILTERPOOL_MIN_ROWS;
+	if (bands <= 1)
+	{
+		band(0, rows);
+		return;
+	}
+
+	std::unique_lock<std::mutex> guard(poolLock);
+	int first, last;
+
+	job = &band;
+	jobRows = rows;
+	jobBands = bands;
+	pendingBands = bands - 1;
+	generation++;
+	wakeWorkers.notify_all();
+
+	BandRows(0, &first, &last);
+	guard.unlock();
+	band(first, last);
+	guard.lock();
+
+	while (pendingBands)
+		bandsDone.wait(guard);
+	job = NULL;
+}
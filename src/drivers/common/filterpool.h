@@ -0,0 +1,20 @@
+#ifndef __FILTERPOOL_H
+#define __FILTERPOOL_H
+
+#include <functional>
+
+// A few persistent threads the special video filters split their work among.
+//
+// A frame is cut into horizontal bands of rows, one for each pool thread and one
+// for the calling thread, and FilterPoolRun() returns once all of them are done.
+// Without pool threads the whole frame runs on the calling thread as before.
+
+// Starts the given number of threads besides the calling one, -1 for one less
+// than the number of CPUs (at most 3). Stops the running ones first.
+void FilterPoolInit(int threads);
+void FilterPoolKill(void);
+
+// Calls band(first, last) for bands of rows covering [0, rows) in parallel.
+void FilterPoolRun(int rows, const std::function<void(int first, int last)> &band);
+
+#endif
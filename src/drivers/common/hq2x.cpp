@@ -150,6 +150,13 @@ static inline int Diff(unsigned int w1, unsigned int w2)
 }
 
 void hq2x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int BpL )
+{
+  hq2x_32_rows( pIn, pOut, Xres, Yres, BpL, 0, Yres );
+}
+
+// Filters the rows [first, last) of the image, reading the rows around them.
+// Bands of rows can be filtered in parallel this way.
+void hq2x_32_rows( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int BpL, int first, int last )
 {
   int  i, j, k;
   int  prevline, nextline;
@@ -167,7 +174,10 @@ void hq2x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int
   //   | w7 | w8 | w9 |
   //   +----+----+----+
 
-  for (j=0; j<Yres; j++)
+  pIn += first*Xres*2;
+  pOut += first*BpL*2;
+
+  for (j=first; j<last; j++)
   {
     if (j>0)      prevline = -Xres*2; else prevline = 0;
     if (j<Yres-1) nextline =  Xres*2; else nextline = 0;
@@ -1,4 +1,5 @@
 void hq2x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int BpL);
+void hq2x_32_rows( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int BpL, int first, int last);
 int hq2x_InitLUTs(void);
 void hq2x_Kill(void);
 
@@ -385,3 +385,37 @@ void scale(unsigned scale, void* void_dst, unsigned dst_slice, const void* void_
 	}
 }
 
+/**
+ * Apply the Scale2x or Scale3x effect on the rows [first, last) of a bitmap.
+ * The result is the same as the rows of scale(), the rows above and below the
+ * range are only read. This lets a bitmap be split in bands scaled in parallel.
+ * \param scale Scale factor, 2 or 3.
+ * \param first First source row to scale.
+ * \param last Source row after the last one to scale.
+ * The other parameters are the same as for scale().
+ */
+void scale_rows(unsigned scale, void* void_dst, unsigned dst_slice, const void* void_src, unsigned src_slice, unsigned pixel, unsigned width, unsigned height, unsigned first, unsigned last)
+{
+	unsigned y;
+
+	for (y = first; y < last; ++y) {
+		const unsigned char* src = (const unsigned char*)void_src + y * src_slice;
+		const unsigned char* above = y > 0 ? src - src_slice : src;
+		const unsigned char* below = y + 1 < height ? src + src_slice : src;
+		unsigned char* dst = (unsigned char*)void_dst + y * scale * dst_slice;
+
+		switch (scale) {
+		case 2 :
+			stage_scale2x(SCDST(0), SCDST(1), above, src, below, pixel, width);
+			break;
+		case 3 :
+			stage_scale3x(SCDST(0), SCDST(1), SCDST(2), above, src, below, pixel, width);
+			break;
+		}
+	}
+
+#if defined(__GNUC__) && defined(__i386__)
+	scale2x_mmx_emms();
+#endif
+}
+
@@ -20,6 +20,8 @@
 
 #include <stdlib.h>
 #include <math.h>
+#include <chrono>
+#include <vector>
 #include "scalebit.h"
 #include "hq2x.h"
 #include "hq3x.h"
@@ -29,12 +31,13 @@
 #include "../../palette.h"
 #include "../../utils/memory.h"
 #include "nes_ntsc.h"
+#include "filterpool.h"
+#include "blitsimd.h"
 
 extern u8 *XBuf;
 extern u8 *XBackBuf;
 extern u8 *XDBuf;
 extern u8 *XDBackBuf;
-extern pal *palo;
 
 #include "../../ppu.h"  // for PPU[]
 
@@ -47,11 +50,12 @@ static int backBpp, backshiftr[3], backshiftl[3];
 static int silt;
 static int Bpp;	// BYTES per pixel
 static int highefx;
+static int filterThreads = -1;	// pool threads besides the blitting one, -1 = by CPU count
 //static uint32 backmask[3];
 
 static uint16 *specbuf=NULL;		// 8bpp -> 16bpp, pre hq2x/hq3x
 static uint32 *specbuf32bpp= NULL;	// Buffer to hold output of hq2x/hq3x when converting to 16bpp and 24bpp
-static uint8  *specbuf8bpp = NULL;	// For 2xscale, 3xscale.
+static uint16 *specbufpal  = NULL;	// Palette indices for 2xscale, 3xscale, before and after scaling.
 static uint8  *ntscblit    = NULL;	// For nes_ntsc
 static uint32 *prescalebuf = NULL;	// Prescale pointresizes to 2x-4x to allow less blur with hardware acceleration.
 
@@ -143,7 +147,9 @@ int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int
 	else if(specfilt == 2 || specfilt == 5) // scale2x and scale3x
 	{
 		int multi = ((specfilt == 2) ? 2 * 2 : 3 * 3);		
-		specbuf8bpp = (uint8*)FCEU_dmalloc(256*240*multi); //mbg merge 7/17/06 added cast		
+		specbufpal = (uint16*)FCEU_dmalloc(256*240*(1+multi)*sizeof(uint16)); //mbg merge 7/17/06 added cast		
+		if(specbufpal)
+			memset(specbufpal, 0, 256*240*(1+multi)*sizeof(uint16));	// every index has to stay inside palettetranslate
 	} // -Video Modes Tag-
 	else if(specfilt == 1 || specfilt == 4) // hq2x and hq3x
 	{ 
@@ -212,6 +218,11 @@ int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int
 
 	silt = specfilt;	
 	Bpp=b;	
+	
+	if(specfilt >= 1 && specfilt <= 5)
+		FilterPoolInit(filterThreads);
+	BlitSimdInit(-1);
+	
 	highefx=efx;
 	
 	if(Bpp<=1 || Bpp>4)
@@ -223,7 +234,7 @@ int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int
 		free(palettetranslate);
 		palettetranslate=NULL;
 	}
-	palettetranslate=(uint32*)FCEU_dmalloc(256*4 + 512*4);
+	palettetranslate=(uint32*)FCEU_dmalloc((PALETTE_8BIT + 256)*4);
 	
 	if(!palettetranslate)
 		return(0);
@@ -235,18 +246,26 @@ int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int
 	return(1);
 }
 
+// Sets the number of threads the next InitBlitToHigh() gives the special filters.
+void SetFilterThreads(int threads)
+{
+	filterThreads = threads;
+}
+
 void KillBlitToHigh(void)
 {
+	FilterPoolKill();
+	
 	if(palettetranslate)
 	{
 		free(palettetranslate);
 		palettetranslate=NULL;
 	}
 	
-	if(specbuf8bpp)
+	if(specbufpal)
 	{
-		free(specbuf8bpp);
-		specbuf8bpp = NULL;
+		free(specbufpal);
+		specbufpal = NULL;
 	}
 	if(specbuf32bpp)
 	{
@@ -292,117 +311,48 @@ void SetPaletteBlitToHigh(uint8 *src)
 	
 	CalculateShift(CBM, cshiftr, cshiftl);
 
-	switch(Bpp)
+	// the 512 PPU colors with all emphasis, then the 8 bit palette for whatever
+	// was drawn over them, see FCEU_PaletteIndex()
+	for(int x=0;x<PALETTE_8BIT+256;x++)
 	{
-	case 2:
-		for(int x=0;x<256;x++)
+		uint32 r,g,b;
+		
+		if(x<PALETTE_8BIT)
 		{
-			uint32 r = src[x<<2];
-			uint32 g = src[(x<<2)+1];
-			uint32 b = src[(x<<2)+2];
-			u16 color = (r>>cshiftr[0])<<cshiftl[0];
-			color |= (g>>cshiftr[1])<<cshiftl[1];
-			color |= (b>>cshiftr[2])<<cshiftl[2];
-			palettetranslate[x]=color;
+			r=(paletteLUT[x]>>16)&0xFF;
+			g=(paletteLUT[x]>>8)&0xFF;
+			b=paletteLUT[x]&0xFF;
 		}
-
-		//full size deemph palette
-		if(palo)
+		else
 		{
-			for(int x=0;x<512;x++)
-			{
-				uint32 r=palo[x].r;
-				uint32 g=palo[x].g;
-				uint32 b=palo[x].b;
-				u16 color = (r>>cshiftr[0])<<cshiftl[0];
-				color |= (g>>cshiftr[1])<<cshiftl[1];
-				color |= (b>>cshiftr[2])<<cshiftl[2];
-				palettetranslate[256+x]=color;
-			}
+			r=src[(x-PALETTE_8BIT)<<2];
+			g=src[((x-PALETTE_8BIT)<<2)+1];
+			b=src[((x-PALETTE_8BIT)<<2)+2];
 		}
-
-		break;
-
-	case 3:
-	case 4:
-		for(int x=0;x<256;x++)
+		
+		switch(Bpp)
 		{
-			uint32 r=src[x<<2];
-			uint32 g=src[(x<<2)+1];
-			uint32 b=src[(x<<2)+2];
+		case 2:
+			palettetranslate[x]=((r>>cshiftr[0])<<cshiftl[0])|((g>>cshiftr[1])<<cshiftl[1])|((b>>cshiftr[2])<<cshiftl[2]);
+			break;
+		case 3:
+		case 4:
 			palettetranslate[x]=(r<<cshiftl[0])|(g<<cshiftl[1])|(b<<cshiftl[2]);
+			break;
 		}
-
-		//full size deemph palette
-		if(palo)
-		{
-			for(int x=0;x<512;x++)
-			{
-				uint32 r=palo[x].r;
-				uint32 g=palo[x].g;
-				uint32 b=palo[x].b;
-				palettetranslate[256+x]=(r<<cshiftl[0])|(g<<cshiftl[1])|(b<<cshiftl[2]);
-			}
-		}
-
-		break;
 	}
 }
 
 void Blit32to24(uint32 *src, uint8 *dest, int xr, int yr, int dpitch)
 {
-	int x,y;
-	
-	for(y=yr;y;y--)
-	{
-		for(x=xr;x;x--)
-		{
-			uint32 tmp = *src;
-			*dest = tmp;
-			dest++;
-			*dest = tmp>>8;
-			dest++;
-			*dest = tmp>>16;
-			dest++;
-			src++;
-		}
-		dest += dpitch / 3 - xr;
-	}
+	for(int y=yr;y;y--,src+=xr,dest+=dpitch)
+		Blit32RowTo24(dest, src, xr);
 }
 
 void Blit32to16(uint32 *src, uint16 *dest, int xr, int yr, int dpitch, int shiftr[3], int shiftl[3])
 {
-	int x,y;
-	//printf("%d\n",shiftl[1]);
-	for(y=yr;y;y--)
-	{
-		for(x=xr;x;x--)
-		{
-			uint32 tmp = *src;
-			uint16 dtmp;
-			
-			// Begin iffy code
-			//dtmp = (tmp & backmask[2]) >> shiftr[2];
-			//dtmp |= (tmp & backmask[1]) >> shiftr[1];
-			//dtmp |= (tmp & backmask[0]) >> shiftr[0];
-			// End iffy code
-			
-			// Begin non-iffy code
-			dtmp =  ((tmp&0x0000FF) >> shiftr[2]) << shiftl[2];
-			dtmp |= ((tmp&0x00FF00) >> shiftr[1]) << shiftl[1];
-			dtmp |= ((tmp&0xFF0000) >> shiftr[0]) << shiftl[0];
-			// End non-iffy code
-			
-			//dtmp = ((tmp&0x0000FF) >> 3);
-			//dtmp |= ((tmp&0x00FC00) >>5);
-			//dtmp |= ((tmp&0xF80000) >>8);
-			
-			*dest = dtmp;
-			src++;
-			dest++;
-		}
-		dest += dpitch / 2 - xr;
-	}
+	for(int y=yr;y;y--,src+=xr,dest+=dpitch/2)
+		Blit32RowTo16(dest, src, xr, shiftr, shiftl);
 }
 
 
@@ -466,42 +416,22 @@ void Blit8To8(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, in
 /* Todo:  Make sure 24bpp code works right with big-endian cpus */
 
 //takes a pointer to XBuf and applies fully modern deemph palettizing
-u32 ModernDeemphColorMap(u8* src, u8* srcbuf, int xscale, int yscale)
+u32 ModernDeemphColorMap(u8* src, u8* srcbuf)
 {
-	u8 pixel = *src;
-	
-	//look up the legacy translation
-	u32 color = palettetranslate[pixel];
-
-	int ofs = src-srcbuf;
-	int xofs = ofs&255;
-	int yofs = ofs>>8;
-	if(xscale!=1) xofs /= xscale; //untested optimization
-	if(yscale!=1) yofs /= yscale; //untested optimization
-	ofs = xofs+yofs*256;
-
-	//find out which deemph bitplane value we're on
-	uint8 deemph = XDBuf[ofs];
-
-	//if it was a deemph'd value, grab it from the deemph palette
-	if(deemph != 0)
-		color = palettetranslate[256+(pixel&0x3F)+deemph*64];
-
-	return color;
+	return palettetranslate[FCEU_PaletteIndex(*src, XDBuf[src-srcbuf])];
 }
 
 void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale)
 {
 	int x,y;
 	int pinc;
-	uint8 *destbackup = NULL;	/* For hq2x */
-	int pitchbackup = 0;
+	uint8 *destbackup = NULL;	/* For prescale */
 
 	
 	//static int google=0;
 	//google^=1;
 	
-	if(specbuf8bpp)                  // 2xscale/3xscale
+	if(specbufpal)                   // 2xscale/3xscale
 	{
 		int mult; 
 		int base;
@@ -510,70 +440,65 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 		if(silt == 2) mult = 2;
 		else mult = 3;
 		
-		Blit8To8(src, specbuf8bpp, xr, yr, 256*mult, xscale, yscale, 0, silt);
-		int mdcmxs = xscale*mult;
-		int mdcmys = yscale*mult;
+		bool scaled = (xscale == mult && yscale == mult);	// Blit8To8() leaves the buffer alone otherwise
+		uint16 *indices = specbufpal;
+		uint16 *scaledindices = specbufpal + 256*240;
+		uint8 *emph = XDBuf + (src - XBuf);
 		
-		xr *= mult;
-		yr *= mult;
-		xscale=yscale=1;
-		src = specbuf8bpp;
 		base = 256*mult;
 		
-		switch(Bpp)
+		// scale the palette indices rather than the pixels, so emphasis scales along
+		// with the colors. The index plane is done first as a band's rows scale
+		// from the rows around them.
+		if(scaled)
 		{
-		case 4:
-			pinc=pitch-(xr<<2);
-			for(y=yr;y;y--,src+=base-xr)
-			{
-				for(x=xr;x;x--)
-				{
-				 *(uint32 *)dest=ModernDeemphColorMap(src,specbuf8bpp,mdcmxs, mdcmys);
-				 dest+=4;
-				 src++;
-				}
-				dest+=pinc;
-			}
-			break;
-		case 3:
-			pinc=pitch-(xr+xr+xr);
-			for(y=yr;y;y--,src+=base-xr)
+			FilterPoolRun(yr, [&](int first, int last)
 			{
-				for(x=xr;x;x--)
-				{
-					uint32 tmp=ModernDeemphColorMap(src,specbuf8bpp,mdcmxs, mdcmys);
-					*(uint8 *)dest=tmp;
-					*((uint8 *)dest+1)=tmp>>8;
-					*((uint8 *)dest+2)=tmp>>16;
-					dest+=3;
-					src++;
-					src++;
-				}
-				dest+=pinc;
-			}
-			break; 
-		case 2:
-			pinc=pitch-(xr<<1);
+				for(int y=first; y<last; y++)
+					for(int x=0; x<xr; x++)
+						indices[y*256+x] = FCEU_PaletteIndex(src[y*256+x], emph[y*256+x]);
+			});
+		}
+		
+		// each band scales its rows and converts the scaled rows
+		FilterPoolRun(yr, [&](int first, int last)
+		{
+			if(scaled)
+				scale_rows(mult, scaledindices, base*2, indices, 256*2, 2, xr, yr, first, last);
 			
-			for(y=yr;y;y--,src+=base-xr)
+			for(int y=first*mult; y<last*mult; y++)
 			{
-				for(x=xr>>1;x;x--)
+				uint16 *s = scaledindices + y*base;
+				uint8 *d = dest + y*pitch;
+				
+				switch(Bpp)
 				{
-					//*(uint32 *)dest=palettetranslate[*(uint16 *)src]; //16bpp is doomed
-					dest+=4;
-					src+=2;
+				case 4:
+					for(int x=xr*mult; x; x--, s++, d+=4)
+						*(uint32 *)d=palettetranslate[*s];
+					break;
+				case 3:
+					for(int x=xr*mult; x; x--, s++, d+=3)
+					{
+						uint32 tmp=palettetranslate[*s];
+						*(uint8 *)d=tmp;
+						*((uint8 *)d+1)=tmp>>8;
+						*((uint8 *)d+2)=tmp>>16;
+					}
+					break;
+				case 2:
+					for(int x=xr*mult; x; x--, s++, d+=2)
+						*(uint16 *)d=palettetranslate[*s];
+					break;
 				}
-				dest+=pinc;
 			}
-			break;
-		}
+		});
 		return;
 	}
 	else if(prescalebuf)             // bare prescale
 	{
 		destbackup = dest;
 		dest = (uint8 *)prescalebuf;
-		pitchbackup = pitch;		
 		pitch = xr*sizeof(uint32);
 		pinc = pitch-(xr<<2);
 
@@ -581,7 +506,7 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 		{
 			for(x=xr; x; x--)
 			{
-				*(uint32 *)dest = ModernDeemphColorMap(src,XBuf,1,1);
+				*(uint32 *)dest = ModernDeemphColorMap(src,XBuf);
 				dest += 4;
 				src++;
 			}
@@ -710,21 +635,19 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 					ofs = src-XBuf;                  //find out which deemph bitplane value we're on
 					deemph = XDBuf[ofs];
 					int temp = *src;
-					index = (*src&63) | (deemph*64); //get combined index from basic value and preemph bitplane
-					index += 256;
+					index = FCEU_PaletteIndex(*src, deemph); //get combined index from basic value and preemph bitplane
 
 					src++;
 					
 					ofs = src-XBuf;
 					deemph = XDBuf[ofs];
-					newindex = (*src&63) | (deemph*64);
-					newindex += 256;
+					newindex = FCEU_PaletteIndex(*src, deemph);
 
 					if(GameInfo && GameInfo->type==GIT_NSF)
 					{
-						*d++ = palettetranslate[temp];
-						*d++ = palettetranslate[temp];
-						*d++ = palettetranslate[temp];
+						*d++ = palettetranslate[PALETTE_8BIT+temp];
+						*d++ = palettetranslate[PALETTE_8BIT+temp];
+						*d++ = palettetranslate[PALETTE_8BIT+temp];
 					}
 					else
 					{
@@ -797,191 +720,223 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 	}
 	else if(specbuf)                 // hq2x/hq3x
 	{
-		destbackup=dest;
-		dest=(uint8 *)specbuf;
-		pitchbackup=pitch;
+		// -Video Modes Tag-
+		int mult = (silt == 4)?3:2;
 		
-		pitch=xr*sizeof(uint16);
-		xscale=1;
-		yscale=1;
+		// to 16 bpp first, as hq2x/hq3x reads the lines around each band
+		FilterPoolRun(yr, [&](int first, int last)
+		{
+			uint8 *emph = XDBuf + (src-XBuf);
+			
+			for(int y=first; y<last; y++)
+				BlitRowTo16(specbuf + y*xr, src + y*256, emph + y*256, palettetranslate, xr, 1);
+		});
+		
+		FilterPoolRun(yr, [&](int first, int last)
+		{
+			if(specbuf32bpp)
+			{
+				int outpitch = xr*mult*sizeof(uint32);
+				uint32 *out = specbuf32bpp + first*mult*xr*mult;
+				
+				if(silt == 4)
+					hq3x_32_rows((uint8 *)specbuf,(uint8*)specbuf32bpp,xr,yr,outpitch,first,last);
+				else
+					hq2x_32_rows((uint8 *)specbuf,(uint8*)specbuf32bpp,xr,yr,outpitch,first,last);
+				
+				if(backBpp == 2)
+					Blit32to16(out, (uint16*)(dest + first*mult*pitch), xr*mult, (last-first)*mult, pitch, backshiftr,backshiftl);
+				else // == 3
+					Blit32to24(out, dest + first*mult*pitch, xr*mult, (last-first)*mult, pitch);
+			}
+			else
+			{
+				if(silt == 4)
+					hq3x_32_rows((uint8 *)specbuf,dest,xr,yr,pitch,first,last);
+				else
+					hq2x_32_rows((uint8 *)specbuf,dest,xr,yr,pitch,first,last);
+			}
+		});
+		return;
 	}
 	
+	if(nes_ntsc && Bpp == 4 && (xscale!=1 || yscale!=1) && GameInfo && GameInfo->type!=GIT_NSF)
 	{
-		if(xscale!=1 || yscale!=1)
+		int outxr = 301;
+		//if(xr == 282) outxr = 282; //hack for windows
+		burst_phase ^= 1;
+
+		u8* srcD = XDBuf + (src-XBuf); // get deemphasis buffer
+		const int in_stride = Bpp * outxr * 2;
+		const int out_stride = pitch;
+
+		FilterPoolRun(yr, [&](int first, int last)
+		{
+			// the burst phase advances by one each row
+			nes_ntsc_blit( nes_ntsc, (unsigned char*)src + first*xr, (unsigned char*)srcD + first*xr, xr,
+				(burst_phase + first) % nes_ntsc_burst_count, xr, last - first, ntscblit + first*in_stride, in_stride );
+		});
+
+		// the copies run past the end of a row into the next one
+		FilterPoolRun(yr, [&](int first, int last)
+		{
+			const uint8 *in = ntscblit + first*in_stride + (Bpp * xscale);
+			uint8 *out = dest + first*2*out_stride;
+			for( int y = first; y < last; y++, in += in_stride, out += 2*out_stride ) {
+				memcpy(out, in, Bpp * outxr * xscale);
+				memcpy(out + out_stride, in, Bpp * outxr * xscale);
+			}
+		});
+	}
+	else
+	{
+		// each line is translated once and copied for the other yscale-1 lines
+		uint8 *emph = XDBuf + (src-XBuf);
+		int rowbytes = xr*xscale*Bpp;
+
+		for(y=yr;y;y--,src+=256,emph+=256)
 		{
 			switch(Bpp)
 			{
 			case 4:
-				if ( nes_ntsc && GameInfo && GameInfo->type!=GIT_NSF) {
-					int outxr = 301;
-					//if(xr == 282) outxr = 282; //hack for windows
-					burst_phase ^= 1;
-
-					u8* srcD = XDBuf + (src-XBuf); // get deemphasis buffer
-					nes_ntsc_blit( nes_ntsc, (unsigned char*)src, (unsigned char*)srcD, xr, burst_phase, xr, yr, ntscblit, (2*outxr) * Bpp );
-
-					const uint8 *in = ntscblit + (Bpp * xscale);
-					uint8 *out = dest;
-					const int in_stride = Bpp * outxr * 2;
-					const int out_stride = pitch;
-					for( int y = 0; y < yr; y++, in += in_stride, out += 2*out_stride ) {
-						memcpy(out, in, Bpp * outxr * xscale);
-						memcpy(out + out_stride, in, Bpp * outxr * xscale);
-					}
-				} else {
-					pinc=pitch-((xr*xscale)<<2);
-					for(y=yr;y;y--,src+=256-xr)
-					{
-						int doo=yscale;
-						        
-						do
-						{
-							for(x=xr;x;x--,src++)
-							{
-								int too=xscale;
-								do
-								{
-									*(uint32 *)dest=palettetranslate[*src];
-									dest+=4;
-								} while(--too);
-							}
-							src-=xr;
-							dest+=pinc;
-						} while(--doo);
-						src+=xr;
-					}
-				}
+				//THE MAIN BLITTING CODEPATH (there may be others that are important)
+				BlitRowTo32((uint32 *)dest, src, emph, palettetranslate, xr, xscale);
 				break;
-			
 			case 3:
-				pinc=pitch-((xr*xscale)*3);
-				for(y=yr;y;y--,src+=256-xr)
-				{  
-					int doo=yscale;
-					 
-					do
-					{
-						for(x=xr;x;x--,src++)
-						{    
-							int too=xscale;
-							do
-							{
-								uint32 tmp=palettetranslate[(uint32)*src];
-								*(uint8 *)dest=tmp;
-								*((uint8 *)dest+1)=tmp>>8;
-								*((uint8 *)dest+2)=tmp>>16;
-								dest+=3;
-								
-								//*(uint32 *)dest=palettetranslate[*src];
-								//dest+=4;
-							} while(--too);
-						}
-						src-=xr;
-						dest+=pinc;
-					} while(--doo);
-					src+=xr;
-				}
+				BlitRowTo24(dest, src, emph, palettetranslate, xr, xscale);
 				break;
-						
 			case 2:
-				pinc=pitch-((xr*xscale)<<1);
-				   
-				for(y=yr;y;y--,src+=256-xr)
-				{   
-					int doo=yscale;
-					   
-					do
-					{
-						for(x=xr;x;x--,src++)
-						{
-							int too=xscale;
-							do
-							{
-								//*(uint16 *)dest=palettetranslate[*src]; 16bpp is doomed right now
-								dest+=2;
-							} while(--too);
-						}
-					src-=xr;
-					dest+=pinc;
-					} while(--doo);
-					src+=xr;
-				}  
+				BlitRowTo16((uint16 *)dest, src, emph, palettetranslate, xr, xscale);
 				break;
 			}
+			for(int doo=1;doo<yscale;doo++)
+				memcpy(dest+doo*pitch, dest, rowbytes);
+			dest+=pitch*yscale;
 		}
-		else
-			switch(Bpp)
+	}
+}
+
+// Times Blit8ToHigh() at each depth and scale with every kernel level the CPU
+// has, on a made up frame in XBuf, so only while no game is running. The
+// output of each level is checked against the plain C one.
+bool BlitBenchmark(void)
+{
+	typedef std::chrono::steady_clock Clock;
+	const int frames = 300;
+	const int bpps[3] = { 4, 3, 2 };
+	bool ok = true;
+	uint8 pal[256*4];
+	
+	if(!XBuf || !XDBuf)
+		return false;
+	
+	// tiles of a few colors tagged the way the PPU does, emphasis on part of the
+	// screen, and noise for what the GUI draws over them
+	srand(1);
+	for(int y=0; y<256; y++)
+		for(int x=0; x<256; x++)
+		{
+			uint8 emph = (y >= 160) ? (x/32) & 7 : 0;
+			uint8 tag = emph == 0 ? 0x80 : emph == 7 ? 0xC0 : 0x40;
+			
+			XBuf[y*256+x] = ((x/8+y/8)%7 == 0) ? rand()%256 : (((x/16)*3 + y/24) % 64) | tag;
+			XDBuf[y*256+x] = emph;
+		}
+	for(int i=0; i<256*4; i++)
+		pal[i] = i*37;
+	
+	int best = BlitSimdInit(-1);
+	
+	FCEU_printf("blit of 256x240, %d frames, best kernels %s\n", frames, BlitSimdName(best));
+	
+	for(int b=0; b<3; b++)
+		for(int scale=1; scale<=4; scale++)
+		{
+			int bpp = bpps[b];
+			int pitch = 256*scale*bpp;
+			std::vector<uint8> ref(pitch*240*scale), out(pitch*240*scale);
+			double base = 0;
+			
+			if(bpp == 2)
+				InitBlitToHigh(bpp, 0xF800, 0x07E0, 0x001F, 0, 0, 0);
+			else
+				InitBlitToHigh(bpp, 0xFF0000, 0x00FF00, 0x0000FF, 0, 0, 0);
+			SetPaletteBlitToHigh(pal);
+			
+			FCEU_printf("%2d bpp %dx:", bpp*8, scale);
+			for(int level=BLITSIMD_C; level<=best; level++)
 			{
-			case 4:
-				pinc=pitch-(xr<<2);
-				for(y=yr;y;y--,src+=256-xr)
-				{
-					for(x=xr;x;x--)
-					{
-						//THE MAIN BLITTING CODEPATH (there may be others that are important)
-						*(uint32 *)dest = ModernDeemphColorMap(src,XBuf,1,1);
-						dest+=4;
-						src++;
-					}
-					dest+=pinc;
-				}
-				break;
-			case 3:
-				pinc=pitch-(xr+xr+xr);
-				for(y=yr;y;y--,src+=256-xr)
+				BlitSimdInit(level);
+				
+				Clock::time_point start = Clock::now();
+				for(int f=0; f<frames; f++)
+					Blit8ToHigh(XBuf, &out[0], 256, 240, pitch, scale, scale);
+				double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / frames;
+				
+				if(level == BLITSIMD_C)
 				{
-					for(x=xr;x;x--)
-					{     
-						uint32 tmp = ModernDeemphColorMap(src,XBuf,1,1);
-						*(uint8 *)dest=tmp;
-						*((uint8 *)dest+1)=tmp>>8;
-						*((uint8 *)dest+2)=tmp>>16;
-						dest+=3;
-						src++;
-					}
-					dest+=pinc;
+					base = us;
+					ref = out;
+					FCEU_printf("  %s %8.1f us", BlitSimdName(level), us);
 				}
-				break;
-			case 2:
-				pinc=pitch-(xr<<1);
-				for(y=yr;y;y--,src+=256-xr)
+				else
 				{
-					for(x=xr;x;x--)
-					{
-						*(uint16 *)dest = ModernDeemphColorMap(src,XBuf,1,1);
-						dest+=2;
-						src++;
-					}
-					dest+=pinc;
+					bool same = (out == ref);
+					
+					ok = ok && same;
+					FCEU_printf("  %s %8.1f us (x%.2f)%s", BlitSimdName(level), us, base/us, same ? "" : " MISMATCH");
 				}
-				break;
 			}
-	}
+			FCEU_printf("\n");
+			KillBlitToHigh();
+		}
 	
-	if(specbuf)
+	// the repacking hq2x/hq3x do for 24 and 16 bpp
 	{
-		if(specbuf32bpp)
+		std::vector<uint32> frame(768*720);
+		std::vector<uint8> ref(768*720*3), out(768*720*3);
+		int shiftr[3] = { 16+3, 8+2, 0+3 }, shiftl[3] = { 11, 5, 0 };
+		
+		for(size_t i=0; i<frame.size(); i++)
+			frame[i] = (uint32)(i * 2654435761u);
+		
+		for(int depth=3; depth>=2; depth--)
 		{
-			// -Video Modes Tag-
-			int mult = (silt == 4)?3:2;
-			
-			if(silt == 4)
-				hq3x_32((uint8 *)specbuf,(uint8*)specbuf32bpp,xr,yr,xr*3*sizeof(uint32));
-			else
-				hq2x_32((uint8 *)specbuf,(uint8*)specbuf32bpp,xr,yr,xr*2*sizeof(uint32));
+			double base = 0;
 			
-			if(backBpp == 2)
-				Blit32to16(specbuf32bpp, (uint16*)destbackup, xr*mult, yr*mult, pitchbackup, backshiftr,backshiftl);
-			else // == 3
-				Blit32to24(specbuf32bpp, (uint8*)destbackup, xr*mult, yr*mult, pitchbackup);
-		}
-		else
-		{
-			// -Video Modes Tag-
-			if(silt == 4)
-				hq3x_32((uint8 *)specbuf,destbackup,xr,yr,pitchbackup);
-			else
-				hq2x_32((uint8 *)specbuf,destbackup,xr,yr,pitchbackup);
+			FCEU_printf("32 to %d bpp:", depth*8);
+			for(int level=BLITSIMD_C; level<=best; level++)
+			{
+				BlitSimdInit(level);
+				
+				Clock::time_point start = Clock::now();
+				for(int f=0; f<frames; f++)
+				{
+					if(depth == 3)
+						Blit32to24(&frame[0], &out[0], 768, 720, 768*3);
+					else
+						Blit32to16(&frame[0], (uint16 *)&out[0], 768, 720, 768*2, shiftr, shiftl);
+				}
+				double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / frames;
+				
+				if(level == BLITSIMD_C)
+				{
+					base = us;
+					ref = out;
+					FCEU_printf("  %s %8.1f us", BlitSimdName(level), us);
+				}
+				else
+				{
+					bool same = (out == ref);
+					
+					ok = ok && same;
+					FCEU_printf("  %s %8.1f us (x%.2f)%s", BlitSimdName(level), us, base/us, same ? "" : " MISMATCH");
+				}
+			}
+			FCEU_printf("\n");
 		}
 	}
+	
+	BlitSimdInit(-1);
+	return ok;
 }
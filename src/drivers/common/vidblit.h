@@ -21,6 +21,8 @@
 int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int eefx, int specfilt, int specfilteropt);
 void SetPaletteBlitToHigh(uint8 *src);
 void KillBlitToHigh(void);
+void SetFilterThreads(int threads);
+bool BlitBenchmark(void);
 void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale);
 void Blit8To8(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale, int efx, int special);
 
@@ -29,4 +31,4 @@ void Blit32to16(uint32 *src, uint16 *dest, int xr, int yr, int dpitch,
         int shiftr[3], int shiftl[3]);
 
 
-u32 ModernDeemphColorMap(u8* src, u8* srcbuf, int xscale, int yscale);
\ No newline at end of file
+u32 ModernDeemphColorMap(u8* src, u8* srcbuf);
\ No newline at end of file
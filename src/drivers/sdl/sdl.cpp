@@ -372,17 +372,18 @@ FCEUD_Update(uint8 *XBuf,
 	{
 	  if(LoggingEnabled == 2)
 	  {
-		int16* MonoBuf = new int16[Count];
+		static std::vector<int16> MonoBuf;
 		int n;
+		if((int)MonoBuf.size() < Count)
+			MonoBuf.resize(Count);
 		for(n=0; n<Count; ++n)
 			MonoBuf[n] = Buffer[n] & 0xFFFF;
 		NESVideoLoggingAudio
 		 (
-		  MonoBuf, 
+		  &MonoBuf[0], 
 		  FSettings.SndRate, 16, 1,
 		  Count
 		 );
-		delete [] MonoBuf;
 	  }
 	  Count /= 2;
 	  if(inited & 1)
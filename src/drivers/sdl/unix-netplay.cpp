@@ -208,7 +208,7 @@ FCEUD_NetworkConnect(void)
 		memcpy(sendbuf + 4 + 16, md5out, 16);
 	}
 
-	memset(sendbuf + 4 + 16 + 16, 0, 64);
+	FCEUI_NetplayLoginExtra(sendbuf + 4 + 16 + 16);
 
 	sendbuf[4 + 16 + 16 + 64] = (uint8)localPlayers;
 
@@ -343,6 +343,22 @@ FCEUD_NetworkClose(void)
 	FCEUDnetplay = 0;
 }
 
+// Rollback play is only supported by the Qt driver.
+int
+FCEUD_RollbackSend(const void *data,
+                   uint32 len)
+{
+	return 0;
+}
+
+int
+FCEUD_RollbackRecv(void *data,
+                   uint32 len,
+                   int timeout)
+{
+	return -1;
+}
+
 
 void
 FCEUD_NetplayText(uint8 *text)
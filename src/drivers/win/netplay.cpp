@@ -280,7 +280,7 @@ int FCEUD_NetworkConnect(void)
     memcpy(sendbuf + 4 + 16, md5out, 16);
    }
                         
-   memset(sendbuf + 4 + 16 + 16, 0, 64);
+   FCEUI_NetplayLoginExtra(sendbuf + 4 + 16 + 16);
    sendbuf[4 + 16 + 16 + 64] = netlocalplayers;
 
    if(netplaynick)
@@ -382,6 +382,17 @@ int FCEUD_RecvData(void *data, uint32 len)
   return 0;
 }
 
+// Rollback play isn't supported by the Windows driver yet.
+int FCEUD_RollbackSend(const void *data, uint32 len)
+{
+ return(0);
+}
+
+int FCEUD_RollbackRecv(void *data, uint32 len, int timeout)
+{
+ return(-1);
+}
+
 CFGSTRUCT NetplayConfig[]={
         AC(remotetport),
         AC(netlocalplayers),
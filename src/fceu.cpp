@@ -42,7 +42,15 @@
 #include "input.h"
 #include "file.h"
 #include "vsuni.h"
+#include "memtrack.h"
+#include "memsnap.h"
+#include "vramtrack.h"
+#include "moviekeyframes.h"
+#include "rollback.h"
+#include "screenshot.h"
+#include "capture.h"
 #include "ines.h"
+#include "romcache.h"
 #ifdef __WIN_DRIVER__
 #include "drivers/win/pref.h"
 #include "utils/xstring.h"
@@ -190,6 +198,7 @@ static void FCEU_CloseGame(void)
 		if (FCEUnetplay) {
 			FCEUD_NetworkClose();
 		}
+		FCEUI_RollbackStop();
 
 		if (GameInfo->name) {
 			free(GameInfo->name);
@@ -261,6 +270,7 @@ int frameAdvance_Delay = FRAMEADVANCE_DELAY_DEFAULT;
 
 //indicates that the emulation core just frame advanced (consumed the frame advance state and paused)
 bool JustFrameAdvanced = false;
+bool resimulatingFrames = false; //FCEUI_Emulate skips output (video, AVI, capture), autosaves, autofire, Lua and debugger hooks
 
 static int *AutosaveStatus; //is it safe to load Auto-savestate
 static int AutosaveIndex = 0; //which Auto-savestate we're on
@@ -395,6 +405,7 @@ void ResetGameLoaded(void) {
 	if (GameInfo) FCEU_CloseGame();
 	EmulationPaused = 0; //mbg 5/8/08 - loading games while paused was bad news. maybe this fixes it
 	GameStateRestore = 0;
+	FCEU_MemTrackReset();
 	PPU_hook = NULL;
 	GameHBIRQHook = NULL;
 	FFCEUX_PPURead = NULL;
@@ -415,6 +426,46 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode);
 int FDSLoad(const char *name, FCEUFILE *fp);
 int NSFLoad(const char *name, FCEUFILE *fp);
 
+//runs the loader of one format, ROMCACHE_INES...
+static int LoadFormat(int format, const char *name, FCEUFILE *fp, int OverwriteVidMode)
+{
+	FCEU_fseek(fp, 0, SEEK_SET);
+	switch (format)
+	{
+	case ROMCACHE_INES: return iNESLoad(name, fp, OverwriteVidMode);
+	case ROMCACHE_NSF:  return NSFLoad(name, fp);
+	case ROMCACHE_UNIF: return UNIFLoad(name, fp);
+	case ROMCACHE_FDS:  return FDSLoad(name, fp);
+	}
+	return LOADER_INVALID_FORMAT;
+}
+
+//adds what the loader found out about the game to the ROM cache
+static void CacheLoadedGame(RomCacheEntry &entry, int format)
+{
+	entry.format = format;
+	entry.flags = 0;
+	memcpy(entry.md5, &GameInfo->MD5, sizeof(entry.md5));
+	entry.romcrc32 = 0;
+	entry.mapper = -1;
+	entry.mirroring = -1;
+	if (format == ROMCACHE_INES && currCartInfo)
+	{
+		entry.romcrc32 = currCartInfo->CRC32;
+		entry.mapper = GameInfo->mappernum;
+		entry.mirroring = currCartInfo->mirror;
+		if (currCartInfo->battery)
+			entry.flags |= ROMCACHE_BATTERY;
+	}
+	if (GameInfo->type == GIT_VSUNI)
+		entry.flags |= ROMCACHE_VSUNI;
+	entry.input[0] = GameInfo->input[0];
+	entry.input[1] = GameInfo->input[1];
+	entry.inputfc = GameInfo->inputfc;
+
+	FCEUI_RomCacheAdd(entry);
+}
+
 //name should be UTF-8, hopefully, or else there may be trouble
 FCEUGI *FCEUI_LoadGameVirtual(const char *name, int OverwriteVidMode, bool silent)
 {
@@ -483,22 +534,31 @@ FCEUGI *FCEUI_LoadGameVirtual(const char *name, int OverwriteVidMode, bool silen
 	//try to load each different format
 	bool FCEUXLoad(const char *name, FCEUFILE * fp);
 
-	int load_result;
-	load_result = iNESLoad(fullname, fp, OverwriteVidMode);
-	if (load_result == LOADER_INVALID_FORMAT)
+	//a cached ROM goes to its own loader first, which can use what's cached
+	RomCacheEntry cached;
+	bool haveKey = FCEU_RomCacheKey(fp, &cached);
+	bool hit = haveKey && FCEUI_RomCacheFind(&cached);
+	int load_result = LOADER_INVALID_FORMAT;
+	int format = 0;
+
+	if (hit)
 	{
-		load_result = NSFLoad(fullname, fp);
-		if (load_result == LOADER_INVALID_FORMAT)
-		{
-			load_result = UNIFLoad(fullname, fp);
-			if (load_result == LOADER_INVALID_FORMAT)
-			{
-				load_result = FDSLoad(fullname, fp);
-			}
-		}
-	}	
+		romCacheCurrent = &cached;
+		format = cached.format;
+		load_result = LoadFormat(format, fullname, fp, OverwriteVidMode);
+		romCacheCurrent = NULL;
+	}
+	for (int f = ROMCACHE_INES; f <= ROMCACHE_FDS && load_result == LOADER_INVALID_FORMAT; f++)
+	{
+		if (hit && f == cached.format)
+			continue;
+		format = f;
+		load_result = LoadFormat(format, fullname, fp, OverwriteVidMode);
+	}
 	if (load_result == LOADER_OK)
 	{
+		if (haveKey && !hit)
+			CacheLoadedGame(cached, format);
 
 #ifdef __WIN_DRIVER__
 		// ################################## Start of SP CODE ###########################
@@ -626,6 +686,8 @@ bool FCEUI_Initialize() {
 	FSettings.Square2Volume = 256;    //0-256 scale (256 is max volume)
 	FSettings.NoiseVolume = 256;      //0-256 scale (256 is max volume)
 	FSettings.PCMVolume = 256;        //0-256 scale (256 is max volume)
+	FSettings.MapRomImages = false;
+	FSettings.ShareRomImages = false;
 
 	FCEUPPU_Init();
 
@@ -638,8 +700,12 @@ void FCEUI_Kill(void) {
 	#ifdef _S9XLUA_H
 	FCEU_LuaStop();
 	#endif
+	FCEU_ScreenshotStop();
+	FCEUI_CaptureEnd();
 	FCEU_KillVirtualVideo();
 	FCEU_KillGenie();
+	FCEUI_RomCacheFlush();
+	FCEUI_RomCacheClose();
 	FreeBuffers();
 }
 
@@ -729,6 +795,7 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 		{
 			// emulator is paused
 			memcpy(XBuf, XBackBuf, 256*256);
+			FCEU_MemSnapshotUpdate(false);
 			FCEU_PutImage();
 			*pXBuf = XBuf;
 			*SoundBuf = WaveFinal;
@@ -737,18 +804,30 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 		}
 	}
 
-	AutoFire();
-	UpdateAutosave();
+	// may load a state and emulate the frames since again
+	FCEU_RollbackFrameBegin();
+
+	// a frame that is emulated again already had its output and hooks, only the game runs
+	bool replay = resimulatingFrames;
+	if (replay)
+		skip = 2;
+
+	if (!replay)
+	{
+		AutoFire();
+		UpdateAutosave();
 
 #ifdef _S9XLUA_H
-	FCEU_LuaFrameBoundary();
+		FCEU_LuaFrameBoundary();
 #endif
+	}
 
 	FCEU_UpdateInput();
 	lagFlag = 1;
 
 #ifdef _S9XLUA_H
-	CallRegisteredLuaFunctions(LUACALL_BEFOREEMULATION);
+	if (!replay)
+		CallRegisteredLuaFunctions(LUACALL_BEFOREEMULATION);
 #endif
 
 	if (geniestage != 1) FCEU_ApplyPeriodicCheats();
@@ -756,36 +835,45 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 
 	if (skip != 2) ssize = FlushEmulateSound();  //If skip = 2 we are skipping sound processing
 
+	if (!replay)
+	{
 #ifdef _S9XLUA_H
-	CallRegisteredLuaFunctions(LUACALL_AFTEREMULATION);
+		CallRegisteredLuaFunctions(LUACALL_AFTEREMULATION);
 #endif
 
-	FCEU_PutImage();
+		FCEU_MemTrackFrameEnd();
+		FCEU_MemSnapshotUpdate(true);
+
+		FCEU_PutImage();
 
 #ifdef __WIN_DRIVER__
-	//These Windows only dialogs need to be updated only once per frame so they are included here
-	// CaH4e3: can't see why, this is only cause problems with selection
-	// adelikat: selection is only a problem when not paused, it should be paused to select, we want to see the values update
-	// owomomo: use an OWNERDATA CListCtrl to partially solve the problem
-	UpdateCheatList();
-	UpdateTextHooker();
-	Update_RAM_Search(); // Update_RAM_Watch() is also called.
-	RamChange();
-	//FCEUI_AviVideoUpdate(XBuf);
+		//These Windows only dialogs need to be updated only once per frame so they are included here
+		// CaH4e3: can't see why, this is only cause problems with selection
+		// adelikat: selection is only a problem when not paused, it should be paused to select, we want to see the values update
+		// owomomo: use an OWNERDATA CListCtrl to partially solve the problem
+		UpdateCheatList();
+		UpdateTextHooker();
+		Update_RAM_Search(); // Update_RAM_Watch() is also called.
+		RamChange();
+		//FCEUI_AviVideoUpdate(XBuf);
 
-	extern int KillFCEUXonFrame;
-	if (KillFCEUXonFrame && (FCEUMOV_GetFrame() >= KillFCEUXonFrame))
-		DoFCEUExit();
+		extern int KillFCEUXonFrame;
+		if (KillFCEUXonFrame && (FCEUMOV_GetFrame() >= KillFCEUXonFrame))
+			DoFCEUExit();
 #else
 		extern int KillFCEUXonFrame;
-	if (KillFCEUXonFrame && (FCEUMOV_GetFrame() >= KillFCEUXonFrame))
-		exit(0);
+		if (KillFCEUXonFrame && (FCEUMOV_GetFrame() >= KillFCEUXonFrame))
+			exit(0);
 #endif
+	}
 
 	timestampbase += timestamp;
 	timestamp = 0;
 	soundtimestamp = 0;
 
+	if (!replay)
+		FCEU_MovieKeyframesFrameEnd();
+
 	*pXBuf = skip ? 0 : XBuf;
 	if (skip == 2) { //If skip = 2, then bypass sound
 		*SoundBuf = 0;
@@ -812,7 +900,7 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 		justLagged = true;
 	} else justLagged = false;
 
-	if (movieSubtitles)
+	if (movieSubtitles && !replay)
 		ProcessSubtitles();
 }
 
@@ -1144,6 +1232,16 @@ void FCEUI_SetGameGenie(bool a) {
 	FSettings.GameGenie = a;
 }
 
+//Enable or disable mapping iNES ROM images from their files, takes effect on the next load.
+void FCEUI_SetMapRomImages(bool a) {
+	FSettings.MapRomImages = a;
+}
+
+//Enable or disable sharing archived or patched ROM images through /dev/shm, takes effect on the next load.
+void FCEUI_SetShareRomImages(bool a) {
+	FSettings.ShareRomImages = a;
+}
+
 //this variable isn't used at all, snap is always name-based
 //void FCEUI_SetSnapName(bool a)
 //{
@@ -1432,6 +1530,10 @@ void FCEU_WriteRomByte(uint32 i, uint8 value) {
 #endif
 	if (i < 16 + PRGsize[0])
 		PRGptr[0][i - 16] = value;
-	else if (i < 16 + PRGsize[0] + CHRsize[0])
+	else if (i < 16 + PRGsize[0] + CHRsize[0]) {
 		CHRptr[0][i - 16 - PRGsize[0]] = value;
+		// the byte may be mapped in any bank, or none
+		FCEU_VRAMTrackInvalidate();
+	}
+	FCEU_MemNoteRomWrite(i);
 }
@@ -69,6 +69,8 @@ extern uint8 qtaintramreg;
 
 extern  uint8  *RAM;            //shared memory modifications
 extern int EmulationPaused;
+//set while frames that were already emulated are run again (rollback, movie seeking)
+extern bool resimulatingFrames;
 extern int frameAdvance_Delay;
 extern int RAMInitOption;
 
@@ -127,6 +129,13 @@ typedef struct fceu_settings_struct {
 	uint32 SndRate;
 	int soundq;
 	int lowpass;
+
+	//use PRG and CHR mapped from the ROM file instead of copies, see iNESLoad(). off by default:
+	//the pages not written to yet follow the file, so rebuilding it in place changes the running
+	//game or crashes it with SIGBUS
+	bool MapRomImages;
+	//also map ROMs that only exist in memory through a copy in /dev/shm, see FCEU_fmap()
+	bool ShareRomImages;
 } FCEUS;
 
 int FCEU_TextScanlineOffset(int y);
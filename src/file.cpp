@@ -32,6 +32,7 @@
 #include "utils/endian.h"
 #include "utils/memory.h"
 #include "utils/md5.h"
+#include "utils/crc32.h"
 #ifdef _SYSTEM_MINIZIP
 #ifdef __linux
 #include <minizip/unzip.h>
@@ -46,11 +47,14 @@
 #include "fceu.h"
 #include "state.h"
 #include "movie.h"
+#include "romcache.h"
 #include "driver.h"
 #include "utils/xstring.h"
 
 #ifndef WIN32
 #include <zlib.h>
+#include <unistd.h>
+#include <fcntl.h>
 #endif
 
 using namespace std;
@@ -447,6 +451,81 @@ int FCEU_fisarchive(FCEUFILE *fp)
 	else return 1;
 }
 
+//Maps the whole file copy-on-write, see FCEU_MapFileCopy(). Returns null if it can't be mapped.
+//A file from an archive or gzip, or patched by an ips, only exists in memory. On Linux, if
+//FSettings.ShareRomImages is set, it is written once to /dev/shm, named by its size and crc32,
+//so that every process loading it maps the same pages. Those files take up memory until
+//they're deleted or the machine restarts.
+uint8 *FCEU_fmap(FCEUFILE *fp, uint32 *size)
+{
+	FILE *file = fp->stream->get_fp();
+
+	if(file)
+		return (uint8*)FCEU_MapFileCopy(file, size);
+
+#ifdef __linux
+	EMUFILE_MEMORY *ms = dynamic_cast<EMUFILE_MEMORY*>(fp->stream);
+	if(!FSettings.ShareRomImages || !ms || ms->size() <= 0)
+		return 0;
+
+	uint8 *buf = ms->buf();
+	uint32 len = (uint32)ms->size();
+	char name[64];
+
+	sprintf(name, "/dev/shm/fceux-%08x-%u.rom", CalcCRC32(0, buf, len), len);
+
+	int fd = open(name, O_RDONLY | O_NOFOLLOW);
+	if(fd < 0)
+	{
+		//written next to it and renamed, so nobody maps a partial file
+		char temp[80];
+		sprintf(temp, "%s.%d", name, (int)getpid());
+
+		int out = open(temp, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, 0644);
+		if(out < 0)
+			return 0;
+		bool ok = write(out, buf, len) == (ssize_t)len;
+		ok = (close(out) == 0) && ok;
+		if(!ok || rename(temp, name))
+		{
+			remove(temp);
+			return 0;
+		}
+		fd = open(name, O_RDONLY | O_NOFOLLOW);
+		if(fd < 0)
+			return 0;
+	}
+
+	//anyone can create the file, and whoever can write it can change the pages not copied yet
+	struct stat st;
+	if(fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH)))
+	{
+		close(fd);
+		return 0;
+	}
+
+	FILE *shm = fdopen(fd, "rb");
+	if(!shm)
+	{
+		close(fd);
+		return 0;
+	}
+
+	uint8 *ret = (uint8*)FCEU_MapFileCopy(shm, size);
+	fclose(shm);
+
+	//the name is only a hash of the contents
+	if(ret && (*size != len || memcmp(ret, buf, len)))
+	{
+		FCEU_UnmapFile(ret, *size);
+		ret = 0;
+	}
+	return ret;
+#else
+	return 0;
+#endif
+}
+
 std::string GetMfn() //Retrieves the movie filename from curMovieFilename (for adding to savestate and auto-save files)
 {
 	std::string movieFilenamePart;
@@ -463,6 +542,12 @@ std::string GetMfn() //Retrieves the movie filename from curMovieFilename (for a
 /// Updates the base directory
 void FCEUI_SetBaseDirectory(std::string const & dir)
 {
+	if (dir != BaseDirectory)
+	{
+		// the cached entries belong to the old directory's cache
+		FCEUI_RomCacheFlush();
+		FCEUI_RomCacheClose();
+	}
 	BaseDirectory = dir;
 }
 /// Gets the base directory
@@ -134,6 +134,7 @@ int FCEU_read16le(uint16 *Bufo, FCEUFILE*);
 int FCEU_fgetc(FCEUFILE*);
 uint64 FCEU_fgetsize(FCEUFILE*);
 int FCEU_fisarchive(FCEUFILE*);
+uint8 *FCEU_fmap(FCEUFILE*, uint32 *size); //unmap with FCEU_UnmapFile
 
 
 
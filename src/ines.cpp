@@ -37,10 +37,13 @@
 #include "cheat.h"
 #include "vsuni.h"
 #include "driver.h"
+#include "romcache.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 
 extern SFORMAT FCEUVSUNI_STATEINFO[];
 
@@ -53,6 +56,10 @@ iNES_HEADER head;
 
 static CartInfo iNESCart;
 
+// the file mapping ROM and VROM point into, if they aren't allocated
+static uint8 *romImage = NULL;
+static uint32 romImageSize = 0;
+
 uint8 Mirroring = 0;
 uint32 ROM_size = 0;
 uint32 VROM_size = 0;
@@ -69,6 +76,24 @@ static DECLFR(TrainerRead) {
 	return(trainerpoo[A & 0x1FF]);
 }
 
+// true if p points into the mapped file rather than at memory of its own
+static bool InROMImage(const uint8 *p) {
+	return romImage && p >= romImage && p < romImage + romImageSize;
+}
+
+static void FreeROMImage(void) {
+	// CHR-RAM is allocated even when the file is mapped
+	if (ROM && !InROMImage(ROM)) free(ROM);
+	if (VROM && !InROMImage(VROM)) free(VROM);
+	if (romImage) {
+		FCEU_UnmapFile(romImage, romImageSize);
+		romImage = NULL;
+		romImageSize = 0;
+	}
+	ROM = NULL;
+	VROM = NULL;
+}
+
 static void iNES_ExecPower() {
 	if (CHRRAMSize != -1)
 		FCEU_MemoryRand(VROM, CHRRAMSize);
@@ -106,14 +131,7 @@ void iNESGI(GI h) { //bbit edited: removed static keyword
 		FCEU_SaveGameSave(&iNESCart);
 		if (iNESCart.Close)
 			iNESCart.Close();
-		if (ROM) {
-			free(ROM);
-			ROM = NULL;
-		}
-		if (VROM) {
-			free(VROM);
-			VROM = NULL;
-		}
+		FreeROMImage();
 		if (trainerpoo) {
 			free(trainerpoo);
 			trainerpoo = NULL;
@@ -141,6 +159,38 @@ struct INPSEL {
 	ESIFC inputfc;
 };
 
+// Sorted view of one of the game and mapper tables, built on first use, so a
+// lookup is a binary search instead of a walk over the table. find() returns
+// the first entry with the key, the one the walk would have stopped at.
+template<typename T, typename K>
+class TableIndex {
+public:
+	TableIndex(const T *table, int count, K (*key)(const T &)) : key(key) {
+		for (int i = 0; i < count; i++)
+			order.push_back(&table[i]);
+		std::stable_sort(order.begin(), order.end(), [key](const T *a, const T *b) { return key(*a) < key(*b); });
+	}
+
+	const T *find(K k) const {
+		typename std::vector<const T *>::const_iterator it = std::lower_bound(order.begin(), order.end(), k,
+			[this](const T *a, K k) { return key(*a) < k; });
+		return (it != order.end() && key(**it) == k) ? *it : NULL;
+	}
+
+private:
+	std::vector<const T *> order;
+	K (*key)(const T &);
+};
+
+// the table ends with an entry that sets no input
+static int InputTableSize(const INPSEL *moo) {
+	int x = 0;
+
+	while (moo[x].input1 >= 0 || moo[x].input2 >= 0 || moo[x].inputfc >= 0)
+		x++;
+	return x;
+}
+
 static void SetInput(void) {
 	static struct INPSEL moo[] =
 	{
@@ -214,16 +264,13 @@ static void SetInput(void) {
 		{0x67b126b9,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FAMINETSYS },	// Famicom Network System
 		{0x00000000,	SI_UNSET,		SI_UNSET,		SIFC_UNSET		}
 	};
-	int x = 0;
+	static const TableIndex<INPSEL, uint32> index(moo, InputTableSize(moo), [](const INPSEL &e) { return e.crc32; });
+	const INPSEL *sel = index.find(iNESGameCRC32);
 
-	while (moo[x].input1 >= 0 || moo[x].input2 >= 0 || moo[x].inputfc >= 0) {
-		if (moo[x].crc32 == iNESGameCRC32) {
-			GameInfo->input[0] = moo[x].input1;
-			GameInfo->input[1] = moo[x].input2;
-			GameInfo->inputfc = moo[x].inputfc;
-			break;
-		}
-		x++;
+	if (sel) {
+		GameInfo->input[0] = sel->input1;
+		GameInfo->input[1] = sel->input2;
+		GameInfo->inputfc = sel->inputfc;
 	}
 }
 
@@ -243,14 +290,11 @@ static struct BADINF BadROMImages[] =
 };
 
 void CheckBad(uint64 md5partial) {
-	int32 x = 0;
-	while (BadROMImages[x].name) {
-		if (BadROMImages[x].md5partial == md5partial) {
-			FCEU_PrintError("The copy game you have loaded, \"%s\", is bad, and will not work properly in FCEUX.", BadROMImages[x].name);
-			return;
-		}
-		x++;
-	}
+	static const TableIndex<BADINF, uint64> index(BadROMImages, ARRAY_SIZE(BadROMImages) - 1, [](const BADINF &e) { return e.md5partial; });
+	const BADINF *bad = index.find(md5partial);
+
+	if (bad)
+		FCEU_PrintError("The copy game you have loaded, \"%s\", is bad, and will not work properly in FCEUX.", bad->name);
 }
 
 
@@ -261,6 +305,16 @@ struct CHINF {
 	const char* params;
 };
 
+// the table ends with an entry that fixes neither
+static int FixTableSize(const CHINF *moo) {
+	int x = 0;
+
+	do
+		x++;
+	while (moo[x].mirror >= 0 || moo[x].mapper >= 0);
+	return x;
+}
+
 static const TMasterRomInfo sMasterRomInfo[] = {
 	{ 0x62b51b108a01d2beULL, "bonus=0" }, //4-in-1 (FK23C8021)[p1][!].nes
 	{ 0x8bb48490d8d22711ULL, "bonus=0" }, //4-in-1 (FK23C8033)[p1][!].nes
@@ -324,6 +378,9 @@ static void CheckHInfo(void) {
 	{
 		#include "ines-correct.h"
 	};
+	static const TableIndex<CHINF, uint32> index(moo, FixTableSize(moo), [](const CHINF &e) { return e.crc32; });
+	static const TableIndex<uint64, uint64> savieIndex(savie, ARRAY_SIZE(savie) - 1, [](const uint64 &e) { return e; });
+	const CHINF *fix = index.find(iNESGameCRC32);
 	int32 tofix = 0, x, mask;
 	uint64 partialmd5 = 0;
 
@@ -348,55 +405,47 @@ static void CheckHInfo(void) {
 		break;
 	}
 
-	x = 0;
-	do {
-		if (moo[x].crc32 == iNESGameCRC32) {
-			if (moo[x].mapper >= 0) {
-				if (moo[x].mapper & 0x800 && VROM_size) {
-					VROM_size = 0;
+	if (fix) {
+		if (fix->mapper >= 0) {
+			if (fix->mapper & 0x800 && VROM_size) {
+				VROM_size = 0;
+				if (!InROMImage(VROM))
 					free(VROM);
-					VROM = NULL;
-					tofix |= 8;
-				}
-				if (moo[x].mapper & 0x1000)
-					mask = 0xFFF;
-				else
-					mask = 0xFF;
-				if (MapperNo != (moo[x].mapper & mask)) {
-					tofix |= 1;
-					MapperNo = moo[x].mapper & mask;
-				}
+				VROM = NULL;
+				tofix |= 8;
 			}
-			if (moo[x].mirror >= 0) {
-				if (moo[x].mirror == 8) {
-					if (Mirroring == 2) {	/* Anything but hard-wired(four screen). */
-						tofix |= 2;
-						Mirroring = 0;
-					}
-				} else if (Mirroring != moo[x].mirror) {
-					if (Mirroring != (moo[x].mirror & ~4))
-						if ((moo[x].mirror & ~4) <= 2)	/* Don't complain if one-screen mirroring
-														needs to be set(the iNES header can't
-														hold this information).
-														*/
-							tofix |= 2;
-					Mirroring = moo[x].mirror;
-				}
+			if (fix->mapper & 0x1000)
+				mask = 0xFFF;
+			else
+				mask = 0xFF;
+			if (MapperNo != (fix->mapper & mask)) {
+				tofix |= 1;
+				MapperNo = fix->mapper & mask;
 			}
-			break;
 		}
-		x++;
-	} while (moo[x].mirror >= 0 || moo[x].mapper >= 0);
-
-	x = 0;
-	while (savie[x] != 0) {
-		if (savie[x] == partialmd5) {
-			if (!(head.ROM_type & 2)) {
-				tofix |= 4;
-				head.ROM_type |= 2;
+		if (fix->mirror >= 0) {
+			if (fix->mirror == 8) {
+				if (Mirroring == 2) {	/* Anything but hard-wired(four screen). */
+					tofix |= 2;
+					Mirroring = 0;
+				}
+			} else if (Mirroring != fix->mirror) {
+				if (Mirroring != (fix->mirror & ~4))
+					if ((fix->mirror & ~4) <= 2)	/* Don't complain if one-screen mirroring
+													needs to be set(the iNES header can't
+													hold this information).
+													*/
+						tofix |= 2;
+				Mirroring = fix->mirror;
 			}
 		}
-		x++;
+	}
+
+	if (savieIndex.find(partialmd5)) {
+		if (!(head.ROM_type & 2)) {
+			tofix |= 4;
+			head.ROM_type |= 2;
+		}
 	}
 
 	/* Games that use these iNES mappers tend to have the four-screen bit set
@@ -733,6 +782,12 @@ BMAPPINGLocal bmap[] = {
 	{"",					0, NULL}
 };
 
+static const BMAPPINGLocal *FindMapper(int num) {
+	static const TableIndex<BMAPPINGLocal, int32> index(bmap, ARRAY_SIZE(bmap) - 1, [](const BMAPPINGLocal &e) { return e.number; });
+
+	return index.find(num);
+}
+
 int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 	struct md5_context md5;
 
@@ -771,7 +826,8 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 	else
 		ROM_size = uppow2(not_round_size);
 
-	VROM_size = uppow2(head.VROM_size | (iNES2?((head.Upper_ROM_VROM_size & 0xF0)<<4):0));
+	int not_round_vsize = head.VROM_size | (iNES2?((head.Upper_ROM_VROM_size & 0xF0)<<4):0);
+	VROM_size = uppow2(not_round_vsize);
 
 	int round = true;
 	for (int i = 0; i != sizeof(not_power2) / sizeof(not_power2[0]); ++i) {
@@ -786,18 +842,38 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 		}
 	}
 
-	if ((ROM = (uint8*)FCEU_malloc(ROM_size << 14)) == NULL)
-		return 0;
-	memset(ROM, 0xFF, ROM_size << 14);
-
-	if (VROM_size) {
-		if ((VROM = (uint8*)FCEU_malloc(VROM_size << 13)) == NULL) {
-			free(ROM);
-			ROM = NULL;
-			FCEU_PrintError("Unable to allocate memory.");
-			return LOADER_HANDLED_ERROR;
+	// When PRG and CHR are in the file as they're used, they're mapped from it instead of
+	// copied. The pages stay shared with the page cache and every other instance running
+	// the ROM until something (a flash mapper, the hex editor) writes to them.
+	uint32 trainerSize = (head.ROM_type & 4) ? 512 : 0;
+	uint32 imageSize = 16 + trainerSize + (ROM_size << 14) + (VROM_size << 13);
+
+	if (FSettings.MapRomImages && ROM_size && (int)ROM_size == not_round_size
+		&& (int)VROM_size == not_round_vsize && FCEU_fgetsize(fp) >= imageSize) {
+		romImage = FCEU_fmap(fp, &romImageSize);
+		if (romImage && romImageSize < imageSize) {
+			FCEU_UnmapFile(romImage, romImageSize);
+			romImage = NULL;
+		}
+	}
+
+	if (romImage) {
+		ROM = romImage + 16 + trainerSize;
+		VROM = VROM_size ? ROM + (ROM_size << 14) : NULL;
+	} else {
+		if ((ROM = (uint8*)FCEU_malloc(ROM_size << 14)) == NULL)
+			return 0;
+		memset(ROM, 0xFF, ROM_size << 14);
+
+		if (VROM_size) {
+			if ((VROM = (uint8*)FCEU_malloc(VROM_size << 13)) == NULL) {
+				free(ROM);
+				ROM = NULL;
+				FCEU_PrintError("Unable to allocate memory.");
+				return LOADER_HANDLED_ERROR;
+			}
+			memset(VROM, 0xFF, VROM_size << 13);
 		}
-		memset(VROM, 0xFF, VROM_size << 13);
 	}
 
 	if (head.ROM_type & 4) {	/* Trainer */
@@ -810,21 +886,29 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 
 	SetupCartPRGMapping(0, ROM, ROM_size << 14, 0);
 
-	FCEU_fread(ROM, 0x4000, (round) ? ROM_size : not_round_size, fp);
+	if (!romImage) {
+		FCEU_fread(ROM, 0x4000, (round) ? ROM_size : not_round_size, fp);
 
-	if (VROM_size)
-		FCEU_fread(VROM, 0x2000, VROM_size, fp);
+		if (VROM_size)
+			FCEU_fread(VROM, 0x2000, VROM_size, fp);
+	}
 
-	md5_starts(&md5);
-	md5_update(&md5, ROM, ROM_size << 14);
+	if (romCacheCurrent && romCacheCurrent->format == ROMCACHE_INES) {
+		// the same file was hashed when it was cached
+		memcpy(iNESCart.MD5, romCacheCurrent->md5, sizeof(iNESCart.MD5));
+		iNESGameCRC32 = romCacheCurrent->romcrc32;
+	} else {
+		md5_starts(&md5);
+		md5_update(&md5, ROM, ROM_size << 14);
 
-	iNESGameCRC32 = CalcCRC32(0, ROM, ROM_size << 14);
+		iNESGameCRC32 = CalcCRC32(0, ROM, ROM_size << 14);
 
-	if (VROM_size) {
-		iNESGameCRC32 = CalcCRC32(iNESGameCRC32, VROM, VROM_size << 13);
-		md5_update(&md5, VROM, VROM_size << 13);
+		if (VROM_size) {
+			iNESGameCRC32 = CalcCRC32(iNESGameCRC32, VROM, VROM_size << 13);
+			md5_update(&md5, VROM, VROM_size << 13);
+		}
+		md5_finish(&md5, iNESCart.MD5);
 	}
-	md5_finish(&md5, iNESCart.MD5);
 	memcpy(&GameInfo->MD5, &iNESCart.MD5, sizeof(iNESCart.MD5));
 
 	iNESCart.CRC32 = iNESGameCRC32;
@@ -841,13 +925,10 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 	}
 
 	const char* mappername = "Not Listed";
+	const BMAPPINGLocal *mapper = FindMapper(MapperNo);
 
-	for (int mappertest = 0; mappertest < (sizeof bmap / sizeof bmap[0]) - 1; mappertest++) {
-		if (bmap[mappertest].number == MapperNo) {
-			mappername = bmap[mappertest].name;
-			break;
-		}
-	}
+	if (mapper)
+		mappername = mapper->name;
 
 	FCEU_printf(" Mapper #:  %d\n", MapperNo);
 	FCEU_printf(" Mapper name: %s\n", mappername);
@@ -908,12 +989,9 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 		FCEU_PrintError("Unable to allocate CHR-RAM.");
 		break;
 	}
-	if (ROM) free(ROM);
-	if (VROM) free(VROM);
+	FreeROMImage();
 	if (trainerpoo) free(trainerpoo);
 	if (ExtraNTARAM) free(ExtraNTARAM);
-	ROM = NULL;
-	VROM = NULL;
 	trainerpoo = NULL;
 	ExtraNTARAM = NULL;
 	return LOADER_HANDLED_ERROR;
@@ -975,6 +1053,12 @@ int iNesSaveAs(const char* name)
 	if (GameInfo->type != GIT_CART) return 0;
 	if (GameInterface != iNESGI) return 0;
 
+	// ROM and VROM may be mapped from the very file being overwritten
+	if (romImage && !FCEU_UnshareMapping(romImage, romImageSize)) {
+		FCEU_PrintError("Unable to save the ROM while it's mapped from its file.");
+		return 0;
+	}
+
 	fp = fopen(name, "wb");
 	if (!fp)
 		return 0;
@@ -1013,60 +1097,57 @@ char *iNesShortFName(void) {
 }
 
 static int iNES_Init(int num) {
-	BMAPPINGLocal *tmp = bmap;
+	const BMAPPINGLocal *tmp = FindMapper(num);
 
 	CHRRAMSize = -1;
 
 	if (GameInfo->type == GIT_VSUNI)
 		AddExState(FCEUVSUNI_STATEINFO, ~0, 0, 0);
 
-	while (tmp->init) {
-		if (num == tmp->number) {
-			UNIFchrrama = NULL;	// need here for compatibility with UNIF mapper code
-			if (!VROM_size) {
-				if(!iNESCart.ines2)
-				{
-					switch (num) {	// FIXME, mapper or game data base with the board parameters and ROM/RAM sizes
-					case 13:  CHRRAMSize = 16 * 1024; break;
-					case 6:
-					case 29:
-					case 30:
-					case 45:
-					case 96:  CHRRAMSize = 32 * 1024; break;
-					case 176: CHRRAMSize = 128 * 1024; break;
-					default:  CHRRAMSize = 8 * 1024; break;
-					}
-					iNESCart.vram_size = CHRRAMSize;
-				}
-				else
-				{
-					CHRRAMSize = iNESCart.battery_vram_size + iNESCart.vram_size;
-				}
-				if (CHRRAMSize > 0)
-				{
-					int mCHRRAMSize = (CHRRAMSize < 1024) ? 1024 : CHRRAMSize; // VPage has a resolution of 1k banks, ensure minimum allocation to prevent malicious access from NES software
-					if ((UNIFchrrama = VROM = (uint8*)FCEU_dmalloc(mCHRRAMSize)) == NULL) return 2;
-					FCEU_MemoryRand(VROM, CHRRAMSize);
-					SetupCartCHRMapping(0, VROM, CHRRAMSize, 1);
-					AddExState(VROM, CHRRAMSize, 0, "CHRR");
-				}
-				else {
-					// mapper 256 (OneBus) has not CHR-RAM _and_ has not CHR-ROM region in iNES file
-					// so zero-sized CHR should be supported at least for this mapper
-					VROM = NULL;
-				}
-			}
-			if (head.ROM_type & 8)
-			{
-				if (ExtraNTARAM != NULL)
-				{
-					AddExState(ExtraNTARAM, 2048, 0, "EXNR");
-				}
+	if (!tmp || !tmp->init)
+		return 1;
+
+	UNIFchrrama = NULL;	// need here for compatibility with UNIF mapper code
+	if (!VROM_size) {
+		if(!iNESCart.ines2)
+		{
+			switch (num) {	// FIXME, mapper or game data base with the board parameters and ROM/RAM sizes
+			case 13:  CHRRAMSize = 16 * 1024; break;
+			case 6:
+			case 29:
+			case 30:
+			case 45:
+			case 96:  CHRRAMSize = 32 * 1024; break;
+			case 176: CHRRAMSize = 128 * 1024; break;
+			default:  CHRRAMSize = 8 * 1024; break;
 			}
-			tmp->init(&iNESCart);
-			return 0;
+			iNESCart.vram_size = CHRRAMSize;
+		}
+		else
+		{
+			CHRRAMSize = iNESCart.battery_vram_size + iNESCart.vram_size;
+		}
+		if (CHRRAMSize > 0)
+		{
+			int mCHRRAMSize = (CHRRAMSize < 1024) ? 1024 : CHRRAMSize; // VPage has a resolution of 1k banks, ensure minimum allocation to prevent malicious access from NES software
+			if ((UNIFchrrama = VROM = (uint8*)FCEU_dmalloc(mCHRRAMSize)) == NULL) return 2;
+			FCEU_MemoryRand(VROM, CHRRAMSize);
+			SetupCartCHRMapping(0, VROM, CHRRAMSize, 1);
+			AddExState(VROM, CHRRAMSize, 0, "CHRR");
+		}
+		else {
+			// mapper 256 (OneBus) has not CHR-RAM _and_ has not CHR-ROM region in iNES file
+			// so zero-sized CHR should be supported at least for this mapper
+			VROM = NULL;
 		}
-		tmp++;
 	}
-	return 1;
+	if (head.ROM_type & 8)
+	{
+		if (ExtraNTARAM != NULL)
+		{
+			AddExState(ExtraNTARAM, 2048, 0, "EXNR");
+		}
+	}
+	tmp->init(&iNESCart);
+	return 0;
 }
@@ -25,6 +25,7 @@
 #include "fceu.h"
 #include "sound.h"
 #include "netplay.h"
+#include "rollback.h"
 #include "movie.h"
 #include "state.h"
 #include "input/zapper.h"
@@ -36,6 +37,8 @@
 #include "fds.h"
 #include "driver.h"
 
+#include <atomic>
+
 #ifdef WIN32
 #include "drivers/win/main.h"
 #include "drivers/win/memwatch.h"
@@ -97,6 +100,12 @@ uint16 snesjoy[4]={0,0,0,0}; //HACK - should be static but movie needs it
 static uint8 LastStrobe;
 uint8 RawReg4016 = 0; // Joystick strobe (W)
 
+//late latching, see FCEUI_SetLateLatch()
+static bool lateLatch = false;
+static std::atomic<bool> latchedValid(false);
+static std::atomic<uint32> latchedPads(0);
+static int32 firstStrobe = -1; //cpu cycles into the frame of its first strobe, -1 if none yet
+
 bool replaceP2StartWithMicrophone = false;
 
 //This function is a quick hack to get the NSF player to use emulated gamepad input.
@@ -159,6 +168,16 @@ static DECLFR(JPRead)
 	return(ret);
 }
 
+static void SetGP(int w, uint32 pads);
+
+//only while the pads' input doesn't have to be known at the start of the frame
+static bool LateLatching(void)
+{
+	return lateLatch && latchedValid.load(std::memory_order_relaxed)
+		&& FCEUMOV_Mode(MOVIEMODE_INACTIVE) && !FCEUnetplay && !FCEUI_RollbackActive()
+		&& GameInfo && GameInfo->type != GIT_VSUNI;
+}
+
 static DECLFW(B4016)
 {
 	if(portFC.driver)
@@ -178,6 +197,15 @@ static DECLFW(B4016)
 
 		//mbg 6/7/08 - I guess he means that the input drivers could track the strobing themselves
 		//I dont see why it is unreasonable here.
+		if(firstStrobe < 0)
+			firstStrobe = timestamp;
+		if(LateLatching())
+		{
+			uint32 pads = latchedPads.load(std::memory_order_relaxed);
+			for(int i=0;i<2;i++)
+				if(joyports[i].type == SI_GAMEPAD)
+					SetGP(i, pads);
+		}
 		for(int i=0;i<2;i++)
 			joyports[i].driver->Strobe(i);
 		if(portFC.driver)
@@ -232,33 +260,37 @@ static uint8 ReadGPVS(int w)
 	return ret;
 }
 
-static void UpdateGP(int w, void *data, int arg)
+static void SetGP(int w, uint32 pads)
 {
 	if(w==0)	//adelikat, 3/14/09: Changing the joypads to inclusive OR the user's joypad + the Lua joypad, this way lua only takes over the buttons it explicity says to
 	{			//FatRatKnight: Assume lua is always good. If it's doing nothing in particular using my logic, it'll pass-through the values anyway.
 		#ifdef _S9XLUA_H
-		joy[0]= *(uint32 *)joyports[0].ptr;
+		joy[0]= pads;
 		joy[0]= FCEU_LuaReadJoypad(0,joy[0]);
-		joy[2]= *(uint32 *)joyports[0].ptr >> 16;
+		joy[2]= pads >> 16;
 		joy[2]= FCEU_LuaReadJoypad(2,joy[2]);
 		#else // without this, there seems to be no input at all without Lua
-		joy[0] = *(uint32 *)joyports[0].ptr;;
-		joy[2] = *(uint32 *)joyports[0].ptr >> 16;
+		joy[0] = pads;
+		joy[2] = pads >> 16;
 		#endif
 	}
 	else
 	{
 		#ifdef _S9XLUA_H
-		joy[1]= *(uint32 *)joyports[1].ptr >> 8;
+		joy[1]= pads >> 8;
 		joy[1]= FCEU_LuaReadJoypad(1,joy[1]);
-		joy[3]= *(uint32 *)joyports[1].ptr >> 24;
+		joy[3]= pads >> 24;
 		joy[3]= FCEU_LuaReadJoypad(3,joy[3]);
 		#else // same goes for the other two pads
-		joy[1] = *(uint32 *)joyports[1].ptr >> 8;
-		joy[3] = *(uint32 *)joyports[1].ptr >> 24;
+		joy[1] = pads >> 8;
+		joy[3] = pads >> 24;
 		#endif
 	}
+}
 
+static void UpdateGP(int w, void *data, int arg)
+{
+	SetGP(w, *(uint32 *)joyports[w].ptr);
 }
 
 static void LogGP(int w, MovieRecord* mr)
@@ -422,6 +454,8 @@ void FCEU_DrawInput(uint8 *buf)
 
 void FCEU_UpdateInput(void)
 {
+	firstStrobe = -1;
+
 	//tell all drivers to poll input and set up their logical states
 	if(!FCEUMOV_Mode(MOVIEMODE_PLAY))
 	{
@@ -436,6 +470,8 @@ void FCEU_UpdateInput(void)
 
 	if(FCEUnetplay)
 		NetplayUpdate(joy);
+	else if(FCEUI_RollbackActive())
+		FCEU_RollbackInput(joy);
 
 	FCEUMOV_AddInputState();
 
@@ -662,6 +698,30 @@ SFORMAT FCEUCTRL_STATEINFO[]={
 	{ 0 }
 };
 
+int32 FCEU_InputFirstStrobe(void)
+{
+	return firstStrobe;
+}
+
+//Late latching: the gamepads' buttons are taken when the game strobes $4016 instead
+//of at the start of the frame, which is up to a frame before. The driver passes the
+//latest state of the pads to FCEUI_LatchGamepads() whenever it polls them, from any thread.
+void FCEUI_SetLateLatch(bool enable)
+{
+	lateLatch = enable;
+}
+
+bool FCEUI_GetLateLatch(void)
+{
+	return lateLatch;
+}
+
+void FCEUI_LatchGamepads(uint32 pads)
+{
+	latchedPads.store(pads, std::memory_order_relaxed);
+	latchedValid.store(true, std::memory_order_relaxed);
+}
+
 void FCEU_DoSimpleCommand(int cmd)
 {
 	switch(cmd)
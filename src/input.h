@@ -98,6 +98,8 @@ extern struct FCPORT
 
 void FCEU_DrawInput(uint8 *buf);
 void FCEU_UpdateInput(void);
+//cpu cycles into the frame the game first strobed the pads at, -1 if it hasn't yet
+int32 FCEU_InputFirstStrobe(void);
 void InitializeInput(void);
 void FCEU_UpdateBot(void);
 extern void (*PStrobe[2])(void);
@@ -0,0 +1,179 @@
+/// \file
+/// \brief Measures a game's input lag in frames by running ahead with savestates
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "emufile.h"
+#include "git.h"
+#include "input.h"
+#include "movie.h"
+#include "netplay.h"
+#include "state.h"
+#include "utils/crc32.h"
+
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+#define INPUTLAG_MAX_FRAMES  15	// frames waited for the picture to react to a button
+#define INPUTLAG_SPACING     7	// frames run between two samples
+
+extern uint8 *XBackBuf;
+
+// stands in for the driver's gamepad state while measuring
+static uint32 measurePads;
+
+// The picture before the HUD, messages and Lua drawings go on it.
+static uint32 RunFrame(uint32 pads)
+{
+	uint8 *gfx;
+	int32 *sound;
+	int32 ssize;
+
+	measurePads = pads;
+	FCEUI_Emulate(&gfx, &sound, &ssize, 0);
+	return CalcCRC32(0, XBackBuf, 256 * 240);
+}
+
+static bool LoadSample(EMUFILE_MEMORY &ms)
+{
+	ms.fseek(0, SEEK_SET);
+	return FCEUSS_LoadFP(&ms, SSLOADPARAM_NOBACKUP);
+}
+
+// Frames from pressing a button until the picture differs from the one without,
+// 1 if the frame the button is pressed at already shows it. Every button is tried
+// as games ignore some of them at times, the earliest reaction counts. 0 if there
+// was none in INPUTLAG_MAX_FRAMES.
+static int MeasureSample(EMUFILE_MEMORY &ms, int32 *strobe)
+{
+	uint32 idle[INPUTLAG_MAX_FRAMES];
+	int best = 0;
+
+	*strobe = -1;
+	for (int f = 0; f < INPUTLAG_MAX_FRAMES; f++)
+	{
+		idle[f] = RunFrame(0);
+		if (*strobe < 0)
+			*strobe = FCEU_InputFirstStrobe();
+	}
+
+	for (int b = 0; b < 8 && best != 1; b++)
+	{
+		if (!LoadSample(ms))
+			return -1;
+		for (int f = 0; f < INPUTLAG_MAX_FRAMES && (!best || f + 1 < best); f++)
+		{
+			if (RunFrame(1 << b) != idle[f])
+			{
+				best = f + 1;
+				break;
+			}
+		}
+	}
+	return best;
+}
+
+bool FCEUI_MeasureInputLag(int samples)
+{
+	if (!GameInfo || GameInfo->type == GIT_NSF)
+	{
+		FCEU_printf("Measuring the input lag needs a game.\n");
+		return false;
+	}
+	if (!FCEUMOV_Mode(MOVIEMODE_INACTIVE) || FCEUnetplay || FCEUI_RollbackActive()
+		|| FCEUI_AviIsRecording() || FCEUI_CaptureIsRecording())
+	{
+		FCEU_printf("Can't measure the input lag during a movie, netplay or recording.\n");
+		return false;
+	}
+	if (joyports[0].type != SI_GAMEPAD)
+	{
+		FCEU_printf("Measuring the input lag needs a gamepad in port 1.\n");
+		return false;
+	}
+
+	EMUFILE_MEMORY start, ms;
+	int counter = currFrameCounter;
+	int paused = EmulationPaused;
+	bool latch = FCEUI_GetLateLatch();
+	void *pads = joyports[0].ptr;
+
+	FCEUSS_SaveMS(&start, Z_NO_COMPRESSION);
+	joyports[0].ptr = &measurePads;
+	EmulationPaused = 0;
+	FCEUI_SetLateLatch(false);
+
+	int hist[INPUTLAG_MAX_FRAMES + 1] = { 0 };
+	int measured = 0, total = 0, minLag = INPUTLAG_MAX_FRAMES, maxLag = 0;
+	int strobes = 0;
+	double strobeSum = 0;
+	bool ok = true;
+
+	for (int s = 0; s < samples && ok; s++)
+	{
+		int32 strobe;
+		int lag;
+
+		ms.set_len(0);
+		ms.unfail();
+		FCEUSS_SaveMS(&ms, Z_NO_COMPRESSION);
+
+		lag = MeasureSample(ms, &strobe);
+		if (lag < 0 || !LoadSample(ms))
+		{
+			ok = false;
+			break;
+		}
+		hist[lag]++;
+		if (lag)
+		{
+			measured++;
+			total += lag;
+			minLag = std::min(minLag, lag);
+			maxLag = std::max(maxLag, lag);
+		}
+		if (strobe >= 0)
+		{
+			strobes++;
+			strobeSum += strobe;
+		}
+
+		for (int f = 0; f < INPUTLAG_SPACING; f++)
+			RunFrame(0);
+	}
+
+	joyports[0].ptr = pads;
+	ok = LoadSample(start) && ok;
+	FCEUI_SetLateLatch(latch);
+	EmulationPaused = paused;
+	currFrameCounter = counter;
+
+	if (!ok)
+	{
+		FCEU_printf("Measuring the input lag failed, a savestate couldn't be loaded.\n");
+		return false;
+	}
+
+	FCEU_printf("Input lag over %d samples, in frames until the picture changes:\n", samples);
+	if (measured)
+		FCEU_printf("  min %d, avg %.2f, max %d\n", minLag, (double)total / measured, maxLag);
+	for (int i = 1; i <= INPUTLAG_MAX_FRAMES; i++)
+		if (hist[i])
+			FCEU_printf("  %2d frames: %d\n", i, hist[i]);
+	if (hist[0])
+		FCEU_printf("  no reaction within %d frames: %d\n", INPUTLAG_MAX_FRAMES, hist[0]);
+
+	// how much of a frame late latching can take off
+	if (strobes)
+	{
+		double cycles = dendy ? 35464.0 : PAL ? 33247.5 : 29780.5;
+		double at = strobeSum / strobes;
+
+		FCEU_printf("The game reads the pads %.0f cycles (%.0f%% of a frame) after the frame starts.\n",
+			at, 100.0 * at / cycles);
+	}
+	else
+		FCEU_printf("The game never read the pads.\n");
+	return true;
+}
@@ -0,0 +1,239 @@
+/// \file
+/// \brief Lock free memory snapshot channel used by the debugger views
+#include "types.h"
+#include "fceu.h"
+#include "cart.h"
+#include "ppu.h"
+#include "debug.h"
+#include "movie.h"
+#include "memsnap.h"
+
+#include <atomic>
+#include <cstring>
+
+// Triple buffer: the emulation thread fills the back buffer and swaps it with
+// the middle one, the GUI thread swaps the middle one with its front buffer
+// whenever the fresh flag says a new snapshot is waiting there.
+#define SNAP_INDEX_MASK  0x03
+#define SNAP_FRESH       0x04
+
+static FCEUMemSnapshot snapBuf[3];
+
+static int backIdx  = 0;  // owned by the emulation thread
+static int frontIdx = 1;  // owned by the GUI thread
+static int lastIdx  = -1; // last published, the writer never fills this one next
+static std::atomic<int> midState(2);
+
+static std::atomic<int>  subscribers(0);
+static std::atomic<bool> updateRequested(false);
+static uint32 snapVersion = 0;
+
+#define ROM_GEN_SLOTS  0x4000
+
+static std::atomic<uint32> romWriteGen(0);
+static std::atomic<uint32> romPageGen[ROM_GEN_SLOTS];
+
+static bool plainRead(uint32 A)
+{
+	return ((ARead[A] == CartBR) || (ARead[A] == CartBROB)) && Page[A >> 11];
+}
+
+static void fillCPU(FCEUMemSnapshot *s)
+{
+	uint32 A;
+
+	for (A = 0; A < 0x2000; A += 0x800)
+	{
+		memcpy(&s->cpu[A], RAM, 0x800);
+	}
+
+	// the PPU registers are mirrored every 8 bytes
+	for (A = 0x2000; A < 0x2008; A++)
+	{
+		s->cpu[A] = GetMem(A);
+	}
+	for (A = 0x2008; A < 0x4000; A += 8)
+	{
+		memcpy(&s->cpu[A], &s->cpu[0x2000], 8);
+	}
+
+	for (A = 0x4000; A < 0x4018; A++)
+	{
+		s->cpu[A] = GetMem(A);
+	}
+	memset(&s->cpu[0x4018], 0xFF, 0x5000 - 0x4018);
+
+	// Plain cartridge space is copied from the page tables a run at a time,
+	// anything with a custom handler (registers, cheats, mapper hooks) goes
+	// through the side effect free debug read.
+	A = 0x5000;
+	while (A < 0x10000)
+	{
+		if (plainRead(A))
+		{
+			uint32 end = (A | 0x7FF) + 1;
+			uint32 run = A + 1;
+
+			while ((run < end) && plainRead(run))
+			{
+				run++;
+			}
+			memcpy(&s->cpu[A], &Page[A >> 11][A], run - A);
+			A = run;
+		}
+		else
+		{
+			s->cpu[A] = GetMem(A);
+			A++;
+		}
+	}
+}
+
+static void fillPPU(FCEUMemSnapshot *s)
+{
+	uint32 A;
+
+	for (A = 0; A < 0x2000; A += 0x400)
+	{
+		if (VPage[A >> 10])
+		{
+			memcpy(&s->ppu[A], &VPage[A >> 10][A], 0x400);
+		}
+		else
+		{
+			memset(&s->ppu[A], 0, 0x400);
+		}
+	}
+
+	if (s->isNSF)
+	{
+		memset(&s->ppu[0x2000], 0, 0x2000);
+		return;
+	}
+
+	for (A = 0x2000; A < 0x3F00; A += 0x400)
+	{
+		uint8 *nt = vnapage[(A >> 10) & 0x3];
+		uint32 len = (A == 0x3C00) ? 0x300 : 0x400;
+
+		if (nt)
+		{
+			memcpy(&s->ppu[A], nt, len);
+		}
+		else
+		{
+			memset(&s->ppu[A], 0, len);
+		}
+	}
+
+	for (A = 0x3F00; A < 0x4000; A++)
+	{
+		s->ppu[A] = READPAL_MOTHEROFALL(A & 0x1F);
+	}
+}
+
+static void updatePageVersions(const uint8 *cur, const uint8 *prev, uint32 *ver, const uint32 *prevVer, uint32 size)
+{
+	for (uint32 p = 0; p < (size >> MEMSNAP_PAGE_SHIFT); p++)
+	{
+		uint32 ofs = p << MEMSNAP_PAGE_SHIFT;
+
+		if ((prev == NULL) || memcmp(&cur[ofs], &prev[ofs], MEMSNAP_PAGE_SIZE))
+		{
+			ver[p] = snapVersion;
+		}
+		else
+		{
+			ver[p] = prevVer[p];
+		}
+	}
+}
+
+void FCEUI_MemSnapshotPublish(void)
+{
+	const FCEUMemSnapshot *prev = (lastIdx >= 0) ? &snapBuf[lastIdx] : NULL;
+
+	FCEUMemSnapshot *s = &snapBuf[backIdx];
+
+	s->valid = (GameInfo != NULL);
+	s->isNSF = s->valid && (GameInfo->type == GIT_NSF);
+	s->frame = currFrameCounter;
+
+	if (s->valid)
+	{
+		fillCPU(s);
+		fillPPU(s);
+		memcpy(s->oam, SPRAM, sizeof(s->oam));
+	}
+	else
+	{
+		memset(s->cpu, 0, sizeof(s->cpu));
+		memset(s->ppu, 0, sizeof(s->ppu));
+		memset(s->oam, 0, sizeof(s->oam));
+	}
+	s->version = ++snapVersion;
+
+	updatePageVersions(s->cpu, prev ? prev->cpu : NULL, s->cpuPageVer, prev ? prev->cpuPageVer : NULL, sizeof(s->cpu));
+	updatePageVersions(s->ppu, prev ? prev->ppu : NULL, s->ppuPageVer, prev ? prev->ppuPageVer : NULL, sizeof(s->ppu));
+	updatePageVersions(s->oam, prev ? prev->oam : NULL, &s->oamPageVer, prev ? &prev->oamPageVer : NULL, sizeof(s->oam));
+
+	lastIdx = backIdx;
+	backIdx = midState.exchange(backIdx | SNAP_FRESH) & SNAP_INDEX_MASK;
+}
+
+void FCEU_MemSnapshotUpdate(bool newFrame)
+{
+	if (subscribers.load() <= 0)
+	{
+		return;
+	}
+	if (updateRequested.exchange(false) || newFrame)
+	{
+		FCEUI_MemSnapshotPublish();
+	}
+}
+
+void FCEUI_MemSnapshotSubscribe(void)
+{
+	subscribers++;
+	updateRequested = true;
+}
+
+void FCEUI_MemSnapshotUnsubscribe(void)
+{
+	subscribers--;
+}
+
+void FCEUI_MemSnapshotRequestUpdate(void)
+{
+	updateRequested = true;
+}
+
+const FCEUMemSnapshot *FCEUI_MemSnapshotAcquire(void)
+{
+	if (midState.load() & SNAP_FRESH)
+	{
+		frontIdx = midState.exchange(frontIdx) & SNAP_INDEX_MASK;
+	}
+	return &snapBuf[frontIdx];
+}
+
+void FCEU_MemNoteRomWrite(uint32 offset)
+{
+	// Writers are serialized by the emulator, the page is stamped before the
+	// global generation so a reader seeing the new generation finds the page.
+	uint32 gen = romWriteGen.load() + 1;
+
+	romPageGen[(offset >> MEMSNAP_PAGE_SHIFT) & (ROM_GEN_SLOTS - 1)] = gen;
+	romWriteGen = gen;
+}
+
+uint32 FCEUI_MemRomWriteGen(void)
+{
+	return romWriteGen.load();
+}
+
+uint32 FCEUI_MemRomPageGen(uint32 offset)
+{
+	return romPageGen[(offset >> MEMSNAP_PAGE_SHIFT) & (ROM_GEN_SLOTS - 1)].load();
+}
@@ -0,0 +1,65 @@
+#ifndef _MEMSNAP_H_
+#define _MEMSNAP_H_
+
+// Memory snapshot channel for the debugger views.
+//
+// While at least one viewer is subscribed, the emulation thread copies the
+// CPU address space, PPU address space (mapped CHR banks, name tables and
+// palette) and sprite RAM into a triple buffer at the end of every frame.
+// The GUI thread reads the most recently published copy without taking the
+// emulator mutex. There must only be one consuming thread (the GUI thread);
+// all viewers living on it share the same front buffer.
+//
+// Every snapshot also records, per 256 byte page, the version of the snapshot
+// in which that page last changed so viewers can limit their refresh to the
+// pages that were written since they last looked.
+
+#define MEMSNAP_PAGE_SHIFT  8
+#define MEMSNAP_PAGE_SIZE   (1 << MEMSNAP_PAGE_SHIFT)
+
+struct FCEUMemSnapshot
+{
+	uint32 version;       // incremented every time a snapshot is published
+	int32  frame;         // currFrameCounter at the time of publishing
+	bool   valid;         // false if no game was loaded
+	bool   isNSF;         // PPU name tables and palette are not meaningful
+
+	uint8  cpu[0x10000];  // CPU address space as seen by debug reads (GetMem)
+	uint8  ppu[0x4000];   // PPU address space
+	uint8  oam[0x100];    // sprite RAM
+
+	uint32 cpuPageVer[0x10000 >> MEMSNAP_PAGE_SHIFT];
+	uint32 ppuPageVer[0x4000 >> MEMSNAP_PAGE_SHIFT];
+	uint32 oamPageVer;
+};
+
+// Called by the core at the end of every frame (newFrame) and while paused
+// (to service update requests after memory was edited).
+void FCEU_MemSnapshotUpdate(bool newFrame);
+
+// Copy current memory into the channel right away, e.g. when the debugger
+// stops at a breakpoint. Must be called from the emulation thread.
+void FCEUI_MemSnapshotPublish(void);
+
+// Viewers subscribe while they are open so that snapshots are only taken when needed.
+void FCEUI_MemSnapshotSubscribe(void);
+void FCEUI_MemSnapshotUnsubscribe(void);
+
+// Ask for a new snapshot to be published even if emulation is paused.
+void FCEUI_MemSnapshotRequestUpdate(void);
+
+// Latest published snapshot, never NULL. The returned buffer stays untouched by
+// the emulation thread until the next call to this function.
+const FCEUMemSnapshot *FCEUI_MemSnapshotAcquire(void);
+
+// ROM is not part of the snapshot, edits to it are counted instead. Offsets are
+// in iNES file layout (16 byte header, PRG, CHR) like the hex editor ROM view.
+// Pages share counters modulo a fixed table size, so a page may occasionally
+// be reported dirty without having been written, never the other way round.
+void FCEU_MemNoteRomWrite(uint32 offset);
+
+// Generation of the last ROM edit, and of the last edit of the page holding offset.
+uint32 FCEUI_MemRomWriteGen(void);
+uint32 FCEUI_MemRomPageGen(uint32 offset);
+
+#endif
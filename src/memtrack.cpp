@@ -0,0 +1,294 @@
+/// \file
+/// \brief Per frame RAM change tracking used by the RAM search tools
+#include "types.h"
+#include "fceu.h"
+#include "cart.h"
+#include "movie.h"
+#include "memtrack.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define MEMTRACK_SSE2
+#endif
+
+// Tracked memory is kept in one linear index space: internal RAM first,
+// followed by the $6000-$7FFF window.
+#define MEMTRACK_SIZE       (MEMTRACK_RAM_SIZE + MEMTRACK_WRAM_SIZE)
+#define MEMTRACK_NUM_SIZES  3   // byte, word, dword
+
+static bool   trackEnabled = false;
+static bool   snapshotValid = false;
+static uint32 frameStamp = 0;
+
+static uint8  prevMem[MEMTRACK_SIZE];
+static int32  lastChgFrame[MEMTRACK_SIZE];
+static uint32 chgCount[MEMTRACK_NUM_SIZES][MEMTRACK_SIZE];
+static uint32 chgStamp[MEMTRACK_NUM_SIZES][MEMTRACK_SIZE];
+
+static int addrToIndex(uint32 A)
+{
+	if (A < 0x2000)
+	{
+		return A & (MEMTRACK_RAM_SIZE - 1);
+	}
+	if ((A >= MEMTRACK_WRAM_START) && (A < (MEMTRACK_WRAM_START + MEMTRACK_WRAM_SIZE)))
+	{
+		return MEMTRACK_RAM_SIZE + (A - MEMTRACK_WRAM_START);
+	}
+	return -1;
+}
+
+static int sizeToSlot(int size)
+{
+	switch (size)
+	{
+		case 4:  return 2;
+		case 2:  return 1;
+		default: return 0;
+	}
+}
+
+// Index of the multi-byte value starting 'back' bytes before idx. RAM windows wrap
+// around like the mirrored address space does, WRAM windows do not.
+static int windowStart(int idx, int back)
+{
+	if (idx < MEMTRACK_RAM_SIZE)
+	{
+		return (idx - back) & (MEMTRACK_RAM_SIZE - 1);
+	}
+	idx -= back;
+
+	return (idx >= MEMTRACK_RAM_SIZE) ? idx : -1;
+}
+
+static void markChanged(int idx, int32 frame)
+{
+	lastChgFrame[idx] = frame;
+
+	for (int slot = 0; slot < MEMTRACK_NUM_SIZES; slot++)
+	{
+		int len = 1 << slot;
+
+		// A byte change counts once for every value that contains it, but a value
+		// that had several of its bytes change in the same frame only counts once.
+		for (int back = 0; back < len; back++)
+		{
+			int s = windowStart(idx, back);
+
+			if ((s >= 0) && (chgStamp[slot][s] != frameStamp))
+			{
+				chgStamp[slot][s] = frameStamp;
+				chgCount[slot][s]++;
+			}
+		}
+	}
+}
+
+static void diffBlock(const uint8 *cur, int base, int size, int32 frame)
+{
+	uint8 *prev = &prevMem[base];
+	int i = 0;
+
+#ifdef MEMTRACK_SSE2
+	for (; (i + 16) <= size; i += 16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i *)&cur[i]);
+		__m128i b = _mm_loadu_si128((const __m128i *)&prev[i]);
+		unsigned int mask = (~_mm_movemask_epi8(_mm_cmpeq_epi8(a, b))) & 0xFFFF;
+
+		if (mask == 0)
+		{
+			continue;
+		}
+		_mm_storeu_si128((__m128i *)&prev[i], a);
+
+		for (int j = 0; mask; j++, mask >>= 1)
+		{
+			if (mask & 1)
+			{
+				markChanged(base + i + j, frame);
+			}
+		}
+	}
+#else
+	for (; (i + 8) <= size; i += 8)
+	{
+		uint64 a, b;
+
+		memcpy(&a, &cur[i], 8);
+		memcpy(&b, &prev[i], 8);
+
+		if (a == b)
+		{
+			continue;
+		}
+		for (int j = 0; j < 8; j++)
+		{
+			if (cur[i + j] != prev[i + j])
+			{
+				prev[i + j] = cur[i + j];
+				markChanged(base + i + j, frame);
+			}
+		}
+	}
+#endif
+	for (; i < size; i++)
+	{
+		if (cur[i] != prev[i])
+		{
+			prev[i] = cur[i];
+			markChanged(base + i, frame);
+		}
+	}
+}
+
+// Direct pointer to the $6000-$7FFF page containing A. Page[] always points at
+// valid memory (unmapped pages point at a dummy buffer), so reading through it
+// has none of the side effects a bus read could have.
+static const uint8 *wramPagePtr(uint32 A)
+{
+	uint8 *p = Page[A >> 11];
+
+	return p ? &p[A] : NULL;
+}
+
+static void takeSnapshot(void)
+{
+	memcpy(prevMem, RAM, MEMTRACK_RAM_SIZE);
+
+	for (uint32 A = MEMTRACK_WRAM_START; A < (MEMTRACK_WRAM_START + MEMTRACK_WRAM_SIZE); A += 0x800)
+	{
+		const uint8 *p = wramPagePtr(A);
+		uint8 *dst = &prevMem[addrToIndex(A)];
+
+		if (p)
+		{
+			memcpy(dst, p, 0x800);
+		}
+		else
+		{
+			memset(dst, 0, 0x800);
+		}
+	}
+	snapshotValid = true;
+}
+
+void FCEU_MemTrackFrameEnd(void)
+{
+	if (!trackEnabled || (GameInfo == NULL))
+	{
+		return;
+	}
+	if (!snapshotValid)
+	{
+		takeSnapshot();
+		return;
+	}
+	frameStamp++;
+
+	if (frameStamp == 0)
+	{
+		// Stamp wrapped around, make sure no stale stamp can match.
+		memset(chgStamp, 0, sizeof(chgStamp));
+		frameStamp = 1;
+	}
+
+	diffBlock(RAM, 0, MEMTRACK_RAM_SIZE, currFrameCounter);
+
+	for (uint32 A = MEMTRACK_WRAM_START; A < (MEMTRACK_WRAM_START + MEMTRACK_WRAM_SIZE); A += 0x800)
+	{
+		const uint8 *p = wramPagePtr(A);
+
+		if (p)
+		{
+			diffBlock(p, addrToIndex(A), 0x800, currFrameCounter);
+		}
+	}
+}
+
+void FCEU_MemTrackReset(void)
+{
+	snapshotValid = false;
+}
+
+void FCEUI_MemTrackEnable(bool enable)
+{
+	if (enable && !trackEnabled)
+	{
+		snapshotValid = false;
+		FCEUI_MemTrackClearCounts();
+	}
+	trackEnabled = enable;
+}
+
+bool FCEUI_MemTrackEnabled(void)
+{
+	return trackEnabled;
+}
+
+void FCEUI_MemTrackClearCounts(void)
+{
+	memset(chgCount, 0, sizeof(chgCount));
+	memset(chgStamp, 0, sizeof(chgStamp));
+	frameStamp = 0;
+
+	for (int i = 0; i < MEMTRACK_SIZE; i++)
+	{
+		lastChgFrame[i] = -1;
+	}
+}
+
+bool FCEUI_MemTrackIsTracked(uint32 A)
+{
+	return addrToIndex(A) >= 0;
+}
+
+uint8 FCEUI_MemTrackPeek(uint32 A)
+{
+	int idx = addrToIndex(A);
+
+	return (idx >= 0) ? prevMem[idx] : 0;
+}
+
+uint32 FCEUI_MemTrackChangeCount(uint32 A, int size)
+{
+	int idx = addrToIndex(A);
+
+	return (idx >= 0) ? chgCount[sizeToSlot(size)][idx] : 0;
+}
+
+int32 FCEUI_MemTrackLastChangeFrame(uint32 A)
+{
+	int idx = addrToIndex(A);
+
+	return (idx >= 0) ? lastChgFrame[idx] : -1;
+}
+
+void FCEUI_MemTrackCopy(uint8 *mem, uint32 *chgCounts, int size)
+{
+	int slot = sizeToSlot(size);
+
+	// Internal RAM and its three mirrors
+	for (uint32 A = 0; A < 0x2000; A += MEMTRACK_RAM_SIZE)
+	{
+		if (mem)
+		{
+			memcpy(&mem[A], prevMem, MEMTRACK_RAM_SIZE);
+		}
+		if (chgCounts)
+		{
+			memcpy(&chgCounts[A], chgCount[slot], MEMTRACK_RAM_SIZE * sizeof(uint32));
+		}
+	}
+
+	if (mem)
+	{
+		memcpy(&mem[MEMTRACK_WRAM_START], &prevMem[MEMTRACK_RAM_SIZE], MEMTRACK_WRAM_SIZE);
+	}
+	if (chgCounts)
+	{
+		memcpy(&chgCounts[MEMTRACK_WRAM_START], &chgCount[slot][MEMTRACK_RAM_SIZE], MEMTRACK_WRAM_SIZE * sizeof(uint32));
+	}
+}
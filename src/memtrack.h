@@ -0,0 +1,44 @@
+#ifndef _MEMTRACK_H_
+#define _MEMTRACK_H_
+
+// Per frame RAM change tracking.
+//
+// When enabled, the core compares the 2KB internal RAM and the 8KB mapped
+// at $6000-$7FFF against their state at the end of the previous frame and
+// accumulates, per address, the number of frames in which the value changed
+// and the frame on which it last changed. Change counts are kept for byte,
+// word and dword sized values so that RAM search can query the count that
+// matches its current data size without sampling memory itself.
+
+#define MEMTRACK_RAM_SIZE    0x0800
+#define MEMTRACK_WRAM_START  0x6000
+#define MEMTRACK_WRAM_SIZE   0x2000
+
+// Called by the core at the end of every emulated frame.
+void FCEU_MemTrackFrameEnd(void);
+
+// Forget the previous frame snapshot (game load/close).
+void FCEU_MemTrackReset(void);
+
+void FCEUI_MemTrackEnable(bool enable);
+bool FCEUI_MemTrackEnabled(void);
+void FCEUI_MemTrackClearCounts(void);
+
+// Returns true if the CPU address is covered by the tracker ($0000-$1FFF or $6000-$7FFF).
+bool FCEUI_MemTrackIsTracked(uint32 A);
+
+// Value of the address at the end of the last tracked frame.
+uint8 FCEUI_MemTrackPeek(uint32 A);
+
+// Number of frames in which the 1, 2 or 4 byte value starting at A changed.
+uint32 FCEUI_MemTrackChangeCount(uint32 A, int size);
+
+// Frame counter value of the last change of the byte at A, -1 if never changed.
+int32 FCEUI_MemTrackLastChangeFrame(uint32 A);
+
+// Copies the end of frame snapshot and the change counts for the given data size
+// into CPU address indexed buffers of 0x10000 entries. Only tracked addresses
+// are written, either pointer may be NULL.
+void FCEUI_MemTrackCopy(uint8 *mem, uint32 *chgCounts, int size);
+
+#endif
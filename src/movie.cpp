@@ -14,6 +14,8 @@
 #include "cart.h"
 #include "fds.h"
 #include "vsuni.h"
+#include "moviejournal.h"
+#include "moviekeyframes.h"
 #ifdef _S9XLUA_H
 #include "fceulua.h"
 #endif
@@ -103,6 +105,8 @@ int input_display = 0;
 int frame_display = 0;
 int rerecord_display = 0;
 bool fullSaveStateLoads = false;	//Option for loading a savestates full contents in read+write mode instead of up to the frame count in the savestate (useful as a recovery option)
+bool slimMovieStates = false;		//Option for saving only a reference to the movie (plus the input changed since it was loaded) in savestates instead of the whole movie
+bool journalMovieRecording = false;	//Option for appending edits made while recording to a journal instead of rewriting the whole movie file
 int movieRecordMode = 0;			//Option for various movie recording modes such as TRUNCATE (normal), OVERWRITE etc.
 
 SFORMAT FCEUMOV_STATEINFO[]={
@@ -117,8 +121,47 @@ int currRerecordCount; // Keep the global value
 
 char lagcounterbuf[32] = {0};
 
+//The movie as it was loaded from disk. Slim movie savestates only store the input that
+//differs from it, the leading records they share with it are verified by a rolling hash.
+static MovieRecordList baselineRecords;
+static std::vector<uint64> baselineHash;	// baselineHash[i] is the hash of baselineRecords[0,i)
+static int baselineShared = 0;				// number of leading records of currMovieData equal to the baseline
+
+static void BaselineChangedAt(int frame)
+{
+	if (frame < baselineShared)
+		baselineShared = (frame > 0) ? frame : 0;
+}
+
+static void CurrMovieChangedAt(int frame)
+{
+	BaselineChangedAt(frame);
+	FCEU_MovieJournalChangedAt(frame);
+	FCEU_MovieKeyframesChangedAt(frame);
+}
+
+static void SetMovieBaseline()
+{
+	baselineRecords = currMovieData.records;
+	baselineHash.assign(1, MOVIE_RECORD_HASH_SEED);
+	baselineShared = (int)baselineRecords.size();
+}
+
+//hash of the first len baseline records, extending the cached prefix hashes as needed
+static uint64 BaselinePrefixHash(int len)
+{
+	while ((int)baselineHash.size() <= len)
+	{
+		int i = (int)baselineHash.size() - 1;
+		baselineHash.push_back(baselineRecords[i].hash(baselineHash[i]));
+	}
+	return baselineHash[len];
+}
+
 void MovieData::clearRecordRange(int start, int len)
 {
+	if (this == &currMovieData)
+		CurrMovieChangedAt(start);
 	for(int i=0;i<len;i++)
 	{
 		records[i+start].clear();
@@ -127,30 +170,26 @@ void MovieData::clearRecordRange(int start, int len)
 
 void MovieData::eraseRecords(int at, int frames)
 {
+	if (this == &currMovieData)
+		CurrMovieChangedAt(at);
 	if (at < (int)records.size())
 	{
-		if (frames == 1)
-		{
-			// erase 1 frame
-			records.erase(records.begin() + at);
-		} else
-		{
-			// erase many frames
-			if (at + frames > (int)records.size())
-				frames = (int)records.size() - at;
-			records.erase(records.begin() + at, records.begin() + (at + frames));
-		}
+		if (at + frames > (int)records.size())
+			frames = (int)records.size() - at;
+		records.erase(at, frames);
 	}
 }
 
 void MovieData::insertEmpty(int at, int frames)
 {
+	if (this == &currMovieData)
+		CurrMovieChangedAt((at == -1) ? (int)records.size() : at);
 	if (at == -1)
 	{
 		records.resize(records.size() + frames);
 	} else
 	{
-		records.insert(records.begin() + at, frames, MovieRecord());
+		records.insert(at, frames, MovieRecord());
 	}
 }
 
@@ -158,10 +197,12 @@ void MovieData::cloneRegion(int at, int frames)
 {
 	if (at < 0) return;
 
-	records.insert(records.begin() + at, frames, MovieRecord());
+	if (this == &currMovieData)
+		CurrMovieChangedAt(at);
+	records.insert(at, frames, MovieRecord());
 
 	for(int i = 0; i < frames; i++)
-		records[i + at].Clone(records[i + at + frames]);
+		records.set(i + at, records.get(i + at + frames));
 }
 // ----------------------------------------------------------------------------
 MovieRecord::MovieRecord()
@@ -178,13 +219,13 @@ void MovieRecord::clear()
 	memset(zappers, 0, sizeof(zappers));
 }
 
-bool MovieRecord::Compare(MovieRecord& compareRec)
+bool MovieRecord::Compare(const MovieRecord& compareRec)
 {
 	//Joysticks, Zappers, and commands
 
 	if (this->commands != compareRec.commands)
 		return false;
-	if ((*(uint32*)&(this->joysticks)) != (*(uint32*)&(compareRec.joysticks)))
+	if ((*(uint32*)&(this->joysticks)) != (*(const uint32*)&(compareRec.joysticks)))
 		return false;
 	if (memcmp(this->zappers, compareRec.zappers, sizeof(zappers)))
 		return false;
@@ -214,13 +255,39 @@ bool MovieRecord::Compare(MovieRecord& compareRec)
 
 	return true;
 }
-void MovieRecord::Clone(MovieRecord& sourceRec)
+void MovieRecord::Clone(const MovieRecord& sourceRec)
 {
-	*(uint32*)&joysticks = *(uint32*)(&(sourceRec.joysticks));
+	*(uint32*)&joysticks = *(const uint32*)(&(sourceRec.joysticks));
 	memcpy(this->zappers, sourceRec.zappers, sizeof(zappers));
 	this->commands = sourceRec.commands;
 }
 
+uint64 MovieRecord::hash(uint64 h)
+{
+	uint8 buf[5 + 2 * 12];
+	int n = 0;
+
+	buf[n++] = commands;
+	for (int i = 0; i < 4; i++)
+		buf[n++] = joysticks[i];
+	for (int p = 0; p < 2; p++)
+	{
+		buf[n++] = zappers[p].x;
+		buf[n++] = zappers[p].y;
+		buf[n++] = zappers[p].b;
+		buf[n++] = zappers[p].bogo;
+		for (int i = 0; i < 8; i++)
+			buf[n++] = (uint8)(zappers[p].zaphit >> (i * 8));
+	}
+	//FNV-1a
+	for (int i = 0; i < n; i++)
+	{
+		h ^= buf[i];
+		h *= 0x100000001B3ull;
+	}
+	return h;
+}
+
 const char MovieRecord::mnemonics[8] = {'A','B','S','T','U','D','L','R'};
 
 void MovieRecord::dumpJoy(EMUFILE* os, uint8 joystate)
@@ -395,6 +462,317 @@ void MovieRecord::dump(MovieData* md, EMUFILE* os, int index)
 	//each frame is on a new line
 	os->fputc('\n');
 }
+// ----------------------------------------------------------------------------
+static bool IsEmptyEntry(uint8 val)
+{
+	return val == 0;
+}
+
+static bool IsEmptyEntry(const MovieRecordZapper& zapper)
+{
+	return !zapper.x && !zapper.y && !zapper.b && !zapper.bogo && !zapper.zaphit;
+}
+
+template<typename T>
+size_t MovieRecordList::SparseColumn<T>::find(int index) const
+{
+	size_t lo = 0, hi = entries.size();
+	while (lo < hi)
+	{
+		size_t mid = (lo + hi) / 2;
+		if (entries[mid].first < index)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+template<typename T>
+T MovieRecordList::SparseColumn<T>::get(int index) const
+{
+	size_t pos = find(index);
+	if (pos < entries.size() && entries[pos].first == index)
+		return entries[pos].second;
+	return T();
+}
+
+template<typename T>
+void MovieRecordList::SparseColumn<T>::set(int index, const T& val)
+{
+	size_t pos = find(index);
+	bool found = pos < entries.size() && entries[pos].first == index;
+
+	if (IsEmptyEntry(val))
+	{
+		if (found)
+			entries.erase(entries.begin() + pos);
+	} else if (found)
+		entries[pos].second = val;
+	else
+		entries.insert(entries.begin() + pos, std::make_pair(index, val));
+}
+
+template<typename T>
+void MovieRecordList::SparseColumn<T>::erase(int at, int n)
+{
+	entries.erase(entries.begin() + find(at), entries.begin() + find(at + n));
+	shift(at + n, -n);
+}
+
+template<typename T>
+void MovieRecordList::SparseColumn<T>::shift(int at, int delta)
+{
+	for (size_t i = find(at); i < entries.size(); i++)
+		entries[i].first += delta;
+}
+
+//An encoded movie whose records are decoded by the MovieRecordLists sharing it as they
+//are used. The data is a copy of the input section of the movie file: a mapping of it
+//would bring the emulator down with SIGBUS whenever another program truncates the movie.
+struct MovieRecordSource
+{
+	const uint8* data;
+	uint32 size;
+	int recordSize;				// binary records, 0 for text
+	std::vector<uint32> lines;	// offsets of the text records, past their leading '|'
+	bool fourscore;
+	int ports[3];
+
+	std::vector<uint8> buffer;
+
+	MovieRecordSource() : data(0), size(0), recordSize(0) {}
+};
+
+//Takes the next len bytes of fp as the data of a record source
+static std::shared_ptr<MovieRecordSource> OpenMovieRecordSource(MovieData& movieData, EMUFILE* fp, int len)
+{
+	std::shared_ptr<MovieRecordSource> source(new MovieRecordSource());
+	source->fourscore = movieData.fourscore;
+	for (int i = 0; i < 3; i++)
+		source->ports[i] = movieData.ports[i];
+
+	source->buffer.resize(len);
+	if (len)
+		fp->fread(&source->buffer[0], len);
+	source->data = len ? &source->buffer[0] : 0;
+	source->size = len;
+	return source;
+}
+
+void MovieRecordList::setSource(const std::shared_ptr<MovieRecordSource>& source, int frames)
+{
+	needAll();
+	this->source = source;
+	pending = frames;
+	sourceNext = 0;
+	if (!pending)
+		this->source.reset();
+}
+
+//decodes the records up to index and a bit further, playback will want them next
+void MovieRecordList::decode(int index)
+{
+	const int chunk = 4096;
+	int n = std::min((int)pending, std::max(index + 1 - (int)count, chunk));
+
+	int first = (int)sourceNext;
+	uint32 begin, end;
+	if (source->recordSize)
+	{
+		begin = first * source->recordSize;
+		end = (first + n) * source->recordSize;
+	} else
+	{
+		begin = source->lines[first];
+		end = (first + n < (int)source->lines.size()) ? source->lines[first + n] : source->size;
+	}
+	EMUFILE_MEMORY is((void*)(source->data + begin), end - begin);
+
+	MovieData format;
+	format.fourscore = source->fourscore;
+	for (int i = 0; i < 3; i++)
+		format.ports[i] = source->ports[i];
+
+	for (int joy = 0; joy < 4; joy++)
+	{
+		if (!joy_col[joy].empty())
+			joy_col[joy].resize(count + n, 0);
+	}
+	int at = (int)count;
+	count += n;
+	pending -= n;
+	sourceNext += n;
+
+	for (int i = 0; i < n; i++)
+	{
+		MovieRecord rec;
+		if (source->recordSize)
+			rec.parseBinary(&format, &is);
+		else
+		{
+			is.fseek(source->lines[first + i] - begin, SEEK_SET);
+			rec.parse(&format, &is);
+		}
+		set(at + i, rec);
+	}
+
+	if (!pending)
+		source.reset();
+}
+
+void MovieRecordList::resize(size_t n)
+{
+	if (pending)
+	{
+		if (n > count)
+			decode((int)std::min(n, size()) - 1);
+		pending = 0;
+		source.reset();
+	}
+	if (n < count)
+	{
+		cmd_col.erase((int)n, (int)(count - n));
+		for (int port = 0; port < 2; port++)
+			zap_col[port].erase((int)n, (int)(count - n));
+	}
+	for (int joy = 0; joy < 4; joy++)
+	{
+		if (!joy_col[joy].empty())
+			joy_col[joy].resize(n, 0);
+	}
+	count = n;
+}
+
+void MovieRecordList::reserve(size_t n)
+{
+	for (int joy = 0; joy < 4; joy++)
+	{
+		if (!joy_col[joy].empty())
+			joy_col[joy].reserve(n);
+	}
+}
+
+void MovieRecordList::insert(int at, int n, const MovieRecord& rec)
+{
+	if (n <= 0)
+		return;
+	needAll();
+	for (int joy = 0; joy < 4; joy++)
+	{
+		if (!joy_col[joy].empty())
+			joy_col[joy].insert(joy_col[joy].begin() + at, n, 0);
+	}
+	cmd_col.shift(at, n);
+	for (int port = 0; port < 2; port++)
+		zap_col[port].shift(at, n);
+	count += n;
+
+	for (int i = at; i < at + n; i++)
+		set(i, rec);
+}
+
+void MovieRecordList::erase(int at, int n)
+{
+	if (n <= 0)
+		return;
+	needAll();
+	for (int joy = 0; joy < 4; joy++)
+	{
+		if (!joy_col[joy].empty())
+			joy_col[joy].erase(joy_col[joy].begin() + at, joy_col[joy].begin() + (at + n));
+	}
+	cmd_col.erase(at, n);
+	for (int port = 0; port < 2; port++)
+		zap_col[port].erase(at, n);
+	count -= n;
+}
+
+MovieRecord MovieRecordList::get(int index) const
+{
+	MovieRecord rec;
+	rec.commands = getCommands(index);
+	for (int joy = 0; joy < 4; joy++)
+		rec.joysticks[joy] = getJoystick(index, joy);
+	for (int port = 0; port < 2; port++)
+		rec.zappers[port] = getZapper(index, port);
+	return rec;
+}
+
+void MovieRecordList::set(int index, const MovieRecord& rec)
+{
+	setCommands(index, rec.commands);
+	for (int joy = 0; joy < 4; joy++)
+		setJoystick(index, joy, rec.joysticks.data[joy]);
+	for (int port = 0; port < 2; port++)
+		setZapper(index, port, rec.zappers[port]);
+}
+
+void MovieRecordList::setJoystick(int index, int joy, uint8 val)
+{
+	need(index);
+	if (joy_col[joy].empty())
+	{
+		if (!val)
+			return;
+		joy_col[joy].assign(count, 0);
+	}
+	joy_col[joy][index] = val;
+}
+
+MovieRecordRef::JoyByteRef::operator uint8() const
+{
+	return list->getJoystick(index, joy);
+}
+
+MovieRecordRef::JoyByteRef& MovieRecordRef::JoyByteRef::operator=(uint8 val)
+{
+	list->setJoystick(index, joy, val);
+	return *this;
+}
+
+MovieRecordRef::CommandsRef::operator uint8() const
+{
+	return list->getCommands(index);
+}
+
+MovieRecordRef::CommandsRef& MovieRecordRef::CommandsRef::operator=(uint8 val)
+{
+	list->setCommands(index, val);
+	return *this;
+}
+
+MovieRecordZapper MovieRecordRef::ZappersRef::operator[](int port) const
+{
+	return list->getZapper(index, port);
+}
+
+MovieRecordRef::operator MovieRecord() const
+{
+	return list->get(index);
+}
+
+MovieRecordRef& MovieRecordRef::operator=(const MovieRecord& rec)
+{
+	list->set(index, rec);
+	return *this;
+}
+
+void MovieRecordRef::parse(MovieData* md, EMUFILE* is)
+{
+	MovieRecord rec;
+	rec.parse(md, is);
+	operator=(rec);
+}
+
+bool MovieRecordRef::parseBinary(MovieData* md, EMUFILE* is)
+{
+	MovieRecord rec;
+	bool ok = rec.parseBinary(md, is);
+	operator=(rec);
+	return ok;
+}
+// ----------------------------------------------------------------------------
 
 MovieData::MovieData()
 	: version(MOVIE_VERSION)
@@ -414,6 +792,8 @@ MovieData::MovieData()
 
 void MovieData::truncateAt(int frame)
 {
+	if (this == &currMovieData)
+		CurrMovieChangedAt(frame);
 	records.resize(frame);
 }
 
@@ -630,11 +1010,44 @@ static void LoadFM2_binarychunk(MovieData& movieData, EMUFILE* fp, int size)
 	if (movieData.loadFrameCount!=-1 && movieData.loadFrameCount<numRecords)
 		numRecords=movieData.loadFrameCount;
 
-	movieData.records.resize(numRecords);
-	for(int i=0;i<numRecords;i++)
+	//the records are decoded as they are first used
+	std::shared_ptr<MovieRecordSource> source = OpenMovieRecordSource(movieData, fp, numRecords * recordsize);
+	source->recordSize = recordsize;
+	movieData.records.setSource(source, numRecords);
+}
+
+//Indexes the text records that make up the rest of the movie, so they can be parsed as they are
+//first used. fp must be past the '|' of the first record. Fails if anything but records follows.
+static bool LoadFM2_textchunk(MovieData& movieData, EMUFILE* fp, int size)
+{
+	int curr = fp->ftell();
+	fp->fseek(0,SEEK_END);
+	int end = fp->ftell();
+	fp->fseek(curr,SEEK_SET);
+
+	std::shared_ptr<MovieRecordSource> source = OpenMovieRecordSource(movieData, fp, std::min<int>(size, end-curr));
+	const uint8* data = source->data;
+	uint32 len = source->size;
+
+	source->lines.push_back(0);
+	for(uint32 i=0;;)
 	{
-		movieData.records[i].parseBinary(&movieData,fp);
+		while(i < len && data[i] != 10 && data[i] != 13)
+			i++;
+		while(i < len && (data[i] == 10 || data[i] == 13 || data[i] == ' ' || data[i] == '\t'))
+			i++;
+		if(i == len)
+			break;
+		if(data[i] != '|')
+		{
+			fp->fseek(curr,SEEK_SET);
+			return false;
+		}
+		source->lines.push_back(++i);
 	}
+
+	movieData.records.setSource(source, (int)source->lines.size());
+	return true;
 }
 
 //yuck... another custom text parser.
@@ -707,6 +1120,8 @@ bool LoadFM2(MovieData& movieData, EMUFILE* fp, int size, bool stopAfterHeader)
 			{
 				dorecord:
 				if (stopAfterHeader) return true;
+				if (movieData.loadFrameCount == -1 && movieData.records.empty() && LoadFM2_textchunk(movieData, fp, size))
+					return true;
 				int currcount = movieData.records.size();
 				movieData.records.resize(currcount+1);
 				int preparse = fp->ftell();
@@ -792,10 +1207,11 @@ static const char *GetMovieRecordModeStr()
 	}
 }
 
+static void closeRecordingMovie();
+
 static EMUFILE *openRecordingMovie(const char* fname)
 {
-	if (osRecordingMovie)
-		delete osRecordingMovie;
+	closeRecordingMovie();
 
 	osRecordingMovie = FCEUD_UTF8_fstream(fname, "wb");
 	if (!osRecordingMovie || osRecordingMovie->fail()) {
@@ -811,7 +1227,9 @@ static void closeRecordingMovie()
 {
 	if (osRecordingMovie)
 	{
-		delete osRecordingMovie;
+		//the journal stays open until recording ends
+		if (osRecordingMovie != FCEU_MovieJournalFile())
+			delete osRecordingMovie;
 		osRecordingMovie = 0;
 	}
 }
@@ -822,12 +1240,42 @@ static void RedumpWholeMovieFile(bool justToggledRecording = false)
 	bool recording = (movieMode == MOVIEMODE_RECORD);
 	assert((NULL != osRecordingMovie) == (recording != justToggledRecording) && "osRecordingMovie should be consistent with movie mode!");
 
+	if (FCEU_MovieJournalFile())
+	{
+		if (recording)
+		{
+			//only the changes are appended, the movie file is rewritten in the background
+			osRecordingMovie = FCEU_MovieJournalFile();
+			FCEU_MovieJournalSync(currMovieData);
+			FCEU_MovieJournalFlush();
+		}
+		else
+		{
+			osRecordingMovie = 0;
+			FCEU_MovieJournalEnd(currMovieData);
+		}
+		return;
+	}
+
 	if (NULL == openRecordingMovie(curMovieFilename))
 		return;
 
 	currMovieData.dump(osRecordingMovie, false/*currMovieData.binaryFlag*/, recording);
 	if (recording)
+	{
 		osRecordingMovie->fflush();
+
+		//the movie file now holds the whole movie, further edits can be journaled
+		if (journalMovieRecording)
+		{
+			EMUFILE* journal = FCEU_MovieJournalBegin(curMovieFilename, currMovieData);
+			if (journal)
+			{
+				closeRecordingMovie();
+				osRecordingMovie = journal;
+			}
+		}
+	}
 	else
 		closeRecordingMovie();
 }
@@ -870,6 +1318,7 @@ static void OnMovieClosed()
 {
 	assert(movieMode == MOVIEMODE_INACTIVE);
 
+	FCEU_MovieKeyframesClose();
 	curMovieFilename[0] = 0;			//No longer a current movie filename
 	freshMovie = false;					//No longer a fresh movie loaded
 	if (bindSavestate) AutoSS = false;	//If bind movies to savestates is true, then there is no longer a valid auto-save to load
@@ -939,6 +1388,7 @@ void FCEUMOV_CreateCleanMovie()
 	currMovieData.PPUflag = (newppu != 0);
 	currMovieData.RAMInitOption = RAMInitOption;
 	currMovieData.RAMInitSeed = RAMInitSeed;
+	SetMovieBaseline();
 }
 void FCEUMOV_ClearCommands()
 {
@@ -1053,9 +1503,22 @@ bool FCEUI_LoadMovie(const char *fname, bool _read_only, int _pauseframe)
 #endif
 
 	LoadFM2(currMovieData, fp->stream, fp->size, false);
-	LoadSubtitles(currMovieData);
+	bool fromArchive = fp->isArchive();
 	delete fp;
 
+	//a journal left next to the movie holds input recorded after the movie file was last written.
+	//playback only applies it, the files are fixed up once the movie is opened for recording.
+	if (!fromArchive && FCEU_MovieJournalExists(fname))
+	{
+		int recovered = FCEU_MovieJournalRecover(fname, currMovieData, !_read_only);
+		if (recovered)
+			FCEU_DispMessage("Recovered %d journaled movie edits.", 0, recovered);
+	}
+	FCEU_MovieKeyframesOpen(fromArchive ? NULL : fname, currMovieData);
+	LoadSubtitles(currMovieData);
+
+	SetMovieBaseline();
+
 	RAMInitOption = currMovieData.RAMInitOption;
 	RAMInitSeed = currMovieData.RAMInitSeed;
 
@@ -1191,13 +1654,15 @@ void FCEUMOV_AddInputState()
 		if (((int)currMovieData.records.size() - 1) < (currFrameCounter + 1))
 			currMovieData.insertEmpty(-1, (currFrameCounter + 1) - ((int)currMovieData.records.size() - 1));
 
-		MovieRecord* mr = &currMovieData.records[currFrameCounter];
+		MovieRecord record = currMovieData.records[currFrameCounter];
+		MovieRecord* mr = &record;
 		if (isTaseditorRecording())
 		{
 			// record commands and buttons
 			mr->commands |= _currCommand;
 			joyports[0].log(mr);
 			joyports[1].log(mr);
+			currMovieData.records[currFrameCounter] = record;
 			recordInputByTaseditor();
 		}
 		// replay buttons
@@ -1229,7 +1694,8 @@ void FCEUMOV_AddInputState()
 			portFC.driver->Update(portFC.ptr,portFC.attrib);
 		} else
 		{
-			MovieRecord* mr = &currMovieData.records[currFrameCounter];
+			MovieRecord record = currMovieData.records[currFrameCounter];
+			MovieRecord* mr = &record;
 
 			//reset and power cycle if necessary
 			if(mr->command_power())
@@ -1266,6 +1732,7 @@ void FCEUMOV_AddInputState()
 	} else if (movieMode == MOVIEMODE_RECORD)
 	{
 		MovieRecord mr;
+		bool overwritten = false, inserted = false;
 
 		joyports[0].log(&mr);
 		joyports[1].log(&mr);
@@ -1278,11 +1745,15 @@ void FCEUMOV_AddInputState()
 			switch (movieRecordMode)
 			{
 			case MOVIE_RECORD_MODE_OVERWRITE:
-				currMovieData.records[currFrameCounter].Clone(mr);
+				BaselineChangedAt(currFrameCounter);
+				currMovieData.records.set(currFrameCounter, mr);
+				overwritten = true;
 				break;
 			case MOVIE_RECORD_MODE_INSERT:
 				//FIXME: this could be very insufficient
-				currMovieData.records.insert(currMovieData.records.begin() + currFrameCounter, mr);
+				BaselineChangedAt(currFrameCounter);
+				currMovieData.records.insert(currFrameCounter, mr);
+				inserted = true;
 				break;
 			//case MOVIE_RECORD_MODE_TRUNCATE:
 			default:
@@ -1294,7 +1765,17 @@ void FCEUMOV_AddInputState()
 		else
 			currMovieData.records.push_back(mr);
 
-		mr.dump(&currMovieData, osRecordingMovie, currFrameCounter);	// to disk
+		if (FCEU_MovieJournalFile())
+		{
+			if (overwritten)
+				FCEU_MovieJournalSetFrame(currMovieData, currFrameCounter);
+			else if (inserted)
+				FCEU_MovieJournalInsertFrame(currMovieData, currFrameCounter);
+			else
+				FCEU_MovieJournalSync(currMovieData);
+		}
+		else
+			mr.dump(&currMovieData, osRecordingMovie, currFrameCounter);	// to disk
 	}
 
 	currFrameCounter++;
@@ -1380,11 +1861,134 @@ void FCEU_DrawLagCounter(uint8 *XBuf)
 	}
 }
 
+//slim movie savestate chunk:
+//  "FCSM", version, guid, length, shared, hash of the shared records, records [shared,length) in binary
+static const char slimMovieStateMagic[4] = { 'F', 'C', 'S', 'M' };
+#define SLIM_MOVIE_STATE_VERSION 1
+
+//Movie contained in a savestate. Either a fully parsed movie, or a slim reference
+//whose leading 'shared' records are those of the baseline movie.
+struct StateMovie
+{
+	MovieData* full;
+	FCEU_Guid guid;
+	int length;
+	int shared;
+	MovieRecordList tail;	// records [shared,length) of a slim reference
+
+	StateMovie() : full(0), length(0), shared(0) {}
+
+	MovieRecord record(int i)
+	{
+		if (full)
+			return full->records.get(i);
+		return (i < shared) ? baselineRecords.get(i) : tail.get(i - shared);
+	}
+};
+
+static int WriteSlimMovieState(EMUFILE* os)
+{
+	int start = os->ftell();
+	int length = (int)currMovieData.records.size();
+	int shared = std::min(baselineShared, length);
+
+	os->fwrite(slimMovieStateMagic, 4);
+	write32le(SLIM_MOVIE_STATE_VERSION, os);
+	os->fwrite(currMovieData.guid.data, FCEU_Guid::size);
+	write32le(length, os);
+	write32le(shared, os);
+	write64le(BaselinePrefixHash(shared), os);
+
+	for (int i = shared; i < length; i++)
+		currMovieData.records[i].dumpBinary(&currMovieData, os, i);
+
+	return os->ftell() - start;
+}
+
+static bool IsSlimMovieState(EMUFILE* is, uint32 size)
+{
+	char magic[4];
+
+	if (size < 4)
+		return false;
+	int pos = is->ftell();
+	bool ret = (is->fread(magic, 4) == 4) && (memcmp(magic, slimMovieStateMagic, 4) == 0);
+	is->fseek(pos, SEEK_SET);
+	return ret;
+}
+
+static bool ReadSlimMovieState(EMUFILE* is, StateMovie& sm)
+{
+	uint32 version, length, shared;
+	uint64 hash;
+
+	//the caller checked the magic with IsSlimMovieState
+	is->fseek(4, SEEK_CUR);
+	if (!read32le(&version, is) || version != SLIM_MOVIE_STATE_VERSION)
+		return false;
+	if (is->fread(sm.guid.data, FCEU_Guid::size) != FCEU_Guid::size)
+		return false;
+	if (!read32le(&length, is) || !read32le(&shared, is) || !read64le(&hash, is))
+		return false;
+	if (shared > length)
+		return false;
+
+	//the shared records have to be available from the movie we have loaded
+	if (sm.guid != currMovieData.guid)
+		return false;
+	if ((int)shared > (int)baselineRecords.size() || BaselinePrefixHash(shared) != hash)
+		return false;
+
+	sm.length = length;
+	sm.shared = shared;
+	sm.tail.resize(length - shared);
+	for (uint32 i = 0; i < length - shared; i++)
+	{
+		//same movie, so the binary record layout is that of the current movie's ports
+		if (!sm.tail[i].parseBinary(&currMovieData, is))
+			return false;
+	}
+	return true;
+}
+
+//replaces the current movie with the first 'len' records of the savestate movie
+static void InstallStateMovie(StateMovie& sm, int len)
+{
+	if (sm.full)
+	{
+		if (len < (int)sm.full->records.size())
+			sm.full->truncateAt(len);
+		currMovieData = *sm.full;
+
+		int n = std::min((int)currMovieData.records.size(), (int)baselineRecords.size());
+		baselineShared = 0;
+		while (baselineShared < n && currMovieData.records[baselineShared].Compare(baselineRecords[baselineShared]))
+			baselineShared++;
+		return;
+	}
+
+	//the records both movies share with the baseline stay where they are
+	if (len > sm.length)
+		len = sm.length;
+	int keep = std::min(len, std::min(sm.shared, baselineShared));
+
+	currMovieData.truncateAt(keep);
+	currMovieData.records.reserve(len);
+	for (int i = keep; i < len; i++)
+		currMovieData.records.push_back(sm.record(i));
+
+	baselineShared = std::min(len, sm.shared);
+}
+
 int FCEUMOV_WriteState(EMUFILE* os)
 {
 	//we are supposed to dump the movie data into the savestate
 	if(movieMode == MOVIEMODE_RECORD || movieMode == MOVIEMODE_PLAY || movieMode == MOVIEMODE_FINISHED)
+	{
+		if (slimMovieStates)
+			return WriteSlimMovieState(os);
 		return currMovieData.dump(os, true);
+	}
 	else return 0;
 }
 
@@ -1407,8 +2011,30 @@ int CheckTimelines(MovieData& stateMovie, MovieData& currMovie)
 	return -1;
 }
 
+static int CheckTimelines(StateMovie& stateMovie, MovieData& currMovie)
+{
+	int end_frame = currMovie.records.size();
+	if (end_frame > stateMovie.length)
+		end_frame = stateMovie.length;
+	if (end_frame > currFrameCounter)
+		end_frame = currFrameCounter;
+
+	// records that both movies share with the baseline are known to match
+	int x = 0;
+	if (!stateMovie.full)
+		x = std::min(end_frame, std::min(stateMovie.shared, baselineShared));
+
+	for (; x < end_frame; x++)
+	{
+		if (!stateMovie.record(x).Compare(currMovie.records[x]))
+			return x;
+	}
+	return -1;
+}
+
 
 static bool load_successful;
+static bool keyframeState = false;	// a keyframe savestate is being saved or loaded
 
 bool FCEUMOV_ReadState(EMUFILE* is, uint32 size)
 {
@@ -1437,8 +2063,28 @@ bool FCEUMOV_ReadState(EMUFILE* is, uint32 size)
 	}
 
 	MovieData tempMovieData = MovieData();
+	StateMovie stateMovie;
 	std::ios::pos_type curr = is->ftell();
-	if(!LoadFM2(tempMovieData, is, size, false)) {
+	if(IsSlimMovieState(is, size)) {
+		//a slim movie only stores the input that differs from the movie it was recorded against,
+		//so it is of no use without that movie
+		bool active = (movieMode == MOVIEMODE_PLAY || movieMode == MOVIEMODE_RECORD || movieMode == MOVIEMODE_FINISHED);
+		bool ok = !active || ReadSlimMovieState(is, stateMovie);
+		is->fseek((uint32)curr+size,SEEK_SET);
+		if(!ok) {
+			if (!backupSavestates)
+			{
+				FCEU_PrintError("Savestate's movie input refers to a movie or branch that is not loaded.\nUnable to restore backup, movie playback stopped.");
+				FCEUI_StopMovie();
+			} else
+				FCEU_PrintError("Savestate's movie input refers to a movie or branch that is not loaded.");
+			return false;
+		}
+	} else if(LoadFM2(tempMovieData, is, size, false)) {
+		stateMovie.full = &tempMovieData;
+		stateMovie.guid = tempMovieData.guid;
+		stateMovie.length = (int)tempMovieData.records.size();
+	} else {
 		is->fseek((uint32)curr+size,SEEK_SET);
 		extern bool FCEU_state_loading_old_format;
 		if(FCEU_state_loading_old_format) {
@@ -1503,11 +2149,11 @@ bool FCEUMOV_ReadState(EMUFILE* is, uint32 size)
 	if(movieMode == MOVIEMODE_PLAY || movieMode == MOVIEMODE_RECORD || movieMode == MOVIEMODE_FINISHED)
 	{
 		//handle moviefile mismatch
-		if(tempMovieData.guid != currMovieData.guid)
+		if(stateMovie.guid != currMovieData.guid)
 		{
 			//mbg 8/18/08 - this code  can be used to turn the error message into an OK/CANCEL
 			#ifdef __WIN_DRIVER__
-				std::string msg = "There is a mismatch between savestate's movie and current movie.\ncurrent: " + currMovieData.guid.toString() + "\nsavestate: " + tempMovieData.guid.toString() + "\n\nThis means that you have loaded a savestate belonging to a different movie than the one you are playing now.\n\nContinue loading this savestate anyway?";
+				std::string msg = "There is a mismatch between savestate's movie and current movie.\ncurrent: " + currMovieData.guid.toString() + "\nsavestate: " + stateMovie.guid.toString() + "\n\nThis means that you have loaded a savestate belonging to a different movie than the one you are playing now.\n\nContinue loading this savestate anyway?";
 				int result = MessageBox(hAppWnd, msg.c_str(), "Error loading savestate", MB_OKCANCEL);
 				if(result == IDCANCEL)
 				{
@@ -1522,11 +2168,11 @@ bool FCEUMOV_ReadState(EMUFILE* is, uint32 size)
 			#else
 				if (!backupSavestates) //If backups are disabled we can just resume normally since we can't restore so stop movie and inform user
 				{
-					FCEU_PrintError("Mismatch between savestate's movie and current movie.\ncurrent: %s\nsavestate: %s\nUnable to restore backup, movie playback stopped.\n",currMovieData.guid.toString().c_str(),tempMovieData.guid.toString().c_str());
+					FCEU_PrintError("Mismatch between savestate's movie and current movie.\ncurrent: %s\nsavestate: %s\nUnable to restore backup, movie playback stopped.\n",currMovieData.guid.toString().c_str(),stateMovie.guid.toString().c_str());
 					FCEUI_StopMovie();
 				}
 				else
-				FCEU_PrintError("Mismatch between savestate's movie and current movie.\ncurrent: %s\nsavestate: %s\n",currMovieData.guid.toString().c_str(),tempMovieData.guid.toString().c_str());
+				FCEU_PrintError("Mismatch between savestate's movie and current movie.\ncurrent: %s\nsavestate: %s\n",currMovieData.guid.toString().c_str(),stateMovie.guid.toString().c_str());
 
 				return false;
 			#endif
@@ -1542,7 +2188,7 @@ bool FCEUMOV_ReadState(EMUFILE* is, uint32 size)
 			}
 
 			// currFrameCounter at this point represents the savestate framecount
-			int frame_of_mismatch = CheckTimelines(tempMovieData, currMovieData);
+			int frame_of_mismatch = CheckTimelines(stateMovie, currMovieData);
 			if (frame_of_mismatch >= 0)
 			{
 				// Wrong timeline, do apprioriate logic here
@@ -1553,19 +2199,19 @@ bool FCEUMOV_ReadState(EMUFILE* is, uint32 size)
 				} else
 					FCEU_PrintError("Error: Savestate not in the same timeline as movie!\nFrame %d branches from current timeline", frame_of_mismatch);
 				return false;
-			} else if ((int)tempMovieData.records.size() < currFrameCounter)
+			} else if (stateMovie.length < currFrameCounter)
 			{
 				// this is post-movie savestate and must be checked further
-				if (tempMovieData.records.size() < currMovieData.records.size())
+				if (stateMovie.length < (int)currMovieData.records.size())
 				{
 					// this savestate doesn't contain enough input to be checked
 					//TODO: turn frame counter to red to get attention
 					if (!backupSavestates)	//If backups are disabled we can just resume normally since we can't restore so stop movie and inform user
 					{
-						FCEU_PrintError("Error: Savestate taken from a frame (%d) after the final frame in the savestated movie (%d) cannot be verified against current movie (%d). This is not permitted.\nUnable to restore backup, movie playback stopped.", currFrameCounter, tempMovieData.records.size() - 1, currMovieData.records.size() - 1);
+						FCEU_PrintError("Error: Savestate taken from a frame (%d) after the final frame in the savestated movie (%d) cannot be verified against current movie (%d). This is not permitted.\nUnable to restore backup, movie playback stopped.", currFrameCounter, stateMovie.length - 1, currMovieData.records.size() - 1);
 						FCEUI_StopMovie();
 					} else
-						FCEU_PrintError("Savestate taken from a frame (%d) after the final frame in the savestated movie (%d) cannot be verified against current movie (%d). This is not permitted.", currFrameCounter, tempMovieData.records.size() - 1, currMovieData.records.size() - 1);
+						FCEU_PrintError("Savestate taken from a frame (%d) after the final frame in the savestated movie (%d) cannot be verified against current movie (%d). This is not permitted.", currFrameCounter, stateMovie.length - 1, currMovieData.records.size() - 1);
 					return false;
 				}
 			}
@@ -1581,11 +2227,11 @@ bool FCEUMOV_ReadState(EMUFILE* is, uint32 size)
 			//Read+Write mode
 			closeRecordingMovie();
 
-			if (currFrameCounter > (int)tempMovieData.records.size())
+			if (currFrameCounter > stateMovie.length)
 			{
 				//This is a post movie savestate, handle it differently
 				//Replace movie contents but then switch to movie finished mode
-				currMovieData = tempMovieData;
+				InstallStateMovie(stateMovie, stateMovie.length);
 				movieMode = MOVIEMODE_PLAY;
 				FCEUMOV_IncrementRerecordCount();
 				RedumpWholeMovieFile();
@@ -1593,11 +2239,9 @@ bool FCEUMOV_ReadState(EMUFILE* is, uint32 size)
 			} else
 			{
 				//truncate before we copy, just to save some time, unless the user selects a full copy option
-				if (!fullSaveStateLoads)
-					//we can only assume this here since we have checked that the frame counter is not greater than the movie data
-					tempMovieData.truncateAt(currFrameCounter);
+				//we can only assume this here since we have checked that the frame counter is not greater than the movie data
+				InstallStateMovie(stateMovie, fullSaveStateLoads ? stateMovie.length : currFrameCounter);
 				
-				currMovieData = tempMovieData;
 				movieMode = MOVIEMODE_RECORD;
 				FCEUMOV_IncrementRerecordCount();
 				RedumpWholeMovieFile(true);
@@ -1617,12 +2261,36 @@ void FCEUMOV_PreLoad(void)
 
 bool FCEUMOV_PostLoad(void)
 {
-	if(movieMode == MOVIEMODE_INACTIVE || movieMode == MOVIEMODE_TASEDITOR)
+	if(movieMode == MOVIEMODE_INACTIVE || movieMode == MOVIEMODE_TASEDITOR || keyframeState)
 		return true;
 	else
 		return load_successful;
 }
 
+bool FCEUMOV_SaveKeyframe(EMUFILE* os)
+{
+	keyframeState = true;
+	bool ok = FCEUSS_SaveMS(os, Z_NO_COMPRESSION);
+	keyframeState = false;
+	return ok;
+}
+
+bool FCEUMOV_LoadKeyframe(EMUFILE* is)
+{
+	keyframeState = true;
+	bool ok = FCEUSS_LoadFP(is, SSLOADPARAM_BACKUP);
+	keyframeState = false;
+
+	if (ok && movieMode == MOVIEMODE_FINISHED && currFrameCounter < (int)currMovieData.records.size())
+		movieMode = MOVIEMODE_PLAY;
+	return ok;
+}
+
+bool FCEUMOV_SavingKeyframe()
+{
+	return keyframeState;
+}
+
 void FCEUMOV_IncrementRerecordCount()
 {
 #ifdef _S9XLUA_H
@@ -1782,8 +2450,8 @@ void FCEUI_MovieInsertFrame()
 	{
 		strcpy(message, "1 frame inserted");
 		strcat(message, GetMovieModeStr());
-		std::vector<MovieRecord>::iterator iter = currMovieData.records.begin();
-		currMovieData.records.insert(iter + currFrameCounter, MovieRecord());
+		CurrMovieChangedAt(currFrameCounter);
+		currMovieData.records.insert(currFrameCounter, MovieRecord());
 		FCEUMOV_IncrementRerecordCount();
 		RedumpWholeMovieFile();
 	} else
@@ -1808,8 +2476,8 @@ void FCEUI_MovieDeleteFrame()
 	else if (movieMode == MOVIEMODE_RECORD || movieMode == MOVIEMODE_PLAY)
 	{
 		strcpy(message, "1 frame deleted");
-		std::vector<MovieRecord>::iterator iter = currMovieData.records.begin();
-		currMovieData.records.erase(iter + currFrameCounter);
+		CurrMovieChangedAt(currFrameCounter);
+		currMovieData.records.erase(currFrameCounter);
 		FCEUMOV_IncrementRerecordCount();
 		RedumpWholeMovieFile();
 
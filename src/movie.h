@@ -7,6 +7,7 @@
 
 #include <vector>
 #include <map>
+#include <memory>
 #include <string>
 #include <ostream>
 #include <cstdlib>
@@ -102,6 +103,11 @@ int FCEUMOV_WriteState(EMUFILE* os);
 bool FCEUMOV_ReadState(EMUFILE* is, uint32 size);
 void FCEUMOV_PreLoad();
 bool FCEUMOV_PostLoad();
+
+//savestates without the movie in them, for seeking within the movie being played
+bool FCEUMOV_SaveKeyframe(EMUFILE* os);
+bool FCEUMOV_LoadKeyframe(EMUFILE* is);
+bool FCEUMOV_SavingKeyframe();
 void FCEUMOV_IncrementRerecordCount();
 
 bool FCEUMOV_FromPoweron();
@@ -109,6 +115,14 @@ bool FCEUMOV_FromPoweron();
 void FCEUMOV_CreateCleanMovie();
 void FCEUMOV_ClearCommands();
 
+#define MOVIE_RECORD_HASH_SEED 0xCBF29CE484222325ull
+
+struct MovieRecordZapper
+{
+	uint8 x,y,b,bogo;
+	uint64 zaphit;
+};
+
 class MovieData;
 class MovieRecord
 {
@@ -117,10 +131,7 @@ public:
 	MovieRecord();
 	ValueArray<uint8,4> joysticks;
 
-	struct {
-		uint8 x,y,b,bogo;
-		uint64 zaphit;
-	} zappers[2];
+	MovieRecordZapper zappers[2];
 
 	//misc commands like reset, etc.
 	//small now to save space; we might need to support more commands later.
@@ -158,10 +169,13 @@ public:
 		return (joysticks[joy] & mask(bit))!=0;
 	}
 
-	bool Compare(MovieRecord& compareRec);
-	void Clone(MovieRecord& sourceRec);
+	bool Compare(const MovieRecord& compareRec);
+	void Clone(const MovieRecord& sourceRec);
 	void clear();
 
+	//folds the input of this record into an FNV-1a hash, start with MOVIE_RECORD_HASH_SEED
+	uint64 hash(uint64 h);
+
 	void parse(MovieData* md, EMUFILE* is);
 	bool parseBinary(MovieData* md, EMUFILE* is);
 	void dump(MovieData* md, EMUFILE* os, int index);
@@ -175,6 +189,175 @@ private:
 	int mask(int bit) { return 1<<bit; }
 };
 
+class MovieRecordList;
+
+//A record stored in a MovieRecordList, with the accessors of MovieRecord.
+//Assigning to it stores into the list. Zapper data can only be read through it.
+class MovieRecordRef
+{
+public:
+	//one joystick byte, reading it does not allocate the joystick column
+	class JoyByteRef
+	{
+	public:
+		operator uint8() const;
+		JoyByteRef& operator=(uint8 val);
+		JoyByteRef& operator=(const JoyByteRef& other) { return operator=((uint8)other); }
+		JoyByteRef& operator|=(uint8 val) { return operator=((uint8)*this | val); }
+		JoyByteRef& operator&=(uint8 val) { return operator=((uint8)*this & val); }
+		JoyByteRef& operator^=(uint8 val) { return operator=((uint8)*this ^ val); }
+		JoyByteRef(MovieRecordList* list, int index, int joy) : list(list), index(index), joy(joy) {}
+	private:
+		MovieRecordList* list;
+		int index, joy;
+	};
+
+	class JoystickRef
+	{
+	public:
+		JoyByteRef operator[](int joy) { return JoyByteRef(list, index, joy); }
+	private:
+		friend class MovieRecordRef;
+		JoystickRef(MovieRecordList* list, int index) : list(list), index(index) {}
+		MovieRecordList* list;
+		int index;
+	};
+
+	class CommandsRef
+	{
+	public:
+		operator uint8() const;
+		CommandsRef& operator=(uint8 val);
+		CommandsRef& operator=(const CommandsRef& other) { return operator=((uint8)other); }
+		CommandsRef& operator|=(uint8 val) { return operator=((uint8)*this | val); }
+		CommandsRef& operator&=(uint8 val) { return operator=((uint8)*this & val); }
+	private:
+		friend class MovieRecordRef;
+		CommandsRef(MovieRecordList* list, int index) : list(list), index(index) {}
+		MovieRecordList* list;
+		int index;
+	};
+
+	class ZappersRef
+	{
+	public:
+		MovieRecordZapper operator[](int port) const;
+	private:
+		friend class MovieRecordRef;
+		ZappersRef(MovieRecordList* list, int index) : list(list), index(index) {}
+		MovieRecordList* list;
+		int index;
+	};
+
+	MovieRecordRef(MovieRecordList* list, int index)
+		: joysticks(list, index), commands(list, index), zappers(list, index), list(list), index(index) {}
+
+	JoystickRef joysticks;
+	CommandsRef commands;
+	ZappersRef zappers;
+
+	operator MovieRecord() const;
+	MovieRecordRef& operator=(const MovieRecord& rec);
+	MovieRecordRef& operator=(const MovieRecordRef& ref) { return operator=((MovieRecord)ref); }
+
+	bool command_reset() { return (commands & MOVIECMD_RESET) != 0; }
+	bool command_power() { return (commands & MOVIECMD_POWER) != 0; }
+	bool command_fds_insert() { return (commands & MOVIECMD_FDS_INSERT) != 0; }
+	bool command_fds_select() { return (commands & MOVIECMD_FDS_SELECT) != 0; }
+	bool command_vs_insertcoin() { return (commands & MOVIECMD_VS_INSERTCOIN) != 0; }
+
+	void toggleBit(int joy, int bit) { joysticks[joy] ^= (1<<bit); }
+	void setBit(int joy, int bit) { joysticks[joy] |= (1<<bit); }
+	void clearBit(int joy, int bit) { joysticks[joy] &= ~(1<<bit); }
+	void setBitValue(int joy, int bit, bool val)
+	{
+		if(val) setBit(joy,bit);
+		else clearBit(joy,bit);
+	}
+	bool checkBit(int joy, int bit) { return (joysticks[joy] & (1<<bit))!=0; }
+
+	bool Compare(const MovieRecord& compareRec) { return ((MovieRecord)*this).Compare(compareRec); }
+	void Clone(const MovieRecord& sourceRec) { operator=(sourceRec); }
+	void clear() { operator=(MovieRecord()); }
+	uint64 hash(uint64 h) { return ((MovieRecord)*this).hash(h); }
+
+	void parse(MovieData* md, EMUFILE* is);
+	bool parseBinary(MovieData* md, EMUFILE* is);
+	void dump(MovieData* md, EMUFILE* os, int index) { ((MovieRecord)*this).dump(md, os, index); }
+	void dumpBinary(MovieData* md, EMUFILE* os, int index) { ((MovieRecord)*this).dumpBinary(md, os, index); }
+
+private:
+	MovieRecordList* list;
+	int index;
+};
+
+struct MovieRecordSource;
+
+//Movie input stored by columns: one byte stream per joystick, allocated once the
+//joystick has any input, and sparse tables for commands and zapper data, which are
+//empty on most frames. A standard two controller movie takes 2 bytes per frame
+//instead of the ~48 of a MovieRecord.
+//Records loaded from a movie file may still be encoded, they are decoded as they are first used.
+class MovieRecordList
+{
+public:
+	MovieRecordList() : count(0), pending(0), sourceNext(0) {}
+
+	size_t size() const { return count + pending; }
+	bool empty() const { return size() == 0; }
+	void clear() { resize(0); }
+	void resize(size_t n);
+	void reserve(size_t n);
+
+	void push_back(const MovieRecord& rec) { resize(count + 1); set((int)count - 1, rec); }
+	void insert(int at, const MovieRecord& rec) { insert(at, 1, rec); }
+	void insert(int at, int n, const MovieRecord& rec);
+	void erase(int at, int n = 1);
+
+	MovieRecordRef operator[](int index) { return MovieRecordRef(this, index); }
+	MovieRecord get(int index) const;
+	void set(int index, const MovieRecord& rec);
+
+	uint8 getJoystick(int index, int joy) const { need(index); return joy_col[joy].empty() ? 0 : joy_col[joy][index]; }
+	void setJoystick(int index, int joy, uint8 val);
+	uint8 getCommands(int index) const { need(index); return cmd_col.get(index); }
+	void setCommands(int index, uint8 val) { need(index); cmd_col.set(index, val); }
+	MovieRecordZapper getZapper(int index, int port) const { need(index); return zap_col[port].get(index); }
+	void setZapper(int index, int port, const MovieRecordZapper& val) { need(index); zap_col[port].set(index, val); }
+
+	//appends frames records that are decoded from source when first used
+	void setSource(const std::shared_ptr<MovieRecordSource>& source, int frames);
+
+private:
+	//(frame, value) pairs sorted by frame, for the frames where the value is not empty
+	template<typename T> struct SparseColumn
+	{
+		std::vector<std::pair<int,T> > entries;
+
+		size_t find(int index) const;	// position of the first entry at or after index
+		T get(int index) const;
+		void set(int index, const T& val);
+		void erase(int at, int n);
+		void shift(int at, int delta);
+	};
+
+	void need(int index) const
+	{
+		if ((size_t)index >= count && pending)
+			const_cast<MovieRecordList*>(this)->decode(index);
+	}
+	void needAll() { if (pending) decode((int)size() - 1); }
+	void decode(int index);
+
+	size_t count;		// decoded records
+	size_t pending;		// records still encoded in source
+	size_t sourceNext;	// first record of source that is not decoded
+	std::shared_ptr<MovieRecordSource> source;
+	std::vector<uint8> joy_col[4];
+	SparseColumn<uint8> cmd_col;
+	SparseColumn<MovieRecordZapper> zap_col[2];
+};
+
 class MovieData
 {
 public:
@@ -191,7 +374,7 @@ public:
 	std::string romFilename;
 	std::vector<uint8> savestate;
 	std::vector<uint8> saveram;
-	std::vector<MovieRecord> records;
+	MovieRecordList records;
 	std::vector<std::wstring> comments;
 	std::vector<std::string> subtitles;
 	//this is the RERECORD COUNT. please rename variable.
@@ -277,6 +460,9 @@ extern bool freshMovie;
 extern bool movie_readonly;
 extern bool autoMovieBackup;
 extern bool fullSaveStateLoads;
+extern bool slimMovieStates;
+extern bool journalMovieRecording;
+extern int movieKeyframeInterval;
 extern int movieRecordMode;
 
 //--------------------------------------------------
@@ -285,6 +471,10 @@ void FCEUI_CreateMovieFile(std::string fn);
 void FCEUI_SaveMovie(const char *fname, EMOVIE_FLAG flags, std::wstring author);
 bool FCEUI_LoadMovie(const char *fname, bool read_only, int _stopframe);
 void FCEUI_MoviePlayFromBeginning(void);
+bool FCEUI_MovieSeek(int frame);
+// Verifies segments shard, shard + shards, ... of the playing movie against its keyframes.
+// frame is set to the first desynced frame or -1, report describes the result.
+bool FCEUI_MovieVerify(int shard, int shards, int &frame, std::string &report);
 void FCEUI_StopMovie(void);
 bool FCEUI_MovieGetInfo(FCEUFILE* fp, MOVIE_INFO& info, bool skipFrameCount = false);
 //char* FCEUI_MovieGetCurrentName(int addSlotNumber);
@@ -0,0 +1,485 @@
+/// \file
+/// \brief Append-only journal for movie recording, compacted to FM2 in the background
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "movie.h"
+#include "moviejournal.h"
+#include "utils/endian.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Journal layout: "FCMJ", version, guid, then the length and record hash of the
+// movie the operations apply to, followed by the operations. A BASE operation marks
+// the point from which later operations apply to the movie a compaction writes out,
+// so whatever state the movie file is left in, replay can start at the matching base.
+#define MOVIEJOURNAL_VERSION       1
+#define MOVIEJOURNAL_COMPACT_SIZE  (1024 * 1024)	// journal size that triggers a compaction
+
+enum EMOVIEJOURNAL_OP
+{
+	MOVIEJOURNAL_OP_TRUNCATE = 1,	// u32 length
+	MOVIEJOURNAL_OP_APPEND,			// record
+	MOVIEJOURNAL_OP_SET,			// u32 frame, record
+	MOVIEJOURNAL_OP_INSERT,			// u32 frame, record
+	MOVIEJOURNAL_OP_RERECORDS,		// u32 rerecord count
+	MOVIEJOURNAL_OP_BASE,			// u32 length, u64 record hash
+};
+
+static const char journalMagic[4] = { 'F', 'C', 'M', 'J' };
+
+static EMUFILE_FILE *journal = NULL;
+static std::string movieFilename;
+static int journalLen = 0;			// number of records the journal describes
+static int dirtyFrom = INT_MAX;		// first record changed since it was journaled
+static int journalRerecords = 0;
+static int baseOffset = -1;			// offset of the BASE operation of the running compaction
+
+static std::thread compactThread;
+static std::atomic<bool> compactBusy(false);
+static std::atomic<bool> compactFailed(false);
+
+static std::string journalPath(const std::string &fname)
+{
+	return fname + ".journal";
+}
+
+static uint64 recordsHash(MovieData &md, int len)
+{
+	uint64 h = MOVIE_RECORD_HASH_SEED;
+
+	for (int i = 0; i < len; i++)
+	{
+		h = md.records[i].hash(h);
+	}
+	return h;
+}
+
+static void writeHeader(EMUFILE *os, FCEU_Guid &guid, int len, uint64 hash)
+{
+	os->fwrite(journalMagic, 4);
+	write32le(MOVIEJOURNAL_VERSION, os);
+	os->fwrite(guid.data, FCEU_Guid::size);
+	write32le(len, os);
+	write64le(hash, os);
+}
+
+// Writes the movie next to its file first, so the file is never left half written.
+static bool writeMovieFile(const std::string &fname, MovieData &md)
+{
+	std::string tmpName = fname + ".tmp";
+	EMUFILE_FILE *os = FCEUD_UTF8_fstream(tmpName, "wb");
+
+	if (!os || os->fail())
+	{
+		delete os;
+		return false;
+	}
+	md.dump(os, false);
+
+	bool ok = !os->fail();
+	delete os;
+
+	if (ok)
+	{
+#ifdef WIN32
+		remove(fname.c_str());
+#endif
+		ok = (rename(tmpName.c_str(), fname.c_str()) == 0);
+	}
+	if (!ok)
+	{
+		remove(tmpName.c_str());
+	}
+	return ok;
+}
+
+static void compactMovie(std::string fname, MovieData *snapshot)
+{
+	if (!writeMovieFile(fname, *snapshot))
+	{
+		compactFailed = true;
+	}
+	delete snapshot;
+	compactBusy = false;
+}
+
+static void waitCompaction(void)
+{
+	if (compactThread.joinable())
+	{
+		compactThread.join();
+	}
+}
+
+// Once the movie file holds the snapshot of a compaction, the operations before its
+// BASE are dropped by moving the rest of the journal to the front.
+static void finishCompaction(void)
+{
+	waitCompaction();
+
+	if (compactFailed)
+	{
+		FCEU_PrintError("Unable to compact the movie journal into %s, further edits are only kept in the journal until recording stops.", movieFilename.c_str());
+		baseOffset = -1;
+		return;
+	}
+	int end = journal->ftell();
+	int len = end - baseOffset;
+	std::vector<uint8> tail(len);
+
+	journal->fseek(baseOffset, SEEK_SET);
+	journal->fread(&tail[0], len);
+
+	// the BASE operation becomes the length and hash fields of the header
+	journal->fseek(4 + 4 + FCEU_Guid::size, SEEK_SET);
+	journal->fwrite(&tail[1], len - 1);
+	journal->truncate(journal->ftell());
+	journal->fseek(0, SEEK_END);
+	journal->fflush();
+
+	baseOffset = -1;
+}
+
+static void startCompaction(MovieData &md)
+{
+	// the snapshot is taken now, the thread only formats and writes it
+	MovieData *snapshot = new MovieData(md);
+	int len = (int)snapshot->records.size();
+
+	baseOffset = journal->ftell();
+	write8le(MOVIEJOURNAL_OP_BASE, journal);
+	write32le(len, journal);
+	write64le(recordsHash(*snapshot, len), journal);
+	journal->fflush();
+
+	compactBusy = true;
+	compactThread = std::thread(compactMovie, movieFilename, snapshot);
+}
+
+EMUFILE* FCEU_MovieJournalFile(void)
+{
+	return journal;
+}
+
+EMUFILE* FCEU_MovieJournalBegin(const char *fname, MovieData &md)
+{
+	std::string jname = journalPath(fname);
+	EMUFILE_FILE *os = FCEUD_UTF8_fstream(jname, "wb");
+
+	if (!os || os->fail())
+	{
+		delete os;
+		FCEU_PrintError("Error opening movie journal: %s", jname.c_str());
+		return NULL;
+	}
+	delete os;
+
+	// reopened for update, so the journal can be read back and truncated in place
+	journal = FCEUD_UTF8_fstream(jname, "r+b");
+	if (!journal || journal->fail())
+	{
+		delete journal;
+		journal = NULL;
+		FCEU_PrintError("Error opening movie journal: %s", jname.c_str());
+		return NULL;
+	}
+	movieFilename = fname;
+	journalLen = (int)md.records.size();
+	dirtyFrom = INT_MAX;
+	journalRerecords = md.rerecordCount;
+	baseOffset = -1;
+	compactFailed = false;
+
+	writeHeader(journal, md.guid, journalLen, recordsHash(md, journalLen));
+	journal->fflush();
+
+	return journal;
+}
+
+void FCEU_MovieJournalEnd(MovieData &md)
+{
+	if (!journal)
+	{
+		return;
+	}
+	waitCompaction();
+
+	delete journal;
+	journal = NULL;
+
+	if (writeMovieFile(movieFilename, md))
+	{
+		remove(journalPath(movieFilename).c_str());
+	}
+	else
+	{
+		FCEU_PrintError("Error writing movie file: %s\nThe recording is kept in %s and will be recovered when the movie is loaded.", movieFilename.c_str(), journalPath(movieFilename).c_str());
+	}
+}
+
+void FCEU_MovieJournalChangedAt(int frame)
+{
+	if (journal && (frame < dirtyFrom))
+	{
+		dirtyFrom = (frame > 0) ? frame : 0;
+	}
+}
+
+void FCEU_MovieJournalSync(MovieData &md)
+{
+	if (!journal)
+	{
+		return;
+	}
+	int len = (int)md.records.size();
+	int from = std::min(dirtyFrom, std::min(journalLen, len));
+
+	if (from < journalLen)
+	{
+		write8le(MOVIEJOURNAL_OP_TRUNCATE, journal);
+		write32le(from, journal);
+	}
+	for (int i = from; i < len; i++)
+	{
+		write8le(MOVIEJOURNAL_OP_APPEND, journal);
+		md.records[i].dumpBinary(&md, journal, i);
+	}
+	journalLen = len;
+	dirtyFrom = INT_MAX;
+
+	if (md.rerecordCount != journalRerecords)
+	{
+		write8le(MOVIEJOURNAL_OP_RERECORDS, journal);
+		write32le(md.rerecordCount, journal);
+		journalRerecords = md.rerecordCount;
+	}
+
+	if (compactBusy)
+	{
+		return;
+	}
+	if (baseOffset >= 0)
+	{
+		finishCompaction();
+	}
+	else if (!compactFailed && (journal->ftell() >= MOVIEJOURNAL_COMPACT_SIZE))
+	{
+		startCompaction(md);
+	}
+}
+
+void FCEU_MovieJournalSetFrame(MovieData &md, int frame)
+{
+	if (!journal)
+	{
+		return;
+	}
+	if ((dirtyFrom != INT_MAX) || (frame >= journalLen))
+	{
+		FCEU_MovieJournalChangedAt(frame);
+		FCEU_MovieJournalSync(md);
+		return;
+	}
+	write8le(MOVIEJOURNAL_OP_SET, journal);
+	write32le(frame, journal);
+	md.records[frame].dumpBinary(&md, journal, frame);
+}
+
+void FCEU_MovieJournalInsertFrame(MovieData &md, int frame)
+{
+	if (!journal)
+	{
+		return;
+	}
+	if ((dirtyFrom != INT_MAX) || (frame >= journalLen))
+	{
+		FCEU_MovieJournalChangedAt(frame);
+		FCEU_MovieJournalSync(md);
+		return;
+	}
+	write8le(MOVIEJOURNAL_OP_INSERT, journal);
+	write32le(frame, journal);
+	md.records[frame].dumpBinary(&md, journal, frame);
+	journalLen++;
+}
+
+void FCEU_MovieJournalFlush(void)
+{
+	if (journal)
+	{
+		journal->fflush();
+	}
+}
+
+// Size of a record in the binary format, which depends on the ports of the movie.
+static int recordSize(MovieData &md)
+{
+	EMUFILE_MEMORY os;
+	MovieRecord mr;
+
+	mr.dumpBinary(&md, &os, 0);
+	return os.size();
+}
+
+// Records are read in one piece, so a record cut short by the emulator going away
+// while writing it is noticed. The padding byte keeps parseBinary from taking the
+// end of the buffer for the end of the movie.
+static bool readRecord(EMUFILE *is, MovieData &md, int size, MovieRecord &mr)
+{
+	std::vector<uint8> buf(size + 1, 0);
+
+	if ((int)is->fread(&buf[0], size) != size)
+		return false;
+
+	EMUFILE_MEMORY ms(&buf);
+	return mr.parseBinary(&md, &ms);
+}
+
+// Reads the operands of one operation, returns false at the end of the journal or on
+// a truncated operation.
+static bool readOp(EMUFILE *is, uint8 op, MovieData &md, int recSize, uint32 &arg, uint64 &hash, MovieRecord &mr)
+{
+	switch (op)
+	{
+		case MOVIEJOURNAL_OP_TRUNCATE:
+		case MOVIEJOURNAL_OP_RERECORDS:
+			return read32le(&arg, is) != 0;
+		case MOVIEJOURNAL_OP_APPEND:
+			return readRecord(is, md, recSize, mr);
+		case MOVIEJOURNAL_OP_SET:
+		case MOVIEJOURNAL_OP_INSERT:
+			return read32le(&arg, is) && readRecord(is, md, recSize, mr);
+		case MOVIEJOURNAL_OP_BASE:
+			return read32le(&arg, is) && read64le(&hash, is);
+		default:
+			return false;
+	}
+}
+
+static bool applyOp(uint8 op, MovieData &md, uint32 arg, MovieRecord &mr)
+{
+	switch (op)
+	{
+		case MOVIEJOURNAL_OP_TRUNCATE:
+			if (arg > md.records.size())
+				return false;
+			md.records.resize(arg);
+			return true;
+		case MOVIEJOURNAL_OP_APPEND:
+			md.records.push_back(mr);
+			return true;
+		case MOVIEJOURNAL_OP_SET:
+			if (arg >= md.records.size())
+				return false;
+			md.records[arg] = mr;
+			return true;
+		case MOVIEJOURNAL_OP_INSERT:
+			if (arg > md.records.size())
+				return false;
+			md.records.insert(arg, mr);
+			return true;
+		case MOVIEJOURNAL_OP_RERECORDS:
+			md.rerecordCount = arg;
+			return true;
+		default:
+			return true;
+	}
+}
+
+bool FCEU_MovieJournalExists(const char *fname)
+{
+	EMUFILE_FILE *is = FCEUD_UTF8_fstream(journalPath(fname), "rb");
+	bool exists = is && !is->fail();
+
+	delete is;
+	return exists;
+}
+
+int FCEU_MovieJournalRecover(const char *fname, MovieData &md, bool write)
+{
+	std::string jname = journalPath(fname);
+	EMUFILE_FILE *is = FCEUD_UTF8_fstream(jname, "rb");
+
+	if (!is || is->fail())
+	{
+		delete is;
+		return 0;
+	}
+	char magic[4];
+	uint32 version = 0, len = 0;
+	uint64 hash = 0;
+	FCEU_Guid guid;
+
+	is->fread(magic, 4);
+	read32le(&version, is);
+	is->fread(guid.data, FCEU_Guid::size);
+
+	if (is->fail() || memcmp(magic, journalMagic, 4) || (version != MOVIEJOURNAL_VERSION) || (guid != md.guid))
+	{
+		delete is;
+		return 0;
+	}
+
+	// find the last base that matches the movie file, operations apply from there
+	int movieLen = (int)md.records.size();
+	uint64 movieHash = recordsHash(md, movieLen);
+	int recSize = recordSize(md);
+	int start = -1;
+
+	read32le(&len, is);
+	read64le(&hash, is);
+	if (((int)len == movieLen) && (hash == movieHash))
+	{
+		start = is->ftell();
+	}
+
+	uint8 op;
+	uint32 arg;
+	MovieRecord mr;
+
+	while (read8le(&op, is) && readOp(is, op, md, recSize, arg, hash, mr))
+	{
+		if ((op == MOVIEJOURNAL_OP_BASE) && ((int)arg == movieLen) && (hash == movieHash))
+		{
+			start = is->ftell();
+		}
+	}
+
+	if (start < 0)
+	{
+		FCEU_PrintError("Movie journal %s does not match %s and was not recovered.", jname.c_str(), fname);
+		delete is;
+		return 0;
+	}
+
+	int count = 0;
+	is->unfail();
+	is->fseek(start, SEEK_SET);
+	while (read8le(&op, is) && readOp(is, op, md, recSize, arg, hash, mr) && applyOp(op, md, arg, mr))
+	{
+		if (op != MOVIEJOURNAL_OP_BASE)
+			count++;
+	}
+	delete is;
+
+	if (!write)
+	{
+		return count;
+	}
+	if (count && !writeMovieFile(fname, md))
+	{
+		FCEU_PrintError("Error writing recovered movie file: %s", fname);
+		return count;
+	}
+	remove(jname.c_str());
+
+	return count;
+}
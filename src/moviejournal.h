@@ -0,0 +1,46 @@
+#ifndef _MOVIEJOURNAL_H_
+#define _MOVIEJOURNAL_H_
+
+// Journaled movie recording.
+//
+// While a journal is active, changes to the movie being recorded are appended
+// to a binary journal next to the movie file ("<movie>.journal") instead of
+// rewriting the whole FM2 on every rerecord or edit. The FM2 on disk is brought
+// up to date by a background thread once the journal has grown large enough,
+// and in full when recording ends. If the emulator goes away while recording,
+// the journal is replayed on top of the FM2 the next time the movie is loaded.
+
+class EMUFILE;
+class MovieData;
+
+// The journal file while one is active, NULL otherwise.
+EMUFILE* FCEU_MovieJournalFile(void);
+
+// Starts a journal for the movie file, which must hold exactly md. Returns the journal file.
+EMUFILE* FCEU_MovieJournalBegin(const char *fname, MovieData &md);
+
+// Writes md to the movie file and removes the journal.
+void FCEU_MovieJournalEnd(MovieData &md);
+
+// The records from frame onward no longer match what was journaled.
+void FCEU_MovieJournalChangedAt(int frame);
+
+// Journals all pending changes of md, may start a background compaction.
+void FCEU_MovieJournalSync(MovieData &md);
+
+// Journals a record that was overwritten or inserted at frame.
+void FCEU_MovieJournalSetFrame(MovieData &md, int frame);
+void FCEU_MovieJournalInsertFrame(MovieData &md, int frame);
+
+void FCEU_MovieJournalFlush(void);
+
+// Whether a journal was left behind for the movie file.
+bool FCEU_MovieJournalExists(const char *fname);
+
+// Replays a journal left behind for the movie file onto md (as loaded from that file).
+// With write the movie file is rewritten with the result and the journal removed,
+// otherwise both files are left as they are. Returns the number of journaled
+// operations recovered.
+int FCEU_MovieJournalRecover(const char *fname, MovieData &md, bool write);
+
+#endif
@@ -0,0 +1,585 @@
+/// \file
+/// \brief Savestate keyframes stored next to a movie, used to seek within it
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "movie.h"
+#include "moviekeyframes.h"
+#include "ppu.h"
+#include "debug.h"
+#include "utils/endian.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+// Keyframe file layout: "FCMK", version, movie guid, then the keyframes, each
+// u32 frame, u64 hash of the records before the frame, u32 count and the RAM
+// hashes of the count frames up to and including the frame, u32 savestate size,
+// u32 compressed size and the compressed savestate. A keyframe appended for a
+// frame replaces any earlier one for the same frame.
+#define MOVIEKEYFRAMES_VERSION  2
+
+#define MOVIEVERIFY_MAX_DIFFS   8	// differing bytes listed per memory area
+
+struct Keyframe
+{
+	int frame;
+	uint64 hash;
+	uint32 frameHashOffset;
+	uint32 frameHashCount;
+	uint32 offset;		// of the compressed savestate
+	uint32 size;
+	uint32 compressedSize;
+};
+
+static const char keyframesMagic[4] = { 'F', 'C', 'M', 'K' };
+
+int movieKeyframeInterval = 0;
+
+static std::string keyframesName;			// empty while no movie has a keyframe file
+static FCEU_Guid movieGuid;
+static EMUFILE_FILE *keyframesFile = NULL;	// opened by the first keyframe read or written
+static bool keyframesValid = false;			// keyframesFile has the header of this movie
+static uint32 writeOffset = 0;				// end of the last complete keyframe
+static std::vector<Keyframe> keyframes;		// sorted by frame
+
+// hash of the first hashFrame records of the current movie, extended as playback advances
+static int hashFrame = 0;
+static uint64 hashValue = MOVIE_RECORD_HASH_SEED;
+
+// RAM hashes of the frames played since the last keyframe, up to frameHashesEnd
+static std::vector<uint64> frameHashes;
+static int frameHashesEnd = -1;
+
+static bool verifying = false;
+
+static uint64 ramHash(void)
+{
+	uint64 h = MOVIE_RECORD_HASH_SEED;
+
+	//FNV-1a
+	for (int i = 0; i < 0x800; i++)
+	{
+		h ^= RAM[i];
+		h *= 0x100000001B3ull;
+	}
+	return h;
+}
+
+static uint64 prefixHash(int frame)
+{
+	if (frame < hashFrame)
+	{
+		hashFrame = 0;
+		hashValue = MOVIE_RECORD_HASH_SEED;
+	}
+	for (; hashFrame < frame; hashFrame++)
+	{
+		hashValue = currMovieData.records[hashFrame].hash(hashValue);
+	}
+	return hashValue;
+}
+
+static std::vector<Keyframe>::iterator findKeyframe(int frame)
+{
+	std::vector<Keyframe>::iterator it = keyframes.begin();
+
+	while ((it != keyframes.end()) && (it->frame < frame))
+	{
+		++it;
+	}
+	return it;
+}
+
+static void addKeyframe(const Keyframe &kf)
+{
+	std::vector<Keyframe>::iterator it = findKeyframe(kf.frame);
+
+	if ((it != keyframes.end()) && (it->frame == kf.frame))
+	{
+		*it = kf;
+	}
+	else
+	{
+		keyframes.insert(it, kf);
+	}
+}
+
+// Reads the keyframe index of an existing file, up to the last complete keyframe.
+static void readIndex(void)
+{
+	char magic[4];
+	uint32 version = 0;
+	FCEU_Guid guid;
+
+	if ((keyframesFile->fread(magic, 4) != 4) || !read32le(&version, keyframesFile) ||
+	    (keyframesFile->fread(guid.data, FCEU_Guid::size) != FCEU_Guid::size) ||
+	    keyframesFile->fail() || memcmp(magic, keyframesMagic, 4) || (version != MOVIEKEYFRAMES_VERSION) || (guid != movieGuid))
+	{
+		return;
+	}
+	keyframesValid = true;
+	writeOffset = keyframesFile->ftell();
+
+	uint32 end = keyframesFile->size();
+
+	for (;;)
+	{
+		Keyframe kf;
+		uint32 frame;
+
+		if (!read32le(&frame, keyframesFile) || !read64le(&kf.hash, keyframesFile) || !read32le(&kf.frameHashCount, keyframesFile))
+		{
+			break;
+		}
+		kf.frame = frame;
+		kf.frameHashOffset = keyframesFile->ftell();
+
+		if ((kf.frameHashCount > end / 8) || (kf.frameHashOffset > end - kf.frameHashCount * 8))
+		{
+			break;
+		}
+		keyframesFile->fseek(kf.frameHashCount * 8, SEEK_CUR);
+
+		if (!read32le(&kf.size, keyframesFile) || !read32le(&kf.compressedSize, keyframesFile))
+		{
+			break;
+		}
+		kf.offset = keyframesFile->ftell();
+
+		if ((kf.compressedSize > end) || (kf.offset > end - kf.compressedSize))
+		{
+			break;
+		}
+		keyframesFile->fseek(kf.compressedSize, SEEK_CUR);
+		writeOffset = kf.offset + kf.compressedSize;
+		addKeyframe(kf);
+	}
+	keyframesFile->unfail();
+}
+
+static bool openFile(bool forWrite)
+{
+	if (keyframesName.empty())
+	{
+		return false;
+	}
+	if (!keyframesFile)
+	{
+		keyframesFile = FCEUD_UTF8_fstream(keyframesName, "r+b");
+		if (keyframesFile && keyframesFile->fail())
+		{
+			delete keyframesFile;
+			keyframesFile = NULL;
+		}
+		if (keyframesFile)
+		{
+			readIndex();
+		}
+	}
+	if (!keyframesValid && forWrite)
+	{
+		// missing or made for another movie
+		delete keyframesFile;
+		keyframesFile = FCEUD_UTF8_fstream(keyframesName, "w+b");
+		if (!keyframesFile || keyframesFile->fail())
+		{
+			FCEU_PrintError("Error creating movie keyframes: %s", keyframesName.c_str());
+			delete keyframesFile;
+			keyframesFile = NULL;
+			keyframesName.clear();
+			return false;
+		}
+		keyframesFile->fwrite(keyframesMagic, 4);
+		write32le(MOVIEKEYFRAMES_VERSION, keyframesFile);
+		keyframesFile->fwrite(movieGuid.data, FCEU_Guid::size);
+		keyframesValid = true;
+		writeOffset = keyframesFile->ftell();
+		keyframes.clear();
+	}
+	return keyframesValid;
+}
+
+static void writeKeyframe(int frame, uint64 hash)
+{
+	EMUFILE_MEMORY state;
+
+	if (!FCEUMOV_SaveKeyframe(&state) || !openFile(true))
+	{
+		return;
+	}
+	uLongf compressedSize = compressBound(state.size());
+	std::vector<uint8> compressed(compressedSize);
+
+	if (compress2(&compressed[0], &compressedSize, state.buf(), state.size(), Z_BEST_SPEED) != Z_OK)
+	{
+		return;
+	}
+
+	Keyframe kf;
+	kf.frame = frame;
+	kf.hash = hash;
+	kf.size = state.size();
+	kf.compressedSize = compressedSize;
+
+	keyframesFile->fseek(writeOffset, SEEK_SET);
+	write32le((uint32)frame, keyframesFile);
+	write64le(hash, keyframesFile);
+	write32le((uint32)frameHashes.size(), keyframesFile);
+	kf.frameHashOffset = keyframesFile->ftell();
+	kf.frameHashCount = (uint32)frameHashes.size();
+	for (size_t i = 0; i < frameHashes.size(); i++)
+	{
+		write64le(frameHashes[i], keyframesFile);
+	}
+	write32le(kf.size, keyframesFile);
+	write32le(kf.compressedSize, keyframesFile);
+	kf.offset = keyframesFile->ftell();
+	keyframesFile->fwrite(&compressed[0], compressedSize);
+	keyframesFile->fflush();
+
+	if (keyframesFile->fail())
+	{
+		keyframesFile->unfail();
+		return;
+	}
+	writeOffset = kf.offset + kf.compressedSize;
+	addKeyframe(kf);
+}
+
+static bool loadKeyframe(const Keyframe &kf)
+{
+	std::vector<uint8> compressed(kf.compressedSize);
+	EMUFILE_MEMORY state(kf.size);
+	uLongf size = kf.size;
+
+	keyframesFile->fseek(kf.offset, SEEK_SET);
+	keyframesFile->fread(&compressed[0], kf.compressedSize);
+	if (keyframesFile->fail())
+	{
+		keyframesFile->unfail();
+		return false;
+	}
+	if ((uncompress(state.buf(), &size, &compressed[0], kf.compressedSize) != Z_OK) || (size != kf.size))
+	{
+		return false;
+	}
+	return FCEUMOV_LoadKeyframe(&state);
+}
+
+static bool readFrameHashes(const Keyframe &kf, std::vector<uint64> &hashes)
+{
+	hashes.resize(kf.frameHashCount);
+	keyframesFile->fseek(kf.frameHashOffset, SEEK_SET);
+
+	for (uint32 i = 0; i < kf.frameHashCount; i++)
+	{
+		if (!read64le(&hashes[i], keyframesFile))
+		{
+			keyframesFile->unfail();
+			return false;
+		}
+	}
+	return true;
+}
+
+// Emulates a frame without video or sound, whether or not the emulator is paused.
+// Like rollback it skips the output and per frame hooks (AVI, capture, autosave,
+// Lua) of FCEUI_Emulate, except that keyframes missing on the way are taken.
+static void runFrame(void)
+{
+	uint8 *gfx;
+	int32 *sound;
+	int32 ssize;
+
+	EmulationPaused = 0;
+	resimulatingFrames = true;
+	FCEUI_Emulate(&gfx, &sound, &ssize, 2);
+	resimulatingFrames = false;
+
+	FCEU_MovieKeyframesFrameEnd();
+}
+
+// The emulated memory compared by movie verification.
+struct VerifyMemory
+{
+	uint8 ram[0x800];
+	uint8 ntaram[0x800];
+	uint8 palram[0x20];
+	uint8 spram[0x100];
+
+	void take(void)
+	{
+		memcpy(ram, RAM, sizeof(ram));
+		memcpy(ntaram, NTARAM, sizeof(ntaram));
+		memcpy(palram, PALRAM, sizeof(palram));
+		memcpy(spram, SPRAM, sizeof(spram));
+	}
+};
+
+// Lists the bytes of an area that differ from the reference, returns their number.
+static int diffMemory(const char *name, const uint8 *mem, const uint8 *ref, int size, std::string &report)
+{
+	int count = 0;
+	std::string lines;
+	char buf[64];
+
+	for (int i = 0; i < size; i++)
+	{
+		if (mem[i] == ref[i])
+		{
+			continue;
+		}
+		if (count++ < MOVIEVERIFY_MAX_DIFFS)
+		{
+			sprintf(buf, "  $%04X: %02X, reference %02X\n", i, mem[i], ref[i]);
+			lines += buf;
+		}
+	}
+	if (count)
+	{
+		sprintf(buf, "%s: %d bytes differ\n", name, count);
+		report += buf + lines;
+	}
+	return count;
+}
+
+void FCEU_MovieKeyframesOpen(const char *fname, MovieData &md)
+{
+	FCEU_MovieKeyframesClose();
+
+	if (fname)
+	{
+		keyframesName = std::string(fname) + ".keyframes";
+		movieGuid = md.guid;
+	}
+}
+
+void FCEU_MovieKeyframesClose(void)
+{
+	delete keyframesFile;
+	keyframesFile = NULL;
+	keyframesValid = false;
+	keyframesName.clear();
+	keyframes.clear();
+	hashFrame = 0;
+	hashValue = MOVIE_RECORD_HASH_SEED;
+	frameHashes.clear();
+	frameHashesEnd = -1;
+}
+
+void FCEU_MovieKeyframesChangedAt(int frame)
+{
+	if (frame < hashFrame)
+	{
+		hashFrame = 0;
+		hashValue = MOVIE_RECORD_HASH_SEED;
+	}
+}
+
+void FCEU_MovieKeyframesFrameEnd(void)
+{
+	int frame = currFrameCounter;
+
+	if ((movieKeyframeInterval <= 0) || keyframesName.empty() || verifying || !FCEUMOV_Mode(MOVIEMODE_PLAY) ||
+	    (frame <= 0) || (frame > (int)currMovieData.records.size()))
+	{
+		return;
+	}
+	if (frame != frameHashesEnd + 1)
+	{
+		frameHashes.clear();
+	}
+	frameHashes.push_back(ramHash());
+	frameHashesEnd = frame;
+
+	if (frame % movieKeyframeInterval)
+	{
+		return;
+	}
+	uint64 hash = prefixHash(frame);
+
+	openFile(false);
+	std::vector<Keyframe>::iterator it = findKeyframe(frame);
+
+	if ((it == keyframes.end()) || (it->frame != frame) || (it->hash != hash))
+	{
+		writeKeyframe(frame, hash);
+	}
+	frameHashes.clear();
+}
+
+bool FCEUI_MovieSeek(int frame)
+{
+	if (!FCEUMOV_Mode(MOVIEMODE_PLAY | MOVIEMODE_FINISHED) || (frame < 0) || (frame > (int)currMovieData.records.size()))
+	{
+		return false;
+	}
+	if (frame == currFrameCounter)
+	{
+		return true;
+	}
+
+	// the latest keyframe at or before the frame that is ahead of the current position
+	int from = (currFrameCounter <= frame) ? currFrameCounter : 0;
+	int loaded = -1;
+
+	if (openFile(false))
+	{
+		std::vector<std::pair<int, uint64> > hashes;
+
+		for (size_t i = 0; (i < keyframes.size()) && (keyframes[i].frame <= frame); i++)
+		{
+			if (keyframes[i].frame > from)
+			{
+				hashes.push_back(std::make_pair((int)i, prefixHash(keyframes[i].frame)));
+			}
+		}
+		while (!hashes.empty() && (loaded < 0))
+		{
+			const Keyframe &kf = keyframes[hashes.back().first];
+
+			if ((kf.hash == hashes.back().second) && loadKeyframe(kf))
+			{
+				loaded = kf.frame;
+			}
+			hashes.pop_back();
+		}
+	}
+	if ((loaded < 0) && (currFrameCounter > frame))
+	{
+		FCEUI_MoviePlayFromBeginning();
+	}
+
+	// fast forward the rest
+	int paused = EmulationPaused;
+
+	while (FCEUMOV_Mode(MOVIEMODE_PLAY) && (currFrameCounter < frame))
+	{
+		runFrame();
+	}
+	EmulationPaused = paused;
+
+	return currFrameCounter == frame;
+}
+
+bool FCEUI_MovieVerify(int shard, int shards, int &frame, std::string &report)
+{
+	frame = -1;
+	report.clear();
+
+	if (!FCEUMOV_Mode(MOVIEMODE_PLAY | MOVIEMODE_FINISHED) || (shards < 1) || (shard < 0) || (shard >= shards) || !openFile(false))
+	{
+		report = "No movie keyframes to verify against.\n";
+		return false;
+	}
+
+	// the keyframes that belong to the movie as it is now
+	std::vector<Keyframe> refs;
+
+	for (size_t i = 0; i < keyframes.size(); i++)
+	{
+		if ((keyframes[i].frame <= (int)currMovieData.records.size()) && (keyframes[i].hash == prefixHash(keyframes[i].frame)))
+		{
+			refs.push_back(keyframes[i]);
+		}
+	}
+
+	int paused = EmulationPaused;
+	bool ok = true;
+	char buf[128];
+
+	verifying = true;
+
+	// segment s runs from keyframe s-1 (the movie start for s = 0) to keyframe s
+	for (size_t s = shard; (s < refs.size()) && ok && (frame < 0); s += shards)
+	{
+		const Keyframe &target = refs[s];
+		std::vector<uint64> hashes;
+		VerifyMemory mem, ref;
+		int start;
+
+		if (s == 0)
+		{
+			if (currFrameCounter != 0)
+			{
+				FCEUI_MoviePlayFromBeginning();
+			}
+			start = 0;
+		}
+		else if (loadKeyframe(refs[s - 1]))
+		{
+			start = refs[s - 1].frame;
+		}
+		else
+		{
+			sprintf(buf, "Unable to load the keyframe at frame %d.\n", refs[s - 1].frame);
+			report = buf;
+			ok = false;
+			break;
+		}
+		if ((currFrameCounter != start) || !readFrameHashes(target, hashes))
+		{
+			sprintf(buf, "Unable to start the segment at frame %d.\n", start);
+			report = buf;
+			ok = false;
+			break;
+		}
+
+		// hashes[i] is the reference for frame target.frame - hashes.size() + 1 + i
+		int firstHashed = target.frame - (int)hashes.size() + 1;
+
+		while (FCEUMOV_Mode(MOVIEMODE_PLAY) && (currFrameCounter < target.frame))
+		{
+			runFrame();
+
+			int i = currFrameCounter - firstHashed;
+
+			if ((frame < 0) && (i >= 0) && (i < (int)hashes.size()) && (ramHash() != hashes[i]))
+			{
+				frame = currFrameCounter;
+			}
+		}
+		mem.take();
+
+		if ((currFrameCounter != target.frame) || !loadKeyframe(target))
+		{
+			sprintf(buf, "Unable to reach the keyframe at frame %d.\n", target.frame);
+			report = buf;
+			ok = false;
+			break;
+		}
+		ref.take();
+
+		std::string diffs;
+		int count = diffMemory("RAM", mem.ram, ref.ram, sizeof(mem.ram), diffs);
+		count += diffMemory("Nametables", mem.ntaram, ref.ntaram, sizeof(mem.ntaram), diffs);
+		count += diffMemory("Palette", mem.palram, ref.palram, sizeof(mem.palram), diffs);
+		count += diffMemory("OAM", mem.spram, ref.spram, sizeof(mem.spram), diffs);
+
+		if ((frame < 0) && count)
+		{
+			frame = target.frame;
+		}
+		if (frame >= 0)
+		{
+			sprintf(buf, "Movie desyncs at frame %d (segment %d-%d).\n", frame, start, target.frame);
+			report = buf;
+			sprintf(buf, "Memory at frame %d compared to the reference:\n", target.frame);
+			report += buf;
+			report += count ? diffs : "  no differences left\n";
+		}
+	}
+	verifying = false;
+	EmulationPaused = paused;
+
+	if (ok && (frame < 0))
+	{
+		sprintf(buf, "Movie syncs with %d keyframes (shard %d of %d).\n", (int)refs.size(), shard + 1, shards);
+		report = buf;
+	}
+	return ok;
+}
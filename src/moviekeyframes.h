@@ -0,0 +1,32 @@
+#ifndef _MOVIEKEYFRAMES_H_
+#define _MOVIEKEYFRAMES_H_
+
+// Movie keyframes.
+//
+// While a movie plays, a compressed savestate is taken every movieKeyframeInterval
+// frames and appended to a file next to the movie ("<movie>.keyframes"). Each
+// keyframe carries the hash of the input that led to it, so keyframes stay usable
+// across sessions for as long as the movie before them is unchanged. Seeking loads
+// the nearest usable keyframe and emulates the remaining frames without video or
+// sound (FCEUI_MovieSeek).
+//
+// Keyframes also record a hash of the internal RAM for every frame since the
+// previous keyframe. FCEUI_MovieVerify replays the movie against them segment
+// by segment (keyframe to keyframe), so separate processes can each verify a
+// shard of the segments, and reports the first frame whose RAM hash differs
+// together with a RAM/PPU memory diff against the following keyframe.
+
+class MovieData;
+
+// Uses the keyframes of the movie file, if any. fname may be NULL for movies
+// that can't have a keyframe file (inside archives).
+void FCEU_MovieKeyframesOpen(const char *fname, MovieData &md);
+void FCEU_MovieKeyframesClose(void);
+
+// The input from frame onward changed, later keyframes no longer apply.
+void FCEU_MovieKeyframesChangedAt(int frame);
+
+// Called by the core at the end of every emulated frame.
+void FCEU_MovieKeyframesFrameEnd(void);
+
+#endif
@@ -45,6 +45,13 @@ static uint8 netjoy[4]; // Controller cache.
 static int numlocal;
 static int netdivisor;
 static int netdcount;
+static int netversion;
+
+// Protocol 2: inputs of all players for the frames of the current update,
+// and the local inputs captured for the next one.
+static uint8 netbatch[FCEUNP_MAX_BATCH][4];
+static uint8 netpending[FCEUNP_MAX_BATCH * 4];
+static int netpendingcount;
 
 //NetError should only be called after a FCEUD_*Data function returned 0, in the function
 //that called FCEUD_*Data, to prevent it from being called twice.
@@ -76,20 +83,36 @@ int FCEUI_NetplayStart(int nlocal, int divisor)
 	numlocal = nlocal;
 	netdivisor = divisor;
 	netdcount = 0;
+	netversion = 1;
+	memset(netbatch,0,sizeof(netbatch));
+	netpendingcount = 0;
 	return(1);
 }
 
+void FCEUI_NetplayLoginExtra(uint8 *extra)
+{
+	memset(extra, 0, 64);
+	extra[0] = FCEUNP_VERSION;
+}
+
+// Length of the input sent to the server per update, commands are escaped in its place.
+static uint32 InputLength(void)
+{
+	return (netversion >= 2) ? numlocal * netdivisor : numlocal;
+}
+
 int FCEUNET_SendCommand(uint8 cmd, uint32 len)
 {
 	//mbg merge 7/17/06 changed to alloca
 	//uint8 buf[numlocal + 1 + 4];
-	uint8 *buf = (uint8*)alloca(numlocal+1+4);
+	uint32 inlen = InputLength();
+	uint8 *buf = (uint8*)alloca(inlen+1+4);
 
 
 	buf[0] = 0xFF;
-	FCEU_en32lsb(&buf[numlocal], len);
-	buf[numlocal + 4] = cmd;
-	if(!FCEUD_SendData(buf,numlocal + 1 + 4))
+	FCEU_en32lsb(&buf[inlen], len);
+	buf[inlen + 4] = cmd;
+	if(!FCEUD_SendData(buf,inlen + 1 + 4))
 	{
 		NetError();
 		return(0);
@@ -195,11 +218,229 @@ static FILE *FetchFile(uint32 remlen)
 	return(0);
 }
 
+//Handles a command from the server, buf holds its 4 byte length and the command.
+//Returns 0 if network play can't continue.
+static int HandleCommand(uint8 *buf)
+{
+	switch(buf[4])
+	{
+	default: FCEU_DoSimpleCommand(buf[4]);break;
+	case FCEUNPCMD_TEXT:
+		{
+			uint8 *tbuf;
+			uint32 len = FCEU_de32lsb(buf);
+
+			if(len > 100000)  // Insanity check!
+			{
+				NetError();
+				return(0);
+			}
+			tbuf = (uint8*)malloc(len + 1); //mbg merge 7/17/06 added cast
+			tbuf[len] = 0;
+			if(!FCEUD_RecvData(tbuf, len))
+			{
+				NetError();
+				free(tbuf);
+				return(0);
+			}
+			FCEUD_NetplayText(tbuf);
+			free(tbuf);
+		}
+		break;
+	case FCEUNPCMD_SAVESTATE:
+		{
+			//mbg todo netplay
+			//char *fn;
+			//FILE *fp;
+
+			////Send the cheats first, then the save state, since
+			////there might be a frame or two in between the two sendfile
+			////commands on the server side.
+
+			//fn = strdup(FCEU_MakeFName(FCEUMKF_CHEAT,0,0).c_str());
+
+			////why??????
+			////if(!
+			//	FCEUNET_SendFile(FCEUNPCMD_LOADCHEATS,fn);
+			//// {
+			////  free(fn);
+			////  return;
+			//// }
+
+			//free(fn);
+			//if(!FCEUnetplay) return;
+
+			//fn = strdup(FCEU_MakeFName(FCEUMKF_NPTEMP,0,0).c_str());
+			//fp = fopen(fn, "wb");
+			//if(FCEUSS_SaveFP(fp,Z_BEST_COMPRESSION))
+			//{
+			//	fclose(fp);
+			//	if(!FCEUNET_SendFile(FCEUNPCMD_LOADSTATE, fn))
+			//	{
+			//		unlink(fn);
+			//		free(fn);
+			//		return;
+			//	}
+			//	unlink(fn);
+			//	free(fn);
+			//}
+			//else
+			//{
+			//	fclose(fp);
+			//	FCEUD_PrintError("File error.  (K)ill, (M)aim, (D)estroy?  Now!");
+			//	unlink(fn);
+			//	free(fn);
+			//	return;
+			//}
+
+		}
+		break;
+	case FCEUNPCMD_PROTOCOL:
+		{
+			uint8 version;
+
+			if(FCEU_de32lsb(buf) != 1 || !FCEUD_RecvData(&version, 1))
+			{
+				NetError();
+				return(0);
+			}
+			if(version != FCEUNP_VERSION || netdivisor > FCEUNP_MAX_BATCH)
+			{
+				NetError();
+				return(0);
+			}
+			//Everything the server sends from here on uses the new protocol.  Tell it that
+			//our input does too, the command itself still goes out in the old format.
+			if(!FCEUNET_SendCommand(FCEUNPCMD_PROTOCOL, 1))
+				return(0);
+			if(!FCEUD_SendData(&version, 1))
+			{
+				NetError();
+				return(0);
+			}
+			netversion = version;
+			netpendingcount = 0;
+			memset(netbatch, 0, sizeof(netbatch));
+			memcpy(netbatch[netdivisor - 1], netjoy, 4);
+		}
+		break;
+	case FCEUNPCMD_LOADCHEATS:
+		{
+			FILE *fp = FetchFile(FCEU_de32lsb(buf));
+			if(!fp) return(0);
+			FCEU_FlushGameCheats(0,1);
+			FCEU_LoadGameCheats(fp);
+		}
+		break;
+		//mbg 6/16/08 - netplay doesnt work right now anyway
+		/*case FCEUNPCMD_LOADSTATE:
+		{
+		FILE *fp = FetchFile(FCEU_de32lsb(buf));
+		if(!fp) return;
+		if(FCEUSS_LoadFP(fp,SSLOADPARAM_BACKUP))
+	 {
+	 fclose(fp);
+	 FCEU_DispMessage("Remote state loaded.",0);
+	 } else FCEUD_PrintError("File error.  (K)ill, (M)aim, (D)estroy?");
+	 }
+	 break;*/
+	}
+	return(1);
+}
+
+//Receives the next update in protocol 2, handling the commands that come before it.
+//An update is a length byte and, for each of its netdivisor frames, a byte with a bit
+//set for each controller that changed followed by the new values.  0xFF in place of
+//the length escapes a command.
+static int ReceiveBatch(void)
+{
+	uint8 buf[FCEUNP_MAX_BATCH * 5];
+
+	for(;;)
+	{
+		if(!FCEUD_RecvData(buf, 1))
+		{
+			NetError();
+			return(0);
+		}
+		if(buf[0] == 0xFF)
+		{
+			if(!FCEUD_RecvData(buf, 5))
+			{
+				NetError();
+				return(0);
+			}
+			if(!HandleCommand(buf))
+				return(0);
+			continue;
+		}
+
+		uint32 len = buf[0];
+		uint32 pos = 0;
+		uint8 joy[4];
+
+		if(len > (uint32)netdivisor * 5 || !FCEUD_RecvData(buf, len))
+		{
+			NetError();
+			return(0);
+		}
+		memcpy(joy, netbatch[netdivisor - 1], 4);
+		for(int f = 0; f < netdivisor; f++)
+		{
+			uint8 mask = (pos < len) ? buf[pos++] : 0xFF;
+
+			if(mask & 0xF0)
+			{
+				NetError();
+				return(0);
+			}
+			for(int x = 0; x < 4; x++)
+				if(mask & (1 << x))
+					joy[x] = (pos < len) ? buf[pos++] : 0;
+			memcpy(netbatch[f], joy, 4);
+		}
+		return(1);
+	}
+}
+
+//Protocol 2: the input of every frame is sent, netdivisor frames at a time, and the
+//frames of an update from the server are played back one per frame.
+static void NetplayUpdateBatch(uint8 *joyp)
+{
+	memcpy(&netpending[netpendingcount * numlocal], joyp, numlocal);
+	netpendingcount++;
+
+	if(!netdcount)
+	{
+		/* 0xFF at the start of the input is used as a command escape. */
+		if(netpending[0] == 0xFF)
+			netpending[0] = 0xF;
+		if(!FCEUD_SendData(netpending, netpendingcount * numlocal))
+		{
+			NetError();
+			return;
+		}
+		netpendingcount = 0;
+		if(!ReceiveBatch())
+			return;
+	}
+
+	memcpy(netjoy, netbatch[netdcount], 4);
+	*(uint32 *)joyp=*(uint32 *)netjoy;
+	netdcount=(netdcount+1)%netdivisor;
+}
+
 void NetplayUpdate(uint8 *joyp)
 {
 	static uint8 buf[5];  /* 4 play states, + command/extra byte */
 	static uint8 joypb[4];
 
+	if(netversion >= 2)
+	{
+		NetplayUpdateBatch(joyp);
+		return;
+	}
+
 	memcpy(joypb,joyp,4);
 
 	/* This shouldn't happen, but just in case.  0xFF is used as a command escape elsewhere. */
@@ -222,99 +463,18 @@ void NetplayUpdate(uint8 *joyp)
 				return;
 			}
 
-			switch(buf[4])
+			if(!HandleCommand(buf))
+				return;
+
+			if(netversion >= 2)
 			{
-			default: FCEU_DoSimpleCommand(buf[4]);break;
-			case FCEUNPCMD_TEXT:
-				{
-					uint8 *tbuf;
-					uint32 len = FCEU_de32lsb(buf);
-
-					if(len > 100000)  // Insanity check!
-					{
-						NetError();
-						return;
-					}
-					tbuf = (uint8*)malloc(len + 1); //mbg merge 7/17/06 added cast
-					tbuf[len] = 0;
-					if(!FCEUD_RecvData(tbuf, len))
-					{
-						NetError();
-						free(tbuf);
-						return;
-					}
-					FCEUD_NetplayText(tbuf);
-					free(tbuf);
-				}
-				break;
-			case FCEUNPCMD_SAVESTATE:
-				{
-					//mbg todo netplay
-					//char *fn;
-					//FILE *fp;
-
-					////Send the cheats first, then the save state, since
-					////there might be a frame or two in between the two sendfile
-					////commands on the server side.
-
-					//fn = strdup(FCEU_MakeFName(FCEUMKF_CHEAT,0,0).c_str());
-
-					////why??????
-					////if(!
-					//	FCEUNET_SendFile(FCEUNPCMD_LOADCHEATS,fn);
-					//// {
-					////  free(fn);
-					////  return;
-					//// }
-
-					//free(fn);
-					//if(!FCEUnetplay) return;
-
-					//fn = strdup(FCEU_MakeFName(FCEUMKF_NPTEMP,0,0).c_str());
-					//fp = fopen(fn, "wb");
-					//if(FCEUSS_SaveFP(fp,Z_BEST_COMPRESSION))
-					//{
-					//	fclose(fp);
-					//	if(!FCEUNET_SendFile(FCEUNPCMD_LOADSTATE, fn))
-					//	{
-					//		unlink(fn);
-					//		free(fn);
-					//		return;
-					//	}
-					//	unlink(fn);
-					//	free(fn);
-					//}
-					//else
-					//{
-					//	fclose(fp);
-					//	FCEUD_PrintError("File error.  (K)ill, (M)aim, (D)estroy?  Now!");
-					//	unlink(fn);
-					//	free(fn);
-					//	return;
-					//}
-
-				}
-				break;
-			case FCEUNPCMD_LOADCHEATS:
-				{
-					FILE *fp = FetchFile(FCEU_de32lsb(buf));
-					if(!fp) return;
-					FCEU_FlushGameCheats(0,1);
-					FCEU_LoadGameCheats(fp);
-				}
-				break;
-				//mbg 6/16/08 - netplay doesnt work right now anyway
-				/*case FCEUNPCMD_LOADSTATE:
-				{
-				FILE *fp = FetchFile(FCEU_de32lsb(buf));
-				if(!fp) return;
-				if(FCEUSS_LoadFP(fp,SSLOADPARAM_BACKUP))
-			 {
-			 fclose(fp);
-			 FCEU_DispMessage("Remote state loaded.",0);
-			 } else FCEUD_PrintError("File error.  (K)ill, (M)aim, (D)estroy?");
-			 }
-			 break;*/
+				//The server switched protocols, the update for this frame comes in the new one.
+				if(!ReceiveBatch())
+					return;
+				memcpy(netjoy, netbatch[0], 4);
+				*(uint32 *)joyp=*(uint32 *)netjoy;
+				netdcount=(netdcount+1)%netdivisor;
+				return;
 			}
 		} while(buf[4]);
 
@@ -17,7 +17,14 @@ extern int FCEUnetplay;
 
 #define FCEUNPCMD_SAVESTATE     0x81 /* Sent from server to client. */
 #define FCEUNPCMD_LOADCHEATS	0x82
+#define FCEUNPCMD_PROTOCOL	0x83 /* Protocol version, sent by the server to switch and
+                                     echoed by the client when its input switches too. */
 #define FCEUNPCMD_TEXT		0x90
 
+/* Protocol 2 sends the input of every frame, netdivisor frames per update, and only
+   the bytes that changed from the previous frame in updates from the server. */
+#define FCEUNP_VERSION    2
+#define FCEUNP_MAX_BATCH  16
+
 int FCEUNET_SendCommand(uint8, uint32);
 int FCEUNET_SendFile(uint8 cmd, char *);
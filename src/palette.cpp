@@ -73,6 +73,7 @@ static void WritePalette(void);
 
 //points to the actually selected current palette
 pal *palo = NULL;
+uint32 paletteLUT[512];
 
 #define RGB_TO_YIQ( r, g, b, y, i ) (\
 	(y = (r) * 0.299f + (g) * 0.587f + (b) * 0.114f),\
@@ -546,6 +547,9 @@ void WritePalette(void)
 	//sets palette entries >= 128 with the 64 selected main colors
 	for(x=0;x<64;x++)
 		FCEUD_SetPalette(128+x,palo[x].r,palo[x].g,palo[x].b);
+
+	for(x=0;x<512;x++)
+		paletteLUT[x]=(palo[x].r<<16)|(palo[x].g<<8)|palo[x].b;
 	SetNESDeemph_OldHacky(lastd,1);
 	#ifdef _S9XLUA_H
 	FCEU_LuaUpdatePalette();
@@ -5,6 +5,28 @@ typedef struct {
 extern pal *palo;
 void FCEU_ResetPalette(void);
 
+// palo as 0x00RRGGBB by color | emphasis << 6, rebuilt whenever the palette is
+// written. Blitters, screenshots and captures all take their colors from here.
+extern uint32 paletteLUT[512];
+
+// Tables that follow the 512 PPU colors with the 256 colors of the 8 bit palette
+// start those here.
+#define PALETTE_8BIT 512
+
+// Index into such a table for an XBuf pixel and the XDBuf emphasis under it. The
+// PPU tags its pixels in the top two bits by emphasis (0x80 none, 0xC0 all three,
+// 0x40 otherwise); a pixel without the right tag was drawn over by the GUI or Lua
+// and keeps its 8 bit palette color.
+static inline int FCEU_PaletteIndex(uint8 pixel, uint8 emph)
+{
+	static const uint8 tag[8] = { 0x80, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0xC0 };
+
+	emph &= 7;
+	if ((pixel & 0xC0) == tag[emph])
+		return (pixel & 0x3F) | (emph << 6);
+	return PALETTE_8BIT + pixel;
+}
+
 void FCEU_ResetPalette(void);
 void FCEU_ResetMessages();
 void FCEU_LoadGamePalette(void);
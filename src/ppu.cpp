@@ -36,6 +36,7 @@
 #include "input.h"
 #include "driver.h"
 #include "debug.h"
+#include "vramtrack.h"
 		 
 #include <cstring>
 #include <cstdio>
@@ -429,8 +430,10 @@ inline void FFCEUX_PPUWrite_Default(uint32 A, uint8 V) {
 	if (PPU_hook) PPU_hook(A);
 
 	if (tmp < 0x2000) {
-		if (PPUCHRRAM & (1 << (tmp >> 10)))
+		if (PPUCHRRAM & (1 << (tmp >> 10))) {
 			VPage[tmp >> 10][tmp] = V;
+			FCEU_VRAMTrackWrite(tmp);
+		}
 	} else if (tmp < 0x3F00) {
 		if (QTAIHack && (qtaintramreg & 1)) {
 			QTAINTRAM[((((tmp & 0xF00) >> 10) >> ((qtaintramreg >> 1)) & 1) << 10) | (tmp & 0x3FF)] = V;
@@ -962,8 +965,10 @@ static DECLFW(B2007) {
 	} else {
 		PPUGenLatch = V;
 		if (tmp < 0x2000) {
-			if (PPUCHRRAM & (1 << (tmp >> 10)))
+			if (PPUCHRRAM & (1 << (tmp >> 10))) {
 				VPage[tmp >> 10][tmp] = V;
+				FCEU_VRAMTrackWrite(tmp);
+			}
 		} else if (tmp < 0x3F00) {
 			if (QTAIHack && (qtaintramreg & 1)) {
 				QTAINTRAM[((((tmp & 0xF00) >> 10) >> ((qtaintramreg >> 1)) & 1) << 10) | (tmp & 0x3FF)] = V;
@@ -1727,6 +1732,7 @@ void FCEUPPU_Power(void) {
 	memset(UPALRAM, 0x00, 0x03);
 	memset(SPRAM, 0x00, 0x100);
 	FCEUPPU_Reset();
+	FCEU_VRAMTrackInvalidate();
 
 	for (x = 0x2000; x < 0x4000; x += 8) {
 		ARead[x] = A200x;
@@ -1900,6 +1906,7 @@ static uint16 TempAddrT, RefreshAddrT;
 void FCEUPPU_LoadState(int version) {
 	TempAddr = TempAddrT;
 	RefreshAddr = RefreshAddrT;
+	FCEU_VRAMTrackInvalidate();
 }
 
 SFORMAT FCEUPPU_STATEINFO[] = {
@@ -0,0 +1,363 @@
+/// \file
+/// \brief Rollback network play with input prediction and in-memory savestates
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "emufile.h"
+#include "movie.h"
+#include "netplay.h"
+#include "state.h"
+#include "rollback.h"
+#include "utils/endian.h"
+
+#include <cstring>
+#include <zlib.h>
+
+// Input packet: 'R', u32 first frame, u32 last frame of the receiver's input
+// the sender has (-1 for none), s32 how many frames the sender runs ahead of
+// the input it has, u8 count and the sender's input for count frames.
+#define ROLLBACK_PACKET_HEADER  14
+#define ROLLBACK_PACKET_MAX     (ROLLBACK_PACKET_HEADER + 255)
+
+#define ROLLBACK_INPUT_RING     (ROLLBACK_MAX_FRAMES * 4)
+#define ROLLBACK_POLL           5		// ms to wait for a packet while stalled
+#define ROLLBACK_TIMEOUT        15000	// ms stalled without a packet before giving up
+#define ROLLBACK_SYNC_FRAMES    2		// frames ahead of the peer before slowing down
+
+uint64 FCEUD_GetTime(void);
+uint64 FCEUD_GetTimeFreq(void);
+
+static bool active = false;
+static bool resimulating = false;
+static int localPort;
+
+static int frame;			// the next frame to emulate
+static int confirmed;		// last frame of remote input received, with all the ones before it
+static int peerAck;			// last frame of local input the peer has
+static int mismatch;		// first emulated frame whose predicted input turned out wrong, -1 if none
+static int remoteAhead;		// frames the peer runs ahead of the input it has, as last reported
+
+static uint8 localInput[ROLLBACK_INPUT_RING];
+static uint8 remoteInput[ROLLBACK_INPUT_RING];
+static uint8 usedInput[ROLLBACK_INPUT_RING];	// remote input the frame was emulated with
+
+// savestates taken at the start of the last ROLLBACK_MAX_FRAMES frames
+static EMUFILE_MEMORY states[ROLLBACK_MAX_FRAMES];
+
+static int rollbacks;
+static int rolledFrames;
+static int userRAMInitSeed;	// RAMInitSeed before the session took it over
+
+static void rollbackError(void)
+{
+	FCEU_DispMessage("Network error/connection lost!",0);
+	FCEUI_RollbackStop();
+}
+
+static int aheadOfInput(void)
+{
+	return frame - (confirmed + 1);
+}
+
+static bool sendInput(void)
+{
+	uint8 buf[ROLLBACK_PACKET_MAX];
+	int first = peerAck + 1;
+
+	if (frame - first > 255)
+	{
+		first = frame - 255;
+	}
+	int count = frame - first;
+
+	buf[0] = 'R';
+	FCEU_en32lsb(buf + 1, first);
+	FCEU_en32lsb(buf + 5, confirmed);
+	FCEU_en32lsb(buf + 9, aheadOfInput());
+	buf[13] = count;
+
+	for (int i = 0; i < count; i++)
+	{
+		buf[ROLLBACK_PACKET_HEADER + i] = localInput[(first + i) % ROLLBACK_INPUT_RING];
+	}
+	return FCEUD_RollbackSend(buf, ROLLBACK_PACKET_HEADER + count) != 0;
+}
+
+static void readPacket(uint8 *buf, int len)
+{
+	if ((len < ROLLBACK_PACKET_HEADER) || (buf[0] != 'R') || (len < ROLLBACK_PACKET_HEADER + buf[13]))
+	{
+		return;
+	}
+	int first = (int)FCEU_de32lsb(buf + 1);
+	int ack = (int)FCEU_de32lsb(buf + 5);
+	int count = buf[13];
+
+	if ((ack > peerAck) && (ack < frame))
+	{
+		peerAck = ack;
+	}
+	if (first + count - 1 > confirmed)
+	{
+		remoteAhead = (int)FCEU_de32lsb(buf + 9);
+	}
+
+	// packets may arrive out of order, only take input that continues what was received
+	for (int i = 0; i < count; i++)
+	{
+		int f = first + i;
+		int slot = f % ROLLBACK_INPUT_RING;
+
+		if (f <= confirmed)
+		{
+			continue;
+		}
+		if ((f != confirmed + 1) || (f < 0))
+		{
+			break;
+		}
+		remoteInput[slot] = buf[ROLLBACK_PACKET_HEADER + i];
+		confirmed = f;
+
+		if ((f < frame) && (usedInput[slot] != remoteInput[slot]) && (mismatch < 0))
+		{
+			mismatch = f;
+		}
+	}
+}
+
+// Reads the packets that arrived, waiting up to timeout ms for the first one.
+// Returns the number of packets read, -1 on failure.
+static int receive(int timeout)
+{
+	uint8 buf[ROLLBACK_PACKET_MAX];
+	int packets = 0;
+
+	for (;;)
+	{
+		int len = FCEUD_RollbackRecv(buf, sizeof(buf), packets ? 0 : timeout);
+
+		if (len < 0)
+		{
+			return -1;
+		}
+		if (len == 0)
+		{
+			return packets;
+		}
+		readPacket(buf, len);
+		packets++;
+	}
+}
+
+// Waits until the input of the peer is close enough to emulate the next frame,
+// and for a frame's time if this peer runs ahead of the other one.
+static bool waitForPeer(void)
+{
+	uint64 freq = FCEUD_GetTimeFreq();
+	uint64 frameTime = (freq << 24) / FCEUI_GetDesiredFPS();
+	uint64 start = FCEUD_GetTime();
+	uint64 lastPacket = start;
+
+	bool pace = aheadOfInput() - remoteAhead >= ROLLBACK_SYNC_FRAMES;
+
+	for (;;)
+	{
+		uint64 now = FCEUD_GetTime();
+
+		if (aheadOfInput() < ROLLBACK_MAX_FRAMES)
+		{
+			if (!pace || (now - start >= frameTime))
+			{
+				return true;
+			}
+		}
+		else if (now - lastPacket > (freq * ROLLBACK_TIMEOUT) / 1000)
+		{
+			return false;
+		}
+
+		// keep the peer supplied while stalled, it may be waiting for this peer
+		if ((aheadOfInput() >= ROLLBACK_MAX_FRAMES) && !sendInput())
+		{
+			return false;
+		}
+		int packets = receive(ROLLBACK_POLL);
+
+		if (packets < 0)
+		{
+			return false;
+		}
+		if (packets > 0)
+		{
+			lastPacket = FCEUD_GetTime();
+		}
+	}
+}
+
+static void saveState(void)
+{
+	EMUFILE_MEMORY &ms = states[frame % ROLLBACK_MAX_FRAMES];
+
+	ms.set_len(0);
+	ms.unfail();
+	FCEUSS_SaveMS(&ms, Z_NO_COMPRESSION);
+}
+
+// Goes back to the first mispredicted frame and emulates up to the current one again.
+static bool rollBack(void)
+{
+	int target = frame;
+	int counter = currFrameCounter;
+	int paused = EmulationPaused;
+	EMUFILE_MEMORY &ms = states[mismatch % ROLLBACK_MAX_FRAMES];
+
+	ms.fseek(0, SEEK_SET);
+
+	if (!FCEUSS_LoadFP(&ms, SSLOADPARAM_NOBACKUP))
+	{
+		return false;
+	}
+	rollbacks++;
+	rolledFrames += target - mismatch;
+
+	frame = mismatch;
+	mismatch = -1;
+	resimulating = true;
+	resimulatingFrames = true;
+
+	while (active && (frame < target))
+	{
+		uint8 *gfx;
+		int32 *sound;
+		int32 ssize;
+
+		EmulationPaused = 0;
+		FCEUI_Emulate(&gfx, &sound, &ssize, 2);
+	}
+	resimulatingFrames = false;
+	resimulating = false;
+	EmulationPaused = paused;
+	currFrameCounter = counter;
+
+	return active;
+}
+
+void FCEU_RollbackFrameBegin(void)
+{
+	if (!active)
+	{
+		return;
+	}
+	if (!resimulating)
+	{
+		if ((receive(0) < 0) || !waitForPeer())
+		{
+			rollbackError();
+			return;
+		}
+		if ((mismatch >= 0) && !rollBack())
+		{
+			rollbackError();
+			return;
+		}
+	}
+	saveState();
+}
+
+void FCEU_RollbackInput(uint8 *joyp)
+{
+	if (!active)
+	{
+		return;
+	}
+	int slot = frame % ROLLBACK_INPUT_RING;
+
+	if (!resimulating)
+	{
+		localInput[slot] = joyp[0];
+	}
+
+	// predict the remote player keeps holding what was last received
+	if (frame > confirmed)
+	{
+		usedInput[slot] = (confirmed >= 0) ? remoteInput[confirmed % ROLLBACK_INPUT_RING] : 0;
+	}
+	else
+	{
+		usedInput[slot] = remoteInput[slot];
+	}
+
+	joyp[localPort] = localInput[slot];
+	joyp[localPort ^ 1] = usedInput[slot];
+	joyp[2] = joyp[3] = 0;
+	frame++;
+
+	if (!resimulating && !sendInput())
+	{
+		rollbackError();
+	}
+}
+
+int FCEUI_RollbackStart(int localPort_)
+{
+	extern int RAMInitSeed;
+	extern int disableBatteryLoading;
+
+	if (!GameInfo || FCEUnetplay || !FCEUMOV_Mode(MOVIEMODE_INACTIVE))
+	{
+		return 0;
+	}
+
+	// both peers have to start from the same state
+	int battery = disableBatteryLoading;
+
+	disableBatteryLoading = 1;
+	userRAMInitSeed = RAMInitSeed;
+	RAMInitSeed = FCEU_de32lsb(GameInfo->MD5.data);
+	PowerNES();
+	disableBatteryLoading = battery;
+
+	localPort = localPort_ & 1;
+	frame = 0;
+	confirmed = -1;
+	peerAck = -1;
+	mismatch = -1;
+	remoteAhead = 0;
+	rollbacks = 0;
+	rolledFrames = 0;
+	resimulating = false;
+	active = true;
+
+	FCEU_DispMessage("Rollback netplay started as player %d.", 0, localPort + 1);
+	return 1;
+}
+
+void FCEUI_RollbackStop(void)
+{
+	extern int RAMInitSeed;
+
+	if (!active)
+	{
+		return;
+	}
+	active = false;
+	RAMInitSeed = userRAMInitSeed;
+
+	for (int i = 0; i < ROLLBACK_MAX_FRAMES; i++)
+	{
+		states[i].truncate(0);
+	}
+	FCEU_printf("Rollback netplay stopped: %d rollbacks, %d frames emulated again.\n", rollbacks, rolledFrames);
+}
+
+bool FCEUI_RollbackActive(void)
+{
+	return active;
+}
+
+void FCEUI_RollbackGetStats(int *rollbacks_, int *frames)
+{
+	*rollbacks_ = rollbacks;
+	*frames = rolledFrames;
+}
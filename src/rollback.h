@@ -0,0 +1,28 @@
+#ifndef _ROLLBACK_H_
+#define _ROLLBACK_H_
+
+// Rollback network play.
+//
+// Instead of waiting every frame for the input of the other player like the
+// server based netplay does, both peers exchange their input directly and
+// keep emulating with the remote input predicted to stay what it was last
+// frame. An in-memory savestate is kept for each of the last
+// ROLLBACK_MAX_FRAMES frames; when remote input arrives that contradicts the
+// prediction, the frame it belongs to is loaded and the frames since are
+// emulated again without video or sound. A peer only waits when it gets more
+// than ROLLBACK_MAX_FRAMES ahead of the input it received, and paces itself
+// down when it runs ahead of the other peer.
+//
+// The driver provides an unreliable datagram transport; packets carry all of
+// the input the peer hasn't acknowledged yet, so losing or reordering them
+// only delays confirmation. The interface used by drivers is in driver.h.
+
+#define ROLLBACK_MAX_FRAMES  64
+
+// Called by the core at the start of every emulated frame, before input is read.
+void FCEU_RollbackFrameBegin(void);
+
+// Replaces the input of the frame with the local and the remote player's.
+void FCEU_RollbackInput(uint8 *joyp);
+
+#endif
@@ -0,0 +1,295 @@
+/// \file
+/// \brief Memory mapped cache of the metadata of loaded ROMs, see romcache.h
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "file.h"
+#include "romcache.h"
+#include "utils/crc32.h"
+#include "utils/memory.h"
+
+#include <sys/stat.h>
+#ifdef WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define ROMCACHE_VERSION    1
+#define ROMCACHE_BYTEORDER  0x01020304
+#define ROMCACHE_FILE       "romcache.dat"
+
+// The entries follow the header, sorted by key. Both are in the byte order of
+// the machine that wrote them, a file from another one is ignored.
+struct RomCacheHeader
+{
+	char   magic[8];     // "FCEUXRC"
+	uint32 version;
+	uint32 byteOrder;
+	uint32 entrySize;
+	uint32 count;
+	uint32 reserved[2];  // keeps the entries 8 byte aligned
+};
+
+const RomCacheEntry *romCacheCurrent = NULL;
+
+static std::mutex cacheLock;
+static bool opened = false;              // tried to map the file
+static void *mapping = NULL;
+static uint32 mappingSize = 0;
+static const RomCacheEntry *mapped = NULL;
+static uint32 mappedCount = 0;
+static std::vector<RomCacheEntry> added; // not written yet, sorted by key
+
+static bool KeyLess(const RomCacheEntry &a, const RomCacheEntry &b)
+{
+	if (a.size != b.size)
+		return a.size < b.size;
+	if (a.mtime != b.mtime)
+		return a.mtime < b.mtime;
+	return a.crc32 < b.crc32;
+}
+
+static bool SameKey(const RomCacheEntry &a, const RomCacheEntry &b)
+{
+	return a.size == b.size && a.mtime == b.mtime && a.crc32 == b.crc32;
+}
+
+static std::string CachePath(void)
+{
+	std::string dir = FCEUI_GetBaseDirectory();
+
+	if (dir.empty())
+		return "";
+	return dir + PSS + ROMCACHE_FILE;
+}
+
+static void UnmapCache(void)
+{
+	if (mapping)
+		FCEU_UnmapFile(mapping, mappingSize);
+	mapping = NULL;
+	mappingSize = 0;
+	mapped = NULL;
+	mappedCount = 0;
+	opened = false;
+}
+
+static void MapCache(void)
+{
+	if (opened)
+		return;
+	opened = true;
+
+	std::string path = CachePath();
+	FILE *fp = path.empty() ? NULL : fopen(path.c_str(), "rb");
+
+	if (!fp)
+		return;
+	mapping = FCEU_MapFile(fp, &mappingSize);
+	fclose(fp);
+	if (!mapping)
+		return;
+
+	const RomCacheHeader *head = (const RomCacheHeader *)mapping;
+
+	if (mappingSize < sizeof(RomCacheHeader)
+		|| memcmp(head->magic, "FCEUXRC", 8)
+		|| head->version != ROMCACHE_VERSION
+		|| head->byteOrder != ROMCACHE_BYTEORDER
+		|| head->entrySize != sizeof(RomCacheEntry)
+		|| head->count > (mappingSize - sizeof(RomCacheHeader)) / sizeof(RomCacheEntry))
+	{
+		FCEU_printf("Ignoring the ROM cache, it was written by another version.\n");
+		UnmapCache();
+		opened = true;
+		return;
+	}
+	mapped = (const RomCacheEntry *)(head + 1);
+	mappedCount = head->count;
+}
+
+bool FCEU_RomCacheKey(FCEUFILE *fp, RomCacheEntry *entry)
+{
+	const std::string &path = fp->archiveFilename != "" ? fp->archiveFilename : fp->fullFilename;
+	struct stat st;
+
+	if (stat(path.c_str(), &st))
+		return false;
+
+	std::vector<uint8> buf(0x10000);
+	uint32 crc = 0;
+	uint64 len;
+
+	memset(entry, 0, sizeof(*entry));
+	entry->size = FCEU_fgetsize(fp);
+	entry->mtime = (uint64)st.st_mtime;
+
+	FCEU_fseek(fp, 0, SEEK_SET);
+	while ((len = FCEU_fread(&buf[0], 1, buf.size(), fp)) > 0)
+		crc = CalcCRC32(crc, &buf[0], (uint32)len);
+	FCEU_fseek(fp, 0, SEEK_SET);
+
+	entry->crc32 = crc;
+	return true;
+}
+
+bool FCEUI_RomCacheFind(RomCacheEntry *entry)
+{
+	std::lock_guard<std::mutex> guard(cacheLock);
+
+	MapCache();
+
+	std::vector<RomCacheEntry>::iterator a = std::lower_bound(added.begin(), added.end(), *entry, KeyLess);
+	if (a != added.end() && SameKey(*a, *entry))
+	{
+		*entry = *a;
+		return true;
+	}
+
+	const RomCacheEntry *m = std::lower_bound(mapped, mapped + mappedCount, *entry, KeyLess);
+	if (m != mapped + mappedCount && SameKey(*m, *entry))
+	{
+		*entry = *m;
+		return true;
+	}
+	return false;
+}
+
+static void FlushAtExit(void)
+{
+	FCEUI_RomCacheFlush();
+}
+
+void FCEUI_RomCacheAdd(const RomCacheEntry &entry)
+{
+	std::lock_guard<std::mutex> guard(cacheLock);
+	std::vector<RomCacheEntry>::iterator a = std::lower_bound(added.begin(), added.end(), entry, KeyLess);
+
+	if (a != added.end() && SameKey(*a, entry))
+		*a = entry;
+	else
+		added.insert(a, entry);
+
+	// drivers leaving through exit() without FCEUI_Kill() still get the entries written
+	static bool registered = false;
+	if (!registered)
+		registered = atexit(FlushAtExit) == 0;
+}
+
+// true if the file isn't the one stat() found before
+static bool CacheChanged(const std::string &path, bool existed, const struct stat &before)
+{
+	struct stat now;
+	bool exists = !stat(path.c_str(), &now);
+
+	if (exists != existed)
+		return true;
+	return exists && (now.st_ino != before.st_ino || now.st_size != before.st_size || now.st_mtime != before.st_mtime);
+}
+
+// Writes the mapped entries merged with the added ones to temp.
+static bool WriteMerged(const std::string &temp)
+{
+	// both are sorted; an added entry replaces the mapped one with its key
+	std::vector<RomCacheEntry> merged;
+	uint32 m = 0;
+
+	merged.reserve(mappedCount + added.size());
+	for (size_t a = 0; a < added.size(); a++)
+	{
+		while (m < mappedCount && KeyLess(mapped[m], added[a]))
+			merged.push_back(mapped[m++]);
+		if (m < mappedCount && SameKey(mapped[m], added[a]))
+			m++;
+		merged.push_back(added[a]);
+	}
+	while (m < mappedCount)
+		merged.push_back(mapped[m++]);
+
+	// renamed over the old file later, which must not be mapped then
+	UnmapCache();
+
+	FILE *fp = fopen(temp.c_str(), "wb");
+	RomCacheHeader head;
+	bool ok;
+
+	if (!fp)
+		return false;
+
+	memset(&head, 0, sizeof(head));
+	memcpy(head.magic, "FCEUXRC", 8);
+	head.version = ROMCACHE_VERSION;
+	head.byteOrder = ROMCACHE_BYTEORDER;
+	head.entrySize = sizeof(RomCacheEntry);
+	head.count = (uint32)merged.size();
+
+	ok = fwrite(&head, sizeof(head), 1, fp) == 1;
+	if (ok && !merged.empty())
+		ok = fwrite(&merged[0], sizeof(RomCacheEntry), merged.size(), fp) == merged.size();
+	ok = (fclose(fp) == 0) && ok;
+	if (!ok)
+		remove(temp.c_str());
+	return ok;
+}
+
+bool FCEUI_RomCacheFlush(void)
+{
+	std::lock_guard<std::mutex> guard(cacheLock);
+
+	if (added.empty())
+		return true;
+
+	std::string path = CachePath();
+	if (path.empty())
+		return false;
+
+	// per process, so two instances flushing at once don't write into one file
+	char pid[16];
+	snprintf(pid, sizeof(pid), ".%d", (int)getpid());
+	std::string temp = path + pid;
+
+	// merged with the file as it is on disk, not as it was mapped: other instances may have
+	// flushed since. if one does while this is written, it's merged again
+	for (int tries = 0; ; tries++)
+	{
+		struct stat before;
+		bool existed = !stat(path.c_str(), &before);
+
+		UnmapCache();
+		MapCache();
+		if (!WriteMerged(temp))
+			return false;
+		if (tries < 4 && CacheChanged(path, existed, before))
+		{
+			remove(temp.c_str());
+			continue;
+		}
+		break;
+	}
+
+#ifdef WIN32
+	remove(path.c_str());
+#endif
+	if (rename(temp.c_str(), path.c_str()))
+	{
+		remove(temp.c_str());
+		return false;
+	}
+	added.clear();
+	return true;
+}
+
+void FCEUI_RomCacheClose(void)
+{
+	std::lock_guard<std::mutex> guard(cacheLock);
+
+	UnmapCache();
+}
@@ -0,0 +1,69 @@
+#ifndef _ROMCACHE_H_
+#define _ROMCACHE_H_
+
+// Metadata cache of the ROM images loaded before.
+//
+// An entry is keyed by the size, modification time and CRC32 of a ROM file (for
+// a file in an archive the archive's time) and holds what loading it found out:
+// the format, its MD5, the mapper, mirroring and battery after the header fixups
+// and the input devices it wants. The entries are kept sorted by key in
+// romcache.dat in the base directory, which is mapped and binary searched in
+// place, so a lookup costs the same with ten or with fifty thousand ROMs.
+//
+// Loading a cached ROM tries its format's loader first and skips the MD5 and
+// CRC32 of the image. Frontends can show the metadata without loading anything.
+
+#include "types.h"
+
+struct FCEUFILE;
+
+#define ROMCACHE_INES   1
+#define ROMCACHE_NSF    2
+#define ROMCACHE_UNIF   3
+#define ROMCACHE_FDS    4
+
+#define ROMCACHE_BATTERY  0x01
+#define ROMCACHE_VSUNI    0x02
+
+// Written to the file as is, so the layout must not change without bumping
+// ROMCACHE_VERSION in romcache.cpp.
+struct RomCacheEntry
+{
+	// key
+	uint64 size;
+	uint64 mtime;
+	uint32 crc32;        // of the whole file
+
+	uint8  format;       // ROMCACHE_INES, ...
+	uint8  flags;        // ROMCACHE_BATTERY, ...
+	uint16 reserved;
+	uint8  md5[16];      // GameInfo->MD5
+	uint32 romcrc32;     // iNES: of PRG and CHR
+	int32  mapper;       // iNES: after the header fixups, -1 otherwise
+	int32  mirroring;    // iNES: after the header fixups, -1 otherwise
+	int32  input[2];     // GameInfo->input
+	int32  inputfc;
+};
+
+// The entry of the ROM being loaded if it was in the cache, NULL otherwise.
+extern const RomCacheEntry *romCacheCurrent;
+
+// Fills in the key of an opened ROM file and rewinds it. False if the file
+// can't be looked up (no file on disk to take the time of).
+bool FCEU_RomCacheKey(FCEUFILE *fp, RomCacheEntry *entry);
+
+// Looks up the entry with the key in *entry and copies it there.
+bool FCEUI_RomCacheFind(RomCacheEntry *entry);
+
+// Adds or replaces an entry. It's written to the file by FCEUI_RomCacheFlush(),
+// which FCEUI_Kill(), FCEUI_SetBaseDirectory() and exit() call, so loading many
+// ROMs rewrites the file once instead of once per ROM.
+void FCEUI_RomCacheAdd(const RomCacheEntry &entry);
+
+// Writes the added entries, merged with those in the file as it is on disk then.
+bool FCEUI_RomCacheFlush(void);
+
+// Unmaps the file, e.g. before the base directory changes.
+void FCEUI_RomCacheClose(void);
+
+#endif
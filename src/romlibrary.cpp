@@ -0,0 +1,453 @@
+/// \file
+/// \brief Parallel scanner of ROM directories and zip archives, see romlibrary.h
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "romcache.h"
+#include "romlibrary.h"
+#include "utils/crc32.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#ifdef _SYSTEM_MINIZIP
+#ifdef __linux
+#include <minizip/unzip.h>
+#else // Apple Most Likely
+#include <unzip.h>
+#endif
+#else
+#include "utils/unzip.h"
+#endif
+
+#define ROMLIBRARY_VERSION      2
+#define ROMLIBRARY_FILE         "romlibrary.txt"
+#define ROMLIBRARY_MAX_THREADS  16
+#define ROMLIBRARY_HEADER       16   // bytes needed to tell the format
+
+// the extensions FCEU_fopen() takes from an archive
+static bool IsRomName(const char *name)
+{
+	static const char *exts[] = { ".nes", ".fds", ".nsf", ".unf", ".unif", ".nez", NULL };
+	size_t len = strlen(name);
+
+	for (int i = 0; exts[i]; i++)
+	{
+		size_t elen = strlen(exts[i]);
+
+		if (len > elen && !strcasecmp(name + len - elen, exts[i]))
+			return true;
+	}
+	return false;
+}
+
+static bool IsZipName(const char *name)
+{
+	size_t len = strlen(name);
+
+	return len > 4 && !strcasecmp(name + len - 4, ".zip");
+}
+
+// Fills in format and the header fields from the first bytes of the image.
+static bool ParseHeader(RomLibraryEntry &entry, const uint8 *h, uint32 len)
+{
+	entry.format = 0;
+	entry.mapper = -1;
+	entry.prg = 0;
+	entry.chr = 0;
+	entry.flags = 0;
+
+	if (len >= 16 && !memcmp(h, "NES\x1a", 4))
+	{
+		entry.format = ROMCACHE_INES;
+		entry.mapper = (h[6] >> 4) | (h[7] & 0xF0);
+		entry.prg = h[4];
+		entry.chr = h[5];
+		if ((h[7] & 0x0C) == 0x08)
+		{
+			entry.flags |= ROMLIBRARY_NES20;
+			entry.mapper |= (h[8] & 0x0F) << 8;
+			// sizes in the exponent form aren't multiples of the units, leave them be
+			if ((h[9] & 0x0F) != 0x0F)
+				entry.prg |= (h[9] & 0x0F) << 8;
+			if ((h[9] & 0xF0) != 0xF0)
+				entry.chr |= (h[9] & 0xF0) << 4;
+		}
+		if (h[6] & 0x01)
+			entry.flags |= ROMLIBRARY_VERTICAL;
+		if (h[6] & 0x02)
+			entry.flags |= ROMLIBRARY_BATTERY;
+		if (h[6] & 0x04)
+			entry.flags |= ROMLIBRARY_TRAINER;
+		if (h[6] & 0x08)
+			entry.flags |= ROMLIBRARY_FOURSCREEN;
+		return true;
+	}
+	if (len >= 5 && !memcmp(h, "FDS\x1a", 4))
+	{
+		entry.format = ROMCACHE_FDS;
+		entry.prg = h[4];
+		return true;
+	}
+	if (len >= 15 && !memcmp(h, "\x01*NINTENDO-HVC*", 15))
+	{
+		// headerless, made of 65500 byte sides
+		entry.format = ROMCACHE_FDS;
+		entry.prg = (int)(entry.size / 65500);
+		return true;
+	}
+	if (len >= 7 && !memcmp(h, "NESM\x1a", 5))
+	{
+		entry.format = ROMCACHE_NSF;
+		entry.prg = h[6];
+		return true;
+	}
+	if (len >= 4 && !memcmp(h, "UNIF", 4))
+	{
+		entry.format = ROMCACHE_UNIF;
+		return true;
+	}
+	return false;
+}
+
+static uint64 FileTime(const std::string &path)
+{
+	struct stat st;
+
+	if (stat(path.c_str(), &st))
+		return 0;
+	return (uint64)st.st_mtime;
+}
+
+static void ScanFile(const std::string &path, std::vector<RomLibraryEntry> &out)
+{
+	FILE *fp = fopen(path.c_str(), "rb");
+
+	if (!fp)
+		return;
+
+	RomLibraryEntry entry;
+	std::vector<uint8> buf(0x10000);
+	uint8 head[ROMLIBRARY_HEADER];
+	uint32 headLen = 0;
+	uint32 crc = 0;
+	uint64 size = 0;
+	size_t len;
+
+	while ((len = fread(&buf[0], 1, buf.size(), fp)) > 0)
+	{
+		if (headLen < ROMLIBRARY_HEADER)
+		{
+			uint32 n = std::min((uint32)len, ROMLIBRARY_HEADER - headLen);
+
+			memcpy(head + headLen, &buf[0], n);
+			headLen += n;
+		}
+		crc = CalcCRC32(crc, &buf[0], (uint32)len);
+		size += len;
+	}
+	fclose(fp);
+
+	entry.path = path;
+	entry.size = size;
+	entry.mtime = FileTime(path);
+	entry.crc32 = crc;
+	if (ParseHeader(entry, head, headLen))
+		out.push_back(entry);
+}
+
+// Only the header of a member is decompressed, the central directory has the rest.
+static void ScanZip(const std::string &path, std::vector<RomLibraryEntry> &out)
+{
+	unzFile zf = unzOpen(path.c_str());
+
+	if (!zf)
+		return;
+
+	uint64 mtime = FileTime(path);
+	size_t first = out.size();
+	int ret = unzGoToFirstFile(zf);
+
+	while (ret == UNZ_OK)
+	{
+		unz_file_info fi;
+		char name[512];
+
+		if (unzGetCurrentFileInfo(zf, &fi, name, sizeof(name), NULL, 0, NULL, 0) == UNZ_OK
+			&& IsRomName(name) && unzOpenCurrentFile(zf) == UNZ_OK)
+		{
+			RomLibraryEntry entry;
+			uint8 head[ROMLIBRARY_HEADER];
+			int len = unzReadCurrentFile(zf, head, sizeof(head));
+
+			unzCloseCurrentFile(zf);
+
+			entry.path = path;
+			entry.member = name;
+			entry.size = fi.uncompressed_size;
+			entry.mtime = mtime;
+			entry.crc32 = (uint32)fi.crc;
+			if (len > 0 && ParseHeader(entry, head, (uint32)len))
+				out.push_back(entry);
+		}
+		ret = unzGoToNextFile(zf);
+	}
+	unzClose(zf);
+
+	std::sort(out.begin() + first, out.end(),
+		[](const RomLibraryEntry &a, const RomLibraryEntry &b) { return a.member < b.member; });
+}
+
+// Collects the ROMs and archives below dir, each directory's names in order.
+static void ListFiles(const std::string &dir, std::vector<std::string> &files, int depth)
+{
+	std::vector<std::string> names;
+
+	// a symlink loop shouldn't take the scan down with it
+	if (depth > 32)
+		return;
+
+#ifdef WIN32
+	WIN32_FIND_DATAA fd;
+	HANDLE h = FindFirstFileA((dir + "\\*").c_str(), &fd);
+
+	if (h == INVALID_HANDLE_VALUE)
+		return;
+	do
+		names.push_back(fd.cFileName);
+	while (FindNextFileA(h, &fd));
+	FindClose(h);
+#else
+	DIR *d = opendir(dir.c_str());
+	struct dirent *de;
+
+	if (!d)
+		return;
+	while ((de = readdir(d)) != NULL)
+		names.push_back(de->d_name);
+	closedir(d);
+#endif
+
+	std::sort(names.begin(), names.end());
+
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		const std::string &name = names[i];
+		std::string path = dir + PSS + name;
+		struct stat st;
+
+		if (name[0] == '.' || stat(path.c_str(), &st))
+			continue;
+		if ((st.st_mode & S_IFMT) == S_IFDIR)
+			ListFiles(path, files, depth + 1);
+		else if (IsRomName(name.c_str()) || IsZipName(name.c_str()))
+			files.push_back(path);
+	}
+}
+
+bool FCEUI_RomLibraryScan(const char *dir, std::vector<RomLibraryEntry> &entries, int threads)
+{
+	struct stat st;
+
+	entries.clear();
+	if (stat(dir, &st) || (st.st_mode & S_IFMT) != S_IFDIR)
+		return false;
+
+	std::string root = dir;
+	std::vector<std::string> files;
+
+	while (root.size() > 1 && (root[root.size() - 1] == '/' || root[root.size() - 1] == '\\'))
+		root.erase(root.size() - 1);
+	ListFiles(root, files, 0);
+
+	if (threads < 0)
+		threads = (int)std::thread::hardware_concurrency();
+	threads = std::max(1, std::min(threads, ROMLIBRARY_MAX_THREADS));
+	threads = std::min(threads, std::max(1, (int)files.size()));
+
+	// files are handed out one at a time, archives and plain ROMs take very
+	// different times to read
+	std::vector<std::vector<RomLibraryEntry> > found(files.size());
+	std::atomic<size_t> next(0);
+
+	auto worker = [&]()
+	{
+		size_t i;
+
+		while ((i = next++) < files.size())
+		{
+			if (IsZipName(files[i].c_str()))
+				ScanZip(files[i], found[i]);
+			else
+				ScanFile(files[i], found[i]);
+		}
+	};
+
+	std::vector<std::thread> pool;
+
+	for (int i = 1; i < threads; i++)
+		pool.push_back(std::thread(worker));
+	worker();
+	for (size_t i = 0; i < pool.size(); i++)
+		pool[i].join();
+
+	for (size_t i = 0; i < found.size(); i++)
+		entries.insert(entries.end(), found[i].begin(), found[i].end());
+	return true;
+}
+
+// Paths and zip member names may hold tabs and line breaks, which are written as \t, \n
+// and \r so they don't split the line. A backslash is written as \\.
+static std::string EscapeField(const std::string &s)
+{
+	std::string ret;
+
+	for (size_t i = 0; i < s.size(); i++)
+	{
+		switch (s[i])
+		{
+		case '\\': ret += "\\\\"; break;
+		case '\t': ret += "\\t"; break;
+		case '\n': ret += "\\n"; break;
+		case '\r': ret += "\\r"; break;
+		default:   ret += s[i]; break;
+		}
+	}
+	return ret;
+}
+
+static std::string UnescapeField(const std::string &s)
+{
+	std::string ret;
+
+	for (size_t i = 0; i < s.size(); i++)
+	{
+		if (s[i] != '\\' || i + 1 == s.size())
+		{
+			ret += s[i];
+			continue;
+		}
+		switch (s[++i])
+		{
+		case 't': ret += '\t'; break;
+		case 'n': ret += '\n'; break;
+		case 'r': ret += '\r'; break;
+		default:  ret += s[i]; break;
+		}
+	}
+	return ret;
+}
+
+bool FCEUI_RomLibraryWrite(const char *fname, const std::vector<RomLibraryEntry> &entries)
+{
+	FILE *fp = fopen(fname, "w");
+
+	if (!fp)
+		return false;
+
+	fprintf(fp, "# FCEUX ROM library %d: path\tmember\tsize\tmtime\tcrc32\tformat\tmapper\tprg\tchr\tflags\n", ROMLIBRARY_VERSION);
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		const RomLibraryEntry &e = entries[i];
+
+		fprintf(fp, "%s\t%s\t%llu\t%llu\t%08x\t%d\t%d\t%d\t%d\t%d\n",
+			EscapeField(e.path).c_str(), EscapeField(e.member).c_str(), (unsigned long long)e.size, (unsigned long long)e.mtime,
+			e.crc32, e.format, e.mapper, e.prg, e.chr, e.flags);
+	}
+	return (fclose(fp) == 0);
+}
+
+bool FCEUI_RomLibraryLoad(const char *fname, std::vector<RomLibraryEntry> &entries)
+{
+	std::ifstream in(fname);
+	std::string line;
+	char expect[32];
+
+	entries.clear();
+	if (!in || !std::getline(in, line))
+		return false;
+
+	sprintf(expect, "# FCEUX ROM library %d:", ROMLIBRARY_VERSION);
+	if (line.compare(0, strlen(expect), expect))
+		return false;
+
+	while (std::getline(in, line))
+	{
+		std::vector<std::string> field;
+		size_t start = 0, tab;
+
+		while ((tab = line.find('\t', start)) != std::string::npos)
+		{
+			field.push_back(line.substr(start, tab - start));
+			start = tab + 1;
+		}
+		field.push_back(line.substr(start));
+		if (field.size() != 10)
+			continue;
+
+		RomLibraryEntry e;
+
+		e.path = UnescapeField(field[0]);
+		e.member = UnescapeField(field[1]);
+		e.size = strtoull(field[2].c_str(), NULL, 10);
+		e.mtime = strtoull(field[3].c_str(), NULL, 10);
+		e.crc32 = (uint32)strtoul(field[4].c_str(), NULL, 16);
+		e.format = atoi(field[5].c_str());
+		e.mapper = atoi(field[6].c_str());
+		e.prg = atoi(field[7].c_str());
+		e.chr = atoi(field[8].c_str());
+		e.flags = atoi(field[9].c_str());
+		entries.push_back(e);
+	}
+	return true;
+}
+
+bool FCEUI_RomLibraryIndex(const char *dir, const char *fname, int threads)
+{
+	std::vector<RomLibraryEntry> entries;
+	std::string out = fname ? fname : "";
+	int formats[5] = { 0 };
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	if (out.empty())
+		out = std::string(FCEUI_GetBaseDirectory()) + PSS + ROMLIBRARY_FILE;
+
+	if (!FCEUI_RomLibraryScan(dir, entries, threads))
+	{
+		FCEU_printf("Can't scan %s, it isn't a directory.\n", dir);
+		return false;
+	}
+	double secs = std::chrono::duration<double>(Clock::now() - start).count();
+
+	for (size_t i = 0; i < entries.size(); i++)
+		formats[entries[i].format]++;
+
+	FCEU_printf("%d ROMs (iNES %d, FDS %d, NSF %d, UNIF %d) in %s, %.2f s.\n",
+		(int)entries.size(), formats[ROMCACHE_INES], formats[ROMCACHE_FDS], formats[ROMCACHE_NSF],
+		formats[ROMCACHE_UNIF], dir, secs);
+
+	if (!FCEUI_RomLibraryWrite(out.c_str(), entries))
+	{
+		FCEU_printf("Can't write the ROM library index to %s.\n", out.c_str());
+		return false;
+	}
+	FCEU_printf("Wrote the index to %s.\n", out.c_str());
+	return true;
+}
@@ -0,0 +1,50 @@
+#ifndef _ROMLIBRARY_H_
+#define _ROMLIBRARY_H_
+
+// Indexing of a directory tree of ROMs for frontends.
+//
+// The scan walks the tree, then a pool of threads identifies each file by the
+// first 16 bytes of the iNES, FDS, NSF or UNIF image and computes its CRC32.
+// Zip archives are read from their central directory: a member's size and CRC32
+// are stored there, so only its header gets decompressed. Other archives and
+// files with unknown extensions are skipped.
+//
+// size, mtime and crc32 are the key of the ROM cache (see romcache.h), so an
+// entry can be matched with what loading the ROM found out.
+
+#include "types.h"
+
+#include <string>
+#include <vector>
+
+#define ROMLIBRARY_BATTERY     0x01
+#define ROMLIBRARY_FOURSCREEN  0x02
+#define ROMLIBRARY_VERTICAL    0x04
+#define ROMLIBRARY_NES20       0x08
+#define ROMLIBRARY_TRAINER     0x10
+
+struct RomLibraryEntry
+{
+	std::string path;    // the file or the zip archive
+	std::string member;  // the file in the archive, empty if not in one
+	uint64 size;
+	uint64 mtime;        // of the file or the archive
+	uint32 crc32;        // of the whole file
+	int format;          // ROMCACHE_INES, ...
+	int mapper;          // iNES: from the header, -1 otherwise
+	int prg;             // iNES: PRG in 16 KiB, FDS: disk sides, NSF: songs
+	int chr;             // iNES: CHR in 8 KiB
+	int flags;           // iNES: ROMLIBRARY_BATTERY, ...
+};
+
+// Scans dir and everything below it with the given number of threads, -1 for
+// one per CPU. The entries come sorted by path and member.
+bool FCEUI_RomLibraryScan(const char *dir, std::vector<RomLibraryEntry> &entries, int threads);
+
+// The index file is text, one tab separated line per entry, with tabs, line breaks
+// and backslashes in names escaped by a backslash. FCEUI_RomLibraryIndex() in
+// driver.h does the scan and the write for the command line.
+bool FCEUI_RomLibraryWrite(const char *fname, const std::vector<RomLibraryEntry> &entries);
+bool FCEUI_RomLibraryLoad(const char *fname, std::vector<RomLibraryEntry> &entries);
+
+#endif
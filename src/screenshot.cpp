@@ -0,0 +1,347 @@
+/// \file
+/// \brief Screenshots encoded to PNG and written by a background thread
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "file.h"
+#include "video.h"
+#include "palette.h"
+#include "screenshot.h"
+#include "utils/crc32.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+#define SCREENSHOT_MAX_PENDING   64		// queued screenshots before taking another one waits
+#define SCREENSHOT_MAX_NUMBER    99999
+
+struct ScreenshotJob
+{
+	std::string fname;
+	int number;					// snapshot number, -1 for a named screenshot
+	bool indexed;				// palette indexed PNG, RGB otherwise
+	int lines;
+	std::vector<uint8> pixels;	// XBuf lines
+	std::vector<uint8> deemph;	// XDBuf lines, RGB only
+	uint32 colors[PALETTE_8BIT + 256];	// RGB: paletteLUT, then the 8 bit palette
+	uint8 palette[256 * 3];		// indexed: the palette written to the PLTE chunk
+};
+
+struct ScreenshotResult
+{
+	int number;
+	bool ok;
+};
+
+static std::mutex queueLock;
+static std::condition_variable wakeWorker;
+static std::condition_variable jobDone;
+static std::deque<ScreenshotJob*> pending;
+static std::vector<ScreenshotResult> results;
+static std::thread worker;
+static bool busy = false;		// worker is writing a screenshot
+static bool stopping = false;
+
+static int nextNumber = -1;		// next free snapshot number, -1 if not looked up yet
+
+static int WritePNGChunk(FILE *fp, uint32 size, const char *type, uint8 *data)
+{
+	uint32 crc;
+
+	uint8 tempo[4];
+
+	tempo[0]=size>>24;
+	tempo[1]=size>>16;
+	tempo[2]=size>>8;
+	tempo[3]=size;
+
+	if(fwrite(tempo,4,1,fp)!=1)
+		return 0;
+	if(fwrite(type,4,1,fp)!=1)
+		return 0;
+
+	if(size)
+		if(fwrite(data,1,size,fp)!=size)
+			return 0;
+
+	crc=CalcCRC32(0,(uint8 *)type,4);
+	if(size)
+		crc=CalcCRC32(crc,data,size);
+
+	tempo[0]=crc>>24;
+	tempo[1]=crc>>16;
+	tempo[2]=crc>>8;
+	tempo[3]=crc;
+
+	if(fwrite(tempo,4,1,fp)!=1)
+		return 0;
+	return 1;
+}
+
+// Filtered scanlines of the image: a filter byte and the pixels of each line.
+static void BuildImage(const ScreenshotJob &job, std::vector<uint8> &image)
+{
+	const uint8 *src = &job.pixels[0];
+	int bpp = job.indexed ? 1 : 3;
+
+	image.resize((256 * bpp + 1) * job.lines);
+	uint8 *dest = &image[0];
+
+	for (int y = 0; y < job.lines; y++)
+	{
+		*dest++ = 0;		// No filter.
+
+		if (job.indexed)
+		{
+			memcpy(dest, src, 256);
+			dest += 256;
+			src += 256;
+			continue;
+		}
+
+		const uint8 *deemph = &job.deemph[y * 256];
+
+		for (int x = 0; x < 256; x++, src++)
+		{
+			uint32 color = job.colors[FCEU_PaletteIndex(*src, deemph[x])];
+
+			*dest++ = (color >> 0x10) & 0xFF;
+			*dest++ = (color >> 0x08) & 0xFF;
+			*dest++ = (color >> 0x00) & 0xFF;
+		}
+	}
+}
+
+static bool WritePNG(const ScreenshotJob &job)
+{
+	std::vector<uint8> image;
+	BuildImage(job, image);
+
+	uLongf compsize = compressBound(image.size());
+	std::vector<uint8> comp(compsize);
+
+	if (compress(&comp[0], &compsize, &image[0], image.size()) != Z_OK)
+		return false;
+
+	FILE *pp = FCEUD_UTF8fopen(job.fname.c_str(), "wb");
+
+	if (!pp)
+		return false;
+
+	static const uint8 header[8]={137,80,78,71,13,10,26,10};
+	uint8 chunko[13];
+
+	chunko[0]=chunko[1]=chunko[3]=0;
+	chunko[2]=0x1;			// Width of 256
+
+	chunko[4]=chunko[5]=chunko[6]=0;
+	chunko[7]=job.lines;		// Height
+
+	chunko[8]=8;				// 8 bits per sample
+	chunko[9]=job.indexed ? 3 : 2;	// Color type; indexed 8-bit or RGB triplet
+	chunko[10]=0;				// compression: deflate
+	chunko[11]=0;				// Basic adapative filter set(though none are used).
+	chunko[12]=0;				// No interlace.
+
+	bool ok = (fwrite(header,8,1,pp) == 1) && WritePNGChunk(pp,13,"IHDR",chunko);
+
+	if (ok && job.indexed)
+		ok = WritePNGChunk(pp,256*3,"PLTE",(uint8 *)job.palette);
+	if (ok)
+		ok = WritePNGChunk(pp,compsize,"IDAT",&comp[0]);
+	if (ok)
+		ok = WritePNGChunk(pp,0,"IEND",0);
+
+	if (fclose(pp))
+		ok = false;
+	return ok;
+}
+
+static void WorkerMain(void)
+{
+	std::unique_lock<std::mutex> guard(queueLock);
+
+	for (;;)
+	{
+		while (pending.empty() && !stopping)
+			wakeWorker.wait(guard);
+		if (pending.empty())
+			break;
+
+		ScreenshotJob *job = pending.front();
+		pending.pop_front();
+		busy = true;
+		jobDone.notify_all();		// room in the queue again
+
+		guard.unlock();
+		ScreenshotResult result;
+		result.number = job->number;
+		result.ok = WritePNG(*job);
+		delete job;
+		guard.lock();
+
+		results.push_back(result);
+		busy = false;
+		jobDone.notify_all();
+	}
+}
+
+static void Enqueue(ScreenshotJob *job)
+{
+	std::unique_lock<std::mutex> guard(queueLock);
+
+	while (pending.size() >= SCREENSHOT_MAX_PENDING)
+		jobDone.wait(guard);
+
+	if (!worker.joinable())
+	{
+		stopping = false;
+		worker = std::thread(WorkerMain);
+	}
+	pending.push_back(job);
+	wakeWorker.notify_one();
+}
+
+static ScreenshotJob* CopyFrame(bool indexed)
+{
+	ScreenshotJob *job = new ScreenshotJob;
+	int first = FSettings.FirstSLine;
+
+	job->indexed = indexed;
+	job->lines = FSettings.LastSLine - first + 1;
+	job->pixels.assign(XBuf + first * 256, XBuf + (first + job->lines) * 256);
+
+	if (indexed)
+	{
+		for (int x = 0; x < 256; x++)
+			FCEUD_GetPalette(x, job->palette + x * 3, job->palette + x * 3 + 1, job->palette + x * 3 + 2);
+	}
+	else
+	{
+		uint8 rgb[3];
+
+		job->deemph.assign(XDBuf + first * 256, XDBuf + (first + job->lines) * 256);
+		memcpy(job->colors, paletteLUT, sizeof(paletteLUT));
+		for (int x = 0; x < 256; x++)
+		{
+			FCEUD_GetPalette(x, rgb, rgb + 1, rgb + 2);
+			job->colors[PALETTE_8BIT + x] = (rgb[0] << 16) | (rgb[1] << 8) | rgb[2];
+		}
+	}
+	return job;
+}
+
+// Finds the first snapshot number without a file, done once per game.
+static void FindNextNumber(void)
+{
+	int u;
+
+	// files of a previous game with the same name may still be on the way
+	FCEU_ScreenshotFlush();
+
+	for (u = 0; u < SCREENSHOT_MAX_NUMBER; ++u)
+	{
+		FILE *pp = FCEUD_UTF8fopen(FCEU_MakeFName(FCEUMKF_SNAP, u, "png").c_str(), "rb");
+
+		if (pp == NULL)
+			break;
+		fclose(pp);
+	}
+	nextNumber = u;
+}
+
+bool FCEU_ScreenshotQueue(void)
+{
+	if (!XBuf || !XDBuf)
+		return false;
+
+	if (nextNumber < 0)
+		FindNextNumber();
+	if (nextNumber >= SCREENSHOT_MAX_NUMBER)
+		return false;
+
+	ScreenshotJob *job = CopyFrame(false);
+
+	job->number = nextNumber++;
+	job->fname = FCEU_MakeFName(FCEUMKF_SNAP, job->number, "png");
+	Enqueue(job);
+	return true;
+}
+
+bool FCEU_ScreenshotQueueAs(const char *fname)
+{
+	if (!XBuf)
+		return false;
+
+	ScreenshotJob *job = CopyFrame(true);
+
+	job->number = -1;
+	job->fname = fname;
+	Enqueue(job);
+	return true;
+}
+
+void FCEU_ScreenshotPoll(void)
+{
+	std::vector<ScreenshotResult> done;
+
+	{
+		std::lock_guard<std::mutex> guard(queueLock);
+
+		if (results.empty())
+			return;
+		done.swap(results);
+	}
+
+	for (size_t i = 0; i < done.size(); i++)
+	{
+		if (!done[i].ok)
+			FCEU_DispMessage("Error saving screen snapshot.",0);
+		else if (done[i].number < 0)
+			FCEU_DispMessage("Snapshot Saved.",0);
+		else
+			FCEU_DispMessage("Screen snapshot %d saved.",0,done[i].number);
+	}
+}
+
+void FCEU_ScreenshotFlush(void)
+{
+	std::unique_lock<std::mutex> guard(queueLock);
+
+	while (!pending.empty() || busy)
+		jobDone.wait(guard);
+}
+
+void FCEU_ScreenshotStop(void)
+{
+	{
+		std::lock_guard<std::mutex> guard(queueLock);
+
+		if (!worker.joinable())
+			return;
+		stopping = true;
+		wakeWorker.notify_one();
+	}
+	worker.join();
+}
+
+void FCEU_ScreenshotResetCounter(void)
+{
+	nextNumber = -1;
+}
+
+// the thread has to be joined before it's destroyed, in case the driver exits without FCEUI_Kill()
+static struct ScreenshotWorkerGuard
+{
+	~ScreenshotWorkerGuard()
+	{
+		FCEU_ScreenshotStop();
+	}
+} workerGuard;
@@ -0,0 +1,30 @@
+#ifndef _SCREENSHOT_H_
+#define _SCREENSHOT_H_
+
+// Background screenshot encoding.
+//
+// Taking a screenshot only copies the visible lines of XBuf, their deemphasis
+// bits and the colors to convert them with, and queues the copy for a worker
+// thread that builds and writes the PNG. The number of the next free snapshot
+// file is looked up once per game and counted up in memory from there. Results
+// are reported on the emulation thread by FCEU_ScreenshotPoll().
+
+// Queues a screenshot to the next numbered snapshot file. Returns false if it can't be taken.
+bool FCEU_ScreenshotQueue(void);
+
+// Queues a screenshot as a palette indexed PNG with the given file name.
+bool FCEU_ScreenshotQueueAs(const char *fname);
+
+// Displays the messages of the screenshots written since the last call.
+void FCEU_ScreenshotPoll(void);
+
+// Waits until all queued screenshots have been written.
+void FCEU_ScreenshotFlush(void);
+
+// Writes the queued screenshots and stops the worker thread.
+void FCEU_ScreenshotStop(void);
+
+// Looks for the next free snapshot number again on the next screenshot (new game).
+void FCEU_ScreenshotResetCounter(void);
+
+#endif
@@ -26,6 +26,7 @@
 #include "filter.h"
 #include "state.h"
 #include "wave.h"
+#include "capture.h"
 #include "debug.h"
 
 #include <cstdlib>
@@ -1105,6 +1106,7 @@ int FlushEmulateSound(void)
 
   FCEU_WriteWaveData(WaveFinal, end); /* This function will just return
 				    if sound recording is off. */
+  FCEU_CaptureAudio(WaveFinal, end);
   return(end);
 }
 
@@ -389,7 +389,8 @@ bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel)
 
 		//MBG TAS Editor HACK HACK HACK!
 		//do not save the movie state if we are in Taseditor! That would be a huge waste of time and space!
-		if(!FCEUMOV_Mode(MOVIEMODE_TASEDITOR))
+		//same for movie keyframes, they are checked against the movie by themselves
+		if(!FCEUMOV_Mode(MOVIEMODE_TASEDITOR) && !FCEUMOV_SavingKeyframe())
 		{
 			os->fseek(5,SEEK_CUR);
 			int size = FCEUMOV_WriteState(os);
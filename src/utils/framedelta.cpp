@@ -0,0 +1,245 @@
+/// \file
+/// \brief Frame delta coding of palette indexed frames, see framedelta.h
+
+#include <string.h>
+#include "framedelta.h"
+
+#define TILE_EMPHASIS_EACH  8
+#define TILE_SOLID          0x10
+
+static bool TileEqual(const uint8 *a, const uint8 *b, int stride, int h)
+{
+	for (int y = 0; y < h; y++, a += stride, b += stride)
+		if (memcmp(a, b, 8))
+			return false;
+	return true;
+}
+
+static void CopyTile(uint8 *dest, const uint8 *src, int stride, int h)
+{
+	for (int y = 0; y < h; y++, dest += stride, src += stride)
+		memcpy(dest, src, 8);
+}
+
+// Writes a tile of h lines, returns the position after it.
+static uint8 *WriteTile(uint8 *dest, const uint8 *pix, const uint8 *emph, int stride, int h)
+{
+	uint8 p = pix[0], e = emph[0];
+	bool solid = true, sameEmphasis = e < TILE_EMPHASIS_EACH;
+
+	for (int y = 0; y < h; y++)
+		for (int x = 0; x < 8; x++)
+		{
+			if (pix[y * stride + x] != p)
+				solid = false;
+			if (emph[y * stride + x] != e)
+				sameEmphasis = false;
+		}
+
+	*dest++ = (sameEmphasis ? e : TILE_EMPHASIS_EACH) | (solid ? TILE_SOLID : 0);
+
+	if (solid)
+		*dest++ = p;
+	else
+		for (int y = 0; y < h; y++, dest += 8)
+			memcpy(dest, pix + y * stride, 8);
+
+	if (!sameEmphasis)
+		for (int y = 0; y < h; y++, dest += 8)
+			memcpy(dest, emph + y * stride, 8);
+	return dest;
+}
+
+FrameDeltaEncoder::FrameDeltaEncoder()
+	: width(0), lines(0), started(false)
+{
+	memset(colors, 0, sizeof(colors));
+}
+
+void FrameDeltaEncoder::reset(int width, int lines)
+{
+	this->width = width;
+	this->lines = lines;
+	started = false;
+	pixels.assign(width * lines, 0);
+	emphasis.assign(width * lines, 0);
+}
+
+void FrameDeltaEncoder::encode(const uint8 *pixels, const uint8 *emphasis, const uint8 *colors, bool keyframe, std::vector<uint8> &out)
+{
+	int tilesX = width / 8;
+	int tilesY = (lines + 7) / 8;
+	int tiles = tilesX * tilesY;
+	size_t start = out.size();
+
+	if (!started)
+		keyframe = true;
+	started = true;
+
+	// room for the worst case, trimmed at the end
+	out.resize(start + 1 + FRAMEDELTA_COLORS / 8 + FRAMEDELTA_COLORS * 3 + (tiles + 7) / 8 + tiles * (1 + 64 * 2));
+
+	uint8 *base = &out[start];
+	uint8 *dest = base + 1;
+
+	*base = keyframe ? FRAMEDELTA_KEYFRAME : 0;
+
+	if (keyframe || memcmp(colors, this->colors, sizeof(this->colors)))
+	{
+		uint8 *bits = dest;
+
+		*base |= FRAMEDELTA_PALETTE;
+		memset(bits, 0, FRAMEDELTA_COLORS / 8);
+		dest += FRAMEDELTA_COLORS / 8;
+
+		for (int c = 0; c < FRAMEDELTA_COLORS; c++)
+		{
+			if (!keyframe && !memcmp(colors + c * 3, this->colors + c * 3, 3))
+				continue;
+			bits[c >> 3] |= 1 << (c & 7);
+			memcpy(dest, colors + c * 3, 3);
+			dest += 3;
+		}
+		memcpy(this->colors, colors, sizeof(this->colors));
+	}
+
+	uint8 *tileBits = dest;
+
+	if (!keyframe)
+	{
+		memset(tileBits, 0, (tiles + 7) / 8);
+		dest += (tiles + 7) / 8;
+	}
+
+	for (int t = 0; t < tiles; t++)
+	{
+		int ty = t / tilesX;
+		int h = (lines - ty * 8 < 8) ? lines - ty * 8 : 8;
+		size_t ofs = ty * 8 * width + (t % tilesX) * 8;
+
+		if (!keyframe)
+		{
+			if (TileEqual(pixels + ofs, &this->pixels[ofs], width, h)
+			 && TileEqual(emphasis + ofs, &this->emphasis[ofs], width, h))
+				continue;
+			tileBits[t >> 3] |= 1 << (t & 7);
+		}
+		dest = WriteTile(dest, pixels + ofs, emphasis + ofs, width, h);
+		CopyTile(&this->pixels[ofs], pixels + ofs, width, h);
+		CopyTile(&this->emphasis[ofs], emphasis + ofs, width, h);
+	}
+
+	out.resize(dest - &out[0]);
+}
+
+FrameDeltaDecoder::FrameDeltaDecoder()
+	: width(0), lines(0), started(false)
+{
+	memset(colors, 0, sizeof(colors));
+}
+
+void FrameDeltaDecoder::reset(int width, int lines)
+{
+	this->width = width;
+	this->lines = lines;
+	started = false;
+	pixels.assign(width * lines, 0);
+	emphasis.assign(width * lines, 0);
+	memset(colors, 0, sizeof(colors));
+}
+
+bool FrameDeltaDecoder::decode(const uint8 *data, size_t size)
+{
+	const uint8 *end = data + size;
+	int tilesX = width / 8;
+	int tilesY = (lines + 7) / 8;
+	int tiles = tilesX * tilesY;
+
+	if (size < 1)
+		return false;
+
+	uint8 flags = *data++;
+	bool keyframe = (flags & FRAMEDELTA_KEYFRAME) != 0;
+
+	if (!keyframe && !started)
+		return false;
+
+	if (flags & FRAMEDELTA_PALETTE)
+	{
+		const uint8 *bits = data;
+
+		if (end - data < FRAMEDELTA_COLORS / 8)
+			return false;
+		data += FRAMEDELTA_COLORS / 8;
+
+		for (int c = 0; c < FRAMEDELTA_COLORS; c++)
+		{
+			if (!(bits[c >> 3] & (1 << (c & 7))))
+				continue;
+			if (end - data < 3)
+				return false;
+			memcpy(colors + c * 3, data, 3);
+			data += 3;
+		}
+	}
+
+	const uint8 *tileBits = data;
+
+	if (!keyframe)
+	{
+		if (end - data < (tiles + 7) / 8)
+			return false;
+		data += (tiles + 7) / 8;
+	}
+
+	for (int t = 0; t < tiles; t++)
+	{
+		if (!keyframe && !(tileBits[t >> 3] & (1 << (t & 7))))
+			continue;
+
+		int ty = t / tilesX;
+		int h = (lines - ty * 8 < 8) ? lines - ty * 8 : 8;
+		uint8 *pix = &pixels[ty * 8 * width + (t % tilesX) * 8];
+		uint8 *emph = &emphasis[ty * 8 * width + (t % tilesX) * 8];
+
+		if (data >= end)
+			return false;
+
+		uint8 head = *data++;
+		uint8 e = head & 0x0F;
+
+		if (head & TILE_SOLID)
+		{
+			if (data >= end)
+				return false;
+			for (int y = 0; y < h; y++)
+				memset(pix + y * width, *data, 8);
+			data++;
+		}
+		else
+		{
+			if (end - data < h * 8)
+				return false;
+			for (int y = 0; y < h; y++, data += 8)
+				memcpy(pix + y * width, data, 8);
+		}
+
+		if (e == TILE_EMPHASIS_EACH)
+		{
+			if (end - data < h * 8)
+				return false;
+			for (int y = 0; y < h; y++, data += 8)
+				memcpy(emph + y * width, data, 8);
+		}
+		else if (e < TILE_EMPHASIS_EACH)
+		{
+			for (int y = 0; y < h; y++)
+				memset(emph + y * width, e, 8);
+		}
+		else
+			return false;
+	}
+
+	started = true;
+	return data == end;
+}
@@ -0,0 +1,71 @@
+#ifndef _FRAMEDELTA_H_
+#define _FRAMEDELTA_H_
+
+#include <vector>
+#include "../types.h"
+
+// Frame delta coding of palette indexed NES frames.
+//
+// A frame is width*lines pixel values as found in XBuf, the emphasis bits of each
+// pixel as found in XDBuf and the 256 + 512 RGB colors they are shown with: the
+// colors of the pixel values followed by the 64 NES colors under each of the 8
+// emphasis settings. Only the 8x8 tiles and colors that changed since the previous
+// frame are stored, which usually leaves a small fraction of the frame. The output
+// isn't entropy coded, running it through zlib afterwards still pays off.
+//
+// Encoded frame:
+//   flags        1 = keyframe, every tile is stored and nothing depends on earlier
+//                frames; 2 = colors follow
+//   colors       (if flags & 2) a bit per color, set if it changed, LSB first,
+//                followed by the RGB triplets of the changed colors
+//   tile bits    (unless a keyframe) a bit per tile, set if the tile is stored, LSB
+//                first, tiles numbered left to right and top to bottom
+//   tiles        for each stored tile a header byte and its data: the low nibble is
+//                the emphasis of every pixel, or 8 if the emphasis of each pixel
+//                follows the pixel values; 0x10 means all pixels have the single
+//                value that follows instead of a value for each pixel
+
+#define FRAMEDELTA_COLORS    (256 + 512)
+#define FRAMEDELTA_KEYFRAME  1
+#define FRAMEDELTA_PALETTE   2
+
+struct FrameDeltaEncoder
+{
+	FrameDeltaEncoder();
+
+	// Starts a new stream of frames, width has to be a multiple of 8.
+	void reset(int width, int lines);
+
+	// Appends the encoding of a frame to out. The first frame after reset() is
+	// always a keyframe.
+	void encode(const uint8 *pixels, const uint8 *emphasis, const uint8 *colors, bool keyframe, std::vector<uint8> &out);
+
+private:
+	int width, lines;
+	bool started;
+	std::vector<uint8> pixels, emphasis;
+	uint8 colors[FRAMEDELTA_COLORS * 3];
+};
+
+struct FrameDeltaDecoder
+{
+	FrameDeltaDecoder();
+
+	void reset(int width, int lines);
+
+	// Applies an encoded frame to the current one. Returns false if the data is
+	// damaged or no keyframe has been decoded since reset().
+	bool decode(const uint8 *data, size_t size);
+
+	const uint8 *getPixels() const { return &pixels[0]; }
+	const uint8 *getEmphasis() const { return &emphasis[0]; }
+	const uint8 *getColors() const { return colors; }
+
+private:
+	int width, lines;
+	bool started;
+	std::vector<uint8> pixels, emphasis;
+	uint8 colors[FRAMEDELTA_COLORS * 3];
+};
+
+#endif
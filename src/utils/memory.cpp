@@ -28,6 +28,14 @@
 #include "../fceu.h"
 #include "memory.h"
 
+#ifdef WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 ///allocates the specified number of bytes. exits process if this fails
 void *FCEU_gmalloc(uint32 size)
 {
@@ -78,3 +86,92 @@ void FCEU_dfree(void *ptr)
 {
     free(ptr);
 }
+
+static void *MapFile(FILE *fp, uint32 *size, bool copy)
+{
+#ifdef WIN32
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno(fp));
+	LARGE_INTEGER len;
+
+	if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &len) || len.QuadPart <= 0 || len.QuadPart > 0x7FFFFFFF)
+		return 0;
+
+	HANDLE mapping = CreateFileMapping(file, NULL, copy ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+	if (!mapping)
+		return 0;
+
+	//the view keeps the mapping alive
+	void *ret = MapViewOfFile(mapping, copy ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!ret)
+		return 0;
+
+	*size = (uint32)len.QuadPart;
+	return ret;
+#else
+	struct stat st;
+
+	if (fstat(fileno(fp), &st) || st.st_size <= 0 || st.st_size > 0x7FFFFFFF)
+		return 0;
+
+	void *ret = copy
+		? mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(fp), 0)
+		: mmap(0, st.st_size, PROT_READ, MAP_SHARED, fileno(fp), 0);
+	if (ret == MAP_FAILED)
+		return 0;
+
+	*size = (uint32)st.st_size;
+	return ret;
+#endif
+}
+
+///maps the whole file read-only. returns null if this fails, otherwise size receives the file size
+void *FCEU_MapFile(FILE *fp, uint32 *size)
+{
+	return MapFile(fp, size, false);
+}
+
+///maps the whole file copy-on-write: the pages are shared with everyone mapping the file until
+///they are written to, which makes private copies of them. the file itself is never changed
+void *FCEU_MapFileCopy(FILE *fp, uint32 *size)
+{
+	return MapFile(fp, size, true);
+}
+
+///unmaps a file mapped with FCEU_MapFile or FCEU_MapFileCopy
+void FCEU_UnmapFile(void *ptr, uint32 size)
+{
+#ifdef WIN32
+	UnmapViewOfFile(ptr);
+#else
+	munmap(ptr, size);
+#endif
+}
+
+///copies the contents of a mapping out of the file. pointers into it stay valid, the pages
+///stop being shared and the file is no longer held open by the mapping. returns false and
+///leaves the mapping alone if it can't be done
+bool FCEU_UnshareMapping(void *ptr, uint32 size)
+{
+#ifdef WIN32
+	//a view can't be replaced in place, and freeing it first would leave the address up for
+	//grabs by other threads with everything still pointing at it
+	return false;
+#else
+	void *copy = malloc(size);
+	if (!copy)
+		return false;
+	memcpy(copy, ptr, size);
+
+	void *ret = mmap(ptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+	if (ret == MAP_FAILED)
+	{
+		free(copy);
+		return false;
+	}
+
+	memcpy(ptr, copy, size);
+	free(copy);
+	return true;
+#endif
+}
@@ -22,6 +22,8 @@
 		(at least that's the idea) 
 */
 
+#include <stdio.h>
+
 #define FCEU_dwmemset(d,c,n) {int _x; for(_x=n-4;_x>=0;_x-=4) *(uint32 *)&(d)[_x]=c;}
 
 void *FCEU_malloc(uint32 size); // initialized to 0
@@ -34,3 +36,13 @@ void FCEU_memmove(void *d, void *s, uint32 l);
 // normal malloc/free
 void *FCEU_dmalloc(uint32 size);
 void FCEU_dfree(void *ptr);
+
+// read-only mapping of a whole open file, returns null if the file can't be mapped
+void *FCEU_MapFile(FILE *fp, uint32 *size);
+// writable private mapping, pages are copied when they are first written to
+void *FCEU_MapFileCopy(FILE *fp, uint32 *size);
+void FCEU_UnmapFile(void *ptr, uint32 size);
+// replaces a mapping made by FCEU_MapFileCopy with private memory at the same address
+// holding the same bytes, so the file can be overwritten. still unmapped with FCEU_UnmapFile.
+// false if that isn't possible (always on Windows), the mapping is kept then
+bool FCEU_UnshareMapping(void *ptr, uint32 size);
@@ -2,8 +2,6 @@
 #define _VIDEO_H_
 int FCEU_InitVirtualVideo(void);
 void FCEU_KillVirtualVideo(void);
-int SaveSnapshot(void);
-int SaveSnapshot(char[]);
 void ResetScreenshotsCounter();
 uint32 GetScreenPixel(int x, int y, bool usebackup);
 int GetScreenPixelPalette(int x, int y, bool usebackup);
@@ -0,0 +1,77 @@
+/// \file
+/// \brief PPU pattern table change tracking used by the PPU and name table viewers
+#include "types.h"
+#include "fceu.h"
+#include "cart.h"
+#include "vramtrack.h"
+
+// Generation 0 is never handed out, so a viewer that starts with 0 sees
+// every tile that was touched since power on as changed.
+static uint32 currGen = 1;
+static uint32 lastWriteGen = 0;
+static uint32 allGen = 0;
+static uint32 tileGen[VRAMTRACK_NUM_TILES];
+static uint32 bankGen[VRAMTRACK_NUM_BANKS];
+
+// Stamps the tile of every window in pages that shows the byte at p.
+static void StampWindows(uint8 *const *pages, const uint8 *p)
+{
+	for (int w = 0; w < VRAMTRACK_NUM_BANKS; w++)
+	{
+		// the pages are biased by the window's PPU address
+		uintptr_t ofs = (uintptr_t)p - (uintptr_t)(pages[w] + (w << 10));
+
+		if (ofs < 0x400)
+		{
+			tileGen[((w << 10) | ofs) / VRAMTRACK_TILE_SIZE] = currGen;
+		}
+	}
+}
+
+void FCEU_VRAMTrackWrite(uint32 A)
+{
+	// the same CHR RAM bank may be mapped in several windows
+	A &= 0x1FFF;
+	const uint8 *p = VPage[A >> 10] + A;
+
+	StampWindows(VPage, p);
+	if (MMC5Hack)
+	{
+		StampWindows(MMC5BGVPage, p);
+		StampWindows(MMC5SPRVPage, p);
+	}
+	lastWriteGen = currGen;
+}
+
+void FCEU_VRAMTrackBank(uint32 A, int banks)
+{
+	int b = (A & 0x1FFF) >> 10;
+
+	while ((banks-- > 0) && (b < VRAMTRACK_NUM_BANKS))
+	{
+		bankGen[b++] = currGen;
+	}
+	lastWriteGen = currGen;
+}
+
+void FCEU_VRAMTrackInvalidate(void)
+{
+	allGen = lastWriteGen = currGen;
+}
+
+uint32 FCEUI_VRAMTrackSync(void)
+{
+	return currGen++;
+}
+
+bool FCEUI_VRAMTrackTileChanged(int tile, uint32 since)
+{
+	tile &= (VRAMTRACK_NUM_TILES - 1);
+
+	return (tileGen[tile] > since) || (bankGen[tile >> 6] > since) || (allGen > since);
+}
+
+bool FCEUI_VRAMTrackAnyChanged(uint32 since)
+{
+	return lastWriteGen > since;
+}
@@ -0,0 +1,38 @@
+#ifndef _VRAMTRACK_H_
+#define _VRAMTRACK_H_
+
+// PPU pattern table change tracking for the PPU and name table viewers.
+//
+// The core stamps every 16 byte tile of $0000-$1FFF that is written through
+// the PPU, in each 1KB window that maps the written CHR RAM, and every 1KB CHR
+// bank that is switched (MMC5's separate background and sprite banks
+// included), with the current generation. CHR ROM edits from the hex editor
+// invalidate everything. A viewer calls FCEUI_VRAMTrackSync()
+// each time it refreshes and only re-decodes the tiles that changed since the
+// generation it got the previous time. Generations only advance on sync, so
+// they never wrap in practice and any number of viewers can consume the map
+// independently.
+
+#define VRAMTRACK_TILE_SIZE   16
+#define VRAMTRACK_NUM_TILES   (0x2000 / VRAMTRACK_TILE_SIZE)
+#define VRAMTRACK_NUM_BANKS   8
+
+// Called by the core when a byte of CHR RAM is written at PPU address A.
+void FCEU_VRAMTrackWrite(uint32 A);
+
+// Called by the core when 'banks' 1KB CHR banks starting at PPU address A are remapped.
+void FCEU_VRAMTrackBank(uint32 A, int banks);
+
+// Everything changed (power, state load, game genie mapping).
+void FCEU_VRAMTrackInvalidate(void);
+
+// Returns the generation to pass to the queries below on the next refresh.
+uint32 FCEUI_VRAMTrackSync(void);
+
+// True if the tile (PPU address / 16) may have changed after generation 'since'.
+bool FCEUI_VRAMTrackTileChanged(int tile, uint32 since);
+
+// True if the CHR bank mapping or any tile in $0000-$1FFF changed after generation 'since'.
+bool FCEUI_VRAMTrackAnyChanged(uint32 since);
+
+#endif